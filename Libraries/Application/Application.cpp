@@ -17,6 +17,7 @@
 #include "Engine/TimeSpace.hpp"
 #include "Graphics/GraphicsEngine.hpp"
 #include "Graphics/GraphicsSpace.hpp"
+#include "Graphics/NullRenderer.hpp"
 #include "ZilchScript/ZilchScriptManager.hpp"
 #include "ZilchScript/ZilchScriptLibrary.hpp"
 #include "ZilchScript/ZilchComponent.hpp"
@@ -24,6 +25,7 @@
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <limits>
 
 VulkanStatus SurfaceCreationCallback(VkInstance instance, void* userData, VkSurfaceKHR& outSurface)
 {
@@ -70,21 +72,25 @@ void Application::Initialize()
 
   mLastFrameTime = std::chrono::high_resolution_clock::now();
 
-  glfwInit();
-  glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-
-  const int cWidth = 800;
-  const int cHeight = 600;
-  mWindow = glfwCreateWindow(cWidth, cHeight, "Vulkan", nullptr, nullptr);
-  glfwSetWindowUserPointer(mWindow, this);
-  glfwSetFramebufferSizeCallback(mWindow, FramebufferResizeCallback);
-  glfwSetKeyCallback(mWindow, &Application::KeyCallback);
-  glfwSetCursorPosCallback(mWindow, &Application::MouseMoveCallback);
-  glfwSetMouseButtonCallback(mWindow, &Application::MouseButtonCallback);
-  glfwSetScrollCallback(mWindow, &Application::MouseScrollCallback);
+  int width = static_cast<int>(mConfig->mHeadlessWidth);
+  int height = static_cast<int>(mConfig->mHeadlessHeight);
+  if(!mConfig->mHeadless)
+  {
+    glfwInit();
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+
+    const int cWidth = 800;
+    const int cHeight = 600;
+    mWindow = glfwCreateWindow(cWidth, cHeight, "Vulkan", nullptr, nullptr);
+    glfwSetWindowUserPointer(mWindow, this);
+    glfwSetFramebufferSizeCallback(mWindow, FramebufferResizeCallback);
+    glfwSetKeyCallback(mWindow, &Application::KeyCallback);
+    glfwSetCursorPosCallback(mWindow, &Application::MouseMoveCallback);
+    glfwSetMouseButtonCallback(mWindow, &Application::MouseButtonCallback);
+    glfwSetScrollCallback(mWindow, &Application::MouseScrollCallback);
 
-  int width = 0, height = 0;
-  glfwGetFramebufferSize(mWindow, &width, &height);
+    glfwGetFramebufferSize(mWindow, &width, &height);
+  }
 
   GraphicsEngineInitData graphicsInitData;
   graphicsInitData.mResourcesDir = mResourcesDir;
@@ -97,8 +103,17 @@ void Application::Initialize()
   GraphicsEngineRendererInitData rendererInitData;
   rendererInitData.mInitialWidth = width;
   rendererInitData.mInitialHeight = height;
-  rendererInitData.mSurfaceCreationCallback.mCallbackFn = &SurfaceCreationCallback;
-  rendererInitData.mSurfaceCreationCallback.mUserData = this;
+  rendererInitData.mHeadless = mConfig->mHeadless;
+  rendererInitData.mRendererType = mConfig->mNullRenderer ? RendererType::Null : RendererType::Vulkan;
+  rendererInitData.mPipelineCachePath = Zero::FilePath::Combine(mCacheDir, "PipelineCache.bin");
+  rendererInitData.mGpuCullingShaderPath = Zero::FilePath::Combine(mResourcesDir, "Shaders", "CullInstances.spv");
+  rendererInitData.mClusterCullingShaderPath = Zero::FilePath::Combine(mResourcesDir, "Shaders", "CullClusters.spv");
+  rendererInitData.mTextureStreaming.mBudget = mConfig->mTextureBudget;
+  if(!mConfig->mHeadless)
+  {
+    rendererInitData.mSurfaceCreationCallback.mCallbackFn = &SurfaceCreationCallback;
+    rendererInitData.mSurfaceCreationCallback.mUserData = this;
+  }
   graphicsEngine->InitializeRenderer(rendererInitData);
 
   graphicsEngine->PopulateMaterialBuffer();
@@ -109,8 +124,11 @@ void Application::Shutdown()
 {
   GraphicsEngine* graphicsEngine = mEngine->Has<GraphicsEngine>();
   graphicsEngine->Shutdown();
-  glfwDestroyWindow(mWindow);
-  glfwTerminate();
+  if(mWindow != nullptr)
+  {
+    glfwDestroyWindow(mWindow);
+    glfwTerminate();
+  }
 }
 
 void Application::LoadConfiguration()
@@ -120,6 +138,8 @@ void Application::LoadConfiguration()
   Zilch::JsonValue* json = jsonReader.ReadIntoTreeFromFile(errors, "BuildConfig.data", nullptr);
   mShaderCoreDir = json->GetMember("ShaderCoreDir")->AsString();
   mResourcesDir = json->GetMember("ResourcesDir")->AsString();
+  mCacheDir = mConfig->mCacheDir.Empty() ? Zero::FilePath::Combine(mResourcesDir, "Cache") : mConfig->mCacheDir;
+  Zero::CreateDirectory(mCacheDir);
 }
 
 void Application::InitializeResourceSystem()
@@ -128,8 +148,12 @@ void Application::InitializeResourceSystem()
   mResourceSystem.RegisterResourceManager(ArchetypeManager, ArchetypeManager, new ArchetypeManager());
   mResourceSystem.RegisterResourceManager(ZilchScript, ZilchScriptManager, new ZilchScriptManager());
   mResourceSystem.RegisterResourceManager(ZilchFragmentFile, ZilchFragmentFileManager, new ZilchFragmentFileManager());
-  mResourceSystem.RegisterResourceManager(Texture, TextureManager, new TextureManager());
-  mResourceSystem.RegisterResourceManager(Mesh, MeshManager, new MeshManager());
+  TextureManager* textureManager = new TextureManager();
+  textureManager->mCookedDirectory = Zero::FilePath::Combine(mCacheDir, "CookedTextures");
+  mResourceSystem.RegisterResourceManager(Texture, TextureManager, textureManager);
+  MeshManager* meshManager = new MeshManager();
+  meshManager->mCookedDirectory = Zero::FilePath::Combine(mCacheDir, "CookedMeshes");
+  mResourceSystem.RegisterResourceManager(Mesh, MeshManager, meshManager);
   mResourceSystem.RegisterResourceManager(ZilchMaterial, ZilchMaterialManager, new ZilchMaterialManager());
   mResourceSystem.LoadLibrary("BasicProject", Zero::FilePath::Combine(mResourcesDir, "BasicProject"));
 }
@@ -167,6 +191,10 @@ void Application::BuildSpace()
     mSpace->AddComponent(ZilchAllocate(TimeSpace));
   if(mSpace->Has<GraphicsSpace>() == nullptr)
     mSpace->AddComponent(ZilchAllocate(GraphicsSpace));
+  if(mConfig->mGpuCulling)
+    mSpace->Has<GraphicsSpace>()->mGpuCulling = true;
+  if(mConfig->mGpuClusterCulling)
+    mSpace->Has<GraphicsSpace>()->mGpuClusterCulling = true;
   mEngine->Add(mSpace);
   mSpace->Initialize(CompositionInitializer());
 }
@@ -242,6 +270,12 @@ void Application::ReloadResources()
 
 void Application::MainLoop()
 {
+  if(mConfig->mHeadless)
+  {
+    HeadlessLoop();
+    return;
+  }
+
   while(!glfwWindowShouldClose(mWindow))
   {
     glfwPollEvents();
@@ -252,6 +286,43 @@ void Application::MainLoop()
   graphicsEngine->WaitIdle();
 }
 
+void Application::HeadlessLoop()
+{
+  // Run un-throttled so the timings reflect the cost of updating and recording a frame
+  size_t frameCount = mConfig->mHeadlessFrameCount;
+  double totalMs = 0.0;
+  double minMs = std::numeric_limits<double>::max();
+  double maxMs = 0.0;
+  for(size_t i = 0; i < frameCount; ++i)
+  {
+    auto startTime = std::chrono::high_resolution_clock::now();
+    float dt = std::chrono::duration<float, std::chrono::seconds::period>(startTime - mLastFrameTime).count();
+    mLastFrameTime = startTime;
+    mEngine->Update(dt);
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    double frameMs = std::chrono::duration<double, std::chrono::milliseconds::period>(endTime - startTime).count();
+    totalMs += frameMs;
+    minMs = Math::Min(minMs, frameMs);
+    maxMs = Math::Max(maxMs, frameMs);
+    printf("Frame %zu: %.3f ms\n", i, frameMs);
+  }
+
+  GraphicsEngine* graphicsEngine = mEngine->Has<GraphicsEngine>();
+  graphicsEngine->WaitIdle();
+
+  if(frameCount == 0)
+    return;
+  printf("Headless: %zu frames, avg %.3f ms, min %.3f ms, max %.3f ms\n", frameCount, totalMs / frameCount, minMs, maxMs);
+  if(mConfig->mNullRenderer)
+  {
+    const NullRendererStatistics& statistics = static_cast<NullRenderer*>(graphicsEngine->GetRenderer())->mStatistics;
+    printf("Per frame: %zu draws, %zu instances, %zu pipeline binds, %zu vertex buffer binds, %zu uniform bytes\n",
+      statistics.mDrawCount / frameCount, statistics.mInstanceCount / frameCount, statistics.mPipelineBinds / frameCount,
+      statistics.mVertexBufferBinds / frameCount, statistics.mUniformBytesWritten / frameCount);
+  }
+}
+
 void Application::ProcessFrame()
 {
   constexpr float targetFramerate = 1.0f / 60.0f;
@@ -277,6 +348,13 @@ ZilchScriptModule* Application::GetActiveModule()
 
 void Application::QueryWindowSize(size_t& outWidth, size_t& outHeight)
 {
+  if(mConfig->mHeadless)
+  {
+    outWidth = mConfig->mHeadlessWidth;
+    outHeight = mConfig->mHeadlessHeight;
+    return;
+  }
+
   int width = 0, height = 0;
   while(width == 0 || height == 0)
   {
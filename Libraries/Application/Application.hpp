@@ -37,6 +37,7 @@ private:
   void ReloadResources();
 
   void MainLoop();
+  void HeadlessLoop();
   void ProcessFrame();
 
   ZilchScriptModule* GetActiveModule();
@@ -51,12 +52,14 @@ private:
   ApplicationConfig* mConfig = nullptr;
   String mResourcesDir;
   String mShaderCoreDir;
+  // Root of everything generated from the resources, independent of the working directory
+  String mCacheDir;
   ResourceSystem mResourceSystem;
   ZilchScriptLibraryManager mZilchScriptLibraryManager;
 
   Zilch::HandleOf<Engine> mEngine;
   Zilch::HandleOf<Space> mSpace;
   
-  GLFWwindow* mWindow;
+  GLFWwindow* mWindow = nullptr;
   std::chrono::steady_clock::time_point mLastFrameTime;
 };
@@ -9,4 +9,22 @@ struct ApplicationConfig
 
   Zilch::ZilchSetup* mZilchSetup = nullptr;
   Zilch::Module* mNativeModule = nullptr;
+
+  // Headless runs render offscreen with no window for a fixed number of frames and report frame timings
+  bool mHeadless = false;
+  size_t mHeadlessWidth = 800;
+  size_t mHeadlessHeight = 600;
+  size_t mHeadlessFrameCount = 1000;
+  // Headless runs on the null renderer so only building and walking the render queue is timed, no device is needed
+  bool mNullRenderer = false;
+  // Turns on gpu frustum culling for the space, on top of whatever the space's data sets
+  bool mGpuCulling = false;
+  // Turns on gpu cluster culling for the space
+  bool mGpuClusterCulling = false;
+  // Bytes of texture memory streaming keeps resident, zero keeps every mip resident
+  size_t mTextureBudget = 0;
+  // Where the pipeline cache and cooked resources are kept, empty uses a Cache folder in the resources directory
+  Zero::String mCacheDir;
+  // Non-zero runs the frustum culling benchmark on that many spheres instead of the application
+  size_t mCullingBenchmarkCount = 0;
 };
@@ -0,0 +1,67 @@
+#include "Precompiled.hpp"
+
+#include "Benchmarks.hpp"
+
+#include "Graphics/FrustumCulling.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+
+// Fixed seed so every run culls the same scene
+float RandomFloat(uint32_t& state, float min, float max)
+{
+  state = state * 1664525u + 1013904223u;
+  return min + (max - min) * ((state >> 8) / 16777216.0f);
+}
+
+template <typename CullFn>
+double TimeCulling(CullFn cullFn, const Frustum& frustum, const CullingBounds& bounds, size_t iterations, Array<uint32_t>& outVisibleIndices)
+{
+  auto startTime = std::chrono::high_resolution_clock::now();
+  for(size_t i = 0; i < iterations; ++i)
+  {
+    outVisibleIndices.Clear();
+    cullFn(frustum, bounds, outVisibleIndices);
+  }
+  auto endTime = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::chrono::milliseconds::period>(endTime - startTime).count() / iterations;
+}
+
+}//namespace
+
+bool RunCullingBenchmark(size_t sphereCount, size_t iterations)
+{
+  // Spheres fill a box around the camera so about a tenth of them are in view
+  CullingBounds bounds;
+  bounds.Reserve(sphereCount);
+  uint32_t state = 12345u;
+  for(size_t i = 0; i < sphereCount; ++i)
+  {
+    Vec3 center(RandomFloat(state, -100.0f, 100.0f), RandomFloat(state, -100.0f, 100.0f), RandomFloat(state, -100.0f, 100.0f));
+    bounds.Add(center, RandomFloat(state, 0.1f, 2.0f));
+  }
+
+  Matrix4 worldToView;
+  worldToView.SetIdentity();
+  Frustum frustum;
+  BuildFrustum(worldToView, Math::DegToRad(60.0f), 16.0f / 9.0f, 0.1f, 100.0f, frustum);
+
+  Array<uint32_t> simdVisible;
+  Array<uint32_t> scalarVisible;
+  iterations = Math::Max(iterations, static_cast<size_t>(1));
+  double simdMs = TimeCulling(CullSpheres, frustum, bounds, iterations, simdVisible);
+  double scalarMs = TimeCulling(CullSpheresScalar, frustum, bounds, iterations, scalarVisible);
+
+  bool matches = simdVisible.Size() == scalarVisible.Size();
+  for(size_t i = 0; matches && i < simdVisible.Size(); ++i)
+    matches = simdVisible[i] == scalarVisible[i];
+
+  printf("Culling %zu spheres: simd %.3f ms, scalar %.3f ms (%.2fx), %zu visible\n",
+    sphereCount, simdMs, scalarMs, simdMs > 0.0 ? scalarMs / simdMs : 0.0, simdVisible.Size());
+  if(!matches)
+    printf("Culling mismatch: simd kept %zu spheres, scalar kept %zu\n", simdVisible.Size(), scalarVisible.Size());
+  return matches;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+/// Culls sphereCount random spheres against a camera frustum with CullSpheres and CullSpheresScalar,
+/// prints the average time of each, and returns whether both kept exactly the same spheres.
+bool RunCullingBenchmark(size_t sphereCount, size_t iterations);
@@ -1,10 +1,39 @@
 #include "Precompiled.hpp"
 
 #include "Application.hpp"
+#include "Benchmarks.hpp"
 
-int main()
+int main(int argc, char** argv)
 {
   ApplicationConfig config;
+  for(int i = 1; i < argc; ++i)
+  {
+    String arg = argv[i];
+    if(arg == "--headless")
+      config.mHeadless = true;
+    else if(arg == "--null-renderer")
+      config.mHeadless = config.mNullRenderer = true;
+    else if(arg == "--frames" && i + 1 < argc)
+      config.mHeadlessFrameCount = static_cast<size_t>(atoi(argv[++i]));
+    else if(arg == "--width" && i + 1 < argc)
+      config.mHeadlessWidth = static_cast<size_t>(atoi(argv[++i]));
+    else if(arg == "--height" && i + 1 < argc)
+      config.mHeadlessHeight = static_cast<size_t>(atoi(argv[++i]));
+    else if(arg == "--gpu-culling")
+      config.mGpuCulling = true;
+    else if(arg == "--gpu-cluster-culling")
+      config.mGpuClusterCulling = true;
+    else if(arg == "--texture-budget" && i + 1 < argc)
+      config.mTextureBudget = static_cast<size_t>(atoi(argv[++i])) * 1024 * 1024;
+    else if(arg == "--cache-dir" && i + 1 < argc)
+      config.mCacheDir = argv[++i];
+    else if(arg == "--benchmark-culling")
+      config.mCullingBenchmarkCount = (i + 1 < argc && argv[i + 1][0] != '-') ? static_cast<size_t>(atoi(argv[++i])) : 100000;
+  }
+
+  if(config.mCullingBenchmarkCount != 0)
+    return RunCullingBenchmark(config.mCullingBenchmarkCount, 100) ? EXIT_SUCCESS : EXIT_FAILURE;
+
   Application app(&config);
 
   app.Run();
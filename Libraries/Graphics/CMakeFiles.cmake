@@ -14,6 +14,14 @@ target_sources(Graphics
     ${CMAKE_CURRENT_LIST_DIR}/ZilchMaterial.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Mesh.cpp
     ${CMAKE_CURRENT_LIST_DIR}/Mesh.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/MeshClusters.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/MeshClusters.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/MeshCooker.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/MeshCooker.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/MeshOptimizer.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/MeshOptimizer.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/MeshSimplifier.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/MeshSimplifier.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Graphical.cpp
     ${CMAKE_CURRENT_LIST_DIR}/Graphical.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Model.cpp
@@ -28,15 +36,31 @@ target_sources(Graphics
     ${CMAKE_CURRENT_LIST_DIR}/ZilchFragment.hpp
     ${CMAKE_CURRENT_LIST_DIR}/ShaderEnumTypes.cpp
     ${CMAKE_CURRENT_LIST_DIR}/ShaderEnumTypes.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/MipGenerator.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/MipGenerator.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Texture.cpp
     ${CMAKE_CURRENT_LIST_DIR}/Texture.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/TextureCompression.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/TextureCompression.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/TextureCooker.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/TextureCooker.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/TextureStreamer.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/TextureStreamer.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Vertex.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/VertexFormat.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/VertexFormat.hpp
     ${CMAKE_CURRENT_LIST_DIR}/GraphicalEntry.cpp
     ${CMAKE_CURRENT_LIST_DIR}/GraphicalEntry.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/FrustumCulling.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/FrustumCulling.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Renderer.cpp
     ${CMAKE_CURRENT_LIST_DIR}/Renderer.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/NullRenderer.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/NullRenderer.hpp
     ${CMAKE_CURRENT_LIST_DIR}/RenderTasks.cpp
     ${CMAKE_CURRENT_LIST_DIR}/RenderTasks.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/RenderGraph.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/RenderGraph.hpp
     ${CMAKE_CURRENT_LIST_DIR}/RenderQueue.cpp
     ${CMAKE_CURRENT_LIST_DIR}/RenderQueue.hpp
     ${CMAKE_CURRENT_LIST_DIR}/GraphicsStandard.hpp
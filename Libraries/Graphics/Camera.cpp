@@ -42,13 +42,15 @@ void Camera::FilloutViewBlock(const Renderer* renderer, ViewBlock& viewBlock) co
   size_t width, height;
   float aspectRatio;
   renderer->GetShape(width, height, aspectRatio);
+  float verticalFov = Math::DegToRad(45.0f);
 
   viewBlock.mWorldToView = GenerateWorldToViewMatrix();
-  viewBlock.mViewToPerspective = renderer->BuildPerspectiveMatrix(Math::DegToRad(45.0f), aspectRatio, mNearPlane, mFarPlane);
+  viewBlock.mViewToPerspective = renderer->BuildPerspectiveMatrix(verticalFov, aspectRatio, mNearPlane, mFarPlane);
   viewBlock.mViewToPerspective.Transpose();
   viewBlock.mNearPlane = mNearPlane;
   viewBlock.mFarPlane = mFarPlane;
   viewBlock.mViewportSize = Vec2(1);
+  BuildFrustum(viewBlock.mWorldToView, verticalFov, aspectRatio, mNearPlane, mFarPlane, viewBlock.mFrustum);
 }
 
 Matrix4 Camera::GenerateWorldToViewMatrix() const
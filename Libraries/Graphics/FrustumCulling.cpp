@@ -0,0 +1,189 @@
+#include "Precompiled.hpp"
+
+#include "FrustumCulling.hpp"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define FRUSTUM_CULLING_SSE 1
+  #include <immintrin.h>
+#endif
+#if defined(FRUSTUM_CULLING_SSE) && defined(__AVX__)
+  #define FRUSTUM_CULLING_AVX 1
+#endif
+
+//-------------------------------------------------------------------Frustum
+Vec4 NormalizePlane(float x, float y, float z, float w)
+{
+  float length = std::sqrt(x * x + y * y + z * z);
+  return Vec4(x / length, y / length, z / length, w / length);
+}
+
+void BuildFrustum(const Matrix4& worldToView, float verticalFov, float aspectRatio, float nearPlane, float farPlane, Frustum& outFrustum)
+{
+  float tanY = std::tan(verticalFov * 0.5f);
+  float tanX = tanY * aspectRatio;
+
+  // View space planes. The side planes go through the eye so they have no distance term.
+  Vec4 viewPlanes[Frustum::cPlaneCount] =
+  {
+    NormalizePlane(1, 0, -tanX, 0),
+    NormalizePlane(-1, 0, -tanX, 0),
+    NormalizePlane(0, 1, -tanY, 0),
+    NormalizePlane(0, -1, -tanY, 0),
+    Vec4(0, 0, -1, -nearPlane),
+    Vec4(0, 0, 1, farPlane),
+  };
+
+  // A plane is a row vector so taking it to world space is planeView * worldToView
+  for(size_t i = 0; i < Frustum::cPlaneCount; ++i)
+  {
+    const Vec4& plane = viewPlanes[i];
+    Vec4& result = outFrustum.mPlanes[i];
+    for(size_t column = 0; column < 4; ++column)
+    {
+      result[column] = plane.x * worldToView[0][column] + plane.y * worldToView[1][column] +
+                       plane.z * worldToView[2][column] + plane.w * worldToView[3][column];
+    }
+  }
+}
+
+//-------------------------------------------------------------------CullingBounds
+void CullingBounds::Clear()
+{
+  mCenterX.Clear();
+  mCenterY.Clear();
+  mCenterZ.Clear();
+  mRadius.Clear();
+}
+
+void CullingBounds::Reserve(size_t count)
+{
+  mCenterX.Reserve(count);
+  mCenterY.Reserve(count);
+  mCenterZ.Reserve(count);
+  mRadius.Reserve(count);
+}
+
+void CullingBounds::Add(const Vec3& center, float radius)
+{
+  mCenterX.PushBack(center.x);
+  mCenterY.PushBack(center.y);
+  mCenterZ.PushBack(center.z);
+  mRadius.PushBack(radius);
+}
+
+size_t CullingBounds::Size() const
+{
+  return mRadius.Size();
+}
+
+void TransformBoundingSphere(const Matrix4& localToWorld, const Vec3& localCenter, float localRadius, Vec3& outCenter, float& outRadius)
+{
+  outCenter = Math::MultiplyPoint(localToWorld, localCenter);
+
+  float maxScaleSq = 0.0f;
+  for(size_t column = 0; column < 3; ++column)
+  {
+    float x = localToWorld[0][column];
+    float y = localToWorld[1][column];
+    float z = localToWorld[2][column];
+    maxScaleSq = Math::Max(maxScaleSq, x * x + y * y + z * z);
+  }
+  outRadius = localRadius * std::sqrt(maxScaleSq);
+}
+
+//-------------------------------------------------------------------Culling
+bool IsSphereVisible(const Frustum& frustum, float x, float y, float z, float radius)
+{
+  // Summed in the same order as the simd paths so a sphere gets the same answer from either
+  for(const Vec4& plane : frustum.mPlanes)
+  {
+    if(x * plane.x + plane.w + y * plane.y + z * plane.z < -radius)
+      return false;
+  }
+  return true;
+}
+
+void PushVisibleMask(uint32_t mask, size_t baseIndex, Array<uint32_t>& outVisibleIndices)
+{
+  while(mask != 0)
+  {
+    uint32_t bit = 0;
+    while((mask & (1u << bit)) == 0)
+      ++bit;
+    outVisibleIndices.PushBack(static_cast<uint32_t>(baseIndex + bit));
+    mask &= mask - 1;
+  }
+}
+
+size_t CullSpheres(const Frustum& frustum, const CullingBounds& bounds, Array<uint32_t>& outVisibleIndices)
+{
+  size_t count = bounds.Size();
+  size_t startVisible = outVisibleIndices.Size();
+  const float* centerX = bounds.mCenterX.Data();
+  const float* centerY = bounds.mCenterY.Data();
+  const float* centerZ = bounds.mCenterZ.Data();
+  const float* radius = bounds.mRadius.Data();
+  size_t i = 0;
+
+#if defined(FRUSTUM_CULLING_AVX)
+  // 8 spheres against one plane at a time, every plane has to pass
+  for(; i + 8 <= count; i += 8)
+  {
+    __m256 x = _mm256_loadu_ps(centerX + i);
+    __m256 y = _mm256_loadu_ps(centerY + i);
+    __m256 z = _mm256_loadu_ps(centerZ + i);
+    __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for(const Vec4& plane : frustum.mPlanes)
+    {
+      __m256 distance = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_set1_ps(plane.w));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(y, _mm256_set1_ps(plane.y)));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(z, _mm256_set1_ps(plane.z)));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+    }
+    PushVisibleMask(static_cast<uint32_t>(_mm256_movemask_ps(inside)), i, outVisibleIndices);
+  }
+#endif
+
+#if defined(FRUSTUM_CULLING_SSE)
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128 x = _mm_loadu_ps(centerX + i);
+    __m128 y = _mm_loadu_ps(centerY + i);
+    __m128 z = _mm_loadu_ps(centerZ + i);
+    __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for(const Vec4& plane : frustum.mPlanes)
+    {
+      __m128 distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_set1_ps(plane.w));
+      distance = _mm_add_ps(distance, _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+      distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+    }
+    PushVisibleMask(static_cast<uint32_t>(_mm_movemask_ps(inside)), i, outVisibleIndices);
+  }
+#endif
+
+  // Whatever didn't fill a full register
+  for(; i < count; ++i)
+  {
+    if(IsSphereVisible(frustum, centerX[i], centerY[i], centerZ[i], radius[i]))
+      outVisibleIndices.PushBack(static_cast<uint32_t>(i));
+  }
+
+  return count - (outVisibleIndices.Size() - startVisible);
+}
+
+size_t CullSpheresScalar(const Frustum& frustum, const CullingBounds& bounds, Array<uint32_t>& outVisibleIndices)
+{
+  size_t count = bounds.Size();
+  size_t startVisible = outVisibleIndices.Size();
+  for(size_t i = 0; i < count; ++i)
+  {
+    if(IsSphereVisible(frustum, bounds.mCenterX[i], bounds.mCenterY[i], bounds.mCenterZ[i], bounds.mRadius[i]))
+      outVisibleIndices.PushBack(static_cast<uint32_t>(i));
+  }
+  return count - (outVisibleIndices.Size() - startVisible);
+}
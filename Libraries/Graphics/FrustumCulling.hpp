@@ -0,0 +1,42 @@
+#pragma once
+
+#include "GraphicsStandard.hpp"
+
+//-------------------------------------------------------------------Frustum
+/// World space planes of a view. The xyz of each plane is an inward facing unit normal and w is the
+/// distance, so a point is inside a plane when dot(normal, point) + w >= 0.
+struct Frustum
+{
+  static constexpr size_t cPlaneCount = 6;
+  Vec4 mPlanes[cPlaneCount];
+};
+
+/// Builds the planes of a perspective camera that looks down -z in view space.
+void BuildFrustum(const Matrix4& worldToView, float verticalFov, float aspectRatio, float nearPlane, float farPlane, Frustum& outFrustum);
+
+//-------------------------------------------------------------------CullingBounds
+/// World space bounding spheres kept as one array per component so several can be tested at once.
+struct CullingBounds
+{
+  void Clear();
+  void Reserve(size_t count);
+  void Add(const Vec3& center, float radius);
+  size_t Size() const;
+
+  Array<float> mCenterX;
+  Array<float> mCenterY;
+  Array<float> mCenterZ;
+  Array<float> mRadius;
+};
+
+/// Transforms a local bounding sphere into world space. The radius grows by the largest axis scale.
+void TransformBoundingSphere(const Matrix4& localToWorld, const Vec3& localCenter, float localRadius, Vec3& outCenter, float& outRadius);
+
+/// True if the sphere touches the frustum.
+bool IsSphereVisible(const Frustum& frustum, float x, float y, float z, float radius);
+
+/// Appends the index of every sphere that touches the frustum to outVisibleIndices, in index order.
+/// Returns how many spheres were culled.
+size_t CullSpheres(const Frustum& frustum, const CullingBounds& bounds, Array<uint32_t>& outVisibleIndices);
+/// Same as CullSpheres one sphere at a time, the reference the simd paths are checked against.
+size_t CullSpheresScalar(const Frustum& frustum, const CullingBounds& bounds, Array<uint32_t>& outVisibleIndices);
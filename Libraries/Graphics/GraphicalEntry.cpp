@@ -1,3 +1,107 @@
 #include "Precompiled.hpp"
 
 #include "GraphicalEntry.hpp"
+
+uint32_t SortIdTable::GetId(const void* object)
+{
+  uint32_t* id = mIds.FindPointer(object);
+  if(id != nullptr)
+    return *id;
+
+  uint32_t newId = static_cast<uint32_t>(mIds.Size());
+  if(!mFreeIds.Empty())
+  {
+    newId = mFreeIds.Back();
+    mFreeIds.PopBack();
+  }
+  mIds.Insert(object, newId);
+  return newId;
+}
+
+void SortIdTable::Release(const void* object)
+{
+  uint32_t* id = mIds.FindPointer(object);
+  if(id == nullptr)
+    return;
+
+  mFreeIds.PushBack(*id);
+  mIds.Erase(object);
+}
+
+uint64_t BuildOpaqueSortKey(uint32_t pipelineId, uint32_t materialId, uint32_t meshId, uint32_t lod, uint32_t quantizedDepth)
+{
+  uint64_t key = 0;
+  key |= static_cast<uint64_t>(pipelineId & 0x7FFF) << 48;
+  key |= static_cast<uint64_t>(materialId & 0xFFFF) << 32;
+  key |= static_cast<uint64_t>(meshId & 0xFFFF) << 16;
+  key |= static_cast<uint64_t>(lod & 0x7) << 13;
+  key |= static_cast<uint64_t>((quantizedDepth >> 3) & 0x1FFF);
+  return key;
+}
+
+uint64_t BuildTransparentSortKey(uint32_t pipelineId, uint32_t materialId, uint32_t meshId, uint32_t quantizedDepth)
+{
+  uint64_t key = 1ull << 63;
+  key |= static_cast<uint64_t>(~quantizedDepth & 0xFFFF) << 47;
+  key |= static_cast<uint64_t>(pipelineId & 0x7FFF) << 32;
+  key |= static_cast<uint64_t>(materialId & 0xFFFF) << 16;
+  key |= static_cast<uint64_t>(meshId & 0xFFFF);
+  return key;
+}
+
+uint32_t QuantizeSortDepth(float viewDepth, float nearPlane, float farPlane)
+{
+  float range = farPlane - nearPlane;
+  float t = range > 0.0f ? (viewDepth - nearPlane) / range : 0.0f;
+  t = Math::Min(Math::Max(t, 0.0f), 1.0f);
+  return static_cast<uint32_t>(t * 65535.0f);
+}
+
+void RadixSort(Array<GraphicalEntry>& entries, Array<GraphicalEntry>& scratch)
+{
+  const size_t cPassCount = sizeof(uint64_t);
+  size_t count = entries.Size();
+  if(count <= 1)
+    return;
+  scratch.Resize(count);
+
+  // Build every pass' histogram up front in one walk over the keys
+  uint32_t histograms[cPassCount][256] = {};
+  for(size_t i = 0; i < count; ++i)
+  {
+    uint64_t key = entries[i].mSortId;
+    for(size_t pass = 0; pass < cPassCount; ++pass)
+      ++histograms[pass][(key >> (pass * 8)) & 0xFF];
+  }
+
+  GraphicalEntry* source = entries.Data();
+  GraphicalEntry* destination = scratch.Data();
+  for(size_t pass = 0; pass < cPassCount; ++pass)
+  {
+    uint32_t* histogram = histograms[pass];
+    size_t shift = pass * 8;
+
+    // Every key has the same byte here so this pass wouldn't move anything
+    if(histogram[(source[0].mSortId >> shift) & 0xFF] == count)
+      continue;
+
+    uint32_t offset = 0;
+    for(size_t bucket = 0; bucket < 256; ++bucket)
+    {
+      uint32_t bucketCount = histogram[bucket];
+      histogram[bucket] = offset;
+      offset += bucketCount;
+    }
+
+    for(size_t i = 0; i < count; ++i)
+    {
+      size_t bucket = (source[i].mSortId >> shift) & 0xFF;
+      destination[histogram[bucket]++] = source[i];
+    }
+    Math::Swap(source, destination);
+  }
+
+  // An odd number of passes leaves the result in the scratch buffer
+  if(source != entries.Data())
+    memcpy(entries.Data(), source, sizeof(GraphicalEntry) * count);
+}
@@ -8,5 +8,38 @@ struct GraphicalEntry
 {
   Graphical* mGraphical = nullptr;
   uint64_t mSortId = 0;
+  // Index of the entry's frame data while its render group is being built
+  uint32_t mFrameDataIndex = 0;
+  // Mesh lod picked for the view the entry was built for
+  uint32_t mLod = 0;
 };
 
+//-------------------------------------------------------------------SortIdTable
+/// Hands out small ids that stay the same for an object so it can be packed into a sort key.
+/// Ids of released objects are handed out again so they stay dense enough to fit their key field.
+struct SortIdTable
+{
+  uint32_t GetId(const void* object);
+  /// Called when the object is destroyed, does nothing if it never got an id.
+  void Release(const void* object);
+
+  HashMap<const void*, uint32_t> mIds;
+  Array<uint32_t> mFreeIds;
+};
+
+//-------------------------------------------------------------------Sort Keys
+/// Opaque keys sort by pipeline, material, then mesh and lod so state changes are grouped and identical
+/// draws end up next to each other. Ties are broken front-to-back on the top 13 bits of the depth.
+/// Transparent keys always come after opaque ones and sort back-to-front first.
+///
+/// Opaque:      [1: 0][15: pipeline][16: material][16: mesh][3: lod][13: depth]
+/// Transparent: [1: 1][16: ~depth][15: pipeline][16: material][16: mesh]
+constexpr uint32_t cSortKeyLodBits = 3;
+uint64_t BuildOpaqueSortKey(uint32_t pipelineId, uint32_t materialId, uint32_t meshId, uint32_t lod, uint32_t quantizedDepth);
+uint64_t BuildTransparentSortKey(uint32_t pipelineId, uint32_t materialId, uint32_t meshId, uint32_t quantizedDepth);
+/// Maps a positive view space depth in [near, far] to 16 bits.
+uint32_t QuantizeSortDepth(float viewDepth, float nearPlane, float farPlane);
+
+/// Stable LSD radix sort on mSortId. Scratch must be the same size as entries, byte passes
+/// where every key has the same value are skipped.
+void RadixSort(Array<GraphicalEntry>& entries, Array<GraphicalEntry>& scratch);
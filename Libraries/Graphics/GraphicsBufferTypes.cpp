@@ -2,6 +2,8 @@
 
 #include "GraphicsBufferTypes.hpp"
 
+#include "Mesh.hpp"
+
 namespace Zilch
 {
 
@@ -39,7 +41,6 @@ ZilchDefineExternalBaseType(CameraData, Zilch::TypeCopyMode::ReferenceType, buil
 ZilchDeclareExternalType(TransformData);
 ZilchDefineExternalBaseType(TransformData, Zilch::TypeCopyMode::ReferenceType, builder, type)
 {
-  ZilchBindMember(mLocalToWorld);
   ZilchBindMember(mWorldToView);
   ZilchBindMember(mViewToPerspective);
   ZilchBindMember(mPerspectiveToApiPerspective);
@@ -69,3 +70,29 @@ ZilchDefineType(BufferDescription, builder, type)
 {
   ZilchBindDefaultCopyDestructor();
 }
+
+void FilloutInstanceData(const Matrix4& localToWorld, InstanceData& instanceData)
+{
+  instanceData.mLocalToWorldRow0 = Vec4(localToWorld[0][0], localToWorld[0][1], localToWorld[0][2], localToWorld[0][3]);
+  instanceData.mLocalToWorldRow1 = Vec4(localToWorld[1][0], localToWorld[1][1], localToWorld[1][2], localToWorld[1][3]);
+  instanceData.mLocalToWorldRow2 = Vec4(localToWorld[2][0], localToWorld[2][1], localToWorld[2][2], localToWorld[2][3]);
+}
+
+void FilloutInstanceData(const Matrix4& localToWorld, const Mesh* mesh, InstanceData& instanceData)
+{
+  if(mesh == nullptr)
+  {
+    FilloutInstanceData(localToWorld, instanceData);
+    return;
+  }
+
+  // localToWorld * (position * scale + bias): scale the basis and move the bias into the translation
+  Zilch::Real4* rows[3] = {&instanceData.mLocalToWorldRow0, &instanceData.mLocalToWorldRow1, &instanceData.mLocalToWorldRow2};
+  const Vec3& bias = mesh->mPositionBias;
+  float scale = mesh->mPositionScale;
+  for(size_t row = 0; row < 3; ++row)
+  {
+    float translation = localToWorld[row][0] * bias.x + localToWorld[row][1] * bias.y + localToWorld[row][2] * bias.z + localToWorld[row][3];
+    *rows[row] = Vec4(localToWorld[row][0] * scale, localToWorld[row][1] * scale, localToWorld[row][2] * scale, translation);
+  }
+}
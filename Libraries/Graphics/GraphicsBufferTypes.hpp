@@ -4,6 +4,8 @@
 #include "MaterialShared.hpp"
 #include "Zilch/Zilch.hpp"
 
+struct Mesh;
+
 namespace Zilch
 {
 ZilchDeclareStaticLibrary(ZilchGraphicsLibrary, ZilchNoNamespace, ZeroNoImportExport);
@@ -34,10 +36,23 @@ struct CameraData
   Zilch::Real2 mViewportSize;
 };
 
+/// Bound once per view. Object transforms are streamed per instance as InstanceData.
 struct TransformData
 {
-  Zilch::Real4x4 mLocalToWorld;
   Zilch::Real4x4 mWorldToView;
   Zilch::Real4x4 mViewToPerspective;
   Zilch::Real4x4 mPerspectiveToApiPerspective;
 };
+
+/// Per object data read from the instance vertex stream. The bottom row of an affine local to world
+/// is always (0, 0, 0, 1) so only the top three rows are sent, 48 bytes instead of 64.
+struct InstanceData
+{
+  Zilch::Real4 mLocalToWorldRow0;
+  Zilch::Real4 mLocalToWorldRow1;
+  Zilch::Real4 mLocalToWorldRow2;
+};
+
+void FilloutInstanceData(const Matrix4& localToWorld, InstanceData& instanceData);
+/// Also folds the mesh's packed position scale and bias into the transform so the vertex shader doesn't decode them.
+void FilloutInstanceData(const Matrix4& localToWorld, const Mesh* mesh, InstanceData& instanceData);
@@ -7,6 +7,7 @@
 #include "GraphicsSpace.hpp"
 
 #include "GraphicsBufferTypes.hpp"
+#include "NullRenderer.hpp"
 #include "RenderQueue.hpp"
 #include "VulkanRenderer.hpp"
 
@@ -51,17 +52,22 @@ void GraphicsEngine::InitializeGraphics(const GraphicsEngineInitData& initData)
 
 void GraphicsEngine::Shutdown()
 {
+  CleanupShaderResources();
   CleanupSwapChain();
   for(Mesh* mesh : mMeshManager->Resources())
   {
-    mRenderer.DestroyMesh(mesh);
+    ReleaseSortIds(mesh);
+    mRenderer->DestroyMesh(mesh);
   }
   for(Texture* texture : mTextureManager->Resources())
   {
-    mRenderer.DestroyTexture(texture);
+    mRenderer->DestroyTexture(texture);
   }
-  mRenderer.CleanupResources();
-  mRenderer.Shutdown();
+  mTextureStreamer.Clear();
+  mRenderer->CleanupResources();
+  mRenderer->Shutdown();
+  delete mRenderer;
+  mRenderer = nullptr;
 }
 
 void GraphicsEngine::Add(GraphicsSpace* space)
@@ -86,7 +92,7 @@ void GraphicsEngine::Update()
   if(mReloadResources)
     ReloadResources();
 
-  RenderFrameStatus status = mRenderer.BeginFrame();
+  RenderFrameStatus status = mRenderer->BeginFrame();
   if(status == RenderFrameStatus::OutOfDate)
   {
     RecreateSwapChain();
@@ -98,9 +104,11 @@ void GraphicsEngine::Update()
   {
     space->RenderQueueUpdate(renderQueue);
   }
-  mRenderer.DrawRenderQueue(renderQueue);
+  mRenderer->DrawRenderQueue(renderQueue);
 
-  status = mRenderer.EndFrame();
+  status = mRenderer->EndFrame();
+  // New levels are uploaded while the next frame records and swapped in at the start of a later one
+  UpdateTextureStreaming(renderQueue);
   if(status == RenderFrameStatus::OutOfDate || status == RenderFrameStatus::SubOptimal)
     RecreateSwapChain();
   else if(status != RenderFrameStatus::Success)
@@ -111,16 +119,37 @@ void GraphicsEngine::Update()
 
 Renderer* GraphicsEngine::GetRenderer()
 {
-  return &mRenderer;
+  return mRenderer;
 }
 
 void GraphicsEngine::InitializeRenderer(GraphicsEngineRendererInitData& rendererInitData)
 {
-  VulkanInitializationData vulkanInitData;
-  vulkanInitData.mWidth = rendererInitData.mInitialWidth;
-  vulkanInitData.mHeight = rendererInitData.mInitialHeight;
-  vulkanInitData.mSurfaceCreationCallback = rendererInitData.mSurfaceCreationCallback;
-  mRenderer.Initialize(vulkanInitData);
+  if(rendererInitData.mRendererType == RendererType::Null)
+  {
+    NullRenderer* nullRenderer = new NullRenderer();
+    // Frames are only timed so the log would just grow
+    nullRenderer->mRecordCommands = false;
+    nullRenderer->Reshape(rendererInitData.mInitialWidth, rendererInitData.mInitialHeight, rendererInitData.mInitialWidth / (float)rendererInitData.mInitialHeight);
+    mRenderer = nullRenderer;
+  }
+  else
+  {
+    VulkanInitializationData vulkanInitData;
+    vulkanInitData.mWidth = rendererInitData.mInitialWidth;
+    vulkanInitData.mHeight = rendererInitData.mInitialHeight;
+    vulkanInitData.mSurfaceCreationCallback = rendererInitData.mSurfaceCreationCallback;
+    vulkanInitData.mHeadless = rendererInitData.mHeadless;
+    vulkanInitData.mPipelineCachePath = rendererInitData.mPipelineCachePath;
+    vulkanInitData.mGpuCullingShaderPath = rendererInitData.mGpuCullingShaderPath;
+    vulkanInitData.mClusterCullingShaderPath = rendererInitData.mClusterCullingShaderPath;
+    VulkanRenderer* vulkanRenderer = new VulkanRenderer();
+    vulkanRenderer->Initialize(vulkanInitData);
+    mRenderer = vulkanRenderer;
+  }
+
+  // Without streaming the settings are left at their defaults which keeps every texture fully resident
+  if(mRenderer->SupportsTextureStreaming())
+    mTextureStreamer.Initialize(rendererInitData.mTextureStreaming);
 
   UploadImages();
   UploadShaders();
@@ -130,18 +159,43 @@ void GraphicsEngine::InitializeRenderer(GraphicsEngineRendererInitData& renderer
 
 void GraphicsEngine::UploadImages()
 {
+  mRenderer->BeginUploadBatch();
   for(Texture* texture : mTextureManager->Resources())
   {
-    mRenderer.CreateTexture(texture);
+    // Streamed textures start with only their smallest levels
+    uint32_t firstMip = mTextureStreamer.AddTexture(texture);
+    mRenderer->CreateTexture(texture, firstMip);
   }
+  mRenderer->EndUploadBatch();
+}
+
+void GraphicsEngine::UpdateTextureStreaming(const RenderQueue& renderQueue)
+{
+  if(!mTextureStreamer.IsEnabled())
+    return;
+
+  size_t width, height;
+  float aspectRatio;
+  mRenderer->GetShape(width, height, aspectRatio);
+  mTextureStreamer.GatherRequests(renderQueue, mTextureManager, height);
+
+  Array<TextureResidencyChange> changes;
+  mTextureStreamer.Update(changes);
+  if(changes.Empty())
+    return;
+
+  mRenderer->BeginUploadBatch();
+  for(const TextureResidencyChange& change : changes)
+    mRenderer->SetTextureResidency(change.mTexture, change.mFirstMip);
+  mRenderer->EndUploadBatch();
 }
 
 void GraphicsEngine::UploadShaders()
 {
   for(ZilchShader* shader : mZilchShaderManager.Values())
   {
-    mRenderer.CreateShader(shader);
-    mRenderer.CreateShaderMaterial(shader);
+    mRenderer->CreateShader(shader);
+    mRenderer->CreateShaderMaterial(shader);
   }
 }
 
@@ -149,7 +203,7 @@ void GraphicsEngine::UploadMaterial(ZilchMaterial* zilchMaterial)
 {
   ZilchShader* zilchShader = mZilchShaderManager.Find(zilchMaterial->mMaterialName);
  if(zilchShader != nullptr)
-    mRenderer.UpdateShaderMaterialInstance(zilchShader, zilchMaterial);
+    mRenderer->UpdateShaderMaterialInstance(zilchShader, zilchMaterial);
 }
 
 void GraphicsEngine::UploadMaterials()
@@ -162,19 +216,22 @@ void GraphicsEngine::UploadMaterials()
 
 void GraphicsEngine::UploadMeshes()
 {
+  mRenderer->BeginUploadBatch();
   for(Mesh* mesh : mMeshManager->Resources())
   {
-    mRenderer.CreateMesh(mesh);
+    mRenderer->CreateMesh(mesh);
   }
+  mRenderer->EndUploadBatch();
 }
 
 void GraphicsEngine::ReloadResources()
 {
   WaitIdle();
-  CleanupSwapChain();
+  CleanupShaderResources();
   mZilchShaderManager.BuildFragmentsLibrary();
   mZilchShaderManager.BuildShadersLibrary();
-  CreateSwapChain();
+  CreateShaderResources();
+  mTextureStreamer.ClearMaterialTextures();
   mReloadResources = false;
 }
 
@@ -199,47 +256,63 @@ void GraphicsEngine::PopulateMaterialBuffer()
     materialData.mZilchMaterial = zilchMaterial;
     materialData.mZilchShader = mZilchShaderManager.Find(zilchMaterial->mMaterialName);
   }
-  mRenderer.UploadShaderMaterialInstances(materialBatchUploadData);
+  mRenderer->UploadShaderMaterialInstances(materialBatchUploadData);
 }
 
-void GraphicsEngine::CreateSwapChain()
+void GraphicsEngine::CreateShaderResources()
 {
-  size_t width, height;
-  mWindowSizeQueryFn(width, height);
-  mRenderer.Reshape(width, height, width / (float)height);
-  mRenderer.CreateDepthResourcesInternal();
-  mRenderer.CreateSwapChainInternal();
-  mRenderer.CreateRenderFramesInternal();
-
-  // This is heavier than needs to happen as a lot of the shader's don't have to be destroyed (modules, etc...). For simplicity do everything right now.
   UploadShaders();
   UploadMaterials();
   PopulateMaterialBuffer();
 }
 
-void GraphicsEngine::CleanupSwapChain()
+void GraphicsEngine::CleanupShaderResources()
 {
   for(ZilchMaterial* zilchMaterial : mZilchMaterialManager->Resources())
   {
     ZilchShader* zilchShader = mZilchShaderManager.Find(zilchMaterial->mMaterialName);
-    mRenderer.DestroyShaderMaterial(zilchShader);
-    mRenderer.DestroyShader(zilchShader);
+    // Shaders are rebuilt as new objects so their old ids would never be seen again
+    ReleaseSortIds(zilchShader);
+    mRenderer->DestroyShaderMaterial(zilchShader);
+    mRenderer->DestroyShader(zilchShader);
   }
+}
+
+void GraphicsEngine::CreateSwapChain()
+{
+  size_t width, height;
+  mWindowSizeQueryFn(width, height);
+  mRenderer->Reshape(width, height, width / (float)height);
+  mRenderer->CreateSwapChain();
+}
 
-  mRenderer.DestroyRenderFramesInternal();
-  mRenderer.DestroySwapChainInternal();
-  mRenderer.DestroyDepthResourcesInternal();
+void GraphicsEngine::CleanupSwapChain()
+{
+  mRenderer->DestroySwapChain();
 }
 
 void GraphicsEngine::RecreateSwapChain()
 {
   WaitIdle();
 
+  // Pipelines use dynamic viewport/scissor and a persistent render pass so only the
+  // swap chain sized objects have to be rebuilt on a resize.
   CleanupSwapChain();
   CreateSwapChain();
+  if(mRenderer->SwapChainLayoutChanged())
+  {
+    CleanupShaderResources();
+    CreateShaderResources();
+  }
+}
+
+void GraphicsEngine::ReleaseSortIds(const void* resource)
+{
+  for(GraphicsSpace* space : mSpaces)
+    space->ReleaseSortIds(resource);
 }
 
 void GraphicsEngine::WaitIdle()
 {
-  mRenderer.WaitForIdle();
+  mRenderer->WaitForIdle();
 }
@@ -3,6 +3,7 @@
 #include "Mesh.hpp"
 #include "Model.hpp"
 #include "Texture.hpp"
+#include "TextureStreamer.hpp"
 #include "ZilchFragment.hpp"
 #include "ZilchMaterial.hpp"
 #include "ZilchShader.hpp"
@@ -15,11 +16,25 @@ class GraphicsSpace;
 class ResourceSystem;
 class UpdateEvent;
 
+enum class RendererType
+{
+  Vulkan,
+  // No device, draws are only logged. See NullRenderer.
+  Null
+};
+
 struct GraphicsEngineRendererInitData
 {
+  RendererType mRendererType = RendererType::Vulkan;
   SurfaceCreationDelegate mSurfaceCreationCallback;
   size_t mInitialWidth = 0;
   size_t mInitialHeight = 0;
+  bool mHeadless = false;
+  String mPipelineCachePath;
+  String mGpuCullingShaderPath;
+  String mClusterCullingShaderPath;
+  // Only used if the renderer supports streaming
+  TextureStreamingSettings mTextureStreaming;
 };
 
 struct GraphicsEngineInitData
@@ -47,6 +62,7 @@ public:
 
   void InitializeRenderer(GraphicsEngineRendererInitData& rendererInitData);
   void UploadImages();
+  void UpdateTextureStreaming(const RenderQueue& renderQueue);
   void UploadShaders();
   void UploadMaterial(ZilchMaterial* zilchMaterial);
   void UploadMaterials();
@@ -57,10 +73,14 @@ public:
   void OnResourceReLoaded(ResourceLoadEvent* event);
 
   void PopulateMaterialBuffer();
+  void CreateShaderResources();
+  void CleanupShaderResources();
   void CreateSwapChain();
   void CleanupSwapChain();
   void RecreateSwapChain();
   void WaitIdle();
+  /// Lets every space reuse the sort ids of a resource that's being destroyed.
+  void ReleaseSortIds(const void* resource);
 
   SurfaceCreationDelegate mSurfaceCreationCallback;
   std::function<void(size_t&, size_t&)> mWindowSizeQueryFn = nullptr;
@@ -73,6 +93,8 @@ public:
   ZilchFragmentFileManager* mZilchFragmentFileManager = nullptr;
   ZilchMaterialManager* mZilchMaterialManager = nullptr;
   ZilchShaderManager mZilchShaderManager;
-  VulkanRenderer mRenderer;
+  // Owned, created by InitializeRenderer
+  Renderer* mRenderer = nullptr;
+  TextureStreamer mTextureStreamer;
   bool mReloadResources = false;
 };
@@ -11,11 +11,22 @@
 #include "RenderTasks.hpp"
 #include "RenderQueue.hpp"
 #include "Camera.hpp"
+#include "Mesh.hpp"
+#include "Model.hpp"
+
+#include <cmath>
+
+static_assert(cMaxMeshLods <= (1u << cSortKeyLodBits), "Every mesh lod needs its own value in the sort key");
 
 ZilchDefineType(GraphicsSpace, builder, type)
 {
   ZilchBindDefaultConstructor();
   ZilchBindDestructor();
+
+  ZilchBindFieldProperty(mGpuCulling);
+  ZilchBindFieldProperty(mGpuClusterCulling);
+  ZilchBindFieldProperty(mLodErrorThreshold);
+  ZilchBindFieldProperty(mLodHysteresis);
 }
 
 GraphicsSpace::GraphicsSpace()
@@ -79,8 +90,15 @@ void GraphicsSpace::RenderQueueUpdate(RenderQueue& renderQueue)
   frameBlock.mFrameTime = mTotalTimeElapsed;
   frameBlock.mLogicTime = mTotalTimeElapsed;
 
-  for(const Camera* camera : mCameras)
+  GatherFrameData();
+  mCullingStatistics = CullingStatistics();
+  bool cullOnGpu = mGpuCulling && renderer->SupportsGpuCulling();
+  size_t width, height;
+  float aspectRatio;
+  renderer->GetShape(width, height, aspectRatio);
+  for(size_t cameraIndex = 0; cameraIndex < mCameras.Size(); ++cameraIndex)
   {
+    const Camera* camera = mCameras[cameraIndex];
     ViewBlock& viewBlock = renderQueue.mViewBlocks.PushBack();
     viewBlock.mFrameBlockId = static_cast<uint32_t>(renderQueue.mFrameBlocks.Size()) - 1;
     camera->FilloutViewBlock(renderer, viewBlock);
@@ -88,19 +106,127 @@ void GraphicsSpace::RenderQueueUpdate(RenderQueue& renderQueue)
     RenderTaskEvent& renderTaskEvent = viewBlock.mRenderTaskEvent;
     renderTaskEvent.mGraphicsSpace = this;
   
-    Array<GraphicalEntry> entries;
-    entries.Reserve(mModels.Size());
-    for(Model* model : mModels)
-    {
-      GraphicalEntry& entry = entries.PushBack();
-      entry.mGraphical = model;
-      entry.mSortId = 0;
-    }
-    Zero::Sort(mModels.All());
+    // Pixels covered per world unit at a view depth of one
+    float pixelScale = std::abs(viewBlock.mViewToPerspective[1][1]) * height * 0.5f;
+    BuildSortedEntries(viewBlock, cameraIndex, pixelScale, cullOnGpu);
   
     renderTaskEvent.CreateClearTargetRenderTask();
     RenderGroupRenderTask* renderGroupTask = renderTaskEvent.CreateRenderGroupRenderTask();
-    for(const GraphicalEntry& entry : entries)
-      renderGroupTask->Add(entry.mGraphical);
+    renderGroupTask->mCullOnGpu = cullOnGpu;
+    renderGroupTask->mCullClustersOnGpu = mGpuClusterCulling;
+    renderGroupTask->mFrameData.Reserve(mEntries.Size());
+    for(const GraphicalEntry& entry : mEntries)
+    {
+      renderGroupTask->Add(mFrameData[entry.mFrameDataIndex]);
+      renderGroupTask->mFrameData.Back().mLod = entry.mLod;
+    }
+  }
+}
+
+void GraphicsSpace::GatherFrameData()
+{
+  // Frame data and world bounds don't depend on the camera so they're built once for all views.
+  // The arrays are reused between frames so they stop allocating once they've grown.
+  mFrameData.Clear();
+  mCullingBounds.Clear();
+  mFrameData.Reserve(mModels.Size());
+  mCullingBounds.Reserve(mModels.Size());
+
+  for(Model* model : mModels)
+  {
+    GraphicalFrameData& frameData = mFrameData.PushBack();
+    model->FilloutFrameData(frameData);
+
+    Vec3 center = Math::MultiplyPoint(frameData.mLocalToWorld, Vec3::cZero);
+    float radius = 0.0f;
+    if(frameData.mMesh != nullptr)
+      TransformBoundingSphere(frameData.mLocalToWorld, frameData.mMesh->mBoundingSphereCenter, frameData.mMesh->mBoundingSphereRadius, center, radius);
+    mCullingBounds.Add(center, radius);
+    frameData.mWorldBoundingSphere = Vec4(center.x, center.y, center.z, radius);
+  }
+}
+
+void GraphicsSpace::BuildSortedEntries(const ViewBlock& viewBlock, size_t cameraIndex, float pixelScale, bool cullOnGpu)
+{
+  mVisibleIndices.Clear();
+  if(cullOnGpu)
+  {
+    // The renderer culls after sorting so invisible models still take up a slot in their batch
+    mVisibleIndices.Reserve(mCullingBounds.Size());
+    for(size_t i = 0; i < mCullingBounds.Size(); ++i)
+      mVisibleIndices.PushBack(static_cast<uint32_t>(i));
   }
+  else
+  {
+    size_t culledCount = CullSpheres(viewBlock.mFrustum, mCullingBounds, mVisibleIndices);
+    mCullingStatistics.mTestedCount += mCullingBounds.Size();
+    mCullingStatistics.mCulledCount += culledCount;
+  }
+
+  mEntries.Clear();
+  mEntries.Reserve(mVisibleIndices.Size());
+  for(uint32_t index : mVisibleIndices)
+  {
+    const GraphicalFrameData& frameData = mFrameData[index];
+
+    Vec3 worldPosition(mCullingBounds.mCenterX[index], mCullingBounds.mCenterY[index], mCullingBounds.mCenterZ[index]);
+    float viewDepth = -Math::MultiplyPoint(viewBlock.mWorldToView, worldPosition).z;
+    uint32_t depth = QuantizeSortDepth(viewDepth, viewBlock.mNearPlane, viewBlock.mFarPlane);
+
+    Model* model = mModels[index];
+    if(model->mLastLods.Size() <= cameraIndex)
+      model->mLastLods.Resize(cameraIndex + 1, 0);
+    uint32_t lod = SelectMeshLod(frameData.mMesh, mCullingBounds.mRadius[index], viewDepth, viewBlock.mNearPlane, pixelScale, model->mLastLods[cameraIndex]);
+    model->mLastLods[cameraIndex] = static_cast<uint8_t>(lod);
+
+    uint32_t pipelineId = mPipelineSortIds.GetId(frameData.mZilchShader);
+    uint32_t materialId = mMaterialSortIds.GetId(frameData.mZilchMaterial);
+    uint32_t meshId = mMeshSortIds.GetId(frameData.mMesh);
+
+    GraphicalEntry& entry = mEntries.PushBack();
+    entry.mGraphical = model;
+    entry.mFrameDataIndex = index;
+    entry.mLod = lod;
+    // Materials don't have any blend state yet so everything goes through the opaque path
+    // Each lod is its own draw so it has its own key field to keep their instances together
+    entry.mSortId = BuildOpaqueSortKey(pipelineId, materialId, meshId, lod, depth);
+  }
+
+  RadixSort(mEntries, mScratchEntries);
+}
+
+uint32_t GraphicsSpace::SelectMeshLod(const Mesh* mesh, float worldRadius, float viewDepth, float nearPlane, float pixelScale, uint32_t lastLod) const
+{
+  if(mesh == nullptr || mesh->mLods.Size() < 2 || mLodErrorThreshold <= 0.0f || mesh->mBoundingSphereRadius <= 0.0f)
+    return 0;
+  // The closest the surface can get to the camera, anything touching the near plane gets full detail
+  float distance = viewDepth - worldRadius;
+  if(distance <= nearPlane)
+    return 0;
+
+  // Lod errors are in local space, the ratio of the radii is the largest scale the transform applies
+  float pixelsPerLocalUnit = worldRadius / mesh->mBoundingSphereRadius * pixelScale / distance;
+  auto findLod = [mesh, pixelsPerLocalUnit](float threshold)
+  {
+    uint32_t result = 0;
+    for(size_t i = 1; i < mesh->mLods.Size(); ++i)
+    {
+      if(mesh->mLods[i].mError * pixelsPerLocalUnit > threshold)
+        break;
+      result = static_cast<uint32_t>(i);
+    }
+    return result;
+  };
+
+  uint32_t lod = findLod(mLodErrorThreshold);
+  if(lod <= lastLod)
+    return lod;
+  return Math::Max(findLod(mLodErrorThreshold * (1.0f - mLodHysteresis)), lastLod);
+}
+
+void GraphicsSpace::ReleaseSortIds(const void* resource)
+{
+  mPipelineSortIds.Release(resource);
+  mMaterialSortIds.Release(resource);
+  mMeshSortIds.Release(resource);
 }
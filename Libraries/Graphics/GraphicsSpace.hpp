@@ -3,12 +3,24 @@
 #include "GraphicsStandard.hpp"
 #include "Engine/Component.hpp"
 #include "Engine/UpdateEvent.hpp"
+#include "FrustumCulling.hpp"
+#include "GraphicalEntry.hpp"
+#include "RenderTasks.hpp"
 
 struct Camera;
+struct Mesh;
 struct Model;
 struct GraphicsEngine;
 struct RenderFrame;
 struct RenderQueue;
+struct ViewBlock;
+
+/// Counts from the last RenderQueueUpdate, summed over every camera.
+struct CullingStatistics
+{
+  size_t mTestedCount = 0;
+  size_t mCulledCount = 0;
+};
 
 class GraphicsSpace : public Component
 {
@@ -28,10 +40,40 @@ public:
 
   void OnLogicUpdate(UpdateEvent* e);
   void RenderQueueUpdate(RenderQueue& renderQueue);
+  /// Fills out every model's frame data and world space bounds for this frame.
+  void GatherFrameData();
+  /// Fills out mEntries with the models inside the view's frustum, sorted by their draw key.
+  /// Every model is kept when culling is left to the gpu. pixelScale is the pixels covered by
+  /// one world unit at a view depth of one and is used to pick each model's mesh lod.
+  void BuildSortedEntries(const ViewBlock& viewBlock, size_t cameraIndex, float pixelScale, bool cullOnGpu);
+  /// Coarsest lod whose error projects to at most mLodErrorThreshold pixels. Only switches to a coarser
+  /// level than lastLod once the error is mLodHysteresis under the threshold so models don't flicker.
+  uint32_t SelectMeshLod(const Mesh* mesh, float worldRadius, float viewDepth, float nearPlane, float pixelScale, uint32_t lastLod) const;
+  /// Frees the sort ids of a shader, material, or mesh that's being destroyed.
+  void ReleaseSortIds(const void* resource);
 
   float mTotalTimeElapsed = 0.0;
   Array<Camera*> mCameras;
   Array<Model*> mModels;
   String mName;
   GraphicsEngine* mEngine = nullptr;
+
+  // One table per key field so each field's ids only count objects of its own kind
+  SortIdTable mPipelineSortIds;
+  SortIdTable mMaterialSortIds;
+  SortIdTable mMeshSortIds;
+  Array<GraphicalEntry> mEntries;
+  Array<GraphicalEntry> mScratchEntries;
+  Array<GraphicalFrameData> mFrameData;
+  CullingBounds mCullingBounds;
+  Array<uint32_t> mVisibleIndices;
+  CullingStatistics mCullingStatistics;
+  // Hands frustum culling to the renderer when it supports it
+  bool mGpuCulling = false;
+  // Culls the clusters of nearby meshes in a compute pass when the renderer supports it, independent of mGpuCulling
+  bool mGpuClusterCulling = false;
+  // Screen space error in pixels a mesh lod may have, zero always draws the full mesh
+  float mLodErrorThreshold = 1.0f;
+  // Fraction of the threshold the error has to drop under before switching to a coarser lod
+  float mLodHysteresis = 0.25f;
 };
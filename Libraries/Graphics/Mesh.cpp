@@ -1,27 +1,124 @@
 #include "Precompiled.hpp"
 
 #include "Mesh.hpp"
+#include "MeshCooker.hpp"
+#include "MeshOptimizer.hpp"
+#include "TextureCooker.hpp"
 #undef Error
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tinyobjloader/tiny_obj_loader.h"
 
-void FilloutMesh(Mesh* mesh, std::vector<tinyobj::shape_t>& shapes, tinyobj::attrib_t& attrib)
+// Returns the attributes the file actually has, the rest are left out of the packed vertices
+uint32_t FilloutMesh(Mesh* mesh, std::vector<tinyobj::shape_t>& shapes, tinyobj::attrib_t& attrib)
 {
+  uint32_t attributes = VertexAttributeBit(VertexAttribute::Position);
+  if(!attrib.normals.empty())
+    attributes |= VertexAttributeBit(VertexAttribute::Normal);
+  if(!attrib.texcoords.empty())
+    attributes |= VertexAttributeBit(VertexAttribute::Uv);
+  // The loader fills in white for vertices without a color
+  for(float channel : attrib.colors)
+  {
+    if(channel != 1.0f)
+    {
+      attributes |= VertexAttributeBit(VertexAttribute::Color);
+      break;
+    }
+  }
+
   for(const auto& shape : shapes)
   {
+    // One vertex per index, duplicates are welded afterwards by OptimizeMesh
     for(const auto& index : shape.mesh.indices)
     {
       Vertex vertex = {};
       vertex.pos = Vec3(&attrib.vertices[3 * index.vertex_index]);
-      vertex.normal = Vec3(&attrib.normals[3 * index.normal_index]);
-      vertex.uv = Vec2(&attrib.texcoords[2 * index.texcoord_index]);
-    
+      if(index.normal_index >= 0)
+        vertex.normal = Vec3(&attrib.normals[3 * index.normal_index]);
+      if(index.texcoord_index >= 0)
+        vertex.uv = Vec2(&attrib.texcoords[2 * index.texcoord_index]);
+      if(attributes & VertexAttributeBit(VertexAttribute::Color))
+      {
+        const float* color = &attrib.colors[3 * index.vertex_index];
+        vertex.color = Vec4(color[0], color[1], color[2], 1.0f);
+      }
+
       uint32_t vertexIndex = static_cast<uint32_t>(mesh->mVertices.Size());
       mesh->mVertices.PushBack(vertex);
       mesh->mIndices.PushBack(vertexIndex);
     }
   }
+  return attributes;
+}
+
+void ComputeMeshBounds(Mesh* mesh)
+{
+  if(mesh->mVertices.Empty())
+  {
+    mesh->mAabbMin = mesh->mAabbMax = mesh->mBoundingSphereCenter = Vec3::cZero;
+    mesh->mBoundingSphereRadius = 0.0f;
+    return;
+  }
+
+  Vec3 aabbMin = mesh->mVertices[0].pos;
+  Vec3 aabbMax = aabbMin;
+  for(const Vertex& vertex : mesh->mVertices)
+  {
+    for(size_t axis = 0; axis < 3; ++axis)
+    {
+      aabbMin[axis] = Math::Min(aabbMin[axis], vertex.pos[axis]);
+      aabbMax[axis] = Math::Max(aabbMax[axis], vertex.pos[axis]);
+    }
+  }
+
+  // Centering the sphere on the box and taking the furthest vertex is tighter than the box's half diagonal
+  Vec3 center = (aabbMin + aabbMax) * 0.5f;
+  float radiusSq = 0.0f;
+  for(const Vertex& vertex : mesh->mVertices)
+  {
+    Vec3 offset = vertex.pos - center;
+    radiusSq = Math::Max(radiusSq, offset.x * offset.x + offset.y * offset.y + offset.z * offset.z);
+  }
+
+  mesh->mAabbMin = aabbMin;
+  mesh->mAabbMax = aabbMax;
+  mesh->mBoundingSphereCenter = center;
+  mesh->mBoundingSphereRadius = std::sqrt(radiusSq);
+}
+
+// The source's stamp combined with every setting that changes what's cooked, so changing them recooks too
+uint64_t StampMeshCookSource(const String& path, const MeshLodSettings& lodSettings)
+{
+  uint64_t sourceStamp = StampCookSource(path);
+  if(sourceStamp == 0)
+    return 0;
+
+  const Array<float>& targetRatios = lodSettings.mTargetRatios;
+  float lodLimits[2] = {lodSettings.mMaxRelativeError, lodSettings.mMinReduction};
+  uint64_t stamp[6];
+  stamp[0] = sourceStamp;
+  stamp[1] = HashCookSource(targetRatios.Data(), targetRatios.Size() * sizeof(float));
+  stamp[2] = HashCookSource(lodLimits, sizeof(lodLimits));
+  stamp[3] = cMaxClusterVertices;
+  stamp[4] = cMaxClusterTriangles;
+  stamp[5] = cMinClusteredTriangles;
+  return HashCookSource(stamp, sizeof(stamp));
+}
+
+void ClearMesh(Mesh* mesh)
+{
+  mesh->mVertices.Clear();
+  mesh->mIndices.Clear();
+  mesh->mLods.Clear();
+  mesh->mClusters.Clear();
+  mesh->mVertexData.Clear();
+  mesh->mVertexFormat = VertexFormat();
+  mesh->mCookedFile.reset();
+  mesh->mCookedVertexData = nullptr;
+  mesh->mCookedVertexDataSize = 0;
+  mesh->mCookedIndices = nullptr;
+  mesh->mCookedIndexCount = 0;
 }
 
 //-----------------------------------------------------------------------------Mesh
@@ -30,10 +127,44 @@ ZilchDefineType(Mesh, builder, type)
   ZilchBindDefaultCopyDestructor();
 }
 
+const byte* Mesh::GetVertexData() const
+{
+  return mCookedFile ? mCookedVertexData : mVertexData.Data();
+}
+
+size_t Mesh::GetVertexDataSize() const
+{
+  return mCookedFile ? mCookedVertexDataSize : mVertexData.Size();
+}
+
+const uint32_t* Mesh::GetIndices() const
+{
+  return mCookedFile ? mCookedIndices : mIndices.Data();
+}
+
+size_t Mesh::GetIndexCount() const
+{
+  return mCookedFile ? mCookedIndexCount : mIndices.Size();
+}
+
+MeshLod Mesh::GetLod(size_t lod) const
+{
+  if(mLods.Empty())
+  {
+    MeshLod fullLod;
+    fullLod.mIndexCount = static_cast<uint32_t>(GetIndexCount());
+    return fullLod;
+  }
+  return mLods[Math::Min(lod, mLods.Size() - 1)];
+}
+
 //-------------------------------------------------------------------MeshManager
 MeshManager::MeshManager()
 {
-
+  mLodSettings.mTargetRatios.PushBack(0.5f);
+  mLodSettings.mTargetRatios.PushBack(0.25f);
+  mLodSettings.mTargetRatios.PushBack(0.125f);
+  mLodSettings.mTargetRatios.PushBack(0.0625f);
 }
 
 MeshManager::~MeshManager()
@@ -58,14 +189,57 @@ bool MeshManager::OnReLoadResource(const ResourceMetaFile& resourceMeta, Mesh* m
 
 bool MeshManager::LoadMesh(const ResourceMetaFile& resourceMeta, Mesh* mesh)
 {
+  const ResourcePath& path = resourceMeta.mResourcePath;
+  ClearMesh(mesh);
+
+  // The cooked copy is only used while the source it was cooked from and the cook settings haven't changed.
+  // The source's size and write time are enough to tell, so it isn't read at all when the cooked copy is current.
+  uint64_t sourceStamp = 0;
+  String cookedPath;
+  if(!mCookedDirectory.Empty())
+  {
+    sourceStamp = StampMeshCookSource(path, mLodSettings);
+    cookedPath = GetCookedPath(mCookedDirectory, path, ".meshbin");
+    uint64_t cookedStamp = 0;
+    if(sourceStamp != 0 && Zero::FileExists(cookedPath) && LoadCookedMesh(cookedPath, *mesh, &cookedStamp) && cookedStamp == sourceStamp)
+      return true;
+    ClearMesh(mesh);
+  }
+
   tinyobj::attrib_t attrib;
   std::vector<tinyobj::shape_t> shapes;
   std::vector<tinyobj::material_t> materials;
   std::string warn, err;
 
-  if(!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, resourceMeta.mResourcePath.c_str()))
+  if(!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
     return false;
 
-  FilloutMesh(mesh, shapes, attrib);
+  uint32_t attributes = FilloutMesh(mesh, shapes, attrib);
+
+  MeshOptimizationStatistics statistics;
+  OptimizeMesh(mesh, &statistics);
+  Zilch::Console::WriteLine("Mesh '%s': %zu -> %zu vertices, %zu -> %zu bytes, ACMR %.2f -> %.2f", path.c_str(),
+    statistics.mVertexCountBefore, statistics.mVertexCountAfter, statistics.mSizeBefore, statistics.mSizeAfter, statistics.mAcmrBefore, statistics.mAcmrAfter);
+
+  ComputeMeshBounds(mesh);
+  GenerateMeshLods(mesh, mLodSettings);
+  for(size_t i = 1; i < mesh->mLods.Size(); ++i)
+  {
+    const MeshLod& lod = mesh->mLods[i];
+    Zilch::Console::WriteLine("Mesh '%s': lod %zu has %u triangles, error %g", path.c_str(), i, lod.mIndexCount / 3, lod.mError);
+  }
+  BuildMeshClusters(mesh);
+  if(!mesh->mClusters.Empty())
+    Zilch::Console::WriteLine("Mesh '%s': split into %zu clusters", path.c_str(), mesh->mClusters.Size());
+
+  PackMeshVertices(mesh, attributes);
+  Zilch::Console::WriteLine("Mesh '%s': %u byte vertices packed into %u bytes", path.c_str(),
+    static_cast<uint32_t>(sizeof(Vertex)), mesh->mVertexFormat.mStride);
+
+  if(!mCookedDirectory.Empty())
+  {
+    Zero::CreateDirectory(mCookedDirectory);
+    SaveCookedMesh(cookedPath, *mesh, sourceStamp);
+  }
   return true;
 }
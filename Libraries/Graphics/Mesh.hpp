@@ -1,18 +1,91 @@
 #pragma once
 
 #include "Vertex.hpp"
+#include "VertexFormat.hpp"
+#include "MeshSimplifier.hpp"
+#include "MeshClusters.hpp"
 #include "GraphicsStandard.hpp"
 #include "ResourceManager.hpp"
+#include "Utilities/MappedFile.hpp"
+
+#include <memory>
+
+/// Most levels of detail a mesh can have, including the full detail one.
+constexpr size_t cMaxMeshLods = 8;
+
+//-------------------------------------------------------------------MeshLod
+/// A level of detail is a range of the mesh's index buffer. Every level indexes the same vertices.
+struct MeshLod
+{
+  uint32_t mIndexOffset = 0;
+  uint32_t mIndexCount = 0;
+  // How far the level's surface can be from the full detail one, in local space
+  float mError = 0.0f;
+};
+
+//-------------------------------------------------------------------MeshCluster
+/// A run of the full detail level's triangles that's culled on its own. See BuildMeshClusters.
+struct MeshCluster
+{
+  uint32_t mIndexOffset = 0;
+  uint32_t mIndexCount = 0;
+  // Local space bounding sphere
+  Vec3 mCenter = Vec3::cZero;
+  float mRadius = 0.0f;
+  // Every triangle's normal is within the cone around the axis, see IsClusterBackFacing. A cutoff of 1 is never back facing.
+  Vec3 mConeAxis = Vec3::cZero;
+  float mConeCutoff = 1.0f;
+};
 
 //-------------------------------------------------------------------Mesh
 struct Mesh : public Resource
 {
   ZilchDeclareType(Mesh, Zilch::TypeCopyMode::ReferenceType);
 
+  /// Packed vertices and indices the renderer uploads. Read straight out of the cooked file if the mesh was loaded from one.
+  const byte* GetVertexData() const;
+  size_t GetVertexDataSize() const;
+  const uint32_t* GetIndices() const;
+  size_t GetIndexCount() const;
+  /// The level's index range, clamped to the coarsest level the mesh has.
+  MeshLod GetLod(size_t lod) const;
+
+  // Only filled in when the mesh is imported from its source, cooked meshes just have the packed data
   Array<Vertex> mVertices;
   Array<uint32_t> mIndices;
+
+  // Finest first, the first level is always the whole mesh. See GenerateMeshLods.
+  Array<MeshLod> mLods;
+  // Only the first lod is split, coarser ones are drawn far enough away that culling them whole is enough.
+  // Empty for meshes too small to be worth culling in pieces.
+  Array<MeshCluster> mClusters;
+
+  // Local space bounds, computed when the mesh is loaded
+  Vec3 mAabbMin = Vec3::cZero;
+  Vec3 mAabbMax = Vec3::cZero;
+  Vec3 mBoundingSphereCenter = Vec3::cZero;
+  float mBoundingSphereRadius = 0.0f;
+
+  // Vertices packed for the gpu, see PackMeshVertices. mVertices is kept as the full precision source.
+  VertexFormat mVertexFormat;
+  Array<byte> mVertexData;
+  // Packed positions decode as position * mPositionScale + mPositionBias
+  float mPositionScale = 1.0f;
+  Vec3 mPositionBias = Vec3::cZero;
+
+  // Set when loaded from a cooked file. The blobs point into the mapping, which is shared so copies stay valid.
+  std::shared_ptr<MappedFile> mCookedFile;
+  const byte* mCookedVertexData = nullptr;
+  size_t mCookedVertexDataSize = 0;
+  const uint32_t* mCookedIndices = nullptr;
+  size_t mCookedIndexCount = 0;
 };
 
+/// Fills out the mesh's bounds from its vertices.
+void ComputeMeshBounds(Mesh* mesh);
+/// Empties the mesh so it can be loaded again.
+void ClearMesh(Mesh* mesh);
+
 //-------------------------------------------------------------------MeshManager
 struct MeshManager : public ResourceManagerTyped<Mesh>
 {
@@ -25,4 +98,9 @@ public:
   virtual bool OnReLoadResource(const ResourceMetaFile& resourceMeta, Mesh* mesh) override;
 
   bool LoadMesh(const ResourceMetaFile& resourceMeta, Mesh* mesh);
+
+  /// Levels generated for every imported mesh. Changing them only affects meshes that get recooked.
+  MeshLodSettings mLodSettings;
+  /// Where cooked copies of source meshes are written and loaded from. Empty disables cooking.
+  String mCookedDirectory;
 };
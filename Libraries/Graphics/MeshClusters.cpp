@@ -0,0 +1,132 @@
+#include "Precompiled.hpp"
+
+#include "MeshClusters.hpp"
+
+#include "Mesh.hpp"
+
+#include <cmath>
+
+namespace
+{
+
+constexpr uint32_t cInvalidCluster = static_cast<uint32_t>(-1);
+
+// Cones wider than this have no view direction that sees them all from behind
+constexpr float cMinConeDot = 0.1f;
+
+void ComputeClusterBounds(const Mesh* mesh, MeshCluster& cluster)
+{
+  const Array<Vertex>& vertices = mesh->mVertices;
+  const uint32_t* indices = mesh->mIndices.Data() + cluster.mIndexOffset;
+
+  Vec3 aabbMin = vertices[indices[0]].pos;
+  Vec3 aabbMax = aabbMin;
+  Vec3 normalSum = Vec3::cZero;
+  for(uint32_t i = 0; i < cluster.mIndexCount; i += 3)
+  {
+    const Vec3& p0 = vertices[indices[i + 0]].pos;
+    const Vec3& p1 = vertices[indices[i + 1]].pos;
+    const Vec3& p2 = vertices[indices[i + 2]].pos;
+    for(const Vec3* point : {&p0, &p1, &p2})
+    {
+      for(size_t axis = 0; axis < 3; ++axis)
+      {
+        aabbMin[axis] = Math::Min(aabbMin[axis], (*point)[axis]);
+        aabbMax[axis] = Math::Max(aabbMax[axis], (*point)[axis]);
+      }
+    }
+
+    Vec3 normal = Math::Cross(p1 - p0, p2 - p0);
+    float length = Math::Length(normal);
+    if(length > 0.0f)
+      normalSum += normal / length;
+  }
+
+  // Same fit as ComputeMeshBounds
+  cluster.mCenter = (aabbMin + aabbMax) * 0.5f;
+  float radiusSq = 0.0f;
+  for(uint32_t i = 0; i < cluster.mIndexCount; ++i)
+  {
+    Vec3 offset = vertices[indices[i]].pos - cluster.mCenter;
+    radiusSq = Math::Max(radiusSq, Math::Dot(offset, offset));
+  }
+  cluster.mRadius = std::sqrt(radiusSq);
+
+  cluster.mConeAxis = Vec3::cZero;
+  cluster.mConeCutoff = 1.0f;
+  float axisLength = Math::Length(normalSum);
+  if(axisLength <= 0.0f)
+    return;
+  Vec3 axis = normalSum / axisLength;
+
+  float minDot = 1.0f;
+  for(uint32_t i = 0; i < cluster.mIndexCount; i += 3)
+  {
+    const Vec3& p0 = vertices[indices[i + 0]].pos;
+    Vec3 normal = Math::Cross(vertices[indices[i + 1]].pos - p0, vertices[indices[i + 2]].pos - p0);
+    float length = Math::Length(normal);
+    if(length > 0.0f)
+      minDot = Math::Min(minDot, Math::Dot(normal, axis) / length);
+  }
+  cluster.mConeAxis = axis;
+  // Sine of the cone's half angle: view directions within 90 degrees minus that of the axis see every triangle's back
+  if(minDot > cMinConeDot)
+    cluster.mConeCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+}//namespace
+
+void BuildMeshClusters(Mesh* mesh)
+{
+  mesh->mClusters.Clear();
+  if(mesh->mLods.Empty() || mesh->mVertices.Empty())
+    return;
+  const MeshLod& lod = mesh->mLods[0];
+  if(lod.mIndexCount / 3 < cMinClusteredTriangles)
+    return;
+
+  // Stamps which cluster last used each vertex so counting a cluster's vertices needs no clearing
+  Array<uint32_t> vertexClusters(mesh->mVertices.Size(), cInvalidCluster);
+  const uint32_t* indices = mesh->mIndices.Data();
+  uint32_t clusterVertexCount = 0;
+  MeshCluster* cluster = nullptr;
+  for(uint32_t i = lod.mIndexOffset; i < lod.mIndexOffset + lod.mIndexCount; i += 3)
+  {
+    uint32_t clusterIndex = static_cast<uint32_t>(mesh->mClusters.Size() - 1);
+    uint32_t newVertexCount = 0;
+    for(size_t corner = 0; corner < 3; ++corner)
+      newVertexCount += (cluster != nullptr && vertexClusters[indices[i + corner]] == clusterIndex) ? 0 : 1;
+
+    // Besides the limits, a triangle that doesn't touch a cluster that's already half full starts a new one.
+    // That's usually a jump to another part of the mesh and would make the bounds much looser.
+    bool full = cluster == nullptr || clusterVertexCount + newVertexCount > cMaxClusterVertices || cluster->mIndexCount / 3 >= cMaxClusterTriangles;
+    bool disconnected = cluster != nullptr && newVertexCount == 3 && cluster->mIndexCount / 3 >= cMaxClusterTriangles / 2;
+    if(full || disconnected)
+    {
+      cluster = &mesh->mClusters.PushBack();
+      cluster->mIndexOffset = i;
+      clusterIndex = static_cast<uint32_t>(mesh->mClusters.Size() - 1);
+      clusterVertexCount = 0;
+    }
+
+    for(size_t corner = 0; corner < 3; ++corner)
+    {
+      uint32_t vertex = indices[i + corner];
+      if(vertexClusters[vertex] != clusterIndex)
+      {
+        vertexClusters[vertex] = clusterIndex;
+        ++clusterVertexCount;
+      }
+    }
+    cluster->mIndexCount += 3;
+  }
+
+  for(MeshCluster& meshCluster : mesh->mClusters)
+    ComputeClusterBounds(mesh, meshCluster);
+}
+
+bool IsClusterBackFacing(const MeshCluster& cluster, const Vec3& localPoint)
+{
+  Vec3 toCluster = cluster.mCenter - localPoint;
+  return Math::Dot(toCluster, cluster.mConeAxis) >= cluster.mConeCutoff * Math::Length(toCluster) + cluster.mRadius;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "GraphicsStandard.hpp"
+
+struct Mesh;
+struct MeshCluster;
+
+/// Cluster limits, small enough that a cluster is mostly on one side of the mesh so its normal cone stays narrow.
+constexpr size_t cMaxClusterVertices = 64;
+constexpr size_t cMaxClusterTriangles = 124;
+/// Meshes with fewer triangles at full detail are only culled as a whole, splitting them would just add draws.
+constexpr size_t cMinClusteredTriangles = 4096;
+
+/// Splits the mesh's first lod into clusters and computes each one's bounding sphere and normal cone.
+/// Triangles are taken in index order, which OptimizeMesh already made local, so the clusters are
+/// contiguous ranges of the index buffer and nothing is reordered.
+void BuildMeshClusters(Mesh* mesh);
+
+/// True if every triangle of the cluster faces away from the point. Back facing is kept by any invertible
+/// affine transform, so the point can be the camera moved into the mesh's local space.
+bool IsClusterBackFacing(const MeshCluster& cluster, const Vec3& localPoint);
@@ -0,0 +1,222 @@
+#include "Precompiled.hpp"
+
+#include "MeshCooker.hpp"
+
+#include "Mesh.hpp"
+#include "Utilities/MappedFile.hpp"
+
+namespace
+{
+
+// "VTMS" read as little endian
+constexpr uint32_t cCookedMeshMagic = 0x534D5456;
+constexpr size_t cCookedMeshChunkAlignment = 16;
+
+enum class CookedMeshChunkId : uint32_t
+{
+  VertexData = 1,
+  Indices = 2,
+  Lods = 3,
+  Clusters = 4
+};
+
+struct CookedMeshHeader
+{
+  uint32_t mMagic;
+  uint32_t mVersion;
+  uint64_t mSourceHash;
+
+  // Vertex format descriptor: which attributes are stored and how each one is packed
+  uint32_t mVertexAttributes;
+  uint32_t mVertexStride;
+  uint8_t mAttributeFormats[8];
+  uint32_t mVertexCount;
+  uint32_t mIndexCount;
+
+  Vec3 mAabbMin;
+  Vec3 mAabbMax;
+  Vec3 mBoundingSphereCenter;
+  float mBoundingSphereRadius;
+  Vec3 mPositionBias;
+  float mPositionScale;
+
+  uint32_t mChunkCount;
+  uint32_t mReserved;
+};
+static_assert(sizeof(Vec3) == 12, "Cooked mesh header expects tightly packed vectors");
+static_assert(cVertexAttributeCount <= 8, "Cooked mesh header has no room for the vertex attributes");
+
+struct CookedMeshChunk
+{
+  CookedMeshChunkId mId;
+  uint32_t mReserved;
+  uint64_t mOffset;
+  uint64_t mSize;
+};
+
+void AppendCookedChunk(Array<byte>& data, size_t chunkTableOffset, size_t chunkIndex, CookedMeshChunkId id, const void* chunkData, size_t size)
+{
+  while(data.Size() % cCookedMeshChunkAlignment != 0)
+    data.PushBack(0);
+
+  CookedMeshChunk chunk = {};
+  chunk.mId = id;
+  chunk.mOffset = data.Size();
+  chunk.mSize = size;
+  memcpy(data.Data() + chunkTableOffset + chunkIndex * sizeof(CookedMeshChunk), &chunk, sizeof(chunk));
+
+  size_t offset = data.Size();
+  data.Resize(offset + size);
+  if(size != 0)
+    memcpy(data.Data() + offset, chunkData, size);
+}
+
+const CookedMeshChunk* FindCookedChunk(const MappedFile& file, const CookedMeshHeader& header, CookedMeshChunkId id)
+{
+  const byte* chunkTable = file.GetData() + sizeof(CookedMeshHeader);
+  for(size_t i = 0; i < header.mChunkCount; ++i)
+  {
+    const CookedMeshChunk* chunk = reinterpret_cast<const CookedMeshChunk*>(chunkTable + i * sizeof(CookedMeshChunk));
+    if(chunk->mId == id)
+      return chunk;
+  }
+  return nullptr;
+}
+
+}//namespace
+
+bool SaveCookedMesh(const String& path, const Mesh& mesh, uint64_t sourceHash)
+{
+  const VertexFormat& vertexFormat = mesh.mVertexFormat;
+  if(vertexFormat.mStride == 0)
+    return false;
+
+  CookedMeshHeader header = {};
+  header.mMagic = cCookedMeshMagic;
+  header.mVersion = cCookedMeshVersion;
+  header.mSourceHash = sourceHash;
+  header.mVertexAttributes = vertexFormat.mAttributes;
+  header.mVertexStride = vertexFormat.mStride;
+  for(size_t i = 0; i < cVertexAttributeCount; ++i)
+    header.mAttributeFormats[i] = static_cast<uint8_t>(vertexFormat.GetFormat(static_cast<VertexAttribute>(i)));
+  header.mVertexCount = static_cast<uint32_t>(mesh.GetVertexDataSize() / vertexFormat.mStride);
+  header.mIndexCount = static_cast<uint32_t>(mesh.GetIndexCount());
+  header.mAabbMin = mesh.mAabbMin;
+  header.mAabbMax = mesh.mAabbMax;
+  header.mBoundingSphereCenter = mesh.mBoundingSphereCenter;
+  header.mBoundingSphereRadius = mesh.mBoundingSphereRadius;
+  header.mPositionBias = mesh.mPositionBias;
+  header.mPositionScale = mesh.mPositionScale;
+  header.mChunkCount = 4;
+
+  Array<byte> data;
+  data.Resize(sizeof(header) + header.mChunkCount * sizeof(CookedMeshChunk));
+  memcpy(data.Data(), &header, sizeof(header));
+  size_t chunkTableOffset = sizeof(header);
+  AppendCookedChunk(data, chunkTableOffset, 0, CookedMeshChunkId::VertexData, mesh.GetVertexData(), mesh.GetVertexDataSize());
+  AppendCookedChunk(data, chunkTableOffset, 1, CookedMeshChunkId::Indices, mesh.GetIndices(), mesh.GetIndexCount() * sizeof(uint32_t));
+  AppendCookedChunk(data, chunkTableOffset, 2, CookedMeshChunkId::Lods, mesh.mLods.Data(), mesh.mLods.Size() * sizeof(MeshLod));
+  AppendCookedChunk(data, chunkTableOffset, 3, CookedMeshChunkId::Clusters, mesh.mClusters.Data(), mesh.mClusters.Size() * sizeof(MeshCluster));
+
+  Zero::WriteToFile(path.c_str(), data.Data(), data.Size());
+  return true;
+}
+
+bool LoadCookedMesh(const String& path, Mesh& outMesh, uint64_t* outSourceHash)
+{
+  std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+  if(!file->Open(path) || file->GetSize() < sizeof(CookedMeshHeader))
+  {
+    Warn("'%s' isn't a cooked mesh", path.c_str());
+    return false;
+  }
+
+  CookedMeshHeader header;
+  memcpy(&header, file->GetData(), sizeof(header));
+  if(header.mMagic != cCookedMeshMagic)
+  {
+    Warn("'%s' isn't a cooked mesh", path.c_str());
+    return false;
+  }
+  // Old versions are expected after the format changes, they're silently recooked
+  if(header.mVersion != cCookedMeshVersion)
+    return false;
+
+  VertexFormat vertexFormat = BuildVertexFormat(header.mVertexAttributes);
+  bool formatMatches = vertexFormat.mAttributes == header.mVertexAttributes && vertexFormat.mStride == header.mVertexStride;
+  for(size_t i = 0; i < cVertexAttributeCount; ++i)
+    formatMatches &= header.mAttributeFormats[i] == static_cast<uint8_t>(vertexFormat.GetFormat(static_cast<VertexAttribute>(i)));
+  if(!formatMatches)
+    return false;
+
+  // Validate every chunk before anything in the mesh is touched
+  size_t fileSize = file->GetSize();
+  if(fileSize < sizeof(header) + header.mChunkCount * sizeof(CookedMeshChunk))
+  {
+    Warn("Cooked mesh '%s' is truncated", path.c_str());
+    return false;
+  }
+  const CookedMeshChunk* vertexChunk = FindCookedChunk(*file, header, CookedMeshChunkId::VertexData);
+  const CookedMeshChunk* indexChunk = FindCookedChunk(*file, header, CookedMeshChunkId::Indices);
+  const CookedMeshChunk* lodChunk = FindCookedChunk(*file, header, CookedMeshChunkId::Lods);
+  const CookedMeshChunk* clusterChunk = FindCookedChunk(*file, header, CookedMeshChunkId::Clusters);
+  for(const CookedMeshChunk* chunk : {vertexChunk, indexChunk, lodChunk, clusterChunk})
+  {
+    if(chunk == nullptr || chunk->mOffset % cCookedMeshChunkAlignment != 0 || chunk->mOffset > fileSize || fileSize - chunk->mOffset < chunk->mSize)
+    {
+      Warn("Cooked mesh '%s' has a bad chunk", path.c_str());
+      return false;
+    }
+  }
+  if(vertexChunk->mSize != static_cast<uint64_t>(header.mVertexCount) * header.mVertexStride || indexChunk->mSize != static_cast<uint64_t>(header.mIndexCount) * sizeof(uint32_t))
+  {
+    Warn("Cooked mesh '%s' has a bad chunk", path.c_str());
+    return false;
+  }
+  size_t lodCount = static_cast<size_t>(lodChunk->mSize / sizeof(MeshLod));
+  bool lodsValid = lodChunk->mSize % sizeof(MeshLod) == 0 && lodCount != 0 && lodCount <= cMaxMeshLods;
+  const MeshLod* lods = reinterpret_cast<const MeshLod*>(file->GetData() + lodChunk->mOffset);
+  for(size_t i = 0; lodsValid && i < lodCount; ++i)
+    lodsValid = lods[i].mIndexCount % 3 == 0 && static_cast<uint64_t>(lods[i].mIndexOffset) + lods[i].mIndexCount <= header.mIndexCount;
+  if(!lodsValid)
+  {
+    Warn("Cooked mesh '%s' has bad lods", path.c_str());
+    return false;
+  }
+  // Clusters split the first lod
+  size_t clusterCount = static_cast<size_t>(clusterChunk->mSize / sizeof(MeshCluster));
+  bool clustersValid = clusterChunk->mSize % sizeof(MeshCluster) == 0;
+  const MeshCluster* clusters = reinterpret_cast<const MeshCluster*>(file->GetData() + clusterChunk->mOffset);
+  for(size_t i = 0; clustersValid && i < clusterCount; ++i)
+  {
+    clustersValid = clusters[i].mIndexCount % 3 == 0 && clusters[i].mIndexOffset >= lods[0].mIndexOffset &&
+      static_cast<uint64_t>(clusters[i].mIndexOffset) + clusters[i].mIndexCount <= static_cast<uint64_t>(lods[0].mIndexOffset) + lods[0].mIndexCount;
+  }
+  if(!clustersValid)
+  {
+    Warn("Cooked mesh '%s' has bad clusters", path.c_str());
+    return false;
+  }
+
+  outMesh.mVertexFormat = vertexFormat;
+  outMesh.mAabbMin = header.mAabbMin;
+  outMesh.mAabbMax = header.mAabbMax;
+  outMesh.mBoundingSphereCenter = header.mBoundingSphereCenter;
+  outMesh.mBoundingSphereRadius = header.mBoundingSphereRadius;
+  outMesh.mPositionBias = header.mPositionBias;
+  outMesh.mPositionScale = header.mPositionScale;
+  outMesh.mCookedVertexData = file->GetData() + vertexChunk->mOffset;
+  outMesh.mCookedVertexDataSize = static_cast<size_t>(vertexChunk->mSize);
+  outMesh.mCookedIndices = reinterpret_cast<const uint32_t*>(file->GetData() + indexChunk->mOffset);
+  outMesh.mCookedIndexCount = header.mIndexCount;
+  outMesh.mLods.Resize(lodCount);
+  memcpy(outMesh.mLods.Data(), lods, lodCount * sizeof(MeshLod));
+  outMesh.mClusters.Resize(clusterCount);
+  if(clusterCount != 0)
+    memcpy(outMesh.mClusters.Data(), clusters, clusterCount * sizeof(MeshCluster));
+  outMesh.mCookedFile = file;
+
+  if(outSourceHash != nullptr)
+    *outSourceHash = header.mSourceHash;
+  return true;
+}
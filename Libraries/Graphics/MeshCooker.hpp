@@ -0,0 +1,16 @@
+#pragma once
+
+#include "GraphicsStandard.hpp"
+
+struct Mesh;
+
+/// Version of the cooked mesh layout. Files with any other version are recooked.
+constexpr uint32_t cCookedMeshVersion = 3;
+
+/// Cooked meshes are a fixed header, a chunk table, then each chunk's bytes aligned to 16. Only the packed
+/// vertices, indices, lod ranges and clusters are stored so loading is one mapping with no per-vertex work. The source hash
+/// is the source's StampCookSource combined with the lod and cluster settings it was cooked with.
+bool SaveCookedMesh(const String& path, const Mesh& mesh, uint64_t sourceHash);
+/// Maps the file and points the mesh's packed data at it. Fails if the file is from a different version or
+/// its vertex format no longer matches how the attributes are packed.
+bool LoadCookedMesh(const String& path, Mesh& outMesh, uint64_t* outSourceHash = nullptr);
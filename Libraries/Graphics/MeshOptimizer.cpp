@@ -0,0 +1,322 @@
+#include "Precompiled.hpp"
+
+#include "MeshOptimizer.hpp"
+
+#include "Mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+//-------------------------------------------------------------------Welding
+namespace
+{
+
+constexpr uint32_t cInvalidVertex = static_cast<uint32_t>(-1);
+
+uint32_t HashVertex(const Vertex& vertex)
+{
+  // Vertex is nothing but floats so hashing its words covers every attribute
+  static_assert(sizeof(Vertex) % sizeof(uint32_t) == 0, "Vertex isn't made of 32-bit words");
+  uint32_t words[sizeof(Vertex) / sizeof(uint32_t)];
+  memcpy(words, &vertex, sizeof(Vertex));
+
+  uint32_t hash = 2166136261u;
+  for(uint32_t word : words)
+  {
+    hash ^= word;
+    hash *= 16777619u;
+  }
+  return hash ^ (hash >> 16);
+}
+
+// Triangles using each vertex, laid out as one array with an offset per vertex
+struct VertexTriangles
+{
+  void Build(const Array<uint32_t>& indices, size_t vertexCount)
+  {
+    mOffsets.Resize(vertexCount + 1);
+    memset(mOffsets.Data(), 0, mOffsets.Size() * sizeof(uint32_t));
+    for(uint32_t index : indices)
+      ++mOffsets[index + 1];
+    for(size_t i = 0; i < vertexCount; ++i)
+      mOffsets[i + 1] += mOffsets[i];
+
+    mTriangles.Resize(indices.Size());
+    Array<uint32_t> cursors(mOffsets);
+    for(size_t i = 0; i < indices.Size(); ++i)
+      mTriangles[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+
+  uint32_t Count(uint32_t vertex) const { return mOffsets[vertex + 1] - mOffsets[vertex]; }
+
+  Array<uint32_t> mOffsets;
+  Array<uint32_t> mTriangles;
+};
+
+}//namespace
+
+size_t WeldVertices(Array<Vertex>& vertices, Array<uint32_t>& indices)
+{
+  size_t vertexCount = vertices.Size();
+  // Open addressing over the welded vertices, kept at most half full
+  size_t tableSize = 1;
+  while(tableSize < vertexCount * 2)
+    tableSize *= 2;
+  Array<uint32_t> table(tableSize, cInvalidVertex);
+
+  Array<uint32_t> remap(vertexCount);
+  size_t weldedCount = 0;
+  for(size_t i = 0; i < vertexCount; ++i)
+  {
+    const Vertex& vertex = vertices[i];
+    size_t slot = HashVertex(vertex) & (tableSize - 1);
+    while(table[slot] != cInvalidVertex && memcmp(&vertices[table[slot]], &vertex, sizeof(Vertex)) != 0)
+      slot = (slot + 1) & (tableSize - 1);
+
+    if(table[slot] == cInvalidVertex)
+    {
+      // Unique vertices are compacted in place, earlier slots are never read again
+      vertices[weldedCount] = vertex;
+      table[slot] = static_cast<uint32_t>(weldedCount++);
+    }
+    remap[i] = table[slot];
+  }
+
+  vertices.Resize(weldedCount);
+  for(uint32_t& index : indices)
+    index = remap[index];
+  return weldedCount;
+}
+
+//-------------------------------------------------------------------Vertex Cache
+namespace
+{
+
+// Next vertex to fan around once the last one's neighbors are used up. Recently emitted vertices
+// are tried first so the jump stays local, otherwise the first vertex with triangles left.
+uint32_t SkipDeadEnd(Array<uint32_t>& deadEnds, const Array<uint32_t>& liveTriangles, size_t& cursor)
+{
+  while(!deadEnds.Empty())
+  {
+    uint32_t vertex = deadEnds.Back();
+    deadEnds.PopBack();
+    if(liveTriangles[vertex] > 0)
+      return vertex;
+  }
+  for(; cursor < liveTriangles.Size(); ++cursor)
+  {
+    if(liveTriangles[cursor] > 0)
+      return static_cast<uint32_t>(cursor);
+  }
+  return cInvalidVertex;
+}
+
+}//namespace
+
+void OptimizeVertexCache(Array<uint32_t>& indices, size_t vertexCount, size_t cacheSize, Array<uint32_t>* outClusters)
+{
+  if(outClusters != nullptr)
+    outClusters->Clear();
+  size_t triangleCount = indices.Size() / 3;
+  if(triangleCount == 0)
+    return;
+
+  VertexTriangles adjacency;
+  adjacency.Build(indices, vertexCount);
+  Array<uint32_t> liveTriangles(vertexCount);
+  for(size_t i = 0; i < vertexCount; ++i)
+    liveTriangles[i] = adjacency.Count(static_cast<uint32_t>(i));
+
+  // A vertex is in the cache while time - cacheTime <= cacheSize
+  Array<size_t> cacheTimes(vertexCount, 0);
+  size_t time = cacheSize + 1;
+  Array<bool> emitted(triangleCount, false);
+  Array<uint32_t> deadEnds;
+  Array<uint32_t> candidates;
+  Array<uint32_t> result;
+  result.Reserve(indices.Size());
+
+  size_t cursor = 0;
+  uint32_t fanVertex = SkipDeadEnd(deadEnds, liveTriangles, cursor);
+  bool newCluster = true;
+  while(fanVertex != cInvalidVertex)
+  {
+    if(newCluster && outClusters != nullptr)
+      outClusters->PushBack(static_cast<uint32_t>(result.Size()));
+
+    candidates.Clear();
+    for(uint32_t i = adjacency.mOffsets[fanVertex]; i < adjacency.mOffsets[fanVertex + 1]; ++i)
+    {
+      uint32_t triangle = adjacency.mTriangles[i];
+      if(emitted[triangle])
+        continue;
+      emitted[triangle] = true;
+
+      for(size_t corner = 0; corner < 3; ++corner)
+      {
+        uint32_t vertex = indices[triangle * 3 + corner];
+        result.PushBack(vertex);
+        deadEnds.PushBack(vertex);
+        candidates.PushBack(vertex);
+        --liveTriangles[vertex];
+        if(time - cacheTimes[vertex] > cacheSize)
+          cacheTimes[vertex] = time++;
+      }
+    }
+
+    // Prefer the candidate that's been in the cache longest while still being in it after its remaining triangles are emitted
+    uint32_t nextVertex = cInvalidVertex;
+    size_t bestPriority = 0;
+    for(uint32_t vertex : candidates)
+    {
+      if(liveTriangles[vertex] == 0)
+        continue;
+      size_t priority = 0;
+      if(time - cacheTimes[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+        priority = time - cacheTimes[vertex];
+      if(nextVertex == cInvalidVertex || priority > bestPriority)
+      {
+        bestPriority = priority;
+        nextVertex = vertex;
+      }
+    }
+
+    newCluster = nextVertex == cInvalidVertex;
+    fanVertex = newCluster ? SkipDeadEnd(deadEnds, liveTriangles, cursor) : nextVertex;
+  }
+
+  indices = result;
+}
+
+float ComputeAcmr(const Array<uint32_t>& indices, size_t vertexCount, size_t cacheSize)
+{
+  size_t triangleCount = indices.Size() / 3;
+  if(triangleCount == 0)
+    return 0.0f;
+
+  // Same timestamp trick as above: misses push the vertex in, a vertex falls out after cacheSize more misses
+  Array<size_t> cacheTimes(vertexCount, 0);
+  size_t time = cacheSize + 1;
+  size_t misses = 0;
+  for(uint32_t index : indices)
+  {
+    if(time - cacheTimes[index] > cacheSize)
+    {
+      cacheTimes[index] = time++;
+      ++misses;
+    }
+  }
+  return misses / static_cast<float>(triangleCount);
+}
+
+//-------------------------------------------------------------------Overdraw
+void OptimizeOverdraw(Array<uint32_t>& indices, const Array<Vertex>& vertices, const Array<uint32_t>& clusters)
+{
+  size_t clusterCount = clusters.Size();
+  if(clusterCount < 2)
+    return;
+
+  // Area weighted centroid of every triangle and of the whole mesh
+  struct ClusterSortData
+  {
+    uint32_t mStart;
+    uint32_t mEnd;
+    float mSortKey;
+  };
+  Array<ClusterSortData> sortData(clusterCount);
+  Array<Vec3> clusterCentroids(clusterCount);
+  Array<Vec3> clusterNormals(clusterCount);
+  Vec3 meshCentroid = Vec3::cZero;
+  float meshArea = 0.0f;
+  for(size_t c = 0; c < clusterCount; ++c)
+  {
+    ClusterSortData& data = sortData[c];
+    data.mStart = clusters[c];
+    data.mEnd = c + 1 < clusterCount ? clusters[c + 1] : static_cast<uint32_t>(indices.Size());
+
+    Vec3 centroid = Vec3::cZero;
+    Vec3 normal = Vec3::cZero;
+    float clusterArea = 0.0f;
+    for(uint32_t i = data.mStart; i < data.mEnd; i += 3)
+    {
+      const Vec3& p0 = vertices[indices[i + 0]].pos;
+      const Vec3& p1 = vertices[indices[i + 1]].pos;
+      const Vec3& p2 = vertices[indices[i + 2]].pos;
+      // Twice the area times the normal, so summing weights larger triangles more
+      Vec3 areaNormal = Math::Cross(p1 - p0, p2 - p0);
+      float area = Math::Length(areaNormal);
+      centroid += (p0 + p1 + p2) * (area / 3.0f);
+      normal += areaNormal;
+      clusterArea += area;
+    }
+    meshCentroid += centroid;
+    meshArea += clusterArea;
+    clusterCentroids[c] = clusterArea > 0.0f ? centroid / clusterArea : vertices[indices[data.mStart]].pos;
+    clusterNormals[c] = normal;
+  }
+  if(meshArea > 0.0f)
+    meshCentroid /= meshArea;
+
+  for(size_t c = 0; c < clusterCount; ++c)
+  {
+    float normalLength = Math::Length(clusterNormals[c]);
+    Vec3 normal = normalLength > 0.0f ? clusterNormals[c] / normalLength : Vec3::cZero;
+    sortData[c].mSortKey = Math::Dot(clusterCentroids[c] - meshCentroid, normal);
+  }
+  std::stable_sort(sortData.Data(), sortData.Data() + sortData.Size(), [](const ClusterSortData& lhs, const ClusterSortData& rhs)
+  {
+    return lhs.mSortKey > rhs.mSortKey;
+  });
+
+  Array<uint32_t> result;
+  result.Reserve(indices.Size());
+  for(const ClusterSortData& data : sortData)
+  {
+    for(uint32_t i = data.mStart; i < data.mEnd; ++i)
+      result.PushBack(indices[i]);
+  }
+  indices = result;
+}
+
+//-------------------------------------------------------------------Vertex Fetch
+void OptimizeVertexFetch(Array<Vertex>& vertices, Array<uint32_t>& indices)
+{
+  Array<uint32_t> remap(vertices.Size(), cInvalidVertex);
+  Array<Vertex> result;
+  result.Reserve(vertices.Size());
+  for(uint32_t& index : indices)
+  {
+    if(remap[index] == cInvalidVertex)
+    {
+      remap[index] = static_cast<uint32_t>(result.Size());
+      result.PushBack(vertices[index]);
+    }
+    index = remap[index];
+  }
+  vertices = result;
+}
+
+//-------------------------------------------------------------------OptimizeMesh
+void OptimizeMesh(Mesh* mesh, MeshOptimizationStatistics* outStatistics)
+{
+  Array<Vertex>& vertices = mesh->mVertices;
+  Array<uint32_t>& indices = mesh->mIndices;
+
+  MeshOptimizationStatistics statistics;
+  statistics.mVertexCountBefore = vertices.Size();
+  statistics.mIndexCount = indices.Size();
+  statistics.mSizeBefore = vertices.Size() * sizeof(Vertex) + indices.Size() * sizeof(uint32_t);
+  statistics.mAcmrBefore = ComputeAcmr(indices, vertices.Size());
+
+  WeldVertices(vertices, indices);
+  Array<uint32_t> clusters;
+  OptimizeVertexCache(indices, vertices.Size(), cMeshVertexCacheSize, &clusters);
+  OptimizeOverdraw(indices, vertices, clusters);
+  OptimizeVertexFetch(vertices, indices);
+
+  statistics.mVertexCountAfter = vertices.Size();
+  statistics.mSizeAfter = vertices.Size() * sizeof(Vertex) + indices.Size() * sizeof(uint32_t);
+  statistics.mAcmrAfter = ComputeAcmr(indices, vertices.Size());
+  if(outStatistics != nullptr)
+    *outStatistics = statistics;
+}
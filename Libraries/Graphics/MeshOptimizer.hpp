@@ -0,0 +1,43 @@
+#pragma once
+
+#include "GraphicsStandard.hpp"
+#include "Vertex.hpp"
+
+struct Mesh;
+
+/// Size of the FIFO post-transform cache that triangles are ordered for and that ACMR is measured with.
+constexpr size_t cMeshVertexCacheSize = 16;
+
+//-------------------------------------------------------------------MeshOptimizationStatistics
+struct MeshOptimizationStatistics
+{
+  size_t mVertexCountBefore = 0;
+  size_t mVertexCountAfter = 0;
+  size_t mIndexCount = 0;
+  // Vertex and index buffer bytes
+  size_t mSizeBefore = 0;
+  size_t mSizeAfter = 0;
+  // Average cache miss ratio: transformed vertices per triangle. 0.5 is the best possible, 3 means no reuse.
+  float mAcmrBefore = 0.0f;
+  float mAcmrAfter = 0.0f;
+};
+
+/// Merges vertices whose attributes are bitwise identical and remaps the indices. Returns the new vertex count.
+size_t WeldVertices(Array<Vertex>& vertices, Array<uint32_t>& indices);
+
+/// Reorders triangles for the post-transform cache with Tipsify (Sander et al. 2007). The index where each run of
+/// triangles starts after the fan had to jump somewhere unrelated is written to outClusters if given.
+void OptimizeVertexCache(Array<uint32_t>& indices, size_t vertexCount, size_t cacheSize = cMeshVertexCacheSize, Array<uint32_t>* outClusters = nullptr);
+
+/// Sorts the clusters from OptimizeVertexCache so the ones facing away from the mesh's center draw first. Those
+/// tend to be in front from any direction so less is shaded and then hidden. Triangles inside a cluster keep their order.
+void OptimizeOverdraw(Array<uint32_t>& indices, const Array<Vertex>& vertices, const Array<uint32_t>& clusters);
+
+/// Reorders vertices by first use in the index buffer so fetches walk memory in order. Unreferenced vertices are dropped.
+void OptimizeVertexFetch(Array<Vertex>& vertices, Array<uint32_t>& indices);
+
+/// Transformed vertices per triangle for a FIFO cache of the given size.
+float ComputeAcmr(const Array<uint32_t>& indices, size_t vertexCount, size_t cacheSize = cMeshVertexCacheSize);
+
+/// Runs the whole import pipeline on the mesh: weld, cache order, overdraw order, then fetch order.
+void OptimizeMesh(Mesh* mesh, MeshOptimizationStatistics* outStatistics = nullptr);
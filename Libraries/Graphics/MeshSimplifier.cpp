@@ -0,0 +1,367 @@
+#include "Precompiled.hpp"
+
+#include "MeshSimplifier.hpp"
+
+#include "Mesh.hpp"
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+constexpr uint32_t cInvalidVertex = static_cast<uint32_t>(-1);
+
+//-------------------------------------------------------------------Quadric
+// Sum of squared distances to a set of planes, as the symmetric 4x4 matrix's upper triangle.
+// Doubles because the terms cancel badly for large meshes far from the origin.
+struct Quadric
+{
+  void AddPlane(const Vec3& normal, double distance, double weight)
+  {
+    double x = normal.x, y = normal.y, z = normal.z;
+    m00 += weight * x * x; m01 += weight * x * y; m02 += weight * x * z; m03 += weight * x * distance;
+    m11 += weight * y * y; m12 += weight * y * z; m13 += weight * y * distance;
+    m22 += weight * z * z; m23 += weight * z * distance;
+    m33 += weight * distance * distance;
+    mWeight += weight;
+  }
+
+  void Add(const Quadric& rhs)
+  {
+    m00 += rhs.m00; m01 += rhs.m01; m02 += rhs.m02; m03 += rhs.m03;
+    m11 += rhs.m11; m12 += rhs.m12; m13 += rhs.m13;
+    m22 += rhs.m22; m23 += rhs.m23;
+    m33 += rhs.m33;
+    mWeight += rhs.mWeight;
+  }
+
+  // Area weighted mean squared distance from the point to the planes
+  double Evaluate(const Vec3& point) const
+  {
+    double x = point.x, y = point.y, z = point.z;
+    double error = m00 * x * x + m11 * y * y + m22 * z * z + m33 +
+                   2.0 * (m01 * x * y + m02 * x * z + m12 * y * z + m03 * x + m13 * y + m23 * z);
+    return mWeight > 0.0 ? Math::Max(error, 0.0) / mWeight : 0.0;
+  }
+
+  double m00 = 0, m01 = 0, m02 = 0, m03 = 0;
+  double m11 = 0, m12 = 0, m13 = 0;
+  double m22 = 0, m23 = 0;
+  double m33 = 0;
+  double mWeight = 0;
+};
+
+Quadric Combine(const Quadric& lhs, const Quadric& rhs)
+{
+  Quadric result = lhs;
+  result.Add(rhs);
+  return result;
+}
+
+// Vertices that share a position, which the vertex cache welding kept apart because another attribute differs
+void FindPositionGroups(const Array<Vertex>& vertices, Array<uint32_t>& outGroups, Array<uint32_t>& outGroupSizes)
+{
+  size_t vertexCount = vertices.Size();
+  Array<uint32_t> order(vertexCount);
+  for(size_t i = 0; i < vertexCount; ++i)
+    order[i] = static_cast<uint32_t>(i);
+  std::sort(order.Data(), order.Data() + vertexCount, [&vertices](uint32_t lhs, uint32_t rhs)
+  {
+    return memcmp(&vertices[lhs].pos, &vertices[rhs].pos, sizeof(Vec3)) < 0;
+  });
+
+  outGroups.Resize(vertexCount);
+  outGroupSizes.Clear();
+  for(size_t i = 0; i < vertexCount; ++i)
+  {
+    if(i == 0 || memcmp(&vertices[order[i - 1]].pos, &vertices[order[i]].pos, sizeof(Vec3)) != 0)
+      outGroupSizes.PushBack(0);
+    outGroups[order[i]] = static_cast<uint32_t>(outGroupSizes.Size() - 1);
+    ++outGroupSizes.Back();
+  }
+}
+
+//-------------------------------------------------------------------Simplifier
+// Keeps the quadrics between calls so coarser levels continue from finer ones and their error is
+// measured against the full detail surface.
+class Simplifier
+{
+public:
+  void Initialize(const Array<Vertex>& vertices, const Array<uint32_t>& indices)
+  {
+    mVertices = &vertices;
+    mIndices = indices;
+    size_t vertexCount = vertices.Size();
+
+    mQuadrics.Clear();
+    mQuadrics.Resize(vertexCount);
+    for(size_t i = 0; i + 2 < mIndices.Size(); i += 3)
+    {
+      const Vec3& p0 = vertices[mIndices[i + 0]].pos;
+      const Vec3& p1 = vertices[mIndices[i + 1]].pos;
+      const Vec3& p2 = vertices[mIndices[i + 2]].pos;
+      Vec3 normal = Math::Cross(p1 - p0, p2 - p0);
+      float doubleArea = Math::Length(normal);
+      if(doubleArea <= 0.0f)
+        continue;
+      normal = normal / doubleArea;
+      Quadric quadric;
+      quadric.AddPlane(normal, -Math::Dot(normal, p0), doubleArea * 0.5);
+      for(size_t corner = 0; corner < 3; ++corner)
+        mQuadrics[mIndices[i + corner]].Add(quadric);
+    }
+
+    // Borders are edges with one triangle once seams are ignored. Both they and seams are locked.
+    Array<uint32_t> groups, groupSizes;
+    FindPositionGroups(vertices, groups, groupSizes);
+    Array<uint64_t> edges;
+    edges.Reserve(mIndices.Size());
+    for(size_t i = 0; i + 2 < mIndices.Size(); i += 3)
+    {
+      for(size_t corner = 0; corner < 3; ++corner)
+      {
+        uint64_t a = groups[mIndices[i + corner]];
+        uint64_t b = groups[mIndices[i + (corner + 1) % 3]];
+        edges.PushBack(a < b ? (a << 32 | b) : (b << 32 | a));
+      }
+    }
+    std::sort(edges.Data(), edges.Data() + edges.Size());
+
+    Array<bool> borderGroups(groupSizes.Size(), false);
+    for(size_t i = 0; i < edges.Size();)
+    {
+      size_t end = i + 1;
+      while(end < edges.Size() && edges[end] == edges[i])
+        ++end;
+      if(end - i == 1)
+      {
+        borderGroups[static_cast<size_t>(edges[i] >> 32)] = true;
+        borderGroups[static_cast<size_t>(edges[i] & 0xFFFFFFFF)] = true;
+      }
+      i = end;
+    }
+
+    mLocked = Array<bool>(vertexCount, false);
+    for(size_t i = 0; i < vertexCount; ++i)
+      mLocked[i] = borderGroups[groups[i]] || groupSizes[groups[i]] > 1;
+    mError = 0.0;
+  }
+
+  // Stops early once every remaining collapse costs more than the error
+  void Simplify(size_t targetIndexCount, double maxError)
+  {
+    double maxErrorSq = maxError * maxError;
+    while(mIndices.Size() > targetIndexCount)
+    {
+      size_t removedTriangles = CollapsePass(targetIndexCount, maxErrorSq);
+      if(removedTriangles == 0)
+        break;
+    }
+  }
+
+  const Array<uint32_t>& GetIndices() const { return mIndices; }
+  float GetError() const { return static_cast<float>(std::sqrt(mError)); }
+
+private:
+  struct Collapse
+  {
+    uint32_t mFrom;
+    uint32_t mTo;
+    double mCost;
+  };
+
+  // Collapses as many independent edges as fit in the remaining budget, cheapest first.
+  // Vertices next to a collapse are skipped until the next pass so the adjacency stays valid.
+  size_t CollapsePass(size_t targetIndexCount, double maxErrorSq)
+  {
+    const Array<Vertex>& vertices = *mVertices;
+    size_t vertexCount = vertices.Size();
+    BuildAdjacency();
+
+    // Cheapest edge out of every vertex that's free to move
+    mCollapses.Clear();
+    for(size_t u = 0; u < vertexCount; ++u)
+    {
+      if(mLocked[u] || mOffsets[u] == mOffsets[u + 1])
+        continue;
+
+      Collapse best = {static_cast<uint32_t>(u), cInvalidVertex, 0.0};
+      for(uint32_t i = mOffsets[u]; i < mOffsets[u + 1]; ++i)
+      {
+        uint32_t triangle = mTriangles[i];
+        for(size_t corner = 0; corner < 3; ++corner)
+        {
+          uint32_t v = mIndices[triangle * 3 + corner];
+          if(v == u)
+            continue;
+          double cost = Combine(mQuadrics[u], mQuadrics[v]).Evaluate(vertices[v].pos);
+          if(best.mTo == cInvalidVertex || cost < best.mCost)
+          {
+            best.mTo = v;
+            best.mCost = cost;
+          }
+        }
+      }
+      if(best.mTo != cInvalidVertex && best.mCost <= maxErrorSq)
+        mCollapses.PushBack(best);
+    }
+    std::sort(mCollapses.Data(), mCollapses.Data() + mCollapses.Size(), [](const Collapse& lhs, const Collapse& rhs)
+    {
+      return lhs.mCost < rhs.mCost;
+    });
+
+    size_t triangleCount = mIndices.Size() / 3;
+    size_t targetTriangleCount = targetIndexCount / 3;
+    size_t removedTriangles = 0;
+    mRemap.Resize(vertexCount);
+    for(size_t i = 0; i < vertexCount; ++i)
+      mRemap[i] = static_cast<uint32_t>(i);
+    mTouched = Array<bool>(vertexCount, false);
+
+    for(const Collapse& collapse : mCollapses)
+    {
+      if(triangleCount - removedTriangles <= targetTriangleCount)
+        break;
+      if(mTouched[collapse.mFrom] || mTouched[collapse.mTo] || FlipsTriangle(collapse.mFrom, collapse.mTo))
+        continue;
+
+      mRemap[collapse.mFrom] = collapse.mTo;
+      mQuadrics[collapse.mTo].Add(mQuadrics[collapse.mFrom]);
+      mError = Math::Max(mError, collapse.mCost);
+      for(uint32_t i = mOffsets[collapse.mFrom]; i < mOffsets[collapse.mFrom + 1]; ++i)
+      {
+        uint32_t triangle = mTriangles[i];
+        bool degenerate = false;
+        for(size_t corner = 0; corner < 3; ++corner)
+        {
+          uint32_t vertex = mIndices[triangle * 3 + corner];
+          mTouched[vertex] = true;
+          degenerate |= vertex == collapse.mTo;
+        }
+        removedTriangles += degenerate ? 1 : 0;
+      }
+    }
+
+    // Apply the collapses and drop the triangles that lost an edge
+    size_t writeIndex = 0;
+    for(size_t i = 0; i + 2 < mIndices.Size(); i += 3)
+    {
+      uint32_t a = mRemap[mIndices[i + 0]];
+      uint32_t b = mRemap[mIndices[i + 1]];
+      uint32_t c = mRemap[mIndices[i + 2]];
+      if(a == b || b == c || a == c)
+        continue;
+      mIndices[writeIndex++] = a;
+      mIndices[writeIndex++] = b;
+      mIndices[writeIndex++] = c;
+    }
+    mIndices.Resize(writeIndex);
+    return removedTriangles;
+  }
+
+  // Moving from onto to can't turn any of from's remaining triangles over or make them slivers
+  bool FlipsTriangle(uint32_t from, uint32_t to) const
+  {
+    const Array<Vertex>& vertices = *mVertices;
+    for(uint32_t i = mOffsets[from]; i < mOffsets[from + 1]; ++i)
+    {
+      const uint32_t* triangle = &mIndices[mTriangles[i] * 3];
+      if(triangle[0] == to || triangle[1] == to || triangle[2] == to)
+        continue;
+
+      Vec3 oldPositions[3], newPositions[3];
+      for(size_t corner = 0; corner < 3; ++corner)
+      {
+        oldPositions[corner] = vertices[triangle[corner]].pos;
+        newPositions[corner] = triangle[corner] == from ? vertices[to].pos : oldPositions[corner];
+      }
+      Vec3 oldNormal = Math::Cross(oldPositions[1] - oldPositions[0], oldPositions[2] - oldPositions[0]);
+      Vec3 newNormal = Math::Cross(newPositions[1] - newPositions[0], newPositions[2] - newPositions[0]);
+      // Rejects anything that turns more than about 75 degrees
+      if(Math::Dot(oldNormal, newNormal) <= 0.25f * Math::Length(oldNormal) * Math::Length(newNormal))
+        return true;
+    }
+    return false;
+  }
+
+  void BuildAdjacency()
+  {
+    size_t vertexCount = mVertices->Size();
+    mOffsets.Resize(vertexCount + 1);
+    memset(mOffsets.Data(), 0, mOffsets.Size() * sizeof(uint32_t));
+    for(uint32_t index : mIndices)
+      ++mOffsets[index + 1];
+    for(size_t i = 0; i < vertexCount; ++i)
+      mOffsets[i + 1] += mOffsets[i];
+
+    mTriangles.Resize(mIndices.Size());
+    mCursors = mOffsets;
+    for(size_t i = 0; i < mIndices.Size(); ++i)
+      mTriangles[mCursors[mIndices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+
+  const Array<Vertex>* mVertices = nullptr;
+  Array<uint32_t> mIndices;
+  Array<Quadric> mQuadrics;
+  Array<bool> mLocked;
+  double mError = 0.0;
+
+  // Scratch reused by every pass
+  Array<uint32_t> mOffsets;
+  Array<uint32_t> mCursors;
+  Array<uint32_t> mTriangles;
+  Array<Collapse> mCollapses;
+  Array<uint32_t> mRemap;
+  Array<bool> mTouched;
+};
+
+}//namespace
+
+float SimplifyMesh(const Array<Vertex>& vertices, const Array<uint32_t>& indices, size_t targetIndexCount, float maxError, Array<uint32_t>& outIndices)
+{
+  Simplifier simplifier;
+  simplifier.Initialize(vertices, indices);
+  simplifier.Simplify(targetIndexCount, maxError);
+  outIndices = simplifier.GetIndices();
+  return simplifier.GetError();
+}
+
+void GenerateMeshLods(Mesh* mesh, const MeshLodSettings& settings)
+{
+  Array<uint32_t>& indices = mesh->mIndices;
+  size_t fullIndexCount = indices.Size();
+  mesh->mLods.Clear();
+  MeshLod& fullLod = mesh->mLods.PushBack();
+  fullLod.mIndexCount = static_cast<uint32_t>(fullIndexCount);
+  if(fullIndexCount == 0 || settings.mTargetRatios.Empty())
+    return;
+
+  float maxError = settings.mMaxRelativeError * mesh->mBoundingSphereRadius;
+  Simplifier simplifier;
+  simplifier.Initialize(mesh->mVertices, indices);
+  Array<uint32_t> lodIndices;
+  for(float ratio : settings.mTargetRatios)
+  {
+    if(mesh->mLods.Size() == cMaxMeshLods)
+      break;
+
+    size_t targetIndexCount = static_cast<size_t>(fullIndexCount / 3 * ratio) * 3;
+    simplifier.Simplify(targetIndexCount, maxError);
+    const Array<uint32_t>& simplified = simplifier.GetIndices();
+    // Not enough left to collapse within the error for this level to be worth drawing
+    if(simplified.Size() > mesh->mLods.Back().mIndexCount * settings.mMinReduction)
+      break;
+
+    lodIndices = simplified;
+    OptimizeVertexCache(lodIndices, mesh->mVertices.Size());
+
+    MeshLod& lod = mesh->mLods.PushBack();
+    lod.mIndexOffset = static_cast<uint32_t>(indices.Size());
+    lod.mIndexCount = static_cast<uint32_t>(lodIndices.Size());
+    lod.mError = simplifier.GetError();
+    for(uint32_t index : lodIndices)
+      indices.PushBack(index);
+  }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "GraphicsStandard.hpp"
+#include "Vertex.hpp"
+
+struct Mesh;
+
+//-------------------------------------------------------------------MeshLodSettings
+struct MeshLodSettings
+{
+  // Triangle count of each level after the first as a fraction of the full mesh's, finest first
+  Array<float> mTargetRatios;
+  // Simplification stops once the error would exceed this fraction of the mesh's bounding radius
+  float mMaxRelativeError = 0.05f;
+  // A level is only kept if it has at most this fraction of the previous level's triangles
+  float mMinReduction = 0.85f;
+};
+
+/// Collapses edges onto one of their vertices, cheapest quadric error first (Garland and Heckbert 1997), until
+/// the index count is at or below the target or every remaining collapse costs more than maxError. No vertices
+/// are created or moved so the result indexes the same vertex buffer. Vertices on open borders and attribute
+/// seams never move so the surface doesn't crack. Returns the largest distance the surface moved.
+float SimplifyMesh(const Array<Vertex>& vertices, const Array<uint32_t>& indices, size_t targetIndexCount, float maxError, Array<uint32_t>& outIndices);
+
+/// Builds the mesh's lod chain from mIndices, which stays as the first level. Each coarser level is simplified
+/// from the last one, reordered for the vertex cache and appended to mIndices.
+void GenerateMeshLods(Mesh* mesh, const MeshLodSettings& settings);
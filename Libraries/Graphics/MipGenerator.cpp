@@ -0,0 +1,443 @@
+#include "Precompiled.hpp"
+
+#include "MipGenerator.hpp"
+
+#include "Utilities/ThreadPool.hpp"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define MIP_GENERATOR_SSE 1
+  #include <immintrin.h>
+#endif
+#if defined(MIP_GENERATOR_SSE) && defined(__AVX__)
+  #define MIP_GENERATOR_AVX 1
+#endif
+
+//-------------------------------------------------------------------Texel conversion
+enum class TexelComponent
+{
+  Unorm8, Unorm16, Half, Float, Srgb8
+};
+
+struct TexelLayout
+{
+  TexelComponent mComponent;
+  size_t mChannelCount;
+  size_t mComponentSize;
+};
+
+bool GetTexelLayout(TextureFormat format, TexelLayout& outLayout)
+{
+  switch(format)
+  {
+  case TextureFormat::R8: outLayout = {TexelComponent::Unorm8, 1, 1}; return true;
+  case TextureFormat::RG8: outLayout = {TexelComponent::Unorm8, 2, 1}; return true;
+  case TextureFormat::RGB8: outLayout = {TexelComponent::Unorm8, 3, 1}; return true;
+  case TextureFormat::RGBA8: outLayout = {TexelComponent::Unorm8, 4, 1}; return true;
+  case TextureFormat::R16: outLayout = {TexelComponent::Unorm16, 1, 2}; return true;
+  case TextureFormat::RG16: outLayout = {TexelComponent::Unorm16, 2, 2}; return true;
+  case TextureFormat::RGB16: outLayout = {TexelComponent::Unorm16, 3, 2}; return true;
+  case TextureFormat::RGBA16: outLayout = {TexelComponent::Unorm16, 4, 2}; return true;
+  case TextureFormat::R16f: outLayout = {TexelComponent::Half, 1, 2}; return true;
+  case TextureFormat::RG16f: outLayout = {TexelComponent::Half, 2, 2}; return true;
+  case TextureFormat::RGB16f: outLayout = {TexelComponent::Half, 3, 2}; return true;
+  case TextureFormat::RGBA16f: outLayout = {TexelComponent::Half, 4, 2}; return true;
+  case TextureFormat::R32f: outLayout = {TexelComponent::Float, 1, 4}; return true;
+  case TextureFormat::RG32f: outLayout = {TexelComponent::Float, 2, 4}; return true;
+  case TextureFormat::RGB32f: outLayout = {TexelComponent::Float, 3, 4}; return true;
+  case TextureFormat::RGBA32f: outLayout = {TexelComponent::Float, 4, 4}; return true;
+  case TextureFormat::SRGB8: outLayout = {TexelComponent::Srgb8, 3, 1}; return true;
+  case TextureFormat::SRGB8A8: outLayout = {TexelComponent::Srgb8, 4, 1}; return true;
+  default:
+    return false;
+  }
+}
+
+float HalfToFloat(uint16_t half)
+{
+  uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1F;
+  uint32_t mantissa = half & 0x3FF;
+  if(exponent == 0)
+  {
+    float value = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign ? -value : value;
+  }
+
+  uint32_t bits = sign | (exponent == 31 ? (0xFFu << 23) : ((exponent + 112) << 23)) | (mantissa << 13);
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+uint16_t FloatToHalf(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000;
+  int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 112;
+  uint32_t mantissa = bits & 0x7FFFFF;
+  if((bits & 0x7FFFFFFF) > 0x7F800000)
+    return static_cast<uint16_t>(sign | 0x7E00);
+  if(exponent >= 31)
+    return static_cast<uint16_t>(sign | 0x7C00);
+  // Too small for a normal half, mips don't need denormals
+  if(exponent <= 0)
+    return static_cast<uint16_t>(sign);
+
+  // Rounding can carry into the exponent which still gives the right result
+  uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+  if(mantissa & 0x1000)
+    ++half;
+  return static_cast<uint16_t>(half);
+}
+
+struct SrgbToLinearTable
+{
+  SrgbToLinearTable()
+  {
+    for(size_t i = 0; i < 256; ++i)
+    {
+      float value = i / 255.0f;
+      mValues[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+  }
+
+  float mValues[256];
+};
+static const SrgbToLinearTable sSrgbToLinear;
+
+float LinearToSrgb(float value)
+{
+  return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+float Saturate(float value)
+{
+  return Math::Min(Math::Max(value, 0.0f), 1.0f);
+}
+
+bool SupportsCpuMips(TextureFormat format)
+{
+  TexelLayout layout;
+  return GetTexelLayout(format, layout);
+}
+
+bool DecodeLinearTexels(TextureFormat format, const byte* texels, size_t count, float* outRgba)
+{
+  TexelLayout layout;
+  if(!GetTexelLayout(format, layout))
+    return false;
+
+  size_t texelSize = layout.mChannelCount * layout.mComponentSize;
+  for(size_t i = 0; i < count; ++i)
+  {
+    const byte* texel = texels + i * texelSize;
+    float* rgba = outRgba + i * 4;
+    rgba[0] = rgba[1] = rgba[2] = 0.0f;
+    rgba[3] = 1.0f;
+    for(size_t c = 0; c < layout.mChannelCount; ++c)
+    {
+      const byte* component = texel + c * layout.mComponentSize;
+      switch(layout.mComponent)
+      {
+      case TexelComponent::Unorm8:
+        rgba[c] = component[0] / 255.0f;
+        break;
+      case TexelComponent::Srgb8:
+        rgba[c] = c < 3 ? sSrgbToLinear.mValues[component[0]] : component[0] / 255.0f;
+        break;
+      case TexelComponent::Unorm16:
+      {
+        uint16_t value;
+        memcpy(&value, component, sizeof(value));
+        rgba[c] = value / 65535.0f;
+        break;
+      }
+      case TexelComponent::Half:
+      {
+        uint16_t value;
+        memcpy(&value, component, sizeof(value));
+        rgba[c] = HalfToFloat(value);
+        break;
+      }
+      case TexelComponent::Float:
+        memcpy(&rgba[c], component, sizeof(float));
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+bool EncodeLinearTexels(TextureFormat format, const float* rgba, size_t count, byte* outTexels)
+{
+  TexelLayout layout;
+  if(!GetTexelLayout(format, layout))
+    return false;
+
+  size_t texelSize = layout.mChannelCount * layout.mComponentSize;
+  for(size_t i = 0; i < count; ++i)
+  {
+    byte* texel = outTexels + i * texelSize;
+    const float* values = rgba + i * 4;
+    for(size_t c = 0; c < layout.mChannelCount; ++c)
+    {
+      byte* component = texel + c * layout.mComponentSize;
+      switch(layout.mComponent)
+      {
+      case TexelComponent::Unorm8:
+        component[0] = static_cast<byte>(Saturate(values[c]) * 255.0f + 0.5f);
+        break;
+      case TexelComponent::Srgb8:
+      {
+        float value = c < 3 ? LinearToSrgb(Saturate(values[c])) : values[c];
+        component[0] = static_cast<byte>(Saturate(value) * 255.0f + 0.5f);
+        break;
+      }
+      case TexelComponent::Unorm16:
+      {
+        uint16_t value = static_cast<uint16_t>(Saturate(values[c]) * 65535.0f + 0.5f);
+        memcpy(component, &value, sizeof(value));
+        break;
+      }
+      case TexelComponent::Half:
+      {
+        uint16_t value = FloatToHalf(values[c]);
+        memcpy(component, &value, sizeof(value));
+        break;
+      }
+      case TexelComponent::Float:
+        memcpy(component, &values[c], sizeof(float));
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+//-------------------------------------------------------------------Filtering
+typedef std::function<void(size_t firstRow, size_t rowEnd)> RowRangeFn;
+
+/// Splits rows into jobs of a few rows each so small levels don't pay for waking up workers.
+void ForEachRowRange(size_t rowCount, ThreadPool* threadPool, const RowRangeFn& rowFn)
+{
+  constexpr size_t cRowsPerJob = 16;
+  if(threadPool == nullptr || rowCount <= cRowsPerJob)
+  {
+    rowFn(0, rowCount);
+    return;
+  }
+
+  size_t jobCount = (rowCount + cRowsPerJob - 1) / cRowsPerJob;
+  threadPool->ParallelFor(jobCount, [&](size_t jobIndex, size_t)
+  {
+    size_t firstRow = jobIndex * cRowsPerJob;
+    rowFn(firstRow, Math::Min(firstRow + cRowsPerJob, rowCount));
+  });
+}
+
+void BoxDownsampleRows(const float* source, size_t sourceX, size_t sourceY, float* destination, size_t destinationX, size_t firstRow, size_t rowEnd)
+{
+  for(size_t y = firstRow; y < rowEnd; ++y)
+  {
+    const float* row0 = source + Math::Min(y * 2, sourceY - 1) * sourceX * 4;
+    const float* row1 = source + Math::Min(y * 2 + 1, sourceY - 1) * sourceX * 4;
+    float* result = destination + y * destinationX * 4;
+
+    size_t x = 0;
+#if defined(MIP_GENERATOR_AVX)
+    // Two destination texels from 4 adjacent source texels per row
+    for(; x + 2 <= destinationX && x * 2 + 3 < sourceX; x += 2)
+    {
+      __m256 left = _mm256_add_ps(_mm256_loadu_ps(row0 + x * 8), _mm256_loadu_ps(row1 + x * 8));
+      __m256 right = _mm256_add_ps(_mm256_loadu_ps(row0 + x * 8 + 8), _mm256_loadu_ps(row1 + x * 8 + 8));
+      __m256 sum = _mm256_add_ps(_mm256_permute2f128_ps(left, right, 0x20), _mm256_permute2f128_ps(left, right, 0x31));
+      _mm256_storeu_ps(result + x * 4, _mm256_mul_ps(sum, _mm256_set1_ps(0.25f)));
+    }
+#endif
+    for(; x < destinationX; ++x)
+    {
+      size_t x0 = Math::Min(x * 2, sourceX - 1) * 4;
+      size_t x1 = Math::Min(x * 2 + 1, sourceX - 1) * 4;
+#if defined(MIP_GENERATOR_SSE)
+      // One texel is exactly one register
+      __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)), _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+      _mm_storeu_ps(result + x * 4, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+      for(size_t c = 0; c < 4; ++c)
+        result[x * 4 + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+#endif
+    }
+  }
+}
+
+// Source texels 2x-2 to 2x+3 contribute to destination texel x
+constexpr size_t cKaiserTaps = 6;
+
+struct KaiserWeights
+{
+  KaiserWeights()
+  {
+    const float cAlpha = 4.0f;
+    const float cRadius = cKaiserTaps / 2.0f;
+    float total = 0;
+    for(size_t i = 0; i < cKaiserTaps; ++i)
+    {
+      // Distance in source texels from the destination texel's center
+      float distance = i - (cKaiserTaps / 2.0f - 0.5f);
+      float t = distance / cRadius;
+      float window = BesselI0(cAlpha * std::sqrt(Math::Max(1.0f - t * t, 0.0f))) / BesselI0(cAlpha);
+      mValues[i] = Sinc(distance * 0.5f) * window;
+      total += mValues[i];
+    }
+    for(size_t i = 0; i < cKaiserTaps; ++i)
+      mValues[i] /= total;
+  }
+
+  static float Sinc(float x)
+  {
+    const float cPi = 3.14159265358979f;
+    return x == 0.0f ? 1.0f : std::sin(cPi * x) / (cPi * x);
+  }
+
+  static float BesselI0(float x)
+  {
+    float sum = 1.0f;
+    float term = 1.0f;
+    for(size_t k = 1; k < 16; ++k)
+    {
+      term *= (x / (2.0f * k)) * (x / (2.0f * k));
+      sum += term;
+    }
+    return sum;
+  }
+
+  float mValues[cKaiserTaps];
+};
+static const KaiserWeights sKaiserWeights;
+
+/// Weighted sum of taps texels, each offsets[i] floats into source.
+void AccumulateKaiserTexel(const float* source, const size_t* offsets, float* result)
+{
+#if defined(MIP_GENERATOR_SSE)
+  __m128 sum = _mm_setzero_ps();
+  for(size_t i = 0; i < cKaiserTaps; ++i)
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(source + offsets[i]), _mm_set1_ps(sKaiserWeights.mValues[i])));
+  _mm_storeu_ps(result, sum);
+#else
+  for(size_t c = 0; c < 4; ++c)
+  {
+    float sum = 0;
+    for(size_t i = 0; i < cKaiserTaps; ++i)
+      sum += source[offsets[i] + c] * sKaiserWeights.mValues[i];
+    result[c] = sum;
+  }
+#endif
+}
+
+/// Clamped source texel indices for the taps of destination texel index.
+void GetKaiserTaps(size_t index, size_t sourceSize, size_t stride, size_t* outOffsets)
+{
+  for(size_t i = 0; i < cKaiserTaps; ++i)
+  {
+    ptrdiff_t sourceIndex = static_cast<ptrdiff_t>(index * 2 + i) - static_cast<ptrdiff_t>(cKaiserTaps / 2 - 1);
+    sourceIndex = Math::Min(Math::Max(sourceIndex, ptrdiff_t(0)), static_cast<ptrdiff_t>(sourceSize) - 1);
+    outOffsets[i] = static_cast<size_t>(sourceIndex) * stride;
+  }
+}
+
+void KaiserDownsample(const float* source, size_t sourceX, size_t sourceY, float* destination, size_t destinationX, size_t destinationY, ThreadPool* threadPool)
+{
+  // Horizontal pass into a destinationX by sourceY image, then vertical into the destination
+  Array<float> horizontal;
+  horizontal.Resize(destinationX * sourceY * 4);
+  float* horizontalData = horizontal.Data();
+  ForEachRowRange(sourceY, threadPool, [&](size_t firstRow, size_t rowEnd)
+  {
+    size_t offsets[cKaiserTaps];
+    for(size_t y = firstRow; y < rowEnd; ++y)
+    {
+      for(size_t x = 0; x < destinationX; ++x)
+      {
+        GetKaiserTaps(x, sourceX, 4, offsets);
+        AccumulateKaiserTexel(source + y * sourceX * 4, offsets, horizontalData + (y * destinationX + x) * 4);
+      }
+    }
+  });
+
+  ForEachRowRange(destinationY, threadPool, [&](size_t firstRow, size_t rowEnd)
+  {
+    size_t offsets[cKaiserTaps];
+    for(size_t y = firstRow; y < rowEnd; ++y)
+    {
+      GetKaiserTaps(y, sourceY, destinationX * 4, offsets);
+      for(size_t x = 0; x < destinationX; ++x)
+        AccumulateKaiserTexel(horizontalData + x * 4, offsets, destination + (y * destinationX + x) * 4);
+    }
+  });
+}
+
+void DownsampleLinear(const float* source, size_t sourceX, size_t sourceY, float* destination, size_t destinationX, size_t destinationY, MipFilter filter, ThreadPool* threadPool)
+{
+  if(filter == MipFilter::Kaiser)
+  {
+    KaiserDownsample(source, sourceX, sourceY, destination, destinationX, destinationY, threadPool);
+    return;
+  }
+
+  ForEachRowRange(destinationY, threadPool, [&](size_t firstRow, size_t rowEnd)
+  {
+    BoxDownsampleRows(source, sourceX, sourceY, destination, destinationX, firstRow, rowEnd);
+  });
+}
+
+//-------------------------------------------------------------------GenerateMipChain
+bool GenerateMipChain(TextureFormat format, const byte* topLevel, size_t sizeX, size_t sizeY, Texture& outTexture, MipFilter filter, ThreadPool* threadPool)
+{
+  if(!SupportsCpuMips(format) || sizeX == 0 || sizeY == 0)
+    return false;
+
+  size_t totalSize = BuildTextureMips(format, sizeX, sizeY, outTexture.mMips);
+  size_t mipLevels = outTexture.mMips.Size();
+  outTexture.mTextureData.Resize(totalSize);
+  memcpy(outTexture.mTextureData.Data(), topLevel, outTexture.mMips[0].mSize);
+
+  // Levels are kept in linear float between steps so nothing gets requantized along the chain
+  size_t texelSize = GetTextureFormatBlockSize(format);
+  Array<float> levels[2];
+  levels[0].Resize(sizeX * sizeY * 4);
+  float* sourceData = levels[0].Data();
+  ForEachRowRange(sizeY, threadPool, [&](size_t firstRow, size_t rowEnd)
+  {
+    DecodeLinearTexels(format, topLevel + firstRow * sizeX * texelSize, (rowEnd - firstRow) * sizeX, sourceData + firstRow * sizeX * 4);
+  });
+
+  size_t levelX = sizeX;
+  size_t levelY = sizeY;
+  for(size_t level = 1; level < mipLevels; ++level)
+  {
+    size_t nextX = Math::Max(levelX / 2, size_t(1));
+    size_t nextY = Math::Max(levelY / 2, size_t(1));
+    Array<float>& source = levels[(level - 1) % 2];
+    Array<float>& destination = levels[level % 2];
+    destination.Resize(nextX * nextY * 4);
+    DownsampleLinear(source.Data(), levelX, levelY, destination.Data(), nextX, nextY, filter, threadPool);
+
+    byte* levelData = outTexture.mTextureData.Data() + outTexture.mMips[level].mOffset;
+    const float* destinationData = destination.Data();
+    ForEachRowRange(nextY, threadPool, [&](size_t firstRow, size_t rowEnd)
+    {
+      EncodeLinearTexels(format, destinationData + firstRow * nextX * 4, (rowEnd - firstRow) * nextX, levelData + firstRow * nextX * texelSize);
+    });
+    levelX = nextX;
+    levelY = nextY;
+  }
+
+  outTexture.mSizeX = sizeX;
+  outTexture.mSizeY = sizeY;
+  outTexture.mMipLevels = mipLevels;
+  outTexture.mFormat = format;
+  return true;
+}
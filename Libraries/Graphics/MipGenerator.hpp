@@ -0,0 +1,34 @@
+#pragma once
+
+#include "GraphicsStandard.hpp"
+#include "Texture.hpp"
+
+class ThreadPool;
+
+//-------------------------------------------------------------------MipFilter
+enum class MipFilter
+{
+  // 2x2 average. Odd sizes drop their last row or column.
+  Box,
+  // Separable Kaiser windowed sinc over 6 texels. Sharper than the box and aliases less.
+  Kaiser
+};
+
+/// Half float conversions. Values too small for a normal half flush to zero.
+float HalfToFloat(uint16_t half);
+uint16_t FloatToHalf(float value);
+
+/// True if the format's texels can be converted to linear RGBA and back. Block compressed and depth formats can't.
+bool SupportsCpuMips(TextureFormat format);
+
+/// Converts texels to linear float RGBA. Missing color channels are 0, missing alpha is 1 and gamma formats are linearized.
+bool DecodeLinearTexels(TextureFormat format, const byte* texels, size_t count, float* outRgba);
+bool EncodeLinearTexels(TextureFormat format, const float* rgba, size_t count, byte* outTexels);
+
+/// Filters a linear RGBA image down to the next mip size. Rows are split across the thread pool if one is given.
+void DownsampleLinear(const float* source, size_t sourceX, size_t sourceY, float* destination, size_t destinationX, size_t destinationY, MipFilter filter, ThreadPool* threadPool = nullptr);
+
+/// Generates every mip level of an uncompressed image on the CPU. Filtering happens in linear space so gamma
+/// formats darken correctly. The top level is copied as is and every level is stored in the texture so the
+/// renderer uploads them directly instead of blitting.
+bool GenerateMipChain(TextureFormat format, const byte* topLevel, size_t sizeX, size_t sizeY, Texture& outTexture, MipFilter filter = MipFilter::Box, ThreadPool* threadPool = nullptr);
@@ -18,4 +18,6 @@ struct Model : public Graphical
   
   Zilch::HandleOf<ZilchMaterial> mMaterial;
   Zilch::HandleOf<Mesh> mMesh;
+  // Mesh lod each camera drew last frame, by the camera's index in the space. Used for hysteresis.
+  Array<uint8_t> mLastLods;
 };
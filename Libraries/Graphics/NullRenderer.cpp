@@ -0,0 +1,251 @@
+#include "Precompiled.hpp"
+
+#include "NullRenderer.hpp"
+
+#include "Mesh.hpp"
+#include "Texture.hpp"
+#include "ZilchShader.hpp"
+#include "RenderQueue.hpp"
+#include "RenderTasks.hpp"
+
+//-------------------------------------------------------------------NullRendererStatistics
+void NullRendererStatistics::Clear()
+{
+  *this = NullRendererStatistics();
+}
+
+//-------------------------------------------------------------------NullRenderer
+NullRenderer::NullRenderer()
+{
+}
+
+NullRenderer::~NullRenderer()
+{
+  Destroy();
+}
+
+void NullRenderer::Shutdown()
+{
+  mMeshes.Clear();
+  mTextures.Clear();
+  mShaders.Clear();
+  mShaderMaterials.Clear();
+}
+
+void NullRenderer::Destroy()
+{
+  ClearCommandLog();
+}
+
+void NullRenderer::BeginUploadBatch()
+{
+}
+
+void NullRenderer::EndUploadBatch()
+{
+}
+
+void NullRenderer::CreateMesh(const Mesh* mesh)
+{
+  mMeshes.Insert(mesh);
+}
+
+void NullRenderer::DestroyMesh(const Mesh* mesh)
+{
+  mMeshes.Erase(mesh);
+}
+
+void NullRenderer::CreateTexture(const Texture* texture, uint32_t firstMip)
+{
+  mTextures.Insert(texture);
+}
+
+void NullRenderer::DestroyTexture(const Texture* texture)
+{
+  mTextures.Erase(texture);
+}
+
+void NullRenderer::CreateShader(const ZilchShader* zilchShader)
+{
+  mShaders.Insert(zilchShader);
+}
+
+void NullRenderer::DestroyShader(const ZilchShader* zilchShader)
+{
+  mShaders.Erase(zilchShader);
+}
+
+void NullRenderer::CreateShaderMaterial(ZilchShader* shaderMaterial)
+{
+  mShaderMaterials.Insert(shaderMaterial);
+}
+
+void NullRenderer::UpdateShaderMaterialInstance(const ZilchShader* zilchShader, const ZilchMaterial* zilchMaterial)
+{
+}
+
+void NullRenderer::UploadShaderMaterialInstances(MaterialBatchUploadData& materialBatchUploadData)
+{
+}
+
+void NullRenderer::DestroyShaderMaterial(const ZilchShader* zilchShader)
+{
+  mShaderMaterials.Erase(zilchShader);
+}
+
+void NullRenderer::DrawRenderQueue(RenderQueue& renderQueue)
+{
+  // Global buffers are written once per frame: frame blocks then view blocks
+  for(size_t i = 0; i < renderQueue.mFrameBlocks.Size(); ++i)
+    WriteUniforms(AlignUniformBufferOffset(sizeof(FrameData)));
+  for(size_t i = 0; i < renderQueue.mViewBlocks.Size(); ++i)
+    WriteUniforms(AlignUniformBufferOffset(sizeof(CameraData)));
+
+  // Clears are folded into the pass's load op the same way the vulkan backend records them
+  mRenderGraph.Compile(renderQueue);
+  for(const RenderGraphPass& pass : mRenderGraph.mPasses)
+  {
+    Record(NullRenderCommandType::BeginRenderPass, pass.mPhysicalTarget, 0, nullptr);
+    if(pass.mLoadOp == TargetLoadOp::Clear)
+      Record(NullRenderCommandType::ClearTarget, pass.mPhysicalTarget, 0, nullptr);
+    for(uint32_t i = 0; i < pass.mDrawCount; ++i)
+    {
+      const RenderGraphDraw& draw = mRenderGraph.mDraws[pass.mFirstDraw + i];
+      DrawRenderGroup(*draw.mViewBlock, *draw.mRenderGroupTask);
+    }
+    Record(NullRenderCommandType::EndRenderPass, pass.mPhysicalTarget, 0, nullptr);
+  }
+}
+
+void NullRenderer::WaitForIdle()
+{
+}
+
+void NullRenderer::Reshape(size_t width, size_t height, float aspectRatio)
+{
+  mWidth = width;
+  mHeight = height;
+}
+
+void NullRenderer::GetShape(size_t& width, size_t& height, float& aspectRatio) const
+{
+  width = mWidth;
+  height = mHeight;
+  aspectRatio = height != 0 ? width / (float)height : 1.0f;
+}
+
+Matrix4 NullRenderer::BuildPerspectiveMatrix(float verticalFov, float aspectRatio, float nearDistance, float farDistance) const
+{
+  // Same convention as the vulkan backend so culling and depth sorting behave identically
+  float depth = farDistance - nearDistance;
+  float n_t = 1.0f / std::tan(verticalFov * 0.5f);
+  float n_r = n_t / aspectRatio;
+
+  Matrix4 m;
+  m.SetIdentity();
+  m[0][0] = n_r;
+  m[1][1] = -n_t;
+  m[2][2] = -farDistance / depth;
+  m[3][3] = 0.0f;
+  m[3][2] = -farDistance * nearDistance / depth;
+  m[2][3] = -1.0f;
+
+  return m;
+}
+
+void NullRenderer::ClearCommandLog()
+{
+  mCommands.Clear();
+  mStatistics.Clear();
+}
+
+void NullRenderer::Record(NullRenderCommandType type, u32 count, u32 instanceCount, const void* object)
+{
+  switch(type)
+  {
+  case NullRenderCommandType::BeginRenderPass:
+    ++mStatistics.mRenderPassCount;
+    break;
+  case NullRenderCommandType::EndRenderPass:
+    break;
+  case NullRenderCommandType::ClearTarget:
+    ++mStatistics.mClearCount;
+    break;
+  case NullRenderCommandType::BindPipeline:
+    ++mStatistics.mPipelineBinds;
+    break;
+  case NullRenderCommandType::BindVertexBuffer:
+    ++mStatistics.mVertexBufferBinds;
+    break;
+  case NullRenderCommandType::BindIndexBuffer:
+    ++mStatistics.mIndexBufferBinds;
+    break;
+  case NullRenderCommandType::BindDescriptorSet:
+    ++mStatistics.mDescriptorSetBinds;
+    break;
+  case NullRenderCommandType::WriteUniforms:
+    mStatistics.mUniformBytesWritten += count;
+    break;
+  case NullRenderCommandType::DrawIndexed:
+    ++mStatistics.mDrawCount;
+    mStatistics.mInstanceCount += instanceCount;
+    mStatistics.mIndexCount += static_cast<size_t>(count) * instanceCount;
+    break;
+  }
+
+  if(!mRecordCommands)
+    return;
+
+  NullRenderCommand& command = mCommands.PushBack();
+  command.mType = type;
+  command.mCount = count;
+  command.mInstanceCount = instanceCount;
+  command.mObject = object;
+}
+
+void NullRenderer::WriteUniforms(size_t sizeInBytes)
+{
+  Record(NullRenderCommandType::WriteUniforms, static_cast<u32>(sizeInBytes), 0, nullptr);
+}
+
+size_t NullRenderer::AlignUniformBufferOffset(size_t offset) const
+{
+  size_t alignment = mUniformBufferAlignment;
+  if(alignment == 0)
+    return offset;
+  return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+void NullRenderer::DrawRenderGroup(const ViewBlock& viewBlock, const RenderGroupRenderTask& renderGroupTask)
+{
+  Array<InstanceBatch> batches;
+  Array<uint32_t> instanceOrder;
+  BuildInstanceBatches(renderGroupTask, batches, instanceOrder);
+
+  // One view transform block for the group plus a 3x4 local to world per instance
+  WriteUniforms(sizeof(TransformData));
+  WriteUniforms(sizeof(InstanceData) * instanceOrder.Size());
+
+  // Only log state that actually changes between consecutive draws
+  const ZilchShader* boundShader = nullptr;
+  const Mesh* boundMesh = nullptr;
+  for(const InstanceBatch& batch : batches)
+  {
+    if(!mMeshes.Contains(batch.mMesh) || !mShaderMaterials.Contains(batch.mZilchShader))
+      continue;
+
+    if(batch.mZilchShader != boundShader)
+    {
+      Record(NullRenderCommandType::BindPipeline, 0, 0, batch.mZilchShader);
+      Record(NullRenderCommandType::BindDescriptorSet, 0, 0, batch.mZilchShader);
+      boundShader = batch.mZilchShader;
+    }
+    if(batch.mMesh != boundMesh)
+    {
+      Record(NullRenderCommandType::BindVertexBuffer, 0, 0, batch.mMesh);
+      Record(NullRenderCommandType::BindIndexBuffer, 0, 0, batch.mMesh);
+      boundMesh = batch.mMesh;
+    }
+    Record(NullRenderCommandType::DrawIndexed, batch.mMesh->GetLod(batch.mLod).mIndexCount, batch.mInstanceCount, batch.mMesh);
+  }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Math.hpp"
+#include "Renderer.hpp"
+#include "RenderGraph.hpp"
+
+struct Mesh;
+struct Texture;
+struct ZilchShader;
+struct RenderQueue;
+struct ViewBlock;
+struct RenderGroupRenderTask;
+
+enum class NullRenderCommandType : u8
+{
+  BeginRenderPass,
+  EndRenderPass,
+  ClearTarget,
+  BindPipeline,
+  BindVertexBuffer,
+  BindIndexBuffer,
+  BindDescriptorSet,
+  WriteUniforms,
+  DrawIndexed
+};
+
+/// One entry in the null renderer's command log. What the extra fields mean depends on the type:
+/// draws store the index count and instance count, uniform writes store the bytes written,
+/// binds store the bound object, and render passes store the physical target.
+struct NullRenderCommand
+{
+  NullRenderCommandType mType;
+  u32 mCount = 0;
+  u32 mInstanceCount = 0;
+  const void* mObject = nullptr;
+};
+
+struct NullRendererStatistics
+{
+  void Clear();
+
+  size_t mDrawCount = 0;
+  size_t mInstanceCount = 0;
+  size_t mIndexCount = 0;
+  size_t mPipelineBinds = 0;
+  size_t mVertexBufferBinds = 0;
+  size_t mIndexBufferBinds = 0;
+  size_t mDescriptorSetBinds = 0;
+  size_t mUniformBytesWritten = 0;
+  size_t mClearCount = 0;
+  size_t mRenderPassCount = 0;
+};
+
+/// A renderer with no graphics api behind it. Resources are only tracked and the render queue is
+/// walked the same way a real backend would, logging the state changes and draws it would issue.
+/// Used to measure and regression-test render queue building, sorting, and culling without a device.
+class NullRenderer : public Renderer
+{
+public:
+  NullRenderer();
+  virtual ~NullRenderer();
+
+  virtual void Shutdown() override;
+  virtual void Destroy() override;
+
+  virtual void BeginUploadBatch() override;
+  virtual void EndUploadBatch() override;
+
+  virtual void CreateMesh(const Mesh* mesh) override;
+  virtual void DestroyMesh(const Mesh* mesh) override;
+
+  virtual void CreateTexture(const Texture* texture, uint32_t firstMip) override;
+  virtual void DestroyTexture(const Texture* texture) override;
+
+  virtual void CreateShader(const ZilchShader* zilchShader) override;
+  virtual void DestroyShader(const ZilchShader* zilchShader) override;
+
+  virtual void CreateShaderMaterial(ZilchShader* shaderMaterial) override;
+  virtual void UpdateShaderMaterialInstance(const ZilchShader* zilchShader, const ZilchMaterial* zilchMaterial) override;
+  virtual void UploadShaderMaterialInstances(MaterialBatchUploadData& materialBatchUploadData) override;
+  virtual void DestroyShaderMaterial(const ZilchShader* zilchShader) override;
+
+  virtual void DrawRenderQueue(RenderQueue& renderQueue) override;
+  virtual void WaitForIdle() override;
+
+  virtual void Reshape(size_t width, size_t height, float aspectRatio) override;
+  virtual void GetShape(size_t& width, size_t& height, float& aspectRatio) const override;
+
+  virtual Matrix4 BuildPerspectiveMatrix(float verticalFov, float aspectRatio, float nearDistance, float farDistance) const override;
+
+  /// Clears the command log and statistics. Resources stay registered.
+  void ClearCommandLog();
+
+  // If false only the statistics are accumulated (avoids the log growing during long benchmarks)
+  bool mRecordCommands = true;
+  // Matches the common minUniformBufferOffsetAlignment so the uniform byte counts line up with a real device
+  size_t mUniformBufferAlignment = 256;
+
+  Array<NullRenderCommand> mCommands;
+  NullRendererStatistics mStatistics;
+  // Compiled from the last render queue
+  RenderGraph mRenderGraph;
+
+private:
+  void Record(NullRenderCommandType type, u32 count, u32 instanceCount, const void* object);
+  void WriteUniforms(size_t sizeInBytes);
+  size_t AlignUniformBufferOffset(size_t offset) const;
+  void DrawRenderGroup(const ViewBlock& viewBlock, const RenderGroupRenderTask& renderGroupTask);
+
+  size_t mWidth = 0;
+  size_t mHeight = 0;
+
+  Zero::HashSet<const Mesh*> mMeshes;
+  Zero::HashSet<const Texture*> mTextures;
+  Zero::HashSet<const ZilchShader*> mShaders;
+  Zero::HashSet<const ZilchShader*> mShaderMaterials;
+};
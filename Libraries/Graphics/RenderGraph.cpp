@@ -0,0 +1,235 @@
+#include "Precompiled.hpp"
+
+#include "RenderGraph.hpp"
+
+#include "RenderQueue.hpp"
+
+constexpr uint32_t cUnassignedPhysicalTarget = static_cast<uint32_t>(-1);
+
+void RenderGraph::Clear()
+{
+  mPasses.Clear();
+  mDraws.Clear();
+  mTargetUses.Clear();
+  mCulledTaskCount = 0;
+  mTargetCount = 1;
+  mPhysicalTargetCount = 1;
+}
+
+void RenderGraph::Compile(const RenderQueue& renderQueue)
+{
+  Clear();
+  mTargetCount = 1 + renderQueue.mTransientTargetCount;
+
+  // Tasks that write a transient target nobody reads are dropped before any passes are built
+  mTargetsRead.Clear();
+  mTargetsRead.Resize(mTargetCount, false);
+  for(const ViewBlock& viewBlock : renderQueue.mViewBlocks)
+  {
+    for(const RenderTask* task : viewBlock.mRenderTaskEvent.mRenderTasks)
+    {
+      if(task->mTaskType != RenderTaskType::RenderGroup)
+        continue;
+      const RenderGroupRenderTask* renderGroupTask = static_cast<const RenderGroupRenderTask*>(task);
+      for(TargetId input : renderGroupTask->mRenderSettings.mInputTargetIds)
+        mTargetsRead[ResolveTarget(input)] = true;
+    }
+  }
+
+  for(const ViewBlock& viewBlock : renderQueue.mViewBlocks)
+  {
+    for(const RenderTask* task : viewBlock.mRenderTaskEvent.mRenderTasks)
+    {
+      if(task->mTaskType == RenderTaskType::ClearTarget)
+      {
+        const ClearTargetRenderTask* clearTask = static_cast<const ClearTargetRenderTask*>(task);
+        TargetId target = ResolveTarget(clearTask->mRenderSettings.mColorTargetId);
+        if(!IsTargetUsed(target))
+        {
+          ++mCulledTaskCount;
+          continue;
+        }
+
+        // The clear only becomes the load op if nothing was drawn to the target yet
+        bool canMerge = !mPasses.Empty() && mPasses.Back().mTarget == target && mPasses.Back().mDrawCount == 0;
+        RenderGraphPass& pass = canMerge ? mPasses.Back() : BeginPass(target, TargetLoadOp::Clear);
+        pass.mLoadOp = TargetLoadOp::Clear;
+        pass.mClearColor = clearTask->mClearColor;
+        pass.mClearDepth = clearTask->mDepthdepth;
+      }
+      else if(task->mTaskType == RenderTaskType::RenderGroup)
+      {
+        const RenderGroupRenderTask* renderGroupTask = static_cast<const RenderGroupRenderTask*>(task);
+        TargetId target = ResolveTarget(renderGroupTask->mRenderSettings.mColorTargetId);
+        if(!IsTargetUsed(target))
+        {
+          ++mCulledTaskCount;
+          continue;
+        }
+
+        // Inputs are always written by an earlier pass, so appending to the last pass never reorders a read before its write
+        bool canMerge = !mPasses.Empty() && mPasses.Back().mTarget == target;
+        RenderGraphPass& pass = canMerge ? mPasses.Back() : BeginPass(target, TargetLoadOp::Load);
+        uint32_t passIndex = static_cast<uint32_t>(mPasses.Size()) - 1;
+        for(TargetId input : renderGroupTask->mRenderSettings.mInputTargetIds)
+        {
+          TargetId resolvedInput = ResolveTarget(input);
+          ErrorIf(resolvedInput == target, "A render group can't read the target it renders to");
+          ErrorIf(resolvedInput == cBackBufferTarget, "The back buffer can't be read by a render group");
+          ErrorIf(!IsTargetWritten(resolvedInput), "A render group reads a target before anything renders to it");
+          if(resolvedInput == target || resolvedInput == cBackBufferTarget || !IsTargetWritten(resolvedInput))
+            continue;
+          mTargetUses.PushBack(TargetUse{resolvedInput, passIndex, true});
+        }
+
+        RenderGraphDraw& draw = mDraws.PushBack();
+        draw.mViewBlock = &viewBlock;
+        draw.mRenderGroupTask = renderGroupTask;
+        ++pass.mDrawCount;
+      }
+    }
+  }
+
+  // The back buffer has to be transitioned for presenting even if no view rendered to it
+  bool backBufferWritten = false;
+  for(const RenderGraphPass& pass : mPasses)
+    backBufferWritten |= (pass.mTarget == cBackBufferTarget);
+  if(!backBufferWritten)
+    BeginPass(cBackBufferTarget, TargetLoadOp::Clear);
+
+  AssignPhysicalTargets();
+  ResolveUsages();
+}
+
+uint32_t RenderGraph::GetPhysicalTargetCount() const
+{
+  return mPhysicalTargetCount;
+}
+
+RenderGraphPass& RenderGraph::BeginPass(TargetId target, TargetLoadOp loadOp)
+{
+  uint32_t passIndex = static_cast<uint32_t>(mPasses.Size());
+  mTargetUses.PushBack(TargetUse{target, passIndex, false});
+
+  RenderGraphPass& pass = mPasses.PushBack();
+  pass.mTarget = target;
+  pass.mLoadOp = loadOp;
+  pass.mFirstDraw = static_cast<uint32_t>(mDraws.Size());
+  return pass;
+}
+
+TargetId RenderGraph::ResolveTarget(TargetId target) const
+{
+  if(target == mInvalidTarget)
+    return cBackBufferTarget;
+  ErrorIf(target >= mTargetCount, "Render task uses a target that wasn't created this frame");
+  return target < mTargetCount ? target : cBackBufferTarget;
+}
+
+bool RenderGraph::IsTargetUsed(TargetId target) const
+{
+  return target == cBackBufferTarget || mTargetsRead[target];
+}
+
+bool RenderGraph::IsTargetWritten(TargetId target) const
+{
+  for(const TargetUse& use : mTargetUses)
+  {
+    if(use.mTarget == target && !use.mRead)
+      return true;
+  }
+  return false;
+}
+
+void RenderGraph::AssignPhysicalTargets()
+{
+  // Last pass each target is used in. Cleared once its physical target has been released.
+  Array<uint32_t> lastUses;
+  lastUses.Resize(mTargetCount, cUnassignedPhysicalTarget);
+  for(const TargetUse& use : mTargetUses)
+    lastUses[use.mTarget] = use.mPassIndex;
+
+  mPhysicalTargets.Clear();
+  mPhysicalTargets.Resize(mTargetCount, cUnassignedPhysicalTarget);
+  mPhysicalTargets[cBackBufferTarget] = 0;
+  mFreePhysicalTargets.Clear();
+
+  // Uses are in pass order so each pass's uses are one contiguous run
+  size_t useIndex = 0;
+  for(uint32_t passIndex = 0; passIndex < mPasses.Size(); ++passIndex)
+  {
+    size_t passUsesStart = useIndex;
+    for(; useIndex < mTargetUses.Size() && mTargetUses[useIndex].mPassIndex == passIndex; ++useIndex)
+    {
+      uint32_t& physicalTarget = mPhysicalTargets[mTargetUses[useIndex].mTarget];
+      if(physicalTarget != cUnassignedPhysicalTarget)
+        continue;
+      if(!mFreePhysicalTargets.Empty())
+      {
+        physicalTarget = mFreePhysicalTargets.Back();
+        mFreePhysicalTargets.PopBack();
+      }
+      else
+        physicalTarget = mPhysicalTargetCount++;
+    }
+
+    // Targets that are done after this pass hand their memory to the ones first used later
+    for(size_t i = passUsesStart; i < useIndex; ++i)
+    {
+      TargetId target = mTargetUses[i].mTarget;
+      if(target == cBackBufferTarget || lastUses[target] != passIndex)
+        continue;
+      mFreePhysicalTargets.PushBack(mPhysicalTargets[target]);
+      lastUses[target] = cUnassignedPhysicalTarget;
+    }
+
+    mPasses[passIndex].mPhysicalTarget = mPhysicalTargets[mPasses[passIndex].mTarget];
+  }
+}
+
+void RenderGraph::ResolveUsages()
+{
+  for(uint32_t passIndex = 0; passIndex < mPasses.Size(); ++passIndex)
+  {
+    RenderGraphPass& pass = mPasses[passIndex];
+    const TargetUse* previousUse = nullptr;
+    const TargetUse* nextUse = nullptr;
+    for(const TargetUse& use : mTargetUses)
+    {
+      if(use.mTarget != pass.mTarget)
+        continue;
+      if(use.mPassIndex < passIndex)
+        previousUse = &use;
+      else if(use.mPassIndex > passIndex)
+      {
+        nextUse = &use;
+        break;
+      }
+    }
+
+    // Nothing was written yet so there's nothing to load
+    if(previousUse == nullptr && pass.mLoadOp == TargetLoadOp::Load)
+      pass.mLoadOp = TargetLoadOp::DontCare;
+    if(pass.mLoadOp == TargetLoadOp::Load)
+      pass.mInitialUsage = previousUse->mRead ? TargetUsage::ShaderRead : TargetUsage::ColorAttachment;
+    else
+      pass.mInitialUsage = TargetUsage::Undefined;
+
+    if(nextUse == nullptr)
+    {
+      bool isBackBuffer = pass.mTarget == cBackBufferTarget;
+      pass.mFinalUsage = isBackBuffer ? TargetUsage::Present : TargetUsage::ColorAttachment;
+      pass.mStoreContents = isBackBuffer;
+    }
+    else if(nextUse->mRead)
+    {
+      pass.mFinalUsage = TargetUsage::ShaderRead;
+      pass.mStoreContents = true;
+    }
+    else
+    {
+      pass.mFinalUsage = TargetUsage::ColorAttachment;
+      pass.mStoreContents = mPasses[nextUse->mPassIndex].mLoadOp == TargetLoadOp::Load;
+    }
+  }
+}
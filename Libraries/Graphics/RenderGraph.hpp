@@ -0,0 +1,92 @@
+#pragma once
+
+#include "GraphicsStandard.hpp"
+#include "RenderTasks.hpp"
+
+struct RenderQueue;
+struct ViewBlock;
+
+/// The image the frame is presented from. Tasks that don't pick a color target render here.
+constexpr TargetId cBackBufferTarget = 0;
+
+/// How a target is used between passes. The renderer maps these to image layouts.
+enum class TargetUsage : char
+{
+  Undefined,
+  ColorAttachment,
+  ShaderRead,
+  Present
+};
+
+enum class TargetLoadOp : char
+{
+  Load,
+  Clear,
+  DontCare
+};
+
+/// A render group recorded inside a compiled pass along with the view it was built for.
+struct RenderGraphDraw
+{
+  const ViewBlock* mViewBlock = nullptr;
+  const RenderGroupRenderTask* mRenderGroupTask = nullptr;
+};
+
+/// One render pass. Consecutive tasks that write the same target are merged into a single pass
+/// and a clear at the start of the pass becomes its load op. Layout transitions are part of the
+/// pass so no separate barriers are recorded between passes.
+struct RenderGraphPass
+{
+  TargetId mTarget = cBackBufferTarget;
+  // Transient targets whose lifetimes don't overlap share a physical target
+  uint32_t mPhysicalTarget = 0;
+  TargetLoadOp mLoadOp = TargetLoadOp::Load;
+  // False when nothing reads the target after this pass
+  bool mStoreContents = true;
+  Vec4 mClearColor = Vec4(0, 0, 0, 1);
+  float mClearDepth = 1.0f;
+  TargetUsage mInitialUsage = TargetUsage::Undefined;
+  TargetUsage mFinalUsage = TargetUsage::ColorAttachment;
+  // Range in RenderGraph::mDraws
+  uint32_t mFirstDraw = 0;
+  uint32_t mDrawCount = 0;
+};
+
+/// Turns the tasks of every view into a list of render passes. Built by the renderer each frame,
+/// the arrays are kept between frames so compiling stops allocating once they've grown.
+class RenderGraph
+{
+public:
+  void Clear();
+  void Compile(const RenderQueue& renderQueue);
+
+  /// Physical target 0 is always the back buffer, transient targets start at 1.
+  uint32_t GetPhysicalTargetCount() const;
+
+  Array<RenderGraphPass> mPasses;
+  Array<RenderGraphDraw> mDraws;
+  // Tasks dropped because nothing reads the target they write
+  size_t mCulledTaskCount = 0;
+
+private:
+  struct TargetUse
+  {
+    TargetId mTarget;
+    uint32_t mPassIndex;
+    bool mRead;
+  };
+
+  RenderGraphPass& BeginPass(TargetId target, TargetLoadOp loadOp);
+  TargetId ResolveTarget(TargetId target) const;
+  bool IsTargetUsed(TargetId target) const;
+  bool IsTargetWritten(TargetId target) const;
+  void AssignPhysicalTargets();
+  void ResolveUsages();
+
+  uint32_t mTargetCount = 1;
+  uint32_t mPhysicalTargetCount = 1;
+  Array<TargetUse> mTargetUses;
+  Array<bool> mTargetsRead;
+  Array<uint32_t> mPhysicalTargets;
+  Array<uint32_t> mFreePhysicalTargets;
+};
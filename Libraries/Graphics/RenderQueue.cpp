@@ -1,3 +1,10 @@
 #include "Precompiled.hpp"
 
 #include "RenderQueue.hpp"
+
+TargetId RenderQueue::CreateTransientTarget()
+{
+  // Target 0 is the back buffer
+  ++mTransientTargetCount;
+  return mTransientTargetCount;
+}
@@ -3,6 +3,7 @@
 #include "GraphicsStandard.hpp"
 #include "Zilch/Zilch.hpp"
 #include "RenderTasks.hpp"
+#include "FrustumCulling.hpp"
 
 struct FrameBlock
 {
@@ -19,12 +20,18 @@ struct ViewBlock
 
   Zilch::Real4x4 mWorldToView;
   Zilch::Real4x4 mViewToPerspective;
+  Frustum mFrustum;
   RenderTaskEvent mRenderTaskEvent;
 };
 
 struct RenderQueue
 {
+  /// Declares a target that only lives for this frame. Transient targets match the back buffer's
+  /// size and format and share memory with other transient targets whose lifetimes don't overlap.
+  TargetId CreateTransientTarget();
+
   Array<FrameBlock> mFrameBlocks;
   Array<ViewBlock> mViewBlocks;
+  uint32_t mTransientTargetCount = 0;
 };
 
@@ -30,6 +30,45 @@ void RenderGroupRenderTask::Add(const Graphical* graphical)
   graphical->FilloutFrameData(frameData);
 }
 
+void RenderGroupRenderTask::Add(const GraphicalFrameData& frameData)
+{
+  mFrameData.PushBack(frameData);
+}
+
+void BuildInstanceBatches(const RenderGroupRenderTask& renderGroupTask, Array<InstanceBatch>& outBatches, Array<uint32_t>& outInstanceOrder)
+{
+  const Array<GraphicalFrameData>& frameData = renderGroupTask.mFrameData;
+  outBatches.Clear();
+  outInstanceOrder.Clear();
+  outInstanceOrder.Reserve(frameData.Size());
+  for(size_t i = 0; i < frameData.Size(); ++i)
+  {
+    if(frameData[i].mMesh != nullptr && frameData[i].mZilchShader != nullptr)
+      outInstanceOrder.PushBack(static_cast<uint32_t>(i));
+  }
+
+  for(size_t i = 0; i < outInstanceOrder.Size(); ++i)
+  {
+    const GraphicalFrameData& data = frameData[outInstanceOrder[i]];
+    if(!outBatches.Empty())
+    {
+      InstanceBatch& lastBatch = outBatches.Back();
+      if(lastBatch.mMesh == data.mMesh && lastBatch.mLod == data.mLod && lastBatch.mZilchShader == data.mZilchShader)
+      {
+        ++lastBatch.mInstanceCount;
+        continue;
+      }
+    }
+
+    InstanceBatch& batch = outBatches.PushBack();
+    batch.mMesh = data.mMesh;
+    batch.mLod = data.mLod;
+    batch.mZilchShader = data.mZilchShader;
+    batch.mFirstInstance = static_cast<uint32_t>(i);
+    batch.mInstanceCount = 1;
+  }
+}
+
 ClearTargetRenderTask* RenderTaskEvent::CreateClearTargetRenderTask()
 {
   ClearTargetRenderTask* result = new ClearTargetRenderTask();
@@ -27,6 +27,10 @@ struct GraphicalFrameData
   const Mesh* mMesh = nullptr;
   const ZilchShader* mZilchShader = nullptr;
   const ZilchMaterial* mZilchMaterial = nullptr;
+  // xyz is the world space center, w the radius
+  Vec4 mWorldBoundingSphere = Vec4(0, 0, 0, 0);
+  // Level of detail of the mesh to draw, picked per view
+  uint32_t mLod = 0;
 };
 
 struct GraphicalViewData
@@ -38,7 +42,10 @@ struct GraphicalViewData
 
 struct RenderSettings
 {
+  // Invalid renders to the back buffer
   TargetId mColorTargetId = mInvalidTarget;
+  // Targets sampled by the task. Used to order passes and transition the targets before they're read.
+  Array<TargetId> mInputTargetIds;
 };
 
 struct RenderTask
@@ -64,11 +71,33 @@ struct RenderGroupRenderTask : public RenderTask
   RenderGroupRenderTask();
 
   void Add(const Graphical* graphical);
+  void Add(const GraphicalFrameData& frameData);
 
   RenderSettings mRenderSettings;
   Array<GraphicalFrameData> mFrameData;
+  // The frame data hasn't been frustum culled and the renderer culls it against the view instead
+  bool mCullOnGpu = false;
+  // Clustered meshes have their clusters culled by the renderer's compute pass when it has one, otherwise on the cpu
+  bool mCullClustersOnGpu = false;
 };
 
+/// A run of frame data that shares a mesh, lod and shader and is issued as one instanced draw.
+struct InstanceBatch
+{
+  const Mesh* mMesh = nullptr;
+  uint32_t mLod = 0;
+  const ZilchShader* mZilchShader = nullptr;
+  // Range in the instance order array
+  uint32_t mFirstInstance = 0;
+  uint32_t mInstanceCount = 0;
+};
+
+/// Groups a render group's frame data into instance batches. outInstanceOrder maps each instance
+/// slot to the index of its frame data, batches are contiguous ranges of it. Entries without a
+/// mesh or shader are skipped. Only neighboring entries are merged, the frame data is expected to
+/// already be in draw key order.
+void BuildInstanceBatches(const RenderGroupRenderTask& renderGroupTask, Array<InstanceBatch>& outBatches, Array<uint32_t>& outInstanceOrder);
+
 struct RenderTaskEvent
 {
   ~RenderTaskEvent();
@@ -11,6 +11,14 @@ struct ZilchShaderManager;
 struct ZilchMaterialManager;
 struct RenderQueue;
 
+enum class RenderFrameStatus
+{
+  Success = 0,
+  OutOfDate,
+  SubOptimal,
+  Error
+};
+
 struct MaterialBatchUploadData
 {
   struct MaterialData
@@ -30,12 +38,22 @@ public:
 
   virtual void Shutdown() abstract;
   virtual void Destroy() abstract;
+  /// Frees every gpu resource still alive before shutting down.
+  virtual void CleanupResources() {}
+
+  /// Resource creation between Begin/EndUploadBatch is submitted to the gpu together.
+  virtual void BeginUploadBatch() abstract;
+  virtual void EndUploadBatch() abstract;
 
   virtual void CreateMesh(const Mesh* mesh) abstract;
   virtual void DestroyMesh(const Mesh* mesh) abstract;
 
-  virtual void CreateTexture(const Texture* texture) abstract;
+  /// Only levels [firstMip, mMipLevels) of the texture are made resident, see SetTextureResidency.
+  virtual void CreateTexture(const Texture* texture, uint32_t firstMip) abstract;
   virtual void DestroyTexture(const Texture* texture) abstract;
+  /// Changes which levels of an existing texture are resident. The texture keeps the same slot so
+  /// materials referencing it don't change.
+  virtual void SetTextureResidency(const Texture* texture, uint32_t firstMip) {}
 
   virtual void CreateShader(const ZilchShader* zilchShader) abstract;
   virtual void DestroyShader(const ZilchShader* zilchShader) abstract;
@@ -45,11 +63,23 @@ public:
   virtual void UploadShaderMaterialInstances(MaterialBatchUploadData& materialBatchUploadData) abstract;
   virtual void DestroyShaderMaterial(const ZilchShader* zilchShader) abstract;
 
+  virtual RenderFrameStatus BeginFrame() { return RenderFrameStatus::Success; }
+  virtual RenderFrameStatus EndFrame() { return RenderFrameStatus::Success; }
   virtual void DrawRenderQueue(RenderQueue& renderQueue) abstract;
   virtual void WaitForIdle() abstract;
 
   virtual void Reshape(size_t width, size_t height, float aspectRatio) abstract;
   virtual void GetShape(size_t& width, size_t& height, float& aspectRatio) const abstract;
+  /// Creates and destroys everything sized to the output, called around a Reshape when the window changes.
+  virtual void CreateSwapChain() {}
+  virtual void DestroySwapChain() {}
+  /// True if the last swap chain recreation invalidated the shader materials so they have to be rebuilt.
+  virtual bool SwapChainLayoutChanged() const { return false; }
 
   virtual Matrix4 BuildPerspectiveMatrix(float verticalFov, float aspectRatio, float nearDistance, float farDistance) const abstract;
+
+  /// Whether render groups marked with mCullOnGpu are frustum culled by the renderer instead of on the cpu.
+  virtual bool SupportsGpuCulling() const { return false; }
+  /// Whether SetTextureResidency can be used to stream textures' mip levels in and out.
+  virtual bool SupportsTextureStreaming() const { return false; }
 };
@@ -4,10 +4,116 @@
 #undef Error
 
 #include "Resources/ResourceMetaFile.hpp"
+#include "MipGenerator.hpp"
+#include "TextureCooker.hpp"
+#include "Utilities/File.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 
+//-------------------------------------------------------------------TextureFormat
+bool IsBlockCompressed(TextureFormat format)
+{
+  switch(format)
+  {
+  case TextureFormat::BC1:
+  case TextureFormat::BC3:
+  case TextureFormat::BC5:
+  case TextureFormat::BC7:
+  case TextureFormat::SRGBBC1:
+  case TextureFormat::SRGBBC3:
+  case TextureFormat::SRGBBC7:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool IsGammaFormat(TextureFormat format)
+{
+  switch(format)
+  {
+  case TextureFormat::SRGB8:
+  case TextureFormat::SRGB8A8:
+  case TextureFormat::SRGBBC1:
+  case TextureFormat::SRGBBC3:
+  case TextureFormat::SRGBBC7:
+    return true;
+  default:
+    return false;
+  }
+}
+
+size_t GetTextureFormatBlockSize(TextureFormat format)
+{
+  switch(format)
+  {
+  case TextureFormat::R8:
+    return 1;
+  case TextureFormat::RG8:
+  case TextureFormat::R16:
+  case TextureFormat::R16f:
+    return 2;
+  case TextureFormat::RGB8:
+  case TextureFormat::SRGB8:
+    return 3;
+  case TextureFormat::RGBA8:
+  case TextureFormat::SRGB8A8:
+  case TextureFormat::RG16:
+  case TextureFormat::RG16f:
+  case TextureFormat::R32f:
+    return 4;
+  case TextureFormat::RGB16:
+  case TextureFormat::RGB16f:
+    return 6;
+  case TextureFormat::RGBA16:
+  case TextureFormat::RGBA16f:
+  case TextureFormat::RG32f:
+  case TextureFormat::BC1:
+  case TextureFormat::SRGBBC1:
+    return 8;
+  case TextureFormat::RGB32f:
+    return 12;
+  case TextureFormat::RGBA32f:
+  case TextureFormat::BC3:
+  case TextureFormat::BC5:
+  case TextureFormat::BC7:
+  case TextureFormat::SRGBBC3:
+  case TextureFormat::SRGBBC7:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+size_t GetTextureLevelSize(TextureFormat format, size_t sizeX, size_t sizeY)
+{
+  size_t blockSize = GetTextureFormatBlockSize(format);
+  if(IsBlockCompressed(format))
+    return ((sizeX + 3) / 4) * ((sizeY + 3) / 4) * blockSize;
+  return sizeX * sizeY * blockSize;
+}
+
+size_t GetMipLevelCount(size_t sizeX, size_t sizeY)
+{
+  return static_cast<size_t>(std::floor(std::log2(Math::Max(Math::Max(sizeX, sizeY), size_t(1))))) + 1;
+}
+
+size_t BuildTextureMips(TextureFormat format, size_t sizeX, size_t sizeY, Array<TextureMip>& outMips)
+{
+  size_t mipLevels = GetMipLevelCount(sizeX, sizeY);
+  size_t totalSize = 0;
+  outMips.Clear();
+  for(size_t level = 0; level < mipLevels; ++level)
+  {
+    TextureMip& mip = outMips.PushBack();
+    mip.mOffset = totalSize;
+    mip.mSize = GetTextureLevelSize(format, Math::Max(sizeX >> level, size_t(1)), Math::Max(sizeY >> level, size_t(1)));
+    totalSize += mip.mSize;
+  }
+  return totalSize;
+}
+
 //-------------------------------------------------------------------Texture
 ZilchDefineType(Texture, builder, type)
 {
@@ -17,7 +123,7 @@ ZilchDefineType(Texture, builder, type)
 //-------------------------------------------------------------------TextureManager
 TextureManager::TextureManager()
 {
-
+  mThreadPool.Initialize();
 }
 
 TextureManager::~TextureManager()
@@ -27,6 +133,7 @@ TextureManager::~TextureManager()
 void TextureManager::GetExtensions(Array<ResourceExtension>& extensions) const
 {
   extensions.PushBack({"png"});
+  extensions.PushBack({"ktx2"});
 }
 
 bool TextureManager::OnLoadResource(const ResourceMetaFile& resourceMeta, Texture* texture)
@@ -39,25 +146,57 @@ bool TextureManager::OnReLoadResource(const ResourceMetaFile& resourceMeta, Text
   return LoadTexture(resourceMeta.mResourcePath, texture);
 }
 
-bool TextureManager::LoadTexture(const ResourcePath& path, Texture* texture) const
+bool TextureManager::LoadTexture(const ResourcePath& path, Texture* texture)
 {
+  if(Zero::FilePath::GetPathInfo(path).Extension == "ktx2")
+    return LoadCookedTexture(path, *texture);
+
+  // The cooked copy is only used while the source it was cooked from hasn't changed. The source's size
+  // and write time are enough to tell, so it isn't read at all when the cooked copy is current.
+  uint64_t sourceStamp = 0;
+  String cookedPath;
+  if(!mCookedDirectory.Empty())
+  {
+    sourceStamp = StampCookSource(path);
+    cookedPath = GetCookedPath(mCookedDirectory, path, ".ktx2");
+    uint64_t cookedStamp = 0;
+    if(sourceStamp != 0 && Zero::FileExists(cookedPath) && LoadCookedTexture(cookedPath, *texture, &cookedStamp) && cookedStamp == sourceStamp)
+      return true;
+  }
+
+  Array<char> source;
+  readFile(path, source);
   int texWidth, texHeight, texChannels;
-  stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+  stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.Data()), static_cast<int>(source.Size()), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
   if(pixels == nullptr)
   {
     Warn("Failed to load image '%s'", path.c_str());
     return false;
   }
-  
-  uint32_t pixelsSize = texWidth * texHeight * 4;
-  
-  texture->mSizeX = texWidth;
-  texture->mSizeY = texHeight;
-  texture->mMipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-  texture->mFormat = TextureFormat::SRGB8A8;
-  texture->mTextureData.Resize(pixelsSize);
-  memcpy(texture->mTextureData.Data(), pixels, pixelsSize);
 
+  if(!mCookedDirectory.Empty())
+  {
+    TextureFormat format = SelectCookedFormat(pixels, texWidth, texHeight, true);
+    bool cooked = CookTexture(pixels, texWidth, texHeight, format, *texture, &mThreadPool);
+    stbi_image_free(pixels);
+    if(!cooked)
+    {
+      Warn("Failed to cook image '%s'", path.c_str());
+      return false;
+    }
+
+    Zero::CreateDirectory(mCookedDirectory);
+    SaveCookedTexture(cookedPath, *texture, sourceStamp);
+    return true;
+  }
+  
+  // Mips are generated here rather than blitted by the renderer so gamma is filtered correctly
+  bool generated = GenerateMipChain(TextureFormat::SRGB8A8, pixels, texWidth, texHeight, *texture, MipFilter::Box, &mThreadPool);
   stbi_image_free(pixels);
+  if(!generated)
+  {
+    Warn("Failed to generate mips for image '%s'", path.c_str());
+    return false;
+  }
   return true;
 }
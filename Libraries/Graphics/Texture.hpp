@@ -3,7 +3,9 @@
 #include "GraphicsStandard.hpp"
 
 #include "ResourceManager.hpp"
+#include "Utilities/ThreadPool.hpp"
 
+typedef unsigned char byte;
 class ResourceMetaFile;
 
 //-------------------------------------------------------------------TextureFormat
@@ -15,10 +17,20 @@ enum class  TextureFormat
   R16f, RG16f, RGB16f, RGBA16f,          // half float
   R32f, RG32f, RGB32f, RGBA32f,          // float
   SRGB8, SRGB8A8,                        // gamma
+  BC1, BC3, BC5, BC7,                    // block compressed
+  SRGBBC1, SRGBBC3, SRGBBC7,             // block compressed gamma
   Depth16, Depth24, Depth32, Depth32f,   // depth
   Depth24Stencil8, Depth32fStencil8Pad24 // depth-stencil
 };
 
+/// Compressed formats store 4x4 texel blocks instead of individual texels.
+bool IsBlockCompressed(TextureFormat format);
+bool IsGammaFormat(TextureFormat format);
+/// Bytes per 4x4 block for compressed formats, bytes per texel otherwise. Zero if the format can't be stored.
+size_t GetTextureFormatBlockSize(TextureFormat format);
+/// Bytes one mip level of the given size takes up.
+size_t GetTextureLevelSize(TextureFormat format, size_t sizeX, size_t sizeY);
+
 //-------------------------------------------------------------------TextureType
 enum class TextureType
 {
@@ -37,6 +49,19 @@ enum class TextureAddressing
   None, Clamp, Repeat, Mirror
 };
 
+//-------------------------------------------------------------------TextureMip
+/// Where one mip level lives in Texture::mTextureData.
+struct TextureMip
+{
+  size_t mOffset = 0;
+  size_t mSize = 0;
+};
+
+/// Number of levels in a full chain down to 1x1.
+size_t GetMipLevelCount(size_t sizeX, size_t sizeY);
+/// Lays out a full mip chain largest first and returns the size of all levels together.
+size_t BuildTextureMips(TextureFormat format, size_t sizeX, size_t sizeY, Array<TextureMip>& outMips);
+
 //-------------------------------------------------------------------Texture
 struct Texture : public Resource
 {
@@ -52,7 +77,10 @@ public:
   TextureAddressing mAddressingX = TextureAddressing::Repeat;
   TextureAddressing mAddressingY = TextureAddressing::Repeat;
   size_t mMipLevels = 1;
-  Array<float> mTextureData;
+  Array<byte> mTextureData;
+  // Levels already stored in mTextureData, largest first. Empty if only the top level is stored
+  // and the renderer has to generate the rest.
+  Array<TextureMip> mMips;
 };
 
 //-------------------------------------------------------------------TextureManager
@@ -66,5 +94,10 @@ public:
   virtual bool OnLoadResource(const ResourceMetaFile& resourceMeta, Texture* texture) override;
   virtual bool OnReLoadResource(const ResourceMetaFile& resourceMeta, Texture* texture) override;
   
-  bool LoadTexture(const ResourcePath& path, Texture* texture) const;
+  bool LoadTexture(const ResourcePath& path, Texture* texture);
+
+  /// Where cooked copies of source images are written and loaded from. Empty disables cooking.
+  String mCookedDirectory;
+  // Mip generation and cooking split each image across these workers
+  ThreadPool mThreadPool;
 };
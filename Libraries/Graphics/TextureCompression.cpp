@@ -0,0 +1,777 @@
+#include "Precompiled.hpp"
+
+#include "TextureCompression.hpp"
+
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define TEXTURE_COMPRESSION_SSE 1
+  #include <immintrin.h>
+#endif
+
+//-------------------------------------------------------------------Block helpers
+void LoadBlockTexels(const byte* rgba, size_t sizeX, size_t sizeY, size_t blockX, size_t blockY, BlockTexels& outTexels)
+{
+  for(size_t y = 0; y < 4; ++y)
+  {
+    size_t sourceY = Math::Min(blockY * 4 + y, sizeY - 1);
+    for(size_t x = 0; x < 4; ++x)
+    {
+      size_t sourceX = Math::Min(blockX * 4 + x, sizeX - 1);
+      const byte* texel = rgba + (sourceY * sizeX + sourceX) * 4;
+      for(size_t c = 0; c < 4; ++c)
+        outTexels.mChannels[c][y * 4 + x] = static_cast<float>(texel[c]);
+    }
+  }
+}
+
+/// Picks the closest palette entry for every texel. Palette entries hold channelCount values
+/// starting at firstChannel.
+void FindClosestPaletteIndices(const BlockTexels& texels, size_t firstChannel, size_t channelCount, const float palette[][4], size_t paletteCount, uint8_t outIndices[16])
+{
+#if defined(TEXTURE_COMPRESSION_SSE)
+  // 4 texels against one palette entry at a time
+  for(size_t i = 0; i < 16; i += 4)
+  {
+    __m128 bestDistance = _mm_set1_ps(FLT_MAX);
+    __m128 bestIndex = _mm_setzero_ps();
+    for(size_t p = 0; p < paletteCount; ++p)
+    {
+      __m128 distance = _mm_setzero_ps();
+      for(size_t c = 0; c < channelCount; ++c)
+      {
+        __m128 delta = _mm_sub_ps(_mm_loadu_ps(texels.mChannels[firstChannel + c] + i), _mm_set1_ps(palette[p][c]));
+        distance = _mm_add_ps(distance, _mm_mul_ps(delta, delta));
+      }
+      __m128 closer = _mm_cmplt_ps(distance, bestDistance);
+      bestDistance = _mm_min_ps(distance, bestDistance);
+      bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps(static_cast<float>(p))), _mm_andnot_ps(closer, bestIndex));
+    }
+
+    alignas(16) int32_t indices[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvttps_epi32(bestIndex));
+    for(size_t j = 0; j < 4; ++j)
+      outIndices[i + j] = static_cast<uint8_t>(indices[j]);
+  }
+#else
+  for(size_t i = 0; i < 16; ++i)
+  {
+    float bestDistance = FLT_MAX;
+    for(size_t p = 0; p < paletteCount; ++p)
+    {
+      float distance = 0;
+      for(size_t c = 0; c < channelCount; ++c)
+      {
+        float delta = texels.mChannels[firstChannel + c][i] - palette[p][c];
+        distance += delta * delta;
+      }
+      if(distance < bestDistance)
+      {
+        bestDistance = distance;
+        outIndices[i] = static_cast<uint8_t>(p);
+      }
+    }
+  }
+#endif
+}
+
+/// Finds the line that best fits the texels' colors (the principal axis of their covariance) and
+/// returns the texels' extremes along it. Uniform blocks get both endpoints at their mean.
+void FindBlockEndpoints(const BlockTexels& texels, size_t channelCount, float outStart[4], float outEnd[4])
+{
+  float mean[4] = {};
+  for(size_t c = 0; c < channelCount; ++c)
+  {
+    for(size_t i = 0; i < 16; ++i)
+      mean[c] += texels.mChannels[c][i];
+    mean[c] /= 16.0f;
+  }
+
+  float covariance[4][4] = {};
+  for(size_t i = 0; i < 16; ++i)
+  {
+    for(size_t a = 0; a < channelCount; ++a)
+    {
+      for(size_t b = a; b < channelCount; ++b)
+        covariance[a][b] += (texels.mChannels[a][i] - mean[a]) * (texels.mChannels[b][i] - mean[b]);
+    }
+  }
+  for(size_t a = 0; a < channelCount; ++a)
+  {
+    for(size_t b = 0; b < a; ++b)
+      covariance[a][b] = covariance[b][a];
+  }
+
+  // A few rounds of power iteration are plenty for a 4x4 matrix
+  float axis[4] = {1, 1, 1, 1};
+  for(size_t iteration = 0; iteration < 8; ++iteration)
+  {
+    float next[4] = {};
+    float largest = 0;
+    for(size_t a = 0; a < channelCount; ++a)
+    {
+      for(size_t b = 0; b < channelCount; ++b)
+        next[a] += covariance[a][b] * axis[b];
+      largest = Math::Max(largest, std::abs(next[a]));
+    }
+    if(largest == 0)
+      break;
+    for(size_t a = 0; a < channelCount; ++a)
+      axis[a] = next[a] / largest;
+  }
+
+  float minProjection = FLT_MAX;
+  float maxProjection = -FLT_MAX;
+  float axisLengthSq = 0;
+  for(size_t c = 0; c < channelCount; ++c)
+    axisLengthSq += axis[c] * axis[c];
+  for(size_t i = 0; i < 16; ++i)
+  {
+    float projection = 0;
+    for(size_t c = 0; c < channelCount; ++c)
+      projection += (texels.mChannels[c][i] - mean[c]) * axis[c];
+    minProjection = Math::Min(minProjection, projection);
+    maxProjection = Math::Max(maxProjection, projection);
+  }
+  if(axisLengthSq == 0)
+    minProjection = maxProjection = 0;
+  else
+  {
+    minProjection /= axisLengthSq;
+    maxProjection /= axisLengthSq;
+  }
+
+  for(size_t c = 0; c < channelCount; ++c)
+  {
+    outStart[c] = Math::Min(Math::Max(mean[c] + axis[c] * minProjection, 0.0f), 255.0f);
+    outEnd[c] = Math::Min(Math::Max(mean[c] + axis[c] * maxProjection, 0.0f), 255.0f);
+  }
+}
+
+/// Writes values into a block least significant bit first.
+struct BlockBitWriter
+{
+  void Write(uint32_t value, size_t bitCount)
+  {
+    for(size_t i = 0; i < bitCount; ++i, ++mBit)
+    {
+      if((value >> i) & 1)
+        mData[mBit >> 3] |= static_cast<byte>(1 << (mBit & 7));
+    }
+  }
+
+  byte* mData;
+  size_t mBit = 0;
+};
+
+/// Reads values from a block least significant bit first.
+struct BlockBitReader
+{
+  uint32_t Read(size_t bitCount)
+  {
+    uint32_t value = 0;
+    for(size_t i = 0; i < bitCount; ++i, ++mBit)
+      value |= static_cast<uint32_t>((mData[mBit >> 3] >> (mBit & 7)) & 1) << i;
+    return value;
+  }
+
+  const byte* mData;
+  size_t mBit = 0;
+};
+
+//-------------------------------------------------------------------BC1
+uint16_t PackRgb565(const float color[4])
+{
+  uint32_t r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+  uint32_t g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+  uint32_t b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void UnpackRgb565(uint16_t packed, float outColor[4])
+{
+  uint32_t r = (packed >> 11) & 31;
+  uint32_t g = (packed >> 5) & 63;
+  uint32_t b = packed & 31;
+  outColor[0] = static_cast<float>((r << 3) | (r >> 2));
+  outColor[1] = static_cast<float>((g << 2) | (g >> 4));
+  outColor[2] = static_cast<float>((b << 3) | (b >> 2));
+  outColor[3] = 255.0f;
+}
+
+void EncodeBC1Block(const BlockTexels& texels, byte* outBlock)
+{
+  float start[4], end[4];
+  FindBlockEndpoints(texels, 3, start, end);
+
+  // Color0 has to be the larger one for the 4 color mode. When they quantize to the same value
+  // the block falls into 3 color mode, where index 0 is still color0.
+  uint16_t color0 = PackRgb565(end);
+  uint16_t color1 = PackRgb565(start);
+  if(color0 < color1)
+    Math::Swap(color0, color1);
+
+  uint8_t indices[16] = {};
+  if(color0 != color1)
+  {
+    float palette[4][4];
+    UnpackRgb565(color0, palette[0]);
+    UnpackRgb565(color1, palette[1]);
+    for(size_t c = 0; c < 3; ++c)
+    {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3.0f;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3.0f;
+    }
+    FindClosestPaletteIndices(texels, 0, 3, palette, 4, indices);
+  }
+
+  uint32_t indexBits = 0;
+  for(size_t i = 0; i < 16; ++i)
+    indexBits |= static_cast<uint32_t>(indices[i]) << (2 * i);
+
+  outBlock[0] = static_cast<byte>(color0 & 0xFF);
+  outBlock[1] = static_cast<byte>(color0 >> 8);
+  outBlock[2] = static_cast<byte>(color1 & 0xFF);
+  outBlock[3] = static_cast<byte>(color1 >> 8);
+  for(size_t i = 0; i < 4; ++i)
+    outBlock[4 + i] = static_cast<byte>((indexBits >> (8 * i)) & 0xFF);
+}
+
+void DecodeBC1Block(const byte* block, bool allowTransparent, byte outTexels[16][4])
+{
+  uint16_t color0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+  uint16_t color1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+  float palette[4][4];
+  UnpackRgb565(color0, palette[0]);
+  UnpackRgb565(color1, palette[1]);
+  // BC3's color block is always in 4 color mode
+  if(color0 > color1 || !allowTransparent)
+  {
+    for(size_t c = 0; c < 3; ++c)
+    {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3.0f;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3.0f;
+    }
+    palette[2][3] = palette[3][3] = 255.0f;
+  }
+  else
+  {
+    for(size_t c = 0; c < 3; ++c)
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+    palette[2][3] = 255.0f;
+    for(size_t c = 0; c < 4; ++c)
+      palette[3][c] = 0.0f;
+  }
+
+  uint32_t indexBits = 0;
+  for(size_t i = 0; i < 4; ++i)
+    indexBits |= static_cast<uint32_t>(block[4 + i]) << (8 * i);
+  for(size_t i = 0; i < 16; ++i)
+  {
+    uint32_t index = (indexBits >> (2 * i)) & 3;
+    for(size_t c = 0; c < 4; ++c)
+      outTexels[i][c] = static_cast<byte>(palette[index][c] + 0.5f);
+  }
+}
+
+//-------------------------------------------------------------------BC3/BC4/BC5
+void EncodeBC4Block(const BlockTexels& texels, size_t channel, byte* outBlock)
+{
+  float minValue = 255.0f;
+  float maxValue = 0.0f;
+  for(size_t i = 0; i < 16; ++i)
+  {
+    minValue = Math::Min(minValue, texels.mChannels[channel][i]);
+    maxValue = Math::Max(maxValue, texels.mChannels[channel][i]);
+  }
+
+  // The 8 value mode needs value0 > value1. Equal values make every index 0 which is still exact.
+  uint32_t value0 = static_cast<uint32_t>(maxValue + 0.5f);
+  uint32_t value1 = static_cast<uint32_t>(minValue + 0.5f);
+  uint8_t indices[16] = {};
+  if(value0 > value1)
+  {
+    float palette[8][4];
+    palette[0][0] = static_cast<float>(value0);
+    palette[1][0] = static_cast<float>(value1);
+    for(size_t i = 2; i < 8; ++i)
+      palette[i][0] = ((8 - i) * value0 + (i - 1) * value1) / 7.0f;
+    FindClosestPaletteIndices(texels, channel, 1, palette, 8, indices);
+  }
+
+  uint64_t indexBits = 0;
+  for(size_t i = 0; i < 16; ++i)
+    indexBits |= static_cast<uint64_t>(indices[i]) << (3 * i);
+
+  outBlock[0] = static_cast<byte>(value0);
+  outBlock[1] = static_cast<byte>(value1);
+  for(size_t i = 0; i < 6; ++i)
+    outBlock[2 + i] = static_cast<byte>((indexBits >> (8 * i)) & 0xFF);
+}
+
+void EncodeBC3Block(const BlockTexels& texels, byte* outBlock)
+{
+  EncodeBC4Block(texels, 3, outBlock);
+  EncodeBC1Block(texels, outBlock + 8);
+}
+
+void EncodeBC5Block(const BlockTexels& texels, byte* outBlock)
+{
+  EncodeBC4Block(texels, 0, outBlock);
+  EncodeBC4Block(texels, 1, outBlock + 8);
+}
+
+void DecodeBC4Block(const byte* block, size_t channel, byte outTexels[16][4])
+{
+  uint32_t value0 = block[0];
+  uint32_t value1 = block[1];
+  uint32_t palette[8] = {value0, value1};
+  // value0 <= value1 selects the 6 value mode with explicit 0 and 255
+  if(value0 > value1)
+  {
+    for(uint32_t i = 2; i < 8; ++i)
+      palette[i] = ((8 - i) * value0 + (i - 1) * value1 + 3) / 7;
+  }
+  else
+  {
+    for(uint32_t i = 2; i < 6; ++i)
+      palette[i] = ((6 - i) * value0 + (i - 1) * value1 + 2) / 5;
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+
+  uint64_t indexBits = 0;
+  for(size_t i = 0; i < 6; ++i)
+    indexBits |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+  for(size_t i = 0; i < 16; ++i)
+    outTexels[i][channel] = static_cast<byte>(palette[(indexBits >> (3 * i)) & 7]);
+}
+
+//-------------------------------------------------------------------BC7
+static const uint32_t cBC7Weights2[4] = {0, 21, 43, 64};
+static const uint32_t cBC7Weights3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+static const uint32_t cBC7Weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct BC7ModeInfo
+{
+  uint32_t mSubsetCount;
+  uint32_t mPartitionBits;
+  uint32_t mRotationBits;
+  uint32_t mIndexSelectionBits;
+  uint32_t mColorBits;
+  uint32_t mAlphaBits;
+  // A lowest bit per endpoint, or one per subset shared by both of its endpoints
+  uint32_t mEndpointPBits;
+  uint32_t mSharedPBits;
+  uint32_t mIndexBits;
+  uint32_t mSecondaryIndexBits;
+};
+
+static const BC7ModeInfo cBC7Modes[8] =
+{
+  {3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+  {2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+  {3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+  {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+  {1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+  {1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+  {1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+  {2, 6, 0, 0, 5, 5, 1, 0, 2, 0},
+};
+
+// Subset of each texel, one bit per texel for two subsets and two bits per texel for three
+static const uint16_t cBC7Partitions2[64] =
+{
+  0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+  0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+  0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+  0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+  0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+  0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+  0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+  0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+static const uint32_t cBC7Partitions3[64] =
+{
+  0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+  0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+  0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+  0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+  0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+  0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+  0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+  0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254,
+};
+
+// Texels whose index drops its top bit, besides texel 0 which is always the first subset's
+static const uint8_t cBC7Anchors2[64] =
+{
+  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+  15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+  15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+   6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+};
+
+static const uint8_t cBC7Anchors3[2][64] =
+{
+  {
+     3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+     3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+     8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+     3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+  },
+  {
+    15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+    15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+    15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+    15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+  },
+};
+
+/// Mode 6 endpoints are 7 bits per channel plus a shared lowest bit. Picks whichever lowest bit
+/// reconstructs the endpoint best.
+void QuantizeBC7Endpoint(const float endpoint[4], uint32_t outQuantized[4], uint32_t& outPBit)
+{
+  float bestError = FLT_MAX;
+  for(uint32_t pBit = 0; pBit < 2; ++pBit)
+  {
+    uint32_t quantized[4];
+    float error = 0;
+    for(size_t c = 0; c < 4; ++c)
+    {
+      float value = (endpoint[c] - pBit) / 2.0f + 0.5f;
+      quantized[c] = static_cast<uint32_t>(Math::Min(Math::Max(value, 0.0f), 127.0f));
+      float delta = static_cast<float>((quantized[c] << 1) | pBit) - endpoint[c];
+      error += delta * delta;
+    }
+    if(error < bestError)
+    {
+      bestError = error;
+      outPBit = pBit;
+      for(size_t c = 0; c < 4; ++c)
+        outQuantized[c] = quantized[c];
+    }
+  }
+}
+
+void EncodeBC7Block(const BlockTexels& texels, byte* outBlock)
+{
+  float start[4], end[4];
+  FindBlockEndpoints(texels, 4, start, end);
+
+  uint32_t endpoints[2][4];
+  uint32_t pBits[2];
+  QuantizeBC7Endpoint(start, endpoints[0], pBits[0]);
+  QuantizeBC7Endpoint(end, endpoints[1], pBits[1]);
+
+  float palette[16][4];
+  for(size_t c = 0; c < 4; ++c)
+  {
+    uint32_t value0 = (endpoints[0][c] << 1) | pBits[0];
+    uint32_t value1 = (endpoints[1][c] << 1) | pBits[1];
+    for(size_t i = 0; i < 16; ++i)
+      palette[i][c] = static_cast<float>(((64 - cBC7Weights4[i]) * value0 + cBC7Weights4[i] * value1 + 32) >> 6);
+  }
+
+  uint8_t indices[16];
+  FindClosestPaletteIndices(texels, 0, 4, palette, 16, indices);
+
+  // The first index only stores 3 bits so its top bit has to be clear. Flipping the endpoints flips every index.
+  if(indices[0] & 8)
+  {
+    for(size_t c = 0; c < 4; ++c)
+      Math::Swap(endpoints[0][c], endpoints[1][c]);
+    Math::Swap(pBits[0], pBits[1]);
+    for(size_t i = 0; i < 16; ++i)
+      indices[i] = static_cast<uint8_t>(15 - indices[i]);
+  }
+
+  memset(outBlock, 0, 16);
+  BlockBitWriter writer;
+  writer.mData = outBlock;
+  writer.Write(1 << 6, 7);
+  for(size_t c = 0; c < 4; ++c)
+  {
+    writer.Write(endpoints[0][c], 7);
+    writer.Write(endpoints[1][c], 7);
+  }
+  writer.Write(pBits[0], 1);
+  writer.Write(pBits[1], 1);
+  writer.Write(indices[0], 3);
+  for(size_t i = 1; i < 16; ++i)
+    writer.Write(indices[i], 4);
+}
+
+uint32_t GetBC7Subset(const BC7ModeInfo& mode, uint32_t partition, size_t texel)
+{
+  if(mode.mSubsetCount == 2)
+    return (cBC7Partitions2[partition] >> texel) & 1;
+  if(mode.mSubsetCount == 3)
+    return (cBC7Partitions3[partition] >> (2 * texel)) & 3;
+  return 0;
+}
+
+bool IsBC7Anchor(const BC7ModeInfo& mode, uint32_t partition, size_t texel)
+{
+  if(texel == 0)
+    return true;
+  if(mode.mSubsetCount == 2)
+    return texel == cBC7Anchors2[partition];
+  if(mode.mSubsetCount == 3)
+    return texel == cBC7Anchors3[0][partition] || texel == cBC7Anchors3[1][partition];
+  return false;
+}
+
+uint32_t GetBC7Weight(uint32_t indexBits, uint32_t index)
+{
+  if(indexBits == 2)
+    return cBC7Weights2[index];
+  if(indexBits == 3)
+    return cBC7Weights3[index];
+  return cBC7Weights4[index];
+}
+
+void DecodeBC7Block(const byte* block, byte outTexels[16][4])
+{
+  uint32_t modeIndex = 0;
+  while(modeIndex < 8 && (block[0] & (1 << modeIndex)) == 0)
+    ++modeIndex;
+  // The reserved mode decodes to transparent black
+  if(modeIndex == 8)
+  {
+    memset(outTexels, 0, 16 * 4);
+    return;
+  }
+
+  const BC7ModeInfo& mode = cBC7Modes[modeIndex];
+  BlockBitReader reader;
+  reader.mData = block;
+  reader.mBit = modeIndex + 1;
+  uint32_t partition = reader.Read(mode.mPartitionBits);
+  uint32_t rotation = reader.Read(mode.mRotationBits);
+  uint32_t indexSelection = reader.Read(mode.mIndexSelectionBits);
+
+  // Endpoints are stored a channel at a time, each channel listing every subset's pair
+  uint32_t endpoints[3][2][4] = {};
+  for(size_t c = 0; c < 4; ++c)
+  {
+    uint32_t bits = c < 3 ? mode.mColorBits : mode.mAlphaBits;
+    for(size_t subset = 0; subset < mode.mSubsetCount; ++subset)
+    {
+      for(size_t e = 0; e < 2; ++e)
+        endpoints[subset][e][c] = reader.Read(bits);
+    }
+  }
+
+  uint32_t pBits[3][2] = {};
+  for(size_t subset = 0; subset < mode.mSubsetCount; ++subset)
+  {
+    if(mode.mEndpointPBits != 0)
+    {
+      pBits[subset][0] = reader.Read(1);
+      pBits[subset][1] = reader.Read(1);
+    }
+    else if(mode.mSharedPBits != 0)
+      pBits[subset][0] = pBits[subset][1] = reader.Read(1);
+  }
+
+  bool hasPBits = mode.mEndpointPBits != 0 || mode.mSharedPBits != 0;
+  for(size_t subset = 0; subset < mode.mSubsetCount; ++subset)
+  {
+    for(size_t e = 0; e < 2; ++e)
+    {
+      for(size_t c = 0; c < 4; ++c)
+      {
+        uint32_t bits = c < 3 ? mode.mColorBits : mode.mAlphaBits;
+        uint32_t& value = endpoints[subset][e][c];
+        // Modes without alpha are opaque
+        if(bits == 0)
+        {
+          value = 255;
+          continue;
+        }
+        if(hasPBits)
+        {
+          value = (value << 1) | pBits[subset][e];
+          ++bits;
+        }
+        // Replicate the top bits into the ones that weren't stored
+        value <<= 8 - bits;
+        value |= value >> bits;
+      }
+    }
+  }
+
+  uint32_t indices[16];
+  uint32_t secondaryIndices[16] = {};
+  for(size_t i = 0; i < 16; ++i)
+    indices[i] = reader.Read(mode.mIndexBits - (IsBC7Anchor(mode, partition, i) ? 1 : 0));
+  if(mode.mSecondaryIndexBits != 0)
+  {
+    for(size_t i = 0; i < 16; ++i)
+      secondaryIndices[i] = reader.Read(mode.mSecondaryIndexBits - (i == 0 ? 1 : 0));
+  }
+
+  for(size_t i = 0; i < 16; ++i)
+  {
+    uint32_t subset = GetBC7Subset(mode, partition, i);
+    uint32_t colorBits = mode.mIndexBits;
+    uint32_t colorIndex = indices[i];
+    uint32_t alphaBits = colorBits;
+    uint32_t alphaIndex = colorIndex;
+    // Modes 4 and 5 interpolate alpha with its own indices, mode 4 can swap which set goes to color
+    if(mode.mSecondaryIndexBits != 0)
+    {
+      alphaBits = mode.mSecondaryIndexBits;
+      alphaIndex = secondaryIndices[i];
+      if(indexSelection != 0)
+      {
+        Math::Swap(colorBits, alphaBits);
+        Math::Swap(colorIndex, alphaIndex);
+      }
+    }
+
+    uint32_t colorWeight = GetBC7Weight(colorBits, colorIndex);
+    uint32_t alphaWeight = GetBC7Weight(alphaBits, alphaIndex);
+    for(size_t c = 0; c < 4; ++c)
+    {
+      uint32_t weight = c < 3 ? colorWeight : alphaWeight;
+      uint32_t value = ((64 - weight) * endpoints[subset][0][c] + weight * endpoints[subset][1][c] + 32) >> 6;
+      outTexels[i][c] = static_cast<byte>(value);
+    }
+    // Rotation swaps alpha with one of the color channels
+    if(rotation != 0)
+      Math::Swap(outTexels[i][3], outTexels[i][rotation - 1]);
+  }
+}
+
+//-------------------------------------------------------------------CompressTextureLevel
+bool CompressTextureLevel(TextureFormat format, const byte* rgba, size_t sizeX, size_t sizeY, byte* outBlocks)
+{
+  if(!IsBlockCompressed(format))
+    return false;
+
+  size_t blockSize = GetTextureFormatBlockSize(format);
+  size_t blocksX = (sizeX + 3) / 4;
+  size_t blocksY = (sizeY + 3) / 4;
+  BlockTexels texels;
+  for(size_t blockY = 0; blockY < blocksY; ++blockY)
+  {
+    for(size_t blockX = 0; blockX < blocksX; ++blockX)
+    {
+      LoadBlockTexels(rgba, sizeX, sizeY, blockX, blockY, texels);
+      byte* block = outBlocks + (blockY * blocksX + blockX) * blockSize;
+      switch(format)
+      {
+      case TextureFormat::BC1:
+      case TextureFormat::SRGBBC1:
+        EncodeBC1Block(texels, block);
+        break;
+      case TextureFormat::BC3:
+      case TextureFormat::SRGBBC3:
+        EncodeBC3Block(texels, block);
+        break;
+      case TextureFormat::BC5:
+        EncodeBC5Block(texels, block);
+        break;
+      case TextureFormat::BC7:
+      case TextureFormat::SRGBBC7:
+        EncodeBC7Block(texels, block);
+        break;
+      default:
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+//-------------------------------------------------------------------DecompressTextureLevel
+TextureFormat GetDecompressedFormat(TextureFormat format)
+{
+  return IsGammaFormat(format) ? TextureFormat::SRGB8A8 : TextureFormat::RGBA8;
+}
+
+bool DecompressTextureLevel(TextureFormat format, const byte* blocks, size_t sizeX, size_t sizeY, byte* outRgba)
+{
+  if(!IsBlockCompressed(format))
+    return false;
+
+  size_t blockSize = GetTextureFormatBlockSize(format);
+  size_t blocksX = (sizeX + 3) / 4;
+  size_t blocksY = (sizeY + 3) / 4;
+  byte texels[16][4];
+  for(size_t blockY = 0; blockY < blocksY; ++blockY)
+  {
+    for(size_t blockX = 0; blockX < blocksX; ++blockX)
+    {
+      // BC5 only stores red and green, the rest read as 0 and opaque
+      for(size_t i = 0; i < 16; ++i)
+      {
+        texels[i][0] = texels[i][1] = texels[i][2] = 0;
+        texels[i][3] = 255;
+      }
+
+      const byte* block = blocks + (blockY * blocksX + blockX) * blockSize;
+      switch(format)
+      {
+      case TextureFormat::BC1:
+      case TextureFormat::SRGBBC1:
+        DecodeBC1Block(block, true, texels);
+        break;
+      case TextureFormat::BC3:
+      case TextureFormat::SRGBBC3:
+        DecodeBC1Block(block + 8, false, texels);
+        DecodeBC4Block(block, 3, texels);
+        break;
+      case TextureFormat::BC5:
+        DecodeBC4Block(block, 0, texels);
+        DecodeBC4Block(block + 8, 1, texels);
+        break;
+      case TextureFormat::BC7:
+      case TextureFormat::SRGBBC7:
+        DecodeBC7Block(block, texels);
+        break;
+      default:
+        break;
+      }
+
+      // Texels hanging off the edge of images that aren't a multiple of 4 are dropped
+      for(size_t y = 0; y < 4 && blockY * 4 + y < sizeY; ++y)
+      {
+        for(size_t x = 0; x < 4 && blockX * 4 + x < sizeX; ++x)
+          memcpy(outRgba + ((blockY * 4 + y) * sizeX + blockX * 4 + x) * 4, texels[y * 4 + x], 4);
+      }
+    }
+  }
+  return true;
+}
+
+bool DecompressTexture(const Texture& texture, Texture& outTexture)
+{
+  if(!IsBlockCompressed(texture.mFormat))
+    return false;
+
+  // Textures without stored levels only have the top one
+  size_t levelCount = Math::Max(texture.mMips.Size(), size_t(1));
+  TextureFormat format = GetDecompressedFormat(texture.mFormat);
+  BuildTextureMips(format, texture.mSizeX, texture.mSizeY, outTexture.mMips);
+  outTexture.mMips.Resize(Math::Min(levelCount, outTexture.mMips.Size()));
+  const TextureMip& lastMip = outTexture.mMips.Back();
+  outTexture.mTextureData.Resize(lastMip.mOffset + lastMip.mSize);
+
+  for(size_t level = 0; level < outTexture.mMips.Size(); ++level)
+  {
+    size_t sourceOffset = texture.mMips.Empty() ? 0 : texture.mMips[level].mOffset;
+    byte* destination = outTexture.mTextureData.Data() + outTexture.mMips[level].mOffset;
+    DecompressTextureLevel(texture.mFormat, texture.mTextureData.Data() + sourceOffset, Math::Max(texture.mSizeX >> level, size_t(1)), Math::Max(texture.mSizeY >> level, size_t(1)), destination);
+  }
+
+  outTexture.mSizeX = texture.mSizeX;
+  outTexture.mSizeY = texture.mSizeY;
+  outTexture.mMipLevels = outTexture.mMips.Size();
+  outTexture.mFormat = format;
+  return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "GraphicsStandard.hpp"
+#include "Texture.hpp"
+
+//-------------------------------------------------------------------BlockTexels
+/// The 16 texels of one 4x4 block kept as one array per channel so several texels can be
+/// compared against a palette entry at once.
+struct BlockTexels
+{
+  float mChannels[4][16];
+};
+
+/// Reads the block at the given block coordinates of an RGBA8 image. Blocks hanging off the
+/// edge of images that aren't a multiple of 4 repeat the last row and column.
+void LoadBlockTexels(const byte* rgba, size_t sizeX, size_t sizeY, size_t blockX, size_t blockY, BlockTexels& outTexels);
+
+/// 4 color BC1. The block is always opaque.
+void EncodeBC1Block(const BlockTexels& texels, byte* outBlock);
+/// One channel of the block as BC4, also used for BC3 alpha and both channels of BC5.
+void EncodeBC4Block(const BlockTexels& texels, size_t channel, byte* outBlock);
+void EncodeBC3Block(const BlockTexels& texels, byte* outBlock);
+void EncodeBC5Block(const BlockTexels& texels, byte* outBlock);
+/// BC7 mode 6, a single RGBA subset with 16 interpolation steps.
+void EncodeBC7Block(const BlockTexels& texels, byte* outBlock);
+
+/// Encodes an RGBA8 image into blocks of a compressed format. outBlocks has to hold
+/// GetTextureLevelSize(format, sizeX, sizeY) bytes. Returns false if the format isn't block compressed.
+bool CompressTextureLevel(TextureFormat format, const byte* rgba, size_t sizeX, size_t sizeY, byte* outBlocks);
+
+/// Decodes one block into RGBA8 texels. BC4 only writes the given channel.
+void DecodeBC1Block(const byte* block, bool allowTransparent, byte outTexels[16][4]);
+void DecodeBC4Block(const byte* block, size_t channel, byte outTexels[16][4]);
+/// Every BC7 mode, not just the one EncodeBC7Block writes.
+void DecodeBC7Block(const byte* block, byte outTexels[16][4]);
+
+/// The uncompressed format a compressed one decodes to, RGBA8 or SRGB8A8.
+TextureFormat GetDecompressedFormat(TextureFormat format);
+/// Decodes the blocks of a compressed format into an RGBA8 image of sizeX * sizeY * 4 bytes.
+/// Returns false if the format isn't block compressed.
+bool DecompressTextureLevel(TextureFormat format, const byte* blocks, size_t sizeX, size_t sizeY, byte* outRgba);
+/// Decodes every stored level of a compressed texture, for devices that can't sample the compressed format.
+bool DecompressTexture(const Texture& texture, Texture& outTexture);
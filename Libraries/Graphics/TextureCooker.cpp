@@ -0,0 +1,426 @@
+#include "Precompiled.hpp"
+
+#include "TextureCooker.hpp"
+
+#include "MipGenerator.hpp"
+#include "TextureCompression.hpp"
+#include "Utilities/File.hpp"
+
+#include <cstdio>
+#include <filesystem>
+
+//-------------------------------------------------------------------KTX2 layout
+static const byte cKtx2Identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+// Identifier, 9 uint32 header fields, then the dfd/kvd/sgd offsets and lengths
+constexpr size_t cKtx2HeaderSize = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+// Byte offset, byte length and uncompressed byte length of each level
+constexpr size_t cKtx2LevelIndexEntrySize = 3 * 8;
+// Level data has to be aligned to the block size and 4, 16 covers every format that's cooked
+constexpr size_t cKtx2LevelAlignment = 16;
+static const char cCookedSourceHashKey[] = "CookedSourceHash";
+
+// Data format descriptor values, see the Khronos Data Format Specification
+constexpr uint32_t cDfdModelRgbsda = 1;
+constexpr uint32_t cDfdModelBC1A = 128;
+constexpr uint32_t cDfdModelBC3 = 130;
+constexpr uint32_t cDfdModelBC5 = 132;
+constexpr uint32_t cDfdModelBC7 = 134;
+constexpr uint32_t cDfdPrimariesBT709 = 1;
+constexpr uint32_t cDfdTransferLinear = 1;
+constexpr uint32_t cDfdTransferSrgb = 2;
+constexpr uint32_t cDfdChannelAlpha = 15;
+// BC1 with punch-through alpha
+constexpr uint32_t cDfdChannelBC1AlphaPresent = 1;
+// Alpha stays linear in gamma formats
+constexpr uint32_t cDfdQualifierLinear = 0x10;
+
+struct CookedFormatMapping
+{
+  TextureFormat mFormat;
+  uint32_t mVkFormat;
+};
+
+// KTX2 stores formats as VkFormat values, Graphics doesn't see the vulkan headers so they're spelled out here
+static const CookedFormatMapping cCookedFormats[] =
+{
+  {TextureFormat::RGBA8, 37},    // VK_FORMAT_R8G8B8A8_UNORM
+  {TextureFormat::SRGB8A8, 43},  // VK_FORMAT_R8G8B8A8_SRGB
+  {TextureFormat::BC1, 133},     // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+  {TextureFormat::SRGBBC1, 134}, // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+  {TextureFormat::BC3, 137},     // VK_FORMAT_BC3_UNORM_BLOCK
+  {TextureFormat::SRGBBC3, 138}, // VK_FORMAT_BC3_SRGB_BLOCK
+  {TextureFormat::BC5, 141},     // VK_FORMAT_BC5_UNORM_BLOCK
+  {TextureFormat::BC7, 145},     // VK_FORMAT_BC7_UNORM_BLOCK
+  {TextureFormat::SRGBBC7, 146}, // VK_FORMAT_BC7_SRGB_BLOCK
+};
+
+uint32_t GetCookedVkFormat(TextureFormat format)
+{
+  for(const CookedFormatMapping& mapping : cCookedFormats)
+  {
+    if(mapping.mFormat == format)
+      return mapping.mVkFormat;
+  }
+  return 0;
+}
+
+TextureFormat GetCookedTextureFormat(uint32_t vkFormat)
+{
+  for(const CookedFormatMapping& mapping : cCookedFormats)
+  {
+    if(mapping.mVkFormat == vkFormat)
+      return mapping.mFormat;
+  }
+  return TextureFormat::None;
+}
+
+template <typename T>
+void AppendCookedValue(Array<byte>& data, const T& value)
+{
+  size_t offset = data.Size();
+  data.Resize(offset + sizeof(T));
+  memcpy(data.Data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+void WriteCookedValue(Array<byte>& data, size_t offset, const T& value)
+{
+  memcpy(data.Data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+bool ReadCookedValue(const Array<char>& data, size_t offset, T& outValue)
+{
+  if(offset > data.Size() || data.Size() - offset < sizeof(T))
+    return false;
+  memcpy(&outValue, data.Data() + offset, sizeof(T));
+  return true;
+}
+
+struct CookedDfdSample
+{
+  uint32_t mBitOffset;
+  uint32_t mBitLength;
+  uint32_t mChannel;
+};
+
+/// Appends a basic descriptor block with one sample per channel, or per independently compressed part of a block.
+void AppendCookedDfd(Array<byte>& data, TextureFormat format)
+{
+  bool gamma = IsGammaFormat(format);
+  uint32_t model = cDfdModelRgbsda;
+  CookedDfdSample samples[4];
+  uint32_t sampleCount = 0;
+  switch(format)
+  {
+  case TextureFormat::BC1:
+  case TextureFormat::SRGBBC1:
+    model = cDfdModelBC1A;
+    samples[sampleCount++] = {0, 64, cDfdChannelBC1AlphaPresent};
+    break;
+  case TextureFormat::BC3:
+  case TextureFormat::SRGBBC3:
+    model = cDfdModelBC3;
+    samples[sampleCount++] = {0, 64, cDfdChannelAlpha};
+    samples[sampleCount++] = {64, 64, 0};
+    break;
+  case TextureFormat::BC5:
+    model = cDfdModelBC5;
+    samples[sampleCount++] = {0, 64, 0};
+    samples[sampleCount++] = {64, 64, 1};
+    break;
+  case TextureFormat::BC7:
+  case TextureFormat::SRGBBC7:
+    model = cDfdModelBC7;
+    samples[sampleCount++] = {0, 128, 0};
+    break;
+  default:
+    // RGBA8 and SRGB8A8
+    for(uint32_t c = 0; c < 4; ++c)
+      samples[sampleCount++] = {c * 8, 8, c < 3 ? c : cDfdChannelAlpha};
+    break;
+  }
+
+  bool compressed = IsBlockCompressed(format);
+  uint32_t blockDimension = compressed ? 3 : 0;
+  uint32_t descriptorBlockSize = 24 + 16 * sampleCount;
+  AppendCookedValue(data, 4 + descriptorBlockSize);
+  // Khronos vendor and basic descriptor type, then version 2 of the format
+  AppendCookedValue(data, uint32_t(0));
+  AppendCookedValue(data, 2 | (descriptorBlockSize << 16));
+  AppendCookedValue(data, model | (cDfdPrimariesBT709 << 8) | ((gamma ? cDfdTransferSrgb : cDfdTransferLinear) << 16));
+  // Block dimensions are stored minus one
+  AppendCookedValue(data, blockDimension | (blockDimension << 8));
+  AppendCookedValue(data, static_cast<uint32_t>(GetTextureFormatBlockSize(format)));
+  AppendCookedValue(data, uint32_t(0));
+  for(uint32_t i = 0; i < sampleCount; ++i)
+  {
+    const CookedDfdSample& sample = samples[i];
+    uint32_t channelType = sample.mChannel;
+    if(gamma && sample.mChannel == cDfdChannelAlpha)
+      channelType |= cDfdQualifierLinear;
+    AppendCookedValue(data, sample.mBitOffset | ((sample.mBitLength - 1) << 16) | (channelType << 24));
+    // Sample position, then the lower and upper values
+    AppendCookedValue(data, uint32_t(0));
+    AppendCookedValue(data, uint32_t(0));
+    AppendCookedValue(data, compressed ? 0xFFFFFFFFu : 0xFFu);
+  }
+}
+
+//-------------------------------------------------------------------Cooking
+TextureFormat SelectCookedFormat(const byte* rgba, size_t sizeX, size_t sizeY, bool gamma)
+{
+  size_t texelCount = sizeX * sizeY;
+  for(size_t i = 0; i < texelCount; ++i)
+  {
+    if(rgba[i * 4 + 3] != 255)
+      return gamma ? TextureFormat::SRGBBC7 : TextureFormat::BC7;
+  }
+  return gamma ? TextureFormat::SRGBBC1 : TextureFormat::BC1;
+}
+
+bool CookTexture(const byte* rgba, size_t sizeX, size_t sizeY, TextureFormat format, Texture& outTexture, ThreadPool* threadPool)
+{
+  // The chain is generated as RGBA8 and then every level is compressed
+  TextureFormat chainFormat = IsGammaFormat(format) ? TextureFormat::SRGB8A8 : TextureFormat::RGBA8;
+  if(format == chainFormat)
+    return GenerateMipChain(format, rgba, sizeX, sizeY, outTexture, MipFilter::Kaiser, threadPool);
+  if(!IsBlockCompressed(format))
+    return false;
+
+  Texture chain;
+  if(!GenerateMipChain(chainFormat, rgba, sizeX, sizeY, chain, MipFilter::Kaiser, threadPool))
+    return false;
+
+  size_t totalSize = BuildTextureMips(format, sizeX, sizeY, outTexture.mMips);
+  outTexture.mTextureData.Resize(totalSize);
+  for(size_t level = 0; level < outTexture.mMips.Size(); ++level)
+  {
+    const byte* levelData = chain.mTextureData.Data() + chain.mMips[level].mOffset;
+    byte* destination = outTexture.mTextureData.Data() + outTexture.mMips[level].mOffset;
+    CompressTextureLevel(format, levelData, Math::Max(sizeX >> level, size_t(1)), Math::Max(sizeY >> level, size_t(1)), destination);
+  }
+
+  outTexture.mSizeX = sizeX;
+  outTexture.mSizeY = sizeY;
+  outTexture.mMipLevels = outTexture.mMips.Size();
+  outTexture.mFormat = format;
+  return true;
+}
+
+uint64_t HashCookSource(const void* data, size_t size)
+{
+  // FNV-1a
+  const byte* bytes = static_cast<const byte*>(data);
+  uint64_t hash = 14695981039346656037ull;
+  for(size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+uint64_t StampCookSource(const String& path)
+{
+  std::error_code error;
+  std::filesystem::path sourcePath(path.c_str());
+  uint64_t stamp[2];
+  stamp[0] = static_cast<uint64_t>(std::filesystem::file_size(sourcePath, error));
+  if(error)
+    return 0;
+  stamp[1] = static_cast<uint64_t>(std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count());
+  if(error)
+    return 0;
+  return HashCookSource(stamp, sizeof(stamp));
+}
+
+String GetCookedPath(const String& cookedDirectory, const String& sourcePath, const String& extension)
+{
+  std::error_code error;
+  std::filesystem::path fullPath = std::filesystem::absolute(std::filesystem::path(sourcePath.c_str()), error);
+  if(error)
+    fullPath = std::filesystem::path(sourcePath.c_str());
+  std::string fullPathString = fullPath.lexically_normal().generic_string();
+
+  char pathHash[17];
+  snprintf(pathHash, sizeof(pathHash), "%016llx", static_cast<unsigned long long>(HashCookSource(fullPathString.data(), fullPathString.size())));
+  String fileName = BuildString(Zero::FilePath::GetFileNameWithoutExtension(sourcePath), "_", String(pathHash));
+  return Zero::FilePath::CombineWithExtension(cookedDirectory, fileName, extension);
+}
+
+//-------------------------------------------------------------------Cooked files
+bool SaveCookedTexture(const String& path, const Texture& texture, uint64_t sourceHash)
+{
+  uint32_t vkFormat = GetCookedVkFormat(texture.mFormat);
+  if(vkFormat == 0 || texture.mMips.Empty())
+    return false;
+
+  uint32_t levelCount = static_cast<uint32_t>(texture.mMips.Size());
+  Array<byte> data;
+  data.Resize(sizeof(cKtx2Identifier));
+  memcpy(data.Data(), cKtx2Identifier, sizeof(cKtx2Identifier));
+  AppendCookedValue(data, vkFormat);
+  // typeSize: 1 for block compressed and 8 bit formats
+  AppendCookedValue(data, uint32_t(1));
+  AppendCookedValue(data, static_cast<uint32_t>(texture.mSizeX));
+  AppendCookedValue(data, static_cast<uint32_t>(texture.mSizeY));
+  // Depth, layer count, face count, level count and supercompression scheme
+  AppendCookedValue(data, uint32_t(0));
+  AppendCookedValue(data, uint32_t(0));
+  AppendCookedValue(data, uint32_t(1));
+  AppendCookedValue(data, levelCount);
+  AppendCookedValue(data, uint32_t(0));
+
+  // Supercompression data is left out, the descriptor and key/value offsets are filled in below
+  size_t dfdIndexOffset = data.Size();
+  size_t kvdIndexOffset = dfdIndexOffset + 2 * sizeof(uint32_t);
+  AppendCookedValue(data, uint32_t(0));
+  AppendCookedValue(data, uint32_t(0));
+  AppendCookedValue(data, uint32_t(0));
+  AppendCookedValue(data, uint32_t(0));
+  AppendCookedValue(data, uint64_t(0));
+  AppendCookedValue(data, uint64_t(0));
+
+  size_t levelIndexOffset = data.Size();
+  data.Resize(levelIndexOffset + levelCount * cKtx2LevelIndexEntrySize);
+
+  size_t dfdOffset = data.Size();
+  AppendCookedDfd(data, texture.mFormat);
+  WriteCookedValue(data, dfdIndexOffset, static_cast<uint32_t>(dfdOffset));
+  WriteCookedValue(data, dfdIndexOffset + sizeof(uint32_t), static_cast<uint32_t>(data.Size() - dfdOffset));
+
+  size_t kvdOffset = data.Size();
+  AppendCookedValue(data, static_cast<uint32_t>(sizeof(cCookedSourceHashKey) + sizeof(sourceHash)));
+  for(char c : cCookedSourceHashKey)
+    data.PushBack(static_cast<byte>(c));
+  AppendCookedValue(data, sourceHash);
+  while(data.Size() % 4 != 0)
+    data.PushBack(0);
+  WriteCookedValue(data, kvdIndexOffset, static_cast<uint32_t>(kvdOffset));
+  WriteCookedValue(data, kvdIndexOffset + sizeof(uint32_t), static_cast<uint32_t>(data.Size() - kvdOffset));
+
+  // The level index is largest first but the levels themselves are stored smallest first
+  for(size_t level = levelCount; level-- > 0;)
+  {
+    while(data.Size() % cKtx2LevelAlignment != 0)
+      data.PushBack(0);
+
+    const TextureMip& mip = texture.mMips[level];
+    size_t offset = data.Size();
+    data.Resize(offset + mip.mSize);
+    memcpy(data.Data() + offset, texture.mTextureData.Data() + mip.mOffset, mip.mSize);
+
+    size_t entryOffset = levelIndexOffset + level * cKtx2LevelIndexEntrySize;
+    WriteCookedValue(data, entryOffset, static_cast<uint64_t>(offset));
+    WriteCookedValue(data, entryOffset + sizeof(uint64_t), static_cast<uint64_t>(mip.mSize));
+    WriteCookedValue(data, entryOffset + 2 * sizeof(uint64_t), static_cast<uint64_t>(mip.mSize));
+  }
+
+  Zero::WriteToFile(path.c_str(), data.Data(), data.Size());
+  return true;
+}
+
+bool LoadCookedTexture(const String& path, Texture& outTexture, uint64_t* outSourceHash)
+{
+  Array<char> data;
+  readFile(path, data);
+  if(data.Size() < cKtx2HeaderSize || memcmp(data.Data(), cKtx2Identifier, sizeof(cKtx2Identifier)) != 0)
+  {
+    Warn("'%s' isn't a KTX2 file", path.c_str());
+    return false;
+  }
+
+  uint32_t header[9];
+  memcpy(header, data.Data() + sizeof(cKtx2Identifier), sizeof(header));
+  uint32_t vkFormat = header[0];
+  size_t sizeX = header[2];
+  size_t sizeY = header[3];
+  uint32_t depth = header[4];
+  uint32_t layerCount = header[5];
+  uint32_t faceCount = header[6];
+  uint32_t levelCount = header[7];
+  uint32_t supercompression = header[8];
+
+  // A corrupt level count could otherwise shift the sizes past their width below
+  TextureFormat format = GetCookedTextureFormat(vkFormat);
+  bool validLevelCount = levelCount != 0 && sizeX != 0 && sizeY != 0 && levelCount <= GetMipLevelCount(sizeX, sizeY);
+  if(format == TextureFormat::None || !validLevelCount || depth > 1 || layerCount > 1 || faceCount != 1 || supercompression != 0)
+  {
+    Warn("KTX2 file '%s' uses features that aren't supported", path.c_str());
+    return false;
+  }
+
+  size_t indexOffset = sizeof(cKtx2Identifier) + sizeof(header);
+  size_t levelIndexOffset = cKtx2HeaderSize;
+  if(data.Size() < levelIndexOffset + levelCount * cKtx2LevelIndexEntrySize)
+  {
+    Warn("KTX2 file '%s' is truncated", path.c_str());
+    return false;
+  }
+
+  // Validate every level before anything in the texture is touched
+  size_t totalSize = 0;
+  for(size_t level = 0; level < levelCount; ++level)
+  {
+    uint64_t levelOffset = 0, levelSize = 0;
+    size_t entryOffset = levelIndexOffset + level * cKtx2LevelIndexEntrySize;
+    ReadCookedValue(data, entryOffset, levelOffset);
+    ReadCookedValue(data, entryOffset + sizeof(uint64_t), levelSize);
+    size_t expectedSize = GetTextureLevelSize(format, Math::Max(sizeX >> level, size_t(1)), Math::Max(sizeY >> level, size_t(1)));
+    if(levelSize != expectedSize || levelOffset > data.Size() || data.Size() - levelOffset < levelSize)
+    {
+      Warn("KTX2 file '%s' has a bad level %d", path.c_str(), static_cast<int>(level));
+      return false;
+    }
+    totalSize += expectedSize;
+  }
+
+  outTexture.mTextureData.Resize(totalSize);
+  outTexture.mMips.Clear();
+  size_t offset = 0;
+  for(size_t level = 0; level < levelCount; ++level)
+  {
+    uint64_t levelOffset = 0, levelSize = 0;
+    size_t entryOffset = levelIndexOffset + level * cKtx2LevelIndexEntrySize;
+    ReadCookedValue(data, entryOffset, levelOffset);
+    ReadCookedValue(data, entryOffset + sizeof(uint64_t), levelSize);
+
+    TextureMip& mip = outTexture.mMips.PushBack();
+    mip.mOffset = offset;
+    mip.mSize = static_cast<size_t>(levelSize);
+    memcpy(outTexture.mTextureData.Data() + offset, data.Data() + levelOffset, mip.mSize);
+    offset += mip.mSize;
+  }
+
+  outTexture.mSizeX = sizeX;
+  outTexture.mSizeY = sizeY;
+  outTexture.mMipLevels = levelCount;
+  outTexture.mFormat = format;
+
+  if(outSourceHash != nullptr)
+  {
+    *outSourceHash = 0;
+    uint32_t kvdOffset = 0, kvdLength = 0;
+    ReadCookedValue(data, indexOffset + 2 * sizeof(uint32_t), kvdOffset);
+    ReadCookedValue(data, indexOffset + 3 * sizeof(uint32_t), kvdLength);
+    size_t kvdEnd = Math::Min(static_cast<size_t>(kvdOffset) + kvdLength, data.Size());
+
+    // Each entry is its length, a null terminated key, the value, then padding to 4 bytes
+    size_t entryOffset = kvdOffset;
+    uint32_t entryLength = 0;
+    while(entryOffset < kvdEnd && ReadCookedValue(data, entryOffset, entryLength))
+    {
+      size_t keyOffset = entryOffset + sizeof(uint32_t);
+      bool isHashEntry = entryLength == sizeof(cCookedSourceHashKey) + sizeof(uint64_t) && keyOffset + entryLength <= kvdEnd &&
+                         memcmp(data.Data() + keyOffset, cCookedSourceHashKey, sizeof(cCookedSourceHashKey)) == 0;
+      if(isHashEntry)
+      {
+        ReadCookedValue(data, keyOffset + sizeof(cCookedSourceHashKey), *outSourceHash);
+        break;
+      }
+      entryOffset = keyOffset + ((entryLength + 3) & ~size_t(3));
+    }
+  }
+  return true;
+}
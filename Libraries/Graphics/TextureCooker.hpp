@@ -0,0 +1,27 @@
+#pragma once
+
+#include "GraphicsStandard.hpp"
+#include "Texture.hpp"
+
+class ThreadPool;
+
+/// Picks the format a source image is cooked to. Opaque images go to BC1, anything with alpha to BC7.
+TextureFormat SelectCookedFormat(const byte* rgba, size_t sizeX, size_t sizeY, bool gamma);
+
+/// Builds the full mip chain of an RGBA8 image and stores every level in the texture in the given
+/// format. Mips are generated with the Kaiser filter, see GenerateMipChain.
+bool CookTexture(const byte* rgba, size_t sizeX, size_t sizeY, TextureFormat format, Texture& outTexture, ThreadPool* threadPool = nullptr);
+
+/// Hash of a source file's contents, stored in the cooked file to know when it's out of date.
+uint64_t HashCookSource(const void* data, size_t size);
+/// Hash of a source file's size and last write time, so a cooked copy can be validated without reading
+/// the source. Zero if the file can't be found.
+uint64_t StampCookSource(const String& path);
+/// Path of the cooked copy of a source file. The name carries a hash of the source's full path so
+/// same-named sources in different folders don't share a cooked file.
+String GetCookedPath(const String& cookedDirectory, const String& sourcePath, const String& extension);
+
+/// Cooked textures are stored as KTX2 with a basic data format descriptor so they can be inspected
+/// with the usual tools. Levels aren't supercompressed.
+bool SaveCookedTexture(const String& path, const Texture& texture, uint64_t sourceHash);
+bool LoadCookedTexture(const String& path, Texture& outTexture, uint64_t* outSourceHash = nullptr);
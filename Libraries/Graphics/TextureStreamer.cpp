@@ -0,0 +1,258 @@
+#include "Precompiled.hpp"
+
+#include "TextureStreamer.hpp"
+
+#include "Texture.hpp"
+#include "ZilchMaterial.hpp"
+#include "RenderQueue.hpp"
+#include "RenderTasks.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+//-------------------------------------------------------------------TextureStreamer
+void TextureStreamer::Initialize(const TextureStreamingSettings& settings)
+{
+  Clear();
+  mSettings = settings;
+}
+
+bool TextureStreamer::IsEnabled() const
+{
+  return mSettings.mBudget != 0;
+}
+
+uint32_t TextureStreamer::AddTexture(const Texture* texture)
+{
+  if(!IsEnabled())
+    return 0;
+
+  StreamedTexture& streamedTexture = mTextures.PushBack();
+  streamedTexture.mTexture = texture;
+  // Textures without stored levels can only be created whole
+  uint32_t levelCount = static_cast<uint32_t>(texture->mMips.Size());
+  for(uint32_t level = 0; level < levelCount; ++level)
+  {
+    streamedTexture.mMinResidentMip = level;
+    if(Math::Max(texture->mSizeX >> level, texture->mSizeY >> level) <= mSettings.mMinResidentSize)
+      break;
+  }
+  streamedTexture.mResidentMip = streamedTexture.mMinResidentMip;
+  streamedTexture.mRequestedMip = streamedTexture.mMinResidentMip;
+  streamedTexture.mLastUsedFrame = mFrame;
+  mTextureIndices[texture] = mTextures.Size() - 1;
+
+  size_t previousBytes = mResidentBytes;
+  mResidentBytes += GetResidentSize(streamedTexture, streamedTexture.mResidentMip);
+  if(previousBytes <= mSettings.mBudget && mResidentBytes > mSettings.mBudget)
+    Warn("Texture streaming budget is smaller than the textures' minimum resident levels");
+  return streamedTexture.mResidentMip;
+}
+
+void TextureStreamer::RemoveTexture(const Texture* texture)
+{
+  size_t index = mTextureIndices.FindValue(texture, static_cast<size_t>(-1));
+  if(index == static_cast<size_t>(-1))
+    return;
+
+  mResidentBytes -= GetResidentSize(mTextures[index], mTextures[index].mResidentMip);
+  mTextureIndices.Erase(texture);
+  size_t lastIndex = mTextures.Size() - 1;
+  if(index != lastIndex)
+  {
+    mTextures[index] = mTextures[lastIndex];
+    mTextureIndices[mTextures[index].mTexture] = index;
+  }
+  mTextures.PopBack();
+}
+
+void TextureStreamer::Clear()
+{
+  mTextures.Clear();
+  mTextureIndices.Clear();
+  mMaterialTextures.Clear();
+  mResidentBytes = 0;
+}
+
+void TextureStreamer::GatherRequests(const RenderQueue& renderQueue, const TextureManager* textureManager, size_t viewportHeight)
+{
+  ++mFrame;
+  for(StreamedTexture& streamedTexture : mTextures)
+    streamedTexture.mRequestedMip = streamedTexture.mMinResidentMip;
+
+  for(const ViewBlock& viewBlock : renderQueue.mViewBlocks)
+  {
+    // Pixels covered per unit of radius at a view depth of one
+    float pixelScale = std::abs(viewBlock.mViewToPerspective[1][1]) * viewportHeight * 0.5f;
+    for(const RenderTask* renderTask : viewBlock.mRenderTaskEvent.mRenderTasks)
+    {
+      if(renderTask->mTaskType != RenderTaskType::RenderGroup)
+        continue;
+
+      const RenderGroupRenderTask* groupTask = static_cast<const RenderGroupRenderTask*>(renderTask);
+      for(const GraphicalFrameData& frameData : groupTask->mFrameData)
+      {
+        if(frameData.mZilchMaterial == nullptr)
+          continue;
+        const Array<const Texture*>& textures = FindMaterialTextures(frameData.mZilchMaterial, textureManager);
+        if(textures.Empty())
+          continue;
+
+        // Assumes the texture is mapped once across the object so its diameter on screen is the texel count needed
+        Vec3 center(frameData.mWorldBoundingSphere.x, frameData.mWorldBoundingSphere.y, frameData.mWorldBoundingSphere.z);
+        float radius = frameData.mWorldBoundingSphere.w;
+        float viewDepth = -Math::MultiplyPoint(viewBlock.mWorldToView, center).z;
+        bool containsCamera = viewDepth <= radius;
+        size_t screenSize = containsCamera ? 0 : static_cast<size_t>(2.0f * radius * pixelScale / viewDepth);
+
+        for(const Texture* texture : textures)
+        {
+          size_t index = mTextureIndices.FindValue(texture, static_cast<size_t>(-1));
+          if(index == static_cast<size_t>(-1))
+            continue;
+
+          StreamedTexture& streamedTexture = mTextures[index];
+          uint32_t mip = 0;
+          if(!containsCamera)
+          {
+            size_t textureSize = Math::Max(texture->mSizeX, texture->mSizeY);
+            while(mip < streamedTexture.mMinResidentMip && (textureSize >> (mip + 1)) >= screenSize)
+              ++mip;
+          }
+          streamedTexture.mRequestedMip = Math::Min(streamedTexture.mRequestedMip, mip);
+          streamedTexture.mLastUsedFrame = mFrame;
+        }
+      }
+    }
+  }
+}
+
+void TextureStreamer::Update(Array<TextureResidencyChange>& outChanges)
+{
+  // Textures furthest from what they need go first, ties go to whichever was seen most recently
+  Array<StreamedTexture*> loads;
+  for(StreamedTexture& streamedTexture : mTextures)
+  {
+    if(streamedTexture.mRequestedMip < streamedTexture.mResidentMip)
+      loads.PushBack(&streamedTexture);
+  }
+  std::sort(loads.Data(), loads.Data() + loads.Size(), [](const StreamedTexture* lhs, const StreamedTexture* rhs)
+  {
+    uint32_t lhsDeficit = lhs->mResidentMip - lhs->mRequestedMip;
+    uint32_t rhsDeficit = rhs->mResidentMip - rhs->mRequestedMip;
+    if(lhsDeficit != rhsDeficit)
+      return lhsDeficit > rhsDeficit;
+    return lhs->mLastUsedFrame > rhs->mLastUsedFrame;
+  });
+
+  // One level per texture per frame. Each level is four times the last so this stays fair between textures.
+  size_t uploadedBytes = 0;
+  for(StreamedTexture* streamedTexture : loads)
+  {
+    uint32_t nextMip = streamedTexture->mResidentMip - 1;
+    size_t levelSize = streamedTexture->mTexture->mMips[nextMip].mSize;
+    // The renderer recreates the image, so the whole chain from the new level down is uploaded
+    size_t uploadSize = GetResidentSize(*streamedTexture, nextMip);
+    if(uploadedBytes != 0 && uploadedBytes + uploadSize > mSettings.mMaxUploadBytesPerFrame)
+      break;
+    if(mResidentBytes + levelSize > mSettings.mBudget && !EvictLeastRecentlyUsed(mResidentBytes + levelSize - mSettings.mBudget, streamedTexture))
+      continue;
+
+    SetResidentMip(*streamedTexture, nextMip);
+    uploadedBytes += uploadSize;
+  }
+
+  for(StreamedTexture& streamedTexture : mTextures)
+  {
+    if(!streamedTexture.mChanged)
+      continue;
+
+    TextureResidencyChange& change = outChanges.PushBack();
+    change.mTexture = streamedTexture.mTexture;
+    change.mFirstMip = streamedTexture.mResidentMip;
+    streamedTexture.mChanged = false;
+  }
+}
+
+void TextureStreamer::ClearMaterialTextures()
+{
+  mMaterialTextures.Clear();
+}
+
+size_t TextureStreamer::GetResidentBytes() const
+{
+  return mResidentBytes;
+}
+
+size_t TextureStreamer::GetResidentSize(const StreamedTexture& streamedTexture, uint32_t firstMip) const
+{
+  const Texture* texture = streamedTexture.mTexture;
+  if(texture->mMips.Empty())
+    return texture->mTextureData.Size();
+
+  size_t size = 0;
+  for(size_t level = firstMip; level < texture->mMips.Size(); ++level)
+    size += texture->mMips[level].mSize;
+  return size;
+}
+
+void TextureStreamer::SetResidentMip(StreamedTexture& streamedTexture, uint32_t firstMip)
+{
+  mResidentBytes -= GetResidentSize(streamedTexture, streamedTexture.mResidentMip);
+  mResidentBytes += GetResidentSize(streamedTexture, firstMip);
+  streamedTexture.mResidentMip = firstMip;
+  streamedTexture.mChanged = true;
+}
+
+const Array<const Texture*>& TextureStreamer::FindMaterialTextures(const ZilchMaterial* zilchMaterial, const TextureManager* textureManager)
+{
+  Array<const Texture*>* textures = mMaterialTextures.FindPointer(zilchMaterial);
+  if(textures != nullptr)
+    return *textures;
+
+  Array<const Texture*>& newTextures = mMaterialTextures[zilchMaterial];
+  for(const MaterialFragment& fragment : zilchMaterial->mFragments)
+  {
+    for(const MaterialProperty& materialProp : fragment.mProperties)
+    {
+      if(materialProp.mType != ShaderPrimitiveType::SampledImage)
+        continue;
+
+      // Sampled image properties store the texture's name
+      String textureName((const char*)materialProp.mData.Data());
+      const Texture* texture = textureManager->FindResource(ResourceName{textureName});
+      if(texture != nullptr)
+        newTextures.PushBack(texture);
+    }
+  }
+  return newTextures;
+}
+
+bool TextureStreamer::EvictLeastRecentlyUsed(size_t requiredBytes, const StreamedTexture* keep)
+{
+  size_t freedBytes = 0;
+  while(freedBytes < requiredBytes)
+  {
+    // Only textures that weren't seen this frame or hold finer levels than they asked for can give memory back
+    StreamedTexture* victim = nullptr;
+    for(StreamedTexture& streamedTexture : mTextures)
+    {
+      if(&streamedTexture == keep || streamedTexture.mResidentMip >= streamedTexture.mMinResidentMip)
+        continue;
+      bool used = streamedTexture.mLastUsedFrame == mFrame;
+      if(used && streamedTexture.mResidentMip >= streamedTexture.mRequestedMip)
+        continue;
+      if(victim == nullptr || streamedTexture.mLastUsedFrame < victim->mLastUsedFrame)
+        victim = &streamedTexture;
+    }
+    if(victim == nullptr)
+      return false;
+
+    bool used = victim->mLastUsedFrame == mFrame;
+    uint32_t firstMip = used ? victim->mRequestedMip : victim->mMinResidentMip;
+    size_t residentSize = GetResidentSize(*victim, victim->mResidentMip);
+    SetResidentMip(*victim, firstMip);
+    freedBytes += residentSize - GetResidentSize(*victim, firstMip);
+  }
+  return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "GraphicsStandard.hpp"
+
+struct Texture;
+struct TextureManager;
+struct ZilchMaterial;
+struct RenderQueue;
+
+//-------------------------------------------------------------------TextureStreamingSettings
+struct TextureStreamingSettings
+{
+  // Bytes of texture memory kept resident on the gpu. Zero disables streaming and every texture is fully resident.
+  size_t mBudget = 0;
+  // Levels this size and smaller are always resident so there's something to sample while the rest stream in
+  size_t mMinResidentSize = 64;
+  // Limits how much is uploaded in one frame so bringing in a large level doesn't hitch
+  size_t mMaxUploadBytesPerFrame = 8 * 1024 * 1024;
+};
+
+//-------------------------------------------------------------------TextureResidencyChange
+/// The renderer should make levels [mFirstMip, mMipLevels) of the texture resident.
+struct TextureResidencyChange
+{
+  const Texture* mTexture = nullptr;
+  uint32_t mFirstMip = 0;
+};
+
+//-------------------------------------------------------------------TextureStreamer
+/// Decides which mip levels of each texture are resident on the gpu. Textures start with only their
+/// smallest levels. Every frame the render queue is walked to find how large each texture is on screen
+/// and finer levels are brought in one at a time, largest deficit first. When the budget is exceeded the
+/// least recently used textures are dropped back down.
+class TextureStreamer
+{
+public:
+  void Initialize(const TextureStreamingSettings& settings);
+  bool IsEnabled() const;
+
+  /// Starts tracking a texture. Returns the first mip level it should be created with.
+  uint32_t AddTexture(const Texture* texture);
+  void RemoveTexture(const Texture* texture);
+  void Clear();
+  /// Materials' sampled textures are cached, call when materials are reloaded.
+  void ClearMaterialTextures();
+
+  /// Finds the finest level each visible texture needs from the bounding spheres in the render queue.
+  void GatherRequests(const RenderQueue& renderQueue, const TextureManager* textureManager, size_t viewportHeight);
+  /// Moves resident levels towards the requests within the budget. Only textures whose residency changed are output.
+  void Update(Array<TextureResidencyChange>& outChanges);
+
+  size_t GetResidentBytes() const;
+
+private:
+  struct StreamedTexture
+  {
+    const Texture* mTexture = nullptr;
+    // First level currently resident
+    uint32_t mResidentMip = 0;
+    // Coarsest first level, every level from here down is always resident
+    uint32_t mMinResidentMip = 0;
+    uint32_t mRequestedMip = 0;
+    size_t mLastUsedFrame = 0;
+    bool mChanged = false;
+  };
+
+  size_t GetResidentSize(const StreamedTexture& streamedTexture, uint32_t firstMip) const;
+  void SetResidentMip(StreamedTexture& streamedTexture, uint32_t firstMip);
+  const Array<const Texture*>& FindMaterialTextures(const ZilchMaterial* zilchMaterial, const TextureManager* textureManager);
+  bool EvictLeastRecentlyUsed(size_t requiredBytes, const StreamedTexture* keep);
+
+  TextureStreamingSettings mSettings;
+  Array<StreamedTexture> mTextures;
+  HashMap<const Texture*, size_t> mTextureIndices;
+  // Sampled textures of each material, found on first use
+  HashMap<const ZilchMaterial*, Array<const Texture*>> mMaterialTextures;
+  size_t mResidentBytes = 0;
+  size_t mFrame = 0;
+};
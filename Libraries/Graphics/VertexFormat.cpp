@@ -0,0 +1,174 @@
+#include "Precompiled.hpp"
+
+#include "VertexFormat.hpp"
+
+#include "Mesh.hpp"
+#include "MipGenerator.hpp"
+
+#include <cmath>
+
+//-------------------------------------------------------------------VertexAttribute
+const char* GetVertexAttributeName(VertexAttribute attribute)
+{
+  switch(attribute)
+  {
+  case VertexAttribute::Position: return "LocalPosition";
+  case VertexAttribute::Normal: return "LocalNormalOctahedral";
+  case VertexAttribute::Color: return "Color";
+  case VertexAttribute::Uv: return "Uv";
+  case VertexAttribute::Aux0: return "Aux0";
+  default:
+    return "";
+  }
+}
+
+const char* GetInstanceRowName(uint32_t row)
+{
+  switch(row)
+  {
+  case 0: return "InstanceLocalToWorldRow0";
+  case 1: return "InstanceLocalToWorldRow1";
+  case 2: return "InstanceLocalToWorldRow2";
+  default:
+    return "";
+  }
+}
+
+//-------------------------------------------------------------------VertexAttributeFormat
+VertexAttributeFormat GetVertexAttributeFormat(VertexAttribute attribute)
+{
+  switch(attribute)
+  {
+  case VertexAttribute::Position: return VertexAttributeFormat::Snorm16x4;
+  case VertexAttribute::Normal: return VertexAttributeFormat::OctahedralSnorm16x2;
+  case VertexAttribute::Color: return VertexAttributeFormat::Unorm8x4;
+  case VertexAttribute::Uv: return VertexAttributeFormat::Half2;
+  case VertexAttribute::Aux0: return VertexAttributeFormat::Float4;
+  default:
+    return VertexAttributeFormat::None;
+  }
+}
+
+size_t GetVertexAttributeFormatSize(VertexAttributeFormat format)
+{
+  switch(format)
+  {
+  case VertexAttributeFormat::Snorm16x4: return 8;
+  case VertexAttributeFormat::OctahedralSnorm16x2: return 4;
+  case VertexAttributeFormat::Half2: return 4;
+  case VertexAttributeFormat::Unorm8x4: return 4;
+  case VertexAttributeFormat::Float4: return 16;
+  default:
+    return 0;
+  }
+}
+
+//-------------------------------------------------------------------VertexFormat
+VertexAttributeFormat VertexFormat::GetFormat(VertexAttribute attribute) const
+{
+  return Has(attribute) ? GetVertexAttributeFormat(attribute) : VertexAttributeFormat::None;
+}
+
+VertexFormat BuildVertexFormat(uint32_t attributes)
+{
+  VertexFormat format;
+  format.mAttributes = attributes & cAllVertexAttributes;
+  for(size_t i = 0; i < cVertexAttributeCount; ++i)
+  {
+    VertexAttribute attribute = static_cast<VertexAttribute>(i);
+    if(!format.Has(attribute))
+      continue;
+    format.mOffsets[i] = format.mStride;
+    format.mStride += static_cast<uint32_t>(GetVertexAttributeFormatSize(GetVertexAttributeFormat(attribute)));
+  }
+  return format;
+}
+
+//-------------------------------------------------------------------Encoding
+Vec2 EncodeOctahedral(const Vec3& normal)
+{
+  float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+  if(length == 0.0f)
+    return Vec2(0.0f, 0.0f);
+
+  Vec2 result(normal.x / length, normal.y / length);
+  // The lower half folds over the diagonals onto the corners
+  if(normal.z < 0.0f)
+  {
+    float x = result.x;
+    result.x = (1.0f - std::abs(result.y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    result.y = (1.0f - std::abs(x)) * (result.y >= 0.0f ? 1.0f : -1.0f);
+  }
+  return result;
+}
+
+Vec3 DecodeOctahedral(const Vec2& encoded)
+{
+  Vec3 result(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+  float fold = Math::Max(-result.z, 0.0f);
+  result.x += result.x >= 0.0f ? -fold : fold;
+  result.y += result.y >= 0.0f ? -fold : fold;
+  float length = std::sqrt(result.x * result.x + result.y * result.y + result.z * result.z);
+  return length > 0.0f ? result / length : result;
+}
+
+namespace
+{
+
+int16_t QuantizeSnorm16(float value)
+{
+  value = Math::Max(-1.0f, Math::Min(value, 1.0f));
+  return static_cast<int16_t>(std::round(value * 32767.0f));
+}
+
+uint8_t QuantizeUnorm8(float value)
+{
+  value = Math::Max(0.0f, Math::Min(value, 1.0f));
+  return static_cast<uint8_t>(value * 255.0f + 0.5f);
+}
+
+}//namespace
+
+void PackMeshVertices(Mesh* mesh, uint32_t attributes)
+{
+  VertexFormat format = BuildVertexFormat(attributes | VertexAttributeBit(VertexAttribute::Position));
+  mesh->mVertexFormat = format;
+
+  // Decoded with position * scale + bias, which the renderer folds into the local to world
+  Vec3 halfExtents = (mesh->mAabbMax - mesh->mAabbMin) * 0.5f;
+  float scale = Math::Max(halfExtents.x, Math::Max(halfExtents.y, halfExtents.z));
+  mesh->mPositionScale = scale > 0.0f ? scale : 1.0f;
+  mesh->mPositionBias = (mesh->mAabbMin + mesh->mAabbMax) * 0.5f;
+  float inverseScale = 1.0f / mesh->mPositionScale;
+
+  mesh->mVertexData.Resize(mesh->mVertices.Size() * format.mStride);
+  byte* vertexData = mesh->mVertexData.Data();
+  for(const Vertex& vertex : mesh->mVertices)
+  {
+    if(format.Has(VertexAttribute::Position))
+    {
+      Vec3 position = (vertex.pos - mesh->mPositionBias) * inverseScale;
+      int16_t values[4] = {QuantizeSnorm16(position.x), QuantizeSnorm16(position.y), QuantizeSnorm16(position.z), 0};
+      memcpy(vertexData + format.mOffsets[static_cast<size_t>(VertexAttribute::Position)], values, sizeof(values));
+    }
+    if(format.Has(VertexAttribute::Normal))
+    {
+      Vec2 encoded = EncodeOctahedral(vertex.normal);
+      int16_t values[2] = {QuantizeSnorm16(encoded.x), QuantizeSnorm16(encoded.y)};
+      memcpy(vertexData + format.mOffsets[static_cast<size_t>(VertexAttribute::Normal)], values, sizeof(values));
+    }
+    if(format.Has(VertexAttribute::Color))
+    {
+      uint8_t values[4] = {QuantizeUnorm8(vertex.color.x), QuantizeUnorm8(vertex.color.y), QuantizeUnorm8(vertex.color.z), QuantizeUnorm8(vertex.color.w)};
+      memcpy(vertexData + format.mOffsets[static_cast<size_t>(VertexAttribute::Color)], values, sizeof(values));
+    }
+    if(format.Has(VertexAttribute::Uv))
+    {
+      uint16_t values[2] = {FloatToHalf(vertex.uv.x), FloatToHalf(vertex.uv.y)};
+      memcpy(vertexData + format.mOffsets[static_cast<size_t>(VertexAttribute::Uv)], values, sizeof(values));
+    }
+    if(format.Has(VertexAttribute::Aux0))
+      memcpy(vertexData + format.mOffsets[static_cast<size_t>(VertexAttribute::Aux0)], &vertex.aux0, sizeof(Vec4));
+    vertexData += format.mStride;
+  }
+}
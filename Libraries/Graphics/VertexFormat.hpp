@@ -0,0 +1,67 @@
+#pragma once
+
+#include "GraphicsStandard.hpp"
+#include "Vertex.hpp"
+
+typedef unsigned char byte;
+struct Mesh;
+
+//-------------------------------------------------------------------VertexAttribute
+/// Attributes a mesh can store. Shaders declare each one in their vertex definitions under its
+/// GetVertexAttributeName and the attribute's input location is looked up by that name.
+enum class VertexAttribute : uint32_t
+{
+  Position, Normal, Color, Uv, Aux0,
+  Count
+};
+constexpr size_t cVertexAttributeCount = static_cast<size_t>(VertexAttribute::Count);
+// Rows of the instance's 3x4 local to world, see InstanceData
+constexpr uint32_t cInstanceRowCount = 3;
+
+/// Name of the attribute's field in the shader's vertex definitions.
+const char* GetVertexAttributeName(VertexAttribute attribute);
+/// Name of a row of the instance's local to world in the shader's vertex definitions.
+const char* GetInstanceRowName(uint32_t row);
+
+inline uint32_t VertexAttributeBit(VertexAttribute attribute) { return 1u << static_cast<uint32_t>(attribute); }
+constexpr uint32_t cAllVertexAttributes = (1u << cVertexAttributeCount) - 1;
+
+//-------------------------------------------------------------------VertexAttributeFormat
+/// Every attribute has one fixed storage format, so which attributes a mesh has is all that varies.
+enum class VertexAttributeFormat : uint8_t
+{
+  None,
+  // Positions mapped to [-1, 1] with the mesh's scale and bias, the 4th component is padding
+  Snorm16x4,
+  // Unit vectors folded onto an octahedron, decoded in the vertex shader
+  OctahedralSnorm16x2,
+  Half2,
+  Unorm8x4,
+  Float4
+};
+VertexAttributeFormat GetVertexAttributeFormat(VertexAttribute attribute);
+size_t GetVertexAttributeFormatSize(VertexAttributeFormat format);
+
+//-------------------------------------------------------------------VertexFormat
+/// Interleaved layout of the attributes a mesh has. Missing attributes have no space in the vertex.
+struct VertexFormat
+{
+  bool Has(VertexAttribute attribute) const { return (mAttributes & VertexAttributeBit(attribute)) != 0; }
+  VertexAttributeFormat GetFormat(VertexAttribute attribute) const;
+
+  // Bit per attribute present, also identifies the layout
+  uint32_t mAttributes = 0;
+  uint32_t mOffsets[cVertexAttributeCount] = {};
+  uint32_t mStride = 0;
+};
+
+VertexFormat BuildVertexFormat(uint32_t attributes);
+
+/// Octahedral encoding of a unit vector into [-1, 1]^2.
+Vec2 EncodeOctahedral(const Vec3& normal);
+Vec3 DecodeOctahedral(const Vec2& encoded);
+
+/// Packs the mesh's vertices into the format. Positions are quantized against the mesh's bounds, so they
+/// have to be computed first. The scale is the same on every axis so normals can be transformed by the
+/// same matrix that decodes positions.
+void PackMeshVertices(Mesh* mesh, uint32_t attributes);
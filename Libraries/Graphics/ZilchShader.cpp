@@ -7,6 +7,7 @@
 #include "ZilchShaders/ZilchShadersStandard.hpp"
 #include "SimpleZilchShaderIRGenerator.hpp"
 #include "GraphicsBufferTypes.hpp"
+#include "VertexFormat.hpp"
 
 //-------------------------------------------------------------------ZilchSpirVBackend
 class ZilchSpirVBackend : public Zero::ZilchShaderIRBackend
@@ -161,16 +162,23 @@ Zero::ZilchShaderSpirVSettings* ZilchShaderManager::CreateZilchShaderSettings(Ze
   Zilch::BoundType* real4Type = ZilchTypeId(Zilch::Real4);
   Zilch::BoundType* intType = ZilchTypeId(Zilch::Integer);
   Zilch::BoundType* int4Type = ZilchTypeId(Zilch::Integer4);
-  Zilch::BoundType* real4x4Type = ZilchTypeId(Zilch::Real4x4);
 
   settings->AutoSetDefaultUniformBufferDescription();
 
   // Add some default vertex definitions (glsl attributes)
-  settings->mVertexDefinitions.AddField(real3Type, "LocalPosition");
-  settings->mVertexDefinitions.AddField(real3Type, "LocalNormal");
-  settings->mVertexDefinitions.AddField(real4Type, "Color");
-  settings->mVertexDefinitions.AddField(real2Type, "Uv");
-  settings->mVertexDefinitions.AddField(real4Type, "Aux0");
+  settings->mVertexDefinitions.AddField(real3Type, GetVertexAttributeName(VertexAttribute::Position));
+  settings->mVertexDefinitions.AddField(real2Type, GetVertexAttributeName(VertexAttribute::Normal));
+  settings->mVertexDefinitions.AddField(real4Type, GetVertexAttributeName(VertexAttribute::Color));
+  settings->mVertexDefinitions.AddField(real2Type, GetVertexAttributeName(VertexAttribute::Uv));
+  settings->mVertexDefinitions.AddField(real4Type, GetVertexAttributeName(VertexAttribute::Aux0));
+  // Per-instance transform rows read from a second vertex stream (see InstanceData)
+  for(uint32_t row = 0; row < cInstanceRowCount; ++row)
+    settings->mVertexDefinitions.AddField(real4Type, GetInstanceRowName(row));
+
+  // Inputs are given locations in the order their fields were added
+  mVertexInputLocations.Clear();
+  for(size_t i = 0; i < settings->mVertexDefinitions.mFields.Size(); ++i)
+    mVertexInputLocations[settings->mVertexDefinitions.mFields[i]->mZilchName] = static_cast<uint32_t>(i);
 
   // Set zilch fragment names for spirv built-ins
   settings->SetHardwareBuiltInName(spv::BuiltInPosition, nameSettings.mApiPerspectivePositionName);
@@ -231,6 +239,7 @@ void ZilchShaderManager::CreateZilchMaterialShader(ZilchMaterial* zilchMaterial)
   ZilchShader* zilchShader = new ZilchShader();
   zilchShader->mName = zilchMaterial->mMaterialName;
   zilchShader->mMaterial = zilchMaterial;
+  zilchShader->mVertexInputLocations = mVertexInputLocations;
   for(size_t i = 0; i < Zero::FragmentType::Size; ++i)
   {
     Zero::ZilchShaderIRCompositor::ShaderStageDescription& stageDesc = shaderDef->mResults[i];
@@ -86,6 +86,8 @@ public:
   Array<ZilchMaterialBindingDescriptor> mBindingDescriptors;
   ZilchMaterial* mMaterial = nullptr;
   String mName;
+  // Input location of each of the vertex definitions' fields, by field name
+  HashMap<String, uint32_t> mVertexInputLocations;
 };
 
 struct ZilchShaderInitData
@@ -131,4 +133,5 @@ private:
   ZilchFragmentFileManager* mFragmentFileManager = nullptr;
   ZilchMaterialManager* mMaterialManager = nullptr;
   Array<Zilch::BoundType*> mUniformDescriptors;
+  HashMap<String, uint32_t> mVertexInputLocations;
 };
@@ -5,6 +5,10 @@ target_sources(Utilities
     ${CMAKE_CURRENT_LIST_DIR}/File.hpp
     ${CMAKE_CURRENT_LIST_DIR}/JsonSerializers.cpp
     ${CMAKE_CURRENT_LIST_DIR}/JsonSerializers.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/MappedFile.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/MappedFile.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Precompiled.cpp
     ${CMAKE_CURRENT_LIST_DIR}/Precompiled.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/ThreadPool.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/ThreadPool.hpp
 )
@@ -0,0 +1,85 @@
+#include "Precompiled.hpp"
+
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+bool MappedFile::Open(const Zero::String& path)
+{
+  Close();
+
+  // The view keeps the file open, so the handles aren't needed once it's mapped
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if(file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER fileSize;
+  if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if(mapping == nullptr)
+    return false;
+
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if(data == nullptr)
+    return false;
+
+  mData = static_cast<const byte*>(data);
+  mSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+  int file = open(path.c_str(), O_RDONLY);
+  if(file < 0)
+    return false;
+
+  struct stat fileStat;
+  if(fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+  {
+    close(file);
+    return false;
+  }
+
+  void* data = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+  if(data == MAP_FAILED)
+    return false;
+
+  mData = static_cast<const byte*>(data);
+  mSize = static_cast<size_t>(fileStat.st_size);
+#endif
+  return true;
+}
+
+void MappedFile::Close()
+{
+  if(mData == nullptr)
+    return;
+
+#ifdef _WIN32
+  UnmapViewOfFile(mData);
+#else
+  munmap(const_cast<byte*>(mData), mSize);
+#endif
+  mData = nullptr;
+  mSize = 0;
+}
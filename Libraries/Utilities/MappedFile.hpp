@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Common/CommonStandard.hpp"
+
+typedef unsigned char byte;
+
+//-------------------------------------------------------------------MappedFile
+/// Read only view of a whole file mapped into memory. Pages are read in by the OS as they're touched
+/// so opening costs nothing however large the file is.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /// Returns false if the file doesn't exist, is empty, or can't be mapped.
+  bool Open(const Zero::String& path);
+  void Close();
+
+  bool IsOpen() const { return mData != nullptr; }
+  const byte* GetData() const { return mData; }
+  size_t GetSize() const { return mSize; }
+
+private:
+  const byte* mData = nullptr;
+  size_t mSize = 0;
+};
@@ -0,0 +1,114 @@
+#include "Precompiled.hpp"
+
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool()
+  : mNextJob(0), mCompletedJobs(0)
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+  Shutdown();
+}
+
+void ThreadPool::Initialize(size_t workerCount)
+{
+  Shutdown();
+
+  if(workerCount == 0)
+  {
+    size_t hardwareThreads = static_cast<size_t>(std::thread::hardware_concurrency());
+    workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+  }
+
+  mExiting = false;
+  mWorkers.reserve(workerCount);
+  for(size_t i = 0; i < workerCount; ++i)
+    mWorkers.emplace_back(&ThreadPool::WorkerLoop, this, i + 1);
+}
+
+void ThreadPool::Shutdown()
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mExiting = true;
+  }
+  mWorkCondition.notify_all();
+  for(std::thread& worker : mWorkers)
+    worker.join();
+  mWorkers.clear();
+}
+
+size_t ThreadPool::GetThreadCount() const
+{
+  return mWorkers.size() + 1;
+}
+
+void ThreadPool::ParallelFor(size_t jobCount, const JobFn& jobFn)
+{
+  // Not worth waking anyone up
+  if(mWorkers.empty() || jobCount <= 1)
+  {
+    for(size_t i = 0; i < jobCount; ++i)
+      jobFn(i, 0);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mJobFn = &jobFn;
+    mJobCount = jobCount;
+    mNextJob = 0;
+    mCompletedJobs = 0;
+    ++mGeneration;
+  }
+  mWorkCondition.notify_all();
+
+  RunJobs(0);
+
+  // Workers that picked up this generation still hold a pointer to jobFn so wait for them to leave as well
+  std::unique_lock<std::mutex> lock(mMutex);
+  mIdleCondition.wait(lock, [this]() { return mCompletedJobs == mJobCount && mActiveWorkers == 0; });
+  mJobFn = nullptr;
+  mJobCount = 0;
+}
+
+void ThreadPool::WorkerLoop(size_t threadIndex)
+{
+  size_t seenGeneration = 0;
+  for(;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mWorkCondition.wait(lock, [&]() { return mExiting || mGeneration != seenGeneration; });
+      if(mExiting)
+        return;
+      seenGeneration = mGeneration;
+      // Woke up after the work was already finished
+      if(mJobFn == nullptr)
+        continue;
+      ++mActiveWorkers;
+    }
+
+    RunJobs(threadIndex);
+
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      --mActiveWorkers;
+    }
+    mIdleCondition.notify_all();
+  }
+}
+
+void ThreadPool::RunJobs(size_t threadIndex)
+{
+  for(;;)
+  {
+    size_t jobIndex = mNextJob.fetch_add(1);
+    if(jobIndex >= mJobCount)
+      return;
+    (*mJobFn)(jobIndex, threadIndex);
+    ++mCompletedJobs;
+  }
+}
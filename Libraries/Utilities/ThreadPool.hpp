@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//-------------------------------------------------------------------ThreadPool
+/// A fixed set of worker threads that split up index ranges. The calling thread also
+/// executes work, so thread index 0 is always the caller and workers are 1 to N.
+class ThreadPool
+{
+public:
+  /// Called with the job index and the index of the thread executing it.
+  typedef std::function<void(size_t jobIndex, size_t threadIndex)> JobFn;
+
+  ThreadPool();
+  ~ThreadPool();
+
+  /// A worker count of zero uses one worker per hardware thread besides the caller.
+  void Initialize(size_t workerCount = 0);
+  void Shutdown();
+
+  /// Number of threads that can execute jobs, including the calling thread.
+  size_t GetThreadCount() const;
+
+  /// Runs jobFn for every index in [0, jobCount) and returns once all of them have finished.
+  void ParallelFor(size_t jobCount, const JobFn& jobFn);
+
+private:
+  void WorkerLoop(size_t threadIndex);
+  void RunJobs(size_t threadIndex);
+
+  std::vector<std::thread> mWorkers;
+  std::mutex mMutex;
+  std::condition_variable mWorkCondition;
+  std::condition_variable mIdleCondition;
+  bool mExiting = false;
+  size_t mGeneration = 0;
+  size_t mActiveWorkers = 0;
+
+  const JobFn* mJobFn = nullptr;
+  size_t mJobCount = 0;
+  std::atomic<size_t> mNextJob;
+  std::atomic<size_t> mCompletedJobs;
+};
@@ -5,15 +5,24 @@ target_sources(Vulkan
     ${CMAKE_CURRENT_LIST_DIR}/Precompiled.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanBufferCreation.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanCommandBuffer.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/VulkanDescriptors.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/VulkanDescriptors.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanDeviceQueries.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanExtensions.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanImages.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanInitialization.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanLogicalDeviceCreation.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/VulkanFrameAllocator.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/VulkanFrameAllocator.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/VulkanGpuCulling.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/VulkanGpuCulling.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanMaterials.cpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanMaterials.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/VulkanMemoryAllocator.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/VulkanMemoryAllocator.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanPhysicsDeviceSelection.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanPipeline.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/VulkanPipelineCache.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanRenderer.cpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanRenderer.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanRendering.cpp
@@ -25,6 +34,8 @@ target_sources(Vulkan
     ${CMAKE_CURRENT_LIST_DIR}/VulkanStructures.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanSwapChain.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanSyncronization.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/VulkanUploader.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/VulkanUploader.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanValidationLayers.hpp
     ${CMAKE_CURRENT_LIST_DIR}/VulkanStandard.hpp
 )
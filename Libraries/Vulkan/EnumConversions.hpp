@@ -1,13 +1,30 @@
 #pragma once
 
 #include "Graphics/Texture.hpp"
+#include "Graphics/RenderGraph.hpp"
 
 inline VkFormat GetImageFormat(TextureFormat format)
 {
   switch(format)
   {
+  case TextureFormat::RGBA8:
+    return VK_FORMAT_R8G8B8A8_UNORM;
   case TextureFormat::SRGB8A8:
     return VK_FORMAT_R8G8B8A8_SRGB;
+  case TextureFormat::BC1:
+    return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+  case TextureFormat::BC3:
+    return VK_FORMAT_BC3_UNORM_BLOCK;
+  case TextureFormat::BC5:
+    return VK_FORMAT_BC5_UNORM_BLOCK;
+  case TextureFormat::BC7:
+    return VK_FORMAT_BC7_UNORM_BLOCK;
+  case TextureFormat::SRGBBC1:
+    return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+  case TextureFormat::SRGBBC3:
+    return VK_FORMAT_BC3_SRGB_BLOCK;
+  case TextureFormat::SRGBBC7:
+    return VK_FORMAT_BC7_SRGB_BLOCK;
   case TextureFormat::RGBA32f:
     return VK_FORMAT_R32G32B32A32_SFLOAT;
   default:
@@ -71,3 +88,32 @@ inline VkDescriptorType ConvertDescriptorType(MaterialDescriptorType descriptorT
     return VkDescriptorType::VK_DESCRIPTOR_TYPE_MAX_ENUM;
   }
 }
+
+inline VkAttachmentLoadOp ConvertLoadOp(TargetLoadOp loadOp)
+{
+  switch(loadOp)
+  {
+  case TargetLoadOp::Load:
+    return VK_ATTACHMENT_LOAD_OP_LOAD;
+  case TargetLoadOp::Clear:
+    return VK_ATTACHMENT_LOAD_OP_CLEAR;
+  default:
+    return VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  }
+}
+
+/// Headless frames are copied out instead of presented so they end in a transfer layout.
+inline VkImageLayout ConvertTargetUsage(TargetUsage usage, bool headless)
+{
+  switch(usage)
+  {
+  case TargetUsage::ColorAttachment:
+    return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  case TargetUsage::ShaderRead:
+    return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  case TargetUsage::Present:
+    return headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  default:
+    return VK_IMAGE_LAYOUT_UNDEFINED;
+  }
+}
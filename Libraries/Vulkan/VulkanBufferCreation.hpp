@@ -3,6 +3,7 @@
 #include <vulkan/vulkan.h>
 #include "VulkanStatus.hpp"
 #include "VulkanPhysicsDeviceSelection.hpp"
+#include "VulkanMemoryAllocator.hpp"
 #include <stdexcept>
 
 struct VulkanBufferCreationData
@@ -12,6 +13,7 @@ struct VulkanBufferCreationData
   VkQueue mGraphicsQueue;
   //VkPipeline mGraphicsPipeline;
   VkCommandPool mCommandPool;
+  VulkanMemoryAllocator* mAllocator = nullptr;
 };
 
 inline VulkanStatus FindMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& outMemoryType)
@@ -38,7 +40,8 @@ inline uint32_t FindMemoryType(VulkanBufferCreationData& vulkanData, uint32_t ty
   return result;
 }
 
-inline void CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+/// Reports failure instead of throwing. Nothing is left to clean up when it fails.
+inline VulkanStatus TryCreateBuffer(VulkanMemoryAllocator& allocator, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VulkanMemoryAllocation& bufferAllocation)
 {
   VkBufferCreateInfo bufferInfo = {};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -47,45 +50,37 @@ inline void CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDev
   bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
   if(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
-    throw std::runtime_error("failed to create vertex buffer!");
-
-  VkMemoryRequirements memRequirements;
-  vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  FindMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties, allocInfo.memoryTypeIndex);
-
-  if(vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
+  {
+    buffer = VK_NULL_HANDLE;
+    return VulkanStatus("failed to create vertex buffer!");
+  }
 
-  vkBindBufferMemory(device, buffer, bufferMemory, 0);
+  VulkanStatus status = allocator.AllocateAndBind(buffer, properties, bufferAllocation);
+  if(!status)
+  {
+    vkDestroyBuffer(device, buffer, nullptr);
+    buffer = VK_NULL_HANDLE;
+  }
+  return status;
 }
 
-inline void CreateBuffer(VulkanBufferCreationData& vulkanData, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+inline void CreateBuffer(VulkanMemoryAllocator& allocator, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VulkanMemoryAllocation& bufferAllocation)
 {
-  VkBufferCreateInfo bufferInfo = {};
-  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  bufferInfo.size = size;
-  bufferInfo.usage = usage;
-  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-  if(vkCreateBuffer(vulkanData.mDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
-    throw std::runtime_error("failed to create vertex buffer!");
-
-  VkMemoryRequirements memRequirements;
-  vkGetBufferMemoryRequirements(vulkanData.mDevice, buffer, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = FindMemoryType(vulkanData, memRequirements.memoryTypeBits, properties);
+  VulkanStatus status = TryCreateBuffer(allocator, device, size, usage, properties, buffer, bufferAllocation);
+  if(!status)
+    throw std::runtime_error(status.mErrorMessage.c_str());
+}
 
-  if(vkAllocateMemory(vulkanData.mDevice, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
+inline void CreateBuffer(VulkanBufferCreationData& vulkanData, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VulkanMemoryAllocation& bufferAllocation)
+{
+  CreateBuffer(*vulkanData.mAllocator, vulkanData.mDevice, size, usage, properties, buffer, bufferAllocation);
+}
 
-  vkBindBufferMemory(vulkanData.mDevice, buffer, bufferMemory, 0);
+inline void DestroyBuffer(VulkanBufferCreationData& vulkanData, VkBuffer& buffer, VulkanMemoryAllocation& bufferAllocation)
+{
+  vkDestroyBuffer(vulkanData.mDevice, buffer, nullptr);
+  vulkanData.mAllocator->Free(bufferAllocation);
+  buffer = VK_NULL_HANDLE;
 }
 
 inline VkCommandBuffer BeginSingleTimeCommands(VkDevice device, VkCommandPool commandPool)
@@ -146,23 +141,20 @@ inline void CopyBuffer(VulkanBufferCreationData& vulkanData, VkBuffer srcBuffer,
   EndSingleTimeCommands(vulkanData, commandBuffer);
 }
 
-inline void CreateBuffer(VulkanBufferCreationData& vulkanData, VkBufferUsageFlags bufferUsage, VkBuffer& buffer, VkDeviceMemory& bufferMemory, const void* initialData, size_t dataSize)
+inline void CreateBuffer(VulkanBufferCreationData& vulkanData, VkBufferUsageFlags bufferUsage, VkBuffer& buffer, VulkanMemoryAllocation& bufferAllocation, const void* initialData, size_t dataSize)
 {
   VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  CreateBuffer(vulkanData, dataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+  VulkanMemoryAllocation stagingAllocation;
+  CreateBuffer(vulkanData, dataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingAllocation);
 
-  void* data;
-  vkMapMemory(vulkanData.mDevice, stagingBufferMemory, 0, dataSize, 0, &data);
-  memcpy(data, initialData, dataSize);
-  vkUnmapMemory(vulkanData.mDevice, stagingBufferMemory);
+  // Host visible memory is persistently mapped by the allocator
+  memcpy(stagingAllocation.mMappedData, initialData, dataSize);
 
-  CreateBuffer(vulkanData, dataSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | bufferUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+  CreateBuffer(vulkanData, dataSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | bufferUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferAllocation);
 
   CopyBuffer(vulkanData, stagingBuffer, buffer, dataSize);
 
-  vkDestroyBuffer(vulkanData.mDevice, stagingBuffer, nullptr);
-  vkFreeMemory(vulkanData.mDevice, stagingBufferMemory, nullptr);
+  DestroyBuffer(vulkanData, stagingBuffer, stagingAllocation);
 }
 
 inline size_t AlignUniformBufferOffset(PhysicalDeviceLimits& deviceLimits, size_t offset)
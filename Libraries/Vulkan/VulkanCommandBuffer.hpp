@@ -36,6 +36,11 @@ struct CommandBufferWriteInfo
   VkFramebuffer mSwapChainFramebuffer;
   VkDescriptorSet mDescriptorSet;
 
+  VkSubpassContents mSubpassContents = VK_SUBPASS_CONTENTS_INLINE;
+  // Only used by render passes that clear their attachments
+  VkClearColorValue mClearColor = {{0.0f, 0.0f, 0.0f, 1.0f}};
+  float mClearDepth = 1.0f;
+
   uint32_t mDrawCount = 0;
   uint32_t* mDynamicOffsets = nullptr;
   uint32_t* mDynamicOffsetsBase = nullptr;
@@ -55,6 +60,26 @@ inline VulkanStatus BeginCommandBuffer(VkCommandBuffer& commandBuffer)
   return result;
 }
 
+/// Begins a secondary command buffer that is executed inside the given render pass.
+inline VulkanStatus BeginSecondaryCommandBuffer(VkCommandBuffer& commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer)
+{
+  VkCommandBufferInheritanceInfo inheritanceInfo = {};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = renderPass;
+  inheritanceInfo.subpass = 0;
+  inheritanceInfo.framebuffer = framebuffer;
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  VulkanStatus result;
+  if(vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    result.MarkFailed("failed to begin recording secondary command buffer!");
+  return result;
+}
+
 inline VulkanStatus EndCommandBuffer(VkCommandBuffer& commandBuffer)
 {
   VulkanStatus result;
@@ -72,15 +97,32 @@ inline VulkanStatus BeginRenderPass(CommandBufferWriteInfo& writeInfo, VkCommand
   renderPassInfo.renderArea.offset = {0, 0};
   renderPassInfo.renderArea.extent = writeInfo.mSwapChainExtent;
   std::array<VkClearValue, 2> clearValues = {};
-  clearValues[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
-  clearValues[1].depthStencil = {1.0f, 0};
+  clearValues[0].color = writeInfo.mClearColor;
+  clearValues[1].depthStencil = {writeInfo.mClearDepth, 0};
   renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
   renderPassInfo.pClearValues = clearValues.data();
 
-  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, writeInfo.mSubpassContents);
   return VulkanStatus();
 }
 
+inline void SetViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent)
+{
+  VkViewport viewport = {};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = static_cast<float>(extent.width);
+  viewport.height = static_cast<float>(extent.height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor = {};
+  scissor.offset = {0, 0};
+  scissor.extent = extent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
 inline VulkanStatus EndRenderPass(CommandBufferWriteInfo& writeInfo, VkCommandBuffer& commandBuffer)
 {
   vkCmdEndRenderPass(commandBuffer);
@@ -92,6 +134,7 @@ inline VulkanStatus WriteCommandBuffer(CommandBufferWriteInfo& writeInfo, VkComm
   BeginCommandBuffer(commandBuffer);
 
   BeginRenderPass(writeInfo, commandBuffer);
+  SetViewportAndScissor(commandBuffer, writeInfo.mSwapChainExtent);
 
   vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, writeInfo.mGraphicsPipeline);
 
@@ -116,12 +159,12 @@ inline VulkanStatus WriteCommandBuffer(CommandBufferWriteInfo& writeInfo, VkComm
   return VulkanStatus();
 }
 
-inline VulkanStatus CreateCommandBuffer(VkDevice device, VkCommandPool commandPool, VkCommandBuffer* resultBuffers, uint32_t resultBuffersCount)
+inline VulkanStatus CreateCommandBuffer(VkDevice device, VkCommandPool commandPool, VkCommandBuffer* resultBuffers, uint32_t resultBuffersCount, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY)
 {
   VkCommandBufferAllocateInfo allocInfo = {};
   allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
   allocInfo.commandPool = commandPool;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.level = level;
   allocInfo.commandBufferCount = resultBuffersCount;
 
   VulkanStatus result;
@@ -0,0 +1,249 @@
+#include "Precompiled.hpp"
+
+#include "VulkanDescriptors.hpp"
+
+//-------------------------------------------------------------------VulkanDescriptorLayoutCache
+void VulkanDescriptorLayoutCache::Initialize(VkDevice device)
+{
+  Destroy();
+  mDevice = device;
+}
+
+void VulkanDescriptorLayoutCache::Destroy()
+{
+  for(Entry& entry : mEntries)
+  {
+    vkDestroyDescriptorUpdateTemplate(mDevice, entry.mLayout.mUpdateTemplate, nullptr);
+    vkDestroyDescriptorSetLayout(mDevice, entry.mLayout.mLayout, nullptr);
+  }
+  mEntries.Clear();
+  mEntryLookup.Clear();
+}
+
+VulkanStatus VulkanDescriptorLayoutCache::FindOrCreate(const Array<VkDescriptorSetLayoutBinding>& bindings, VulkanDescriptorLayout& outLayout)
+{
+  VulkanStatus result;
+  uint64_t hash = HashBindings(bindings);
+  if(const Entry* entry = FindEntry(hash, bindings))
+  {
+    outLayout = entry->mLayout;
+    return result;
+  }
+
+  VulkanDescriptorLayout layout;
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.Size());
+  layoutInfo.pBindings = bindings.Data();
+  if(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &layout.mLayout) != VK_SUCCESS)
+  {
+    result.MarkFailed("failed to create descriptor set layout!");
+    return result;
+  }
+
+  Array<VkDescriptorUpdateTemplateEntry> templateEntries;
+  templateEntries.Resize(bindings.Size());
+  for(size_t i = 0; i < bindings.Size(); ++i)
+  {
+    VkDescriptorUpdateTemplateEntry& templateEntry = templateEntries[i];
+    templateEntry.dstBinding = bindings[i].binding;
+    templateEntry.dstArrayElement = 0;
+    templateEntry.descriptorCount = 1;
+    templateEntry.descriptorType = bindings[i].descriptorType;
+    templateEntry.offset = i * sizeof(VulkanDescriptorInfo);
+    templateEntry.stride = sizeof(VulkanDescriptorInfo);
+  }
+
+  VkDescriptorUpdateTemplateCreateInfo templateInfo = {};
+  templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+  templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(templateEntries.Size());
+  templateInfo.pDescriptorUpdateEntries = templateEntries.Data();
+  templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+  templateInfo.descriptorSetLayout = layout.mLayout;
+  if(vkCreateDescriptorUpdateTemplate(mDevice, &templateInfo, nullptr, &layout.mUpdateTemplate) != VK_SUCCESS)
+  {
+    vkDestroyDescriptorSetLayout(mDevice, layout.mLayout, nullptr);
+    result.MarkFailed("failed to create descriptor update template!");
+    return result;
+  }
+
+  // On a hash collision the lookup keeps pointing at the first entry and FindEntry falls back to a search
+  if(mEntryLookup.FindPointer(hash) == nullptr)
+    mEntryLookup.Insert(hash, mEntries.Size());
+  Entry& entry = mEntries.PushBack();
+  entry.mBindings = bindings;
+  entry.mLayout = layout;
+  outLayout = layout;
+  return result;
+}
+
+size_t VulkanDescriptorLayoutCache::GetLayoutCount() const
+{
+  return mEntries.Size();
+}
+
+uint64_t VulkanDescriptorLayoutCache::HashBindings(const Array<VkDescriptorSetLayoutBinding>& bindings)
+{
+  // FNV-1a over the fields that make layouts different. Immutable samplers aren't used by materials.
+  uint64_t hash = 14695981039346656037ull;
+  auto hashValue = [&hash](uint32_t value)
+  {
+    hash = (hash ^ value) * 1099511628211ull;
+  };
+  for(const VkDescriptorSetLayoutBinding& binding : bindings)
+  {
+    hashValue(binding.binding);
+    hashValue(static_cast<uint32_t>(binding.descriptorType));
+    hashValue(binding.descriptorCount);
+    hashValue(binding.stageFlags);
+  }
+  return hash;
+}
+
+bool VulkanDescriptorLayoutCache::BindingsMatch(const Array<VkDescriptorSetLayoutBinding>& lhs, const Array<VkDescriptorSetLayoutBinding>& rhs)
+{
+  if(lhs.Size() != rhs.Size())
+    return false;
+  for(size_t i = 0; i < lhs.Size(); ++i)
+  {
+    if(lhs[i].binding != rhs[i].binding || lhs[i].descriptorType != rhs[i].descriptorType ||
+       lhs[i].descriptorCount != rhs[i].descriptorCount || lhs[i].stageFlags != rhs[i].stageFlags)
+      return false;
+  }
+  return true;
+}
+
+const VulkanDescriptorLayoutCache::Entry* VulkanDescriptorLayoutCache::FindEntry(uint64_t hash, const Array<VkDescriptorSetLayoutBinding>& bindings) const
+{
+  const size_t* entryIndex = mEntryLookup.FindPointer(hash);
+  if(entryIndex == nullptr)
+    return nullptr;
+  if(BindingsMatch(mEntries[*entryIndex].mBindings, bindings))
+    return &mEntries[*entryIndex];
+
+  for(const Entry& entry : mEntries)
+  {
+    if(BindingsMatch(entry.mBindings, bindings))
+      return &entry;
+  }
+  return nullptr;
+}
+
+//-------------------------------------------------------------------VulkanDescriptorAllocator
+void VulkanDescriptorAllocator::Initialize(VkDevice device, VkDescriptorPoolCreateFlags flags, uint32_t setsPerPool)
+{
+  Destroy();
+  mDevice = device;
+  mFlags = flags;
+  mSetsPerPool = setsPerPool;
+}
+
+void VulkanDescriptorAllocator::Destroy()
+{
+  for(VkDescriptorPool pool : mPools)
+    vkDestroyDescriptorPool(mDevice, pool, nullptr);
+  mPools.Clear();
+  mCurrentPool = 0;
+}
+
+void VulkanDescriptorAllocator::Reset()
+{
+  for(VkDescriptorPool pool : mPools)
+    vkResetDescriptorPool(mDevice, pool, 0);
+  mCurrentPool = 0;
+}
+
+VulkanStatus VulkanDescriptorAllocator::Allocate(const VkDescriptorSetLayout* layouts, uint32_t count, VkDescriptorSet* outSets, VkDescriptorPool* outPool)
+{
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorSetCount = count;
+  allocInfo.pSetLayouts = layouts;
+
+  VulkanStatus result;
+  for(;;)
+  {
+    bool createdPool = false;
+    if(mCurrentPool == mPools.Size())
+    {
+      createdPool = true;
+      VkDescriptorPool pool = CreatePool();
+      if(pool == VK_NULL_HANDLE)
+      {
+        result.MarkFailed("failed to create descriptor pool!");
+        return result;
+      }
+      mPools.PushBack(pool);
+    }
+
+    allocInfo.descriptorPool = mPools[mCurrentPool];
+    VkResult allocResult = vkAllocateDescriptorSets(mDevice, &allocInfo, outSets);
+    if(allocResult == VK_SUCCESS)
+    {
+      if(outPool != nullptr)
+        *outPool = allocInfo.descriptorPool;
+      return result;
+    }
+
+    // A full pool moves on to the next one in the chain, anything else is a real failure
+    if(allocResult != VK_ERROR_OUT_OF_POOL_MEMORY && allocResult != VK_ERROR_FRAGMENTED_POOL)
+    {
+      result.MarkFailed("failed to allocate descriptor sets!");
+      return result;
+    }
+    // A fresh pool that can't fit the request never will
+    if(createdPool)
+    {
+      result.MarkFailed("descriptor allocation is larger than a pool!");
+      return result;
+    }
+    ++mCurrentPool;
+  }
+}
+
+VulkanStatus VulkanDescriptorAllocator::Allocate(VkDescriptorSetLayout layout, VkDescriptorSet& outSet)
+{
+  return Allocate(&layout, 1, &outSet);
+}
+
+void VulkanDescriptorAllocator::Free(VkDescriptorPool pool, const VkDescriptorSet* sets, uint32_t count)
+{
+  ErrorIf(!(mFlags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT), "Descriptor sets can only be freed from pools created to allow it");
+  if(pool == VK_NULL_HANDLE || count == 0)
+    return;
+  vkFreeDescriptorSets(mDevice, pool, count, sets);
+
+  // Let the next allocation try the pool that just got space back before creating a new one
+  for(size_t i = 0; i < mCurrentPool; ++i)
+  {
+    if(mPools[i] == pool)
+    {
+      mCurrentPool = i;
+      break;
+    }
+  }
+}
+
+VkDescriptorPool VulkanDescriptorAllocator::CreatePool()
+{
+  // Rough mix of what materials and compute dispatches use per set
+  VkDescriptorPoolSize poolSizes[] =
+  {
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * mSetsPerPool},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2 * mSetsPerPool},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 * mSetsPerPool},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * mSetsPerPool},
+  };
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = mFlags;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(sizeof(poolSizes) / sizeof(poolSizes[0]));
+  poolInfo.pPoolSizes = poolSizes;
+  poolInfo.maxSets = mSetsPerPool;
+
+  VkDescriptorPool pool = VK_NULL_HANDLE;
+  if(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+    return VK_NULL_HANDLE;
+  return pool;
+}
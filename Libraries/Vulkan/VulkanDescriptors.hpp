@@ -0,0 +1,80 @@
+#pragma once
+
+#include "VulkanStandard.hpp"
+#include "VulkanStatus.hpp"
+
+/// One descriptor's worth of update data. Update templates read an array of these, one per binding.
+union VulkanDescriptorInfo
+{
+  VkDescriptorBufferInfo mBuffer;
+  VkDescriptorImageInfo mImage;
+};
+
+/// A shared set layout and the template that fills out a set of it from an array of
+/// VulkanDescriptorInfo given in the same order as the bindings the layout was made from.
+struct VulkanDescriptorLayout
+{
+  VkDescriptorSetLayout mLayout = VK_NULL_HANDLE;
+  VkDescriptorUpdateTemplate mUpdateTemplate = VK_NULL_HANDLE;
+};
+
+//-------------------------------------------------------------------VulkanDescriptorLayoutCache
+/// Shaders with identical bindings share one layout. Layouts are owned by the cache and live
+/// until it's destroyed, so users never destroy what they get back.
+class VulkanDescriptorLayoutCache
+{
+public:
+  void Initialize(VkDevice device);
+  void Destroy();
+
+  VulkanStatus FindOrCreate(const Array<VkDescriptorSetLayoutBinding>& bindings, VulkanDescriptorLayout& outLayout);
+  size_t GetLayoutCount() const;
+
+private:
+  struct Entry
+  {
+    Array<VkDescriptorSetLayoutBinding> mBindings;
+    VulkanDescriptorLayout mLayout;
+  };
+
+  static uint64_t HashBindings(const Array<VkDescriptorSetLayoutBinding>& bindings);
+  static bool BindingsMatch(const Array<VkDescriptorSetLayoutBinding>& lhs, const Array<VkDescriptorSetLayoutBinding>& rhs);
+  const Entry* FindEntry(uint64_t hash, const Array<VkDescriptorSetLayoutBinding>& bindings) const;
+
+  VkDevice mDevice = VK_NULL_HANDLE;
+  Array<Entry> mEntries;
+  // Hash of the bindings to the index of the first entry created with that hash
+  HashMap<uint64_t, size_t> mEntryLookup;
+};
+
+//-------------------------------------------------------------------VulkanDescriptorAllocator
+/// Hands out descriptor sets from a chain of pools, creating another pool when the current ones
+/// run out so allocation never fails for lack of space. Pools are sized for a mix of descriptor
+/// types rather than one exact layout. Created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+/// for sets that are freed one at a time, or without it for sets that are all dropped by Reset.
+/// Lives in arrays of frames so it's not cleaned up on destruction, Destroy has to be called.
+class VulkanDescriptorAllocator
+{
+public:
+  void Initialize(VkDevice device, VkDescriptorPoolCreateFlags flags = 0, uint32_t setsPerPool = cDefaultSetsPerPool);
+  void Destroy();
+
+  /// Returns every set to the pools. Only call once the GPU has finished with them.
+  void Reset();
+  /// All sets come from the same pool, which is returned so they can be freed later.
+  VulkanStatus Allocate(const VkDescriptorSetLayout* layouts, uint32_t count, VkDescriptorSet* outSets, VkDescriptorPool* outPool = nullptr);
+  VulkanStatus Allocate(VkDescriptorSetLayout layout, VkDescriptorSet& outSet);
+  void Free(VkDescriptorPool pool, const VkDescriptorSet* sets, uint32_t count);
+
+  static constexpr uint32_t cDefaultSetsPerPool = 256;
+
+private:
+  VkDescriptorPool CreatePool();
+
+  VkDevice mDevice = VK_NULL_HANDLE;
+  VkDescriptorPoolCreateFlags mFlags = 0;
+  uint32_t mSetsPerPool = cDefaultSetsPerPool;
+
+  Array<VkDescriptorPool> mPools;
+  size_t mCurrentPool = 0;
+};
@@ -7,6 +7,8 @@ struct QueueFamilyIndices
 {
   std::optional<uint32_t> graphicsFamily;
   std::optional<uint32_t> presentFamily;
+  // A family that only does transfers (typically backed by a dma engine). Falls back to the graphics family.
+  std::optional<uint32_t> transferFamily;
 
   bool isComplete()
   {
@@ -37,8 +39,12 @@ inline QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKH
     if(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
       indices.graphicsFamily = i;
 
+    // Without a surface nothing is ever presented, so the graphics queue stands in for the present queue
     VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+    if(surface != VK_NULL_HANDLE)
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+    else
+      presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
     if(presentSupport)
       indices.presentFamily = i;
 
@@ -48,6 +54,24 @@ inline QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKH
     i++;
   }
 
+  // Prefer a family without graphics or compute so uploads run in parallel with rendering
+  uint32_t bestTransferScore = 0;
+  for(uint32_t familyIndex = 0; familyIndex < queueFamilyCount; ++familyIndex)
+  {
+    VkQueueFlags flags = queueFamilies[familyIndex].queueFlags;
+    if(!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT))
+      continue;
+
+    uint32_t score = (flags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+    if(score > bestTransferScore)
+    {
+      bestTransferScore = score;
+      indices.transferFamily = familyIndex;
+    }
+  }
+  if(!indices.transferFamily.has_value())
+    indices.transferFamily = indices.graphicsFamily;
+
   return indices;
 }
 
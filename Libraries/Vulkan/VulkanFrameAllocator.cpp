@@ -0,0 +1,69 @@
+#include "Precompiled.hpp"
+
+#include "VulkanFrameAllocator.hpp"
+#include "VulkanBufferCreation.hpp"
+
+void VulkanFrameAllocator::Initialize(VulkanMemoryAllocator* allocator, VkDevice device, VkBufferUsageFlags usage, VkDeviceSize blockSize)
+{
+  Destroy();
+  mAllocator = allocator;
+  mDevice = device;
+  mUsage = usage;
+  mBlockSize = blockSize;
+  CreateBlock(mBlockSize);
+}
+
+void VulkanFrameAllocator::Destroy()
+{
+  for(Block& block : mBlocks)
+  {
+    vkDestroyBuffer(mDevice, block.mBuffer, nullptr);
+    mAllocator->Free(block.mAllocation);
+  }
+  mBlocks.Clear();
+  mCurrentBlock = 0;
+}
+
+void VulkanFrameAllocator::Reset()
+{
+  for(Block& block : mBlocks)
+    block.mUsedSize = 0;
+  mCurrentBlock = 0;
+}
+
+VulkanFrameAllocation VulkanFrameAllocator::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+  VulkanFrameAllocation result;
+  if(mBlocks.Empty() || size == 0)
+    return result;
+
+  for(;;)
+  {
+    Block& block = mBlocks[mCurrentBlock];
+    VkDeviceSize offset = (block.mUsedSize + alignment - 1) / alignment * alignment;
+    if(offset + size <= block.mSize)
+    {
+      block.mUsedSize = offset + size;
+      result.mBuffer = block.mBuffer;
+      result.mOffset = offset;
+      result.mData = static_cast<byte*>(block.mAllocation.mMappedData) + offset;
+      return result;
+    }
+
+    // Move on to the next block in the chain, making one big enough if there isn't one
+    if(mCurrentBlock + 1 == mBlocks.Size() && !CreateBlock(Math::Max(mBlockSize, size)))
+      return result;
+    ++mCurrentBlock;
+  }
+}
+
+bool VulkanFrameAllocator::CreateBlock(VkDeviceSize size)
+{
+  Block block;
+  block.mSize = size;
+  VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  if(!TryCreateBuffer(*mAllocator, mDevice, size, mUsage, properties, block.mBuffer, block.mAllocation))
+    return false;
+  mBlocks.PushBack(block);
+  return true;
+}
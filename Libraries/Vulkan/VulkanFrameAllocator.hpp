@@ -0,0 +1,52 @@
+#pragma once
+
+#include "VulkanStandard.hpp"
+#include "VulkanMemoryAllocator.hpp"
+
+/// Where a frame allocation lives. The data pointer is already mapped so filling it out is just a write.
+struct VulkanFrameAllocation
+{
+  VkBuffer mBuffer = VK_NULL_HANDLE;
+  VkDeviceSize mOffset = 0;
+  void* mData = nullptr;
+};
+
+//-------------------------------------------------------------------VulkanFrameAllocator
+/// Linear allocator for data that only lives for one frame. Blocks are host visible, mapped once
+/// when they're created and kept between frames. When a block fills up the next one in the chain
+/// is used, creating it if needed, so a frame that needs more memory than usual only fails when
+/// device memory runs out. A failed allocation is returned empty.
+/// Lives in arrays of frames so it's not cleaned up on destruction, Destroy has to be called.
+class VulkanFrameAllocator
+{
+public:
+  void Initialize(VulkanMemoryAllocator* allocator, VkDevice device, VkBufferUsageFlags usage, VkDeviceSize blockSize = cDefaultBlockSize);
+  void Destroy();
+
+  /// Makes all blocks available again. Only call once the GPU has finished with the frame.
+  void Reset();
+  /// Returns an empty allocation (null buffer and data) if a new block was needed and couldn't be created.
+  VulkanFrameAllocation Allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+  static constexpr VkDeviceSize cDefaultBlockSize = 256 * 1024;
+
+private:
+  struct Block
+  {
+    VkBuffer mBuffer = VK_NULL_HANDLE;
+    VulkanMemoryAllocation mAllocation;
+    VkDeviceSize mSize = 0;
+    VkDeviceSize mUsedSize = 0;
+  };
+
+  /// Returns false and adds nothing if the block's buffer couldn't be created.
+  bool CreateBlock(VkDeviceSize size);
+
+  VulkanMemoryAllocator* mAllocator = nullptr;
+  VkDevice mDevice = VK_NULL_HANDLE;
+  VkBufferUsageFlags mUsage = 0;
+  VkDeviceSize mBlockSize = cDefaultBlockSize;
+
+  Array<Block> mBlocks;
+  size_t mCurrentBlock = 0;
+};
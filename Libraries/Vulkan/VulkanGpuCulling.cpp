@@ -0,0 +1,192 @@
+#include "Precompiled.hpp"
+
+#include "VulkanGpuCulling.hpp"
+
+#include "Graphics/FrustumCulling.hpp"
+#include "Utilities/File.hpp"
+#include "VulkanDescriptors.hpp"
+#include "VulkanPipeline.hpp"
+
+namespace
+{
+
+constexpr uint32_t cCullingBindingCount = 3;
+
+VulkanStatus CreateCullingPipeline(VkDevice device, VkPipelineCache pipelineCache, const String& shaderPath, VkDescriptorSetLayout descriptorSetLayout, uint32_t pushConstantSize, VkPipelineLayout& outPipelineLayout, VkPipeline& outPipeline)
+{
+  VulkanStatus result;
+  Array<char> shaderCode;
+  readFile(shaderPath, shaderCode);
+  VkShaderModule shaderModule = CreateShaderModule(device, shaderCode);
+
+  VkPushConstantRange pushConstantRange = {};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = pushConstantSize;
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  if(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &outPipelineLayout) != VK_SUCCESS)
+    result.MarkFailed("failed to create culling pipeline layout!");
+
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = outPipelineLayout;
+  if(result && vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &outPipeline) != VK_SUCCESS)
+  {
+    outPipeline = VK_NULL_HANDLE;
+    result.MarkFailed("failed to create culling pipeline!");
+  }
+
+  vkDestroyShaderModule(device, shaderModule, nullptr);
+  return result;
+}
+
+VulkanStatus AllocateCullingDescriptorSet(const VulkanGpuCulling& culling, VkDevice device, VulkanDescriptorAllocator* descriptorAllocator, const VkDescriptorBufferInfo* bufferInfos[cCullingBindingCount], VkDescriptorSet& outDescriptorSet)
+{
+  VulkanStatus result;
+  if(!descriptorAllocator->Allocate(culling.mDescriptorSetLayout, outDescriptorSet))
+  {
+    result.MarkFailed("failed to allocate culling descriptor set!");
+    return result;
+  }
+
+  VkWriteDescriptorSet descriptorWrites[cCullingBindingCount] = {};
+  for(uint32_t i = 0; i < cCullingBindingCount; ++i)
+  {
+    descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[i].dstSet = outDescriptorSet;
+    descriptorWrites[i].dstBinding = i;
+    descriptorWrites[i].descriptorCount = 1;
+    descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrites[i].pBufferInfo = bufferInfos[i];
+  }
+  vkUpdateDescriptorSets(device, cCullingBindingCount, descriptorWrites, 0, nullptr);
+  return result;
+}
+
+void RecordCullingBarrier(VkCommandBuffer commandBuffer)
+{
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+  VkPipelineStageFlags dstStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+}//namespace
+
+VulkanStatus CreateGpuCulling(GpuCullingCreationInfo& creationInfo, VulkanGpuCulling& outCulling)
+{
+  VulkanStatus result;
+  // The shaders are only built when glslangValidator was found, without them everything culls on the cpu
+  if(!creationInfo.mShaderPath.Empty() && !Zero::FileExists(creationInfo.mShaderPath))
+    Warn("Culling shader '%s' wasn't found, gpu culling is disabled", creationInfo.mShaderPath.c_str());
+  if(!creationInfo.mClusterShaderPath.Empty() && !Zero::FileExists(creationInfo.mClusterShaderPath))
+    Warn("Cluster culling shader '%s' wasn't found, gpu cluster culling is disabled", creationInfo.mClusterShaderPath.c_str());
+  bool hasInstanceShader = creationInfo.mSupportsDrawIndirectFirstInstance && !creationInfo.mShaderPath.Empty() && Zero::FileExists(creationInfo.mShaderPath);
+  bool hasClusterShader = creationInfo.mSupportsDrawIndirectFirstInstance && creationInfo.mSupportsMultiDrawIndirect &&
+    !creationInfo.mClusterShaderPath.Empty() && Zero::FileExists(creationInfo.mClusterShaderPath);
+  if(!hasInstanceShader && !hasClusterShader)
+    return result;
+
+  VkDevice device = creationInfo.mDevice;
+  VkDescriptorSetLayoutBinding bindings[cCullingBindingCount] = {};
+  for(uint32_t i = 0; i < cCullingBindingCount; ++i)
+  {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = cCullingBindingCount;
+  layoutInfo.pBindings = bindings;
+  if(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &outCulling.mDescriptorSetLayout) != VK_SUCCESS)
+    result.MarkFailed("failed to create culling descriptor set layout!");
+
+  if(result && hasInstanceShader)
+    result = CreateCullingPipeline(device, creationInfo.mPipelineCache, creationInfo.mShaderPath, outCulling.mDescriptorSetLayout, sizeof(CullConstants), outCulling.mPipelineLayout, outCulling.mPipeline);
+  if(result && hasClusterShader)
+    result = CreateCullingPipeline(device, creationInfo.mPipelineCache, creationInfo.mClusterShaderPath, outCulling.mDescriptorSetLayout, sizeof(ClusterCullConstants), outCulling.mClusterPipelineLayout, outCulling.mClusterPipeline);
+
+  if(!result)
+    DestroyGpuCulling(device, outCulling);
+  return result;
+}
+
+void DestroyGpuCulling(VkDevice device, VulkanGpuCulling& culling)
+{
+  vkDestroyPipeline(device, culling.mClusterPipeline, nullptr);
+  vkDestroyPipelineLayout(device, culling.mClusterPipelineLayout, nullptr);
+  vkDestroyPipeline(device, culling.mPipeline, nullptr);
+  vkDestroyPipelineLayout(device, culling.mPipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, culling.mDescriptorSetLayout, nullptr);
+  culling.mClusterPipeline = VK_NULL_HANDLE;
+  culling.mClusterPipelineLayout = VK_NULL_HANDLE;
+  culling.mPipeline = VK_NULL_HANDLE;
+  culling.mPipelineLayout = VK_NULL_HANDLE;
+  culling.mDescriptorSetLayout = VK_NULL_HANDLE;
+}
+
+VulkanStatus RecordGpuCulling(const VulkanGpuCulling& culling, const GpuCullingDispatchInfo& dispatchInfo, VkCommandBuffer commandBuffer)
+{
+  const VkDescriptorBufferInfo* bufferInfos[cCullingBindingCount] = {&dispatchInfo.mObjects, &dispatchInfo.mDrawCommands, &dispatchInfo.mInstances};
+  VkDescriptorSet descriptorSet;
+  VulkanStatus result = AllocateCullingDescriptorSet(culling, dispatchInfo.mDevice, dispatchInfo.mDescriptorAllocator, bufferInfos, descriptorSet);
+  if(!result)
+    return result;
+
+  CullConstants constants;
+  for(size_t i = 0; i < Frustum::cPlaneCount; ++i)
+    constants.mPlanes[i] = dispatchInfo.mFrustum->mPlanes[i];
+  constants.mObjectCount = dispatchInfo.mObjectCount;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling.mPipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling.mPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+  vkCmdPushConstants(commandBuffer, culling.mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+  uint32_t groupCount = (dispatchInfo.mObjectCount + VulkanGpuCulling::cGroupSize - 1) / VulkanGpuCulling::cGroupSize;
+  vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+
+  RecordCullingBarrier(commandBuffer);
+  return result;
+}
+
+VulkanStatus RecordGpuClusterCulling(const VulkanGpuCulling& culling, const GpuClusterCullingDispatchInfo& dispatchInfo, VkCommandBuffer commandBuffer)
+{
+  const VkDescriptorBufferInfo* bufferInfos[cCullingBindingCount] = {&dispatchInfo.mClusters, &dispatchInfo.mInstances, &dispatchInfo.mDrawCommands};
+  VkDescriptorSet descriptorSet;
+  VulkanStatus result = AllocateCullingDescriptorSet(culling, dispatchInfo.mDevice, dispatchInfo.mDescriptorAllocator, bufferInfos, descriptorSet);
+  if(!result)
+    return result;
+
+  ClusterCullConstants constants;
+  for(size_t i = 0; i < Frustum::cPlaneCount; ++i)
+    constants.mPlanes[i] = dispatchInfo.mFrustum->mPlanes[i];
+  const Vec3& cameraPosition = dispatchInfo.mCameraPosition;
+  constants.mCameraPosition = Vec4(cameraPosition.x, cameraPosition.y, cameraPosition.z, 1.0f);
+  constants.mClusterCount = dispatchInfo.mClusterCount;
+  constants.mInstanceCount = dispatchInfo.mInstanceCount;
+  constants.mFirstInstance = dispatchInfo.mFirstInstance;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling.mClusterPipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling.mClusterPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+  vkCmdPushConstants(commandBuffer, culling.mClusterPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+  uint32_t pairCount = dispatchInfo.mClusterCount * dispatchInfo.mInstanceCount;
+  uint32_t groupCount = (pairCount + VulkanGpuCulling::cGroupSize - 1) / VulkanGpuCulling::cGroupSize;
+  vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+
+  RecordCullingBarrier(commandBuffer);
+  return result;
+}
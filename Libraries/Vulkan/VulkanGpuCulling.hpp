@@ -0,0 +1,119 @@
+#pragma once
+
+#include "VulkanStandard.hpp"
+#include "VulkanStatus.hpp"
+#include "Graphics/GraphicsBufferTypes.hpp"
+
+struct Frustum;
+class VulkanDescriptorAllocator;
+
+/// One object to cull. Must match CullObject in CullInstances.comp.
+struct CullObject
+{
+  InstanceData mInstanceData;
+  // xyz is the world center, w the radius
+  Vec4 mBoundingSphere;
+  uint32_t mBatchIndex;
+  uint32_t mPadding[3];
+};
+
+/// Push constants of CullInstances.comp
+struct CullConstants
+{
+  Vec4 mPlanes[6];
+  uint32_t mObjectCount;
+};
+
+/// One cluster of a mesh's first lod, in the mesh's packed position space. Must match MeshCluster in CullClusters.comp.
+struct GpuMeshCluster
+{
+  // xyz is the center, w the radius
+  Vec4 mBoundingSphere;
+  // xyz is the cone axis, w the cutoff. See IsClusterBackFacing.
+  Vec4 mCone;
+  uint32_t mIndexOffset;
+  uint32_t mIndexCount;
+  uint32_t mPadding[2];
+};
+
+/// Push constants of CullClusters.comp
+struct ClusterCullConstants
+{
+  Vec4 mPlanes[6];
+  // xyz is the world space camera position
+  Vec4 mCameraPosition;
+  uint32_t mClusterCount;
+  uint32_t mInstanceCount;
+  uint32_t mFirstInstance;
+};
+
+struct GpuCullingCreationInfo
+{
+  VkDevice mDevice;
+  VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
+  // Compiled SPIR-V of CullInstances.comp
+  String mShaderPath;
+  // Compiled SPIR-V of CullClusters.comp. Its draws need multi draw indirect so it's skipped without it.
+  String mClusterShaderPath;
+  // The culled draws start at each batch's first instance, neither pipeline is created without it
+  bool mSupportsDrawIndirectFirstInstance = false;
+  bool mSupportsMultiDrawIndirect = false;
+};
+
+/// Compute pipelines that frustum cull a render group's instances and fill out its indirect draws, and
+/// that cull the clusters of large meshes into one indirect draw per instance and cluster.
+struct VulkanGpuCulling
+{
+  bool IsAvailable() const { return mPipeline != VK_NULL_HANDLE; }
+  bool IsClusterCullingAvailable() const { return mClusterPipeline != VK_NULL_HANDLE; }
+
+  // Both shaders bind three storage buffers
+  VkDescriptorSetLayout mDescriptorSetLayout = VK_NULL_HANDLE;
+  VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
+  VkPipeline mPipeline = VK_NULL_HANDLE;
+  VkPipelineLayout mClusterPipelineLayout = VK_NULL_HANDLE;
+  VkPipeline mClusterPipeline = VK_NULL_HANDLE;
+
+  static constexpr uint32_t cGroupSize = 64;
+};
+
+/// Leaves either culling unavailable if its shader doesn't exist or the device lacks the indirect draw
+/// features it needs, callers fall back to culling on the cpu.
+VulkanStatus CreateGpuCulling(GpuCullingCreationInfo& creationInfo, VulkanGpuCulling& outCulling);
+void DestroyGpuCulling(VkDevice device, VulkanGpuCulling& culling);
+
+struct GpuCullingDispatchInfo
+{
+  VkDevice mDevice;
+  // The frame's allocator, the set only has to live until the frame is recorded again
+  VulkanDescriptorAllocator* mDescriptorAllocator;
+  const Frustum* mFrustum;
+  uint32_t mObjectCount;
+  VkDescriptorBufferInfo mObjects;
+  VkDescriptorBufferInfo mDrawCommands;
+  VkDescriptorBufferInfo mInstances;
+};
+
+/// Records the culling dispatch and the barrier that makes its results visible to indirect draws
+/// and vertex input. Has to be recorded outside of a render pass.
+VulkanStatus RecordGpuCulling(const VulkanGpuCulling& culling, const GpuCullingDispatchInfo& dispatchInfo, VkCommandBuffer commandBuffer);
+
+struct GpuClusterCullingDispatchInfo
+{
+  VkDevice mDevice;
+  VulkanDescriptorAllocator* mDescriptorAllocator;
+  const Frustum* mFrustum;
+  Vec3 mCameraPosition;
+  uint32_t mClusterCount;
+  // Range of the batch in the instance stream, the instances have to be written already
+  uint32_t mFirstInstance;
+  uint32_t mInstanceCount;
+  VkDescriptorBufferInfo mClusters;
+  VkDescriptorBufferInfo mInstances;
+  // One command per instance and cluster, instance major
+  VkDescriptorBufferInfo mDrawCommands;
+};
+
+/// Records the dispatch that culls every cluster of every instance of one batch and the barrier before
+/// its indirect draws. Has to be recorded outside of a render pass.
+VulkanStatus RecordGpuClusterCulling(const VulkanGpuCulling& culling, const GpuClusterCullingDispatchInfo& dispatchInfo, VkCommandBuffer commandBuffer);
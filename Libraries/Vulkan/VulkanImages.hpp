@@ -3,11 +3,12 @@
 #include "VulkanStatus.hpp"
 #include "VulkanBufferCreation.hpp"
 #include "VulkanStructures.hpp"
+#include "VulkanUploader.hpp"
 
 struct ImageViewMemorySet
 {
   VkImage mImage;
-  VkDeviceMemory mImageMemory;
+  VulkanMemoryAllocation mImageAllocation;
   VkImageView mImageView;
 };
 
@@ -45,19 +46,19 @@ struct ImageViewCreationInfo
   uint32_t mBaseMipLevel = 0;
 };
 
-__declspec(noinline) inline void Cleanup(VkDevice device, VulkanImage& image)
+__declspec(noinline) inline void Cleanup(VkDevice device, VulkanMemoryAllocator& allocator, VulkanImage& image)
 {
   vkDestroyImageView(device, image.mImageView, nullptr);
-  vkFreeMemory(device, image.mImageMemory, nullptr);
   vkDestroyImage(device, image.mImage, nullptr);
+  allocator.Free(image.mImageAllocation);
   vkDestroySampler(device, image.mSampler, nullptr);
 }
 
-inline void Cleanup(VkDevice device, ImageViewMemorySet& set)
+inline void Cleanup(VkDevice device, VulkanMemoryAllocator& allocator, ImageViewMemorySet& set)
 {
   vkDestroyImageView(device, set.mImageView, nullptr);
-  vkFreeMemory(device, set.mImageMemory, nullptr);
   vkDestroyImage(device, set.mImage, nullptr);
+  allocator.Free(set.mImageAllocation);
 }
 
 inline VulkanStatus CreateImage(ImageCreationInfo& info, VkImage& outImage)
@@ -86,23 +87,17 @@ inline VulkanStatus CreateImage(ImageCreationInfo& info, VkImage& outImage)
 
 struct ImageMemoryCreationInfo
 {
-  VkDevice mDevice;
-  VkPhysicalDevice mPhysicalDevice;
+  VulkanMemoryAllocator* mAllocator = nullptr;
   VkImage mImage;
   VkMemoryPropertyFlags mProperties;
+  // Must match the tiling the image was created with
+  VkImageTiling mTiling = VK_IMAGE_TILING_OPTIMAL;
 };
 
-inline VulkanStatus CreateImageMemory(ImageMemoryCreationInfo& info, VkDeviceMemory& outImageMemory)
+/// Allocates the image's memory and binds it to the image.
+inline VulkanStatus CreateImageMemory(ImageMemoryCreationInfo& info, VulkanMemoryAllocation& outImageAllocation)
 {
-  VkMemoryRequirements memRequirements;
-  vkGetImageMemoryRequirements(info.mDevice, info.mImage, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  FindMemoryType(info.mPhysicalDevice, memRequirements.memoryTypeBits, info.mProperties, allocInfo.memoryTypeIndex);
-
-  if(vkAllocateMemory(info.mDevice, &allocInfo, nullptr, &outImageMemory) != VK_SUCCESS)
+  if(!info.mAllocator->AllocateAndBind(info.mImage, info.mTiling, info.mProperties, outImageAllocation))
     return VulkanStatus("failed to allocate image memory!");
   return VulkanStatus();
 }
@@ -222,10 +217,8 @@ inline bool HasStencilComponent(VkFormat format)
   return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
-inline VulkanStatus TransitionImageLayout(ImageLayoutTransitionInfo& info)
+inline VulkanStatus RecordTransitionImageLayout(VkCommandBuffer commandBuffer, ImageLayoutTransitionInfo& info)
 {
-  VkCommandBuffer commandBuffer = BeginSingleTimeCommands(info.mDevice, info.mCommandPool);
-
   VkImageMemoryBarrier barrier = {};
   barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
   barrier.oldLayout = info.mOldLayout;
@@ -264,9 +257,15 @@ inline VulkanStatus TransitionImageLayout(ImageLayoutTransitionInfo& info)
     0, nullptr,
     1, &barrier
   );
+  return VulkanStatus();
+}
 
+inline VulkanStatus TransitionImageLayout(ImageLayoutTransitionInfo& info)
+{
+  VkCommandBuffer commandBuffer = BeginSingleTimeCommands(info.mDevice, info.mCommandPool);
+  VulkanStatus result = RecordTransitionImageLayout(commandBuffer, info);
   EndSingleTimeCommands(info.mDevice, info.mGraphicsQueue, info.mCommandPool, commandBuffer);
-  return VulkanStatus();
+  return result;
 }
 
 struct ImageCopyInfo
@@ -275,22 +274,22 @@ struct ImageCopyInfo
   VkQueue mGraphicsQueue = VK_NULL_HANDLE;
   VkCommandPool mCommandPool = VK_NULL_HANDLE;
   VkBuffer mBuffer;
+  VkDeviceSize mBufferOffset = 0;
   uint32_t mWidth;
   uint32_t mHeight;
+  uint32_t mMipLevel = 0;
   VkImage mImage;
 };
 
-inline void CopyBufferToImage(ImageCopyInfo info)
+inline void RecordCopyBufferToImage(VkCommandBuffer commandBuffer, ImageCopyInfo& info)
 {
-  VkCommandBuffer commandBuffer = BeginSingleTimeCommands(info.mDevice, info.mCommandPool);
-
   VkBufferImageCopy region = {};
-  region.bufferOffset = 0;
+  region.bufferOffset = info.mBufferOffset;
   region.bufferRowLength = 0;
   region.bufferImageHeight = 0;
 
   region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.mipLevel = info.mMipLevel;
   region.imageSubresource.baseArrayLayer = 0;
   region.imageSubresource.layerCount = 1;
 
@@ -308,7 +307,12 @@ inline void CopyBufferToImage(ImageCopyInfo info)
     1,
     &region
   );
+}
 
+inline void CopyBufferToImage(ImageCopyInfo info)
+{
+  VkCommandBuffer commandBuffer = BeginSingleTimeCommands(info.mDevice, info.mCommandPool);
+  RecordCopyBufferToImage(commandBuffer, info);
   EndSingleTimeCommands(info.mDevice, info.mGraphicsQueue, info.mCommandPool, commandBuffer);
 }
 
@@ -325,7 +329,7 @@ struct MipmapGenerationInfo
   uint32_t mMipLevels;
 };
 
-inline VulkanStatus GenerateMipmaps(MipmapGenerationInfo info)
+inline VulkanStatus RecordGenerateMipmaps(VkCommandBuffer commandBuffer, MipmapGenerationInfo& info)
 {
   // Check if image format supports linear blitting
   VkFormatProperties formatProperties;
@@ -334,8 +338,6 @@ inline VulkanStatus GenerateMipmaps(MipmapGenerationInfo info)
   if(!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
     return VulkanStatus("texture image format does not support linear blitting!");
 
-  VkCommandBuffer commandBuffer = BeginSingleTimeCommands(info.mDevice, info.mCommandPool);
-
   VkImageMemoryBarrier barrier = {};
   barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
   barrier.image = info.mImage;
@@ -411,9 +413,15 @@ inline VulkanStatus GenerateMipmaps(MipmapGenerationInfo info)
     0, nullptr,
     0, nullptr,
     1, &barrier);
+  return VulkanStatus();
+}
 
+inline VulkanStatus GenerateMipmaps(MipmapGenerationInfo info)
+{
+  VkCommandBuffer commandBuffer = BeginSingleTimeCommands(info.mDevice, info.mCommandPool);
+  VulkanStatus result = RecordGenerateMipmaps(commandBuffer, info);
   EndSingleTimeCommands(info.mDevice, info.mGraphicsQueue, info.mCommandPool, commandBuffer);
-  return VulkanStatus();
+  return result;
 }
 
 struct TextureImageCreationInfo
@@ -423,32 +431,26 @@ struct TextureImageCreationInfo
   VkQueue mGraphicsQueue = VK_NULL_HANDLE;
   VkPipeline mGraphicsPipeline = VK_NULL_HANDLE;
   VkCommandPool mCommandPool = VK_NULL_HANDLE;
+  VulkanMemoryAllocator* mAllocator = nullptr;
+  // The copy, layout transitions, and mip generation are recorded into the uploader's current batch
+  VulkanUploader* mUploader = nullptr;
   VkFormat mFormat;
   const void* mPixels = nullptr;
   uint32_t mPixelsSize = 0;
   uint32_t mWidth;
   uint32_t mHeight;
   uint32_t mMipLevels;
+  // Where each mip level starts in mPixels. Empty if only the top level is given and the rest have to be generated.
+  Array<VkDeviceSize> mMipOffsets;
 };
 
 inline VulkanStatus CreateTextureImage(TextureImageCreationInfo& info, ImageViewMemorySet& imageSet)
 {
-  VkDeviceSize imageSize = info.mPixelsSize;
   uint32_t mipLevels = info.mMipLevels;
 
   if(info.mPixels == nullptr)
     return VulkanStatus("failed to load texture image!");
 
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  VulkanBufferCreationData vulkanData{info.mPhysicalDevice, info.mDevice, info.mGraphicsQueue, info.mCommandPool};
-  CreateBuffer(vulkanData, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-  void* data;
-  vkMapMemory(info.mDevice, stagingBufferMemory, 0, imageSize, 0, &data);
-  memcpy(data, info.mPixels, static_cast<size_t>(info.mPixelsSize));
-  vkUnmapMemory(info.mDevice, stagingBufferMemory);
-
   VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL;
   VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
   VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
@@ -465,55 +467,71 @@ inline VulkanStatus CreateTextureImage(TextureImageCreationInfo& info, ImageView
     CreateImage(imageInfo, imageSet.mImage);
 
     ImageMemoryCreationInfo memoryInfo;
+    memoryInfo.mAllocator = info.mAllocator;
     memoryInfo.mImage = imageSet.mImage;
-    memoryInfo.mDevice = info.mDevice;
-    memoryInfo.mPhysicalDevice = info.mPhysicalDevice;
     memoryInfo.mProperties = properties;
-    CreateImageMemory(memoryInfo, imageSet.mImageMemory);
-
-    vkBindImageMemory(info.mDevice, imageSet.mImage, imageSet.mImageMemory, 0);
+    memoryInfo.mTiling = tiling;
+    CreateImageMemory(memoryInfo, imageSet.mImageAllocation);
   }
 
+  VulkanUploader& uploader = *info.mUploader;
+  VulkanStagingRange stagingRange = uploader.Stage(info.mPixels, info.mPixelsSize);
+  VkCommandBuffer commandBuffer = uploader.GetCommandBuffer();
   {
     ImageLayoutTransitionInfo transitionInfo;
-    transitionInfo.mDevice = info.mDevice;
-    transitionInfo.mGraphicsQueue = info.mGraphicsQueue;
-    transitionInfo.mCommandPool = info.mCommandPool;
     transitionInfo.mFormat = info.mFormat;
     transitionInfo.mImage = imageSet.mImage;
     transitionInfo.mOldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     transitionInfo.mNewLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
     transitionInfo.mMipLevels = mipLevels;
-    TransitionImageLayout(transitionInfo);
+    RecordTransitionImageLayout(commandBuffer, transitionInfo);
+  }
+  // Textures loaded from disk come with every level so they're copied as is, blits are only a fallback
+  if(!info.mMipOffsets.Empty())
+  {
+    for(uint32_t level = 0; level < info.mMipOffsets.Size(); ++level)
+    {
+      ImageCopyInfo copyInfo;
+      copyInfo.mBuffer = stagingRange.mBuffer;
+      copyInfo.mBufferOffset = stagingRange.mOffset + info.mMipOffsets[level];
+      copyInfo.mWidth = Math::Max(info.mWidth >> level, 1u);
+      copyInfo.mHeight = Math::Max(info.mHeight >> level, 1u);
+      copyInfo.mMipLevel = level;
+      copyInfo.mImage = imageSet.mImage;
+      RecordCopyBufferToImage(commandBuffer, copyInfo);
+    }
+    uploader.TransferImageOwnership(imageSet.mImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    ImageLayoutTransitionInfo transitionInfo;
+    transitionInfo.mFormat = info.mFormat;
+    transitionInfo.mImage = imageSet.mImage;
+    transitionInfo.mOldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    transitionInfo.mNewLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    transitionInfo.mMipLevels = mipLevels;
+    return RecordTransitionImageLayout(uploader.GetGraphicsCommandBuffer(), transitionInfo);
   }
+
   {
     ImageCopyInfo copyInfo;
-    copyInfo.mDevice = info.mDevice;
-    copyInfo.mGraphicsQueue = info.mGraphicsQueue;
-    copyInfo.mCommandPool = info.mCommandPool;
-    copyInfo.mBuffer = stagingBuffer;
+    copyInfo.mBuffer = stagingRange.mBuffer;
+    copyInfo.mBufferOffset = stagingRange.mOffset;
     copyInfo.mWidth = info.mWidth;
     copyInfo.mHeight = info.mHeight;
     copyInfo.mImage = imageSet.mImage;
-    CopyBufferToImage(copyInfo);
+    RecordCopyBufferToImage(commandBuffer, copyInfo);
   }
+  // Blits need the graphics queue so hand the image over before generating mips
+  uploader.TransferImageOwnership(imageSet.mImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
   //transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
-  
-  vkDestroyBuffer(info.mDevice, stagingBuffer, nullptr);
-  vkFreeMemory(info.mDevice, stagingBufferMemory, nullptr);
-
   {
     MipmapGenerationInfo mipGenerationInfo;
     mipGenerationInfo.mPhysicalDevice = info.mPhysicalDevice;
-    mipGenerationInfo.mDevice = info.mDevice;
-    mipGenerationInfo.mGraphicsQueue = info.mGraphicsQueue;
-    mipGenerationInfo.mCommandPool = info.mCommandPool;
     mipGenerationInfo.mImage = imageSet.mImage;
     mipGenerationInfo.mWidth = info.mWidth;
     mipGenerationInfo.mHeight = info.mHeight;
     mipGenerationInfo.mFormat = info.mFormat;
     mipGenerationInfo.mMipLevels = mipLevels;
-    GenerateMipmaps(mipGenerationInfo);
+    RecordGenerateMipmaps(uploader.GetGraphicsCommandBuffer(), mipGenerationInfo);
   }
   return VulkanStatus();
 }
@@ -522,11 +540,11 @@ inline VulkanStatus CreateTextureImage(TextureImageCreationInfo& info, VulkanIma
 {
   ImageViewMemorySet set;
   set.mImage = vulkanImage.mImage;
-  set.mImageMemory = vulkanImage.mImageMemory;
+  set.mImageAllocation = vulkanImage.mImageAllocation;
   set.mImageView = vulkanImage.mImageView;
   VulkanStatus result = CreateTextureImage(info, set);
   vulkanImage.mImage = set.mImage;
-  vulkanImage.mImageMemory = set.mImageMemory;
+  vulkanImage.mImageAllocation = set.mImageAllocation;
   vulkanImage.mImageView = set.mImageView;
   return result;
 }
@@ -5,7 +5,9 @@
 #include <vector>
 
 #include "Utilities/File.hpp"
+#include "Utilities/ThreadPool.hpp"
 #include "Graphics/Vertex.hpp"
+#include "Graphics/RenderGraph.hpp"
 
 #include "VulkanValidationLayers.hpp"
 #include "VulkanPhysicsDeviceSelection.hpp"
@@ -14,10 +16,16 @@
 #include "VulkanStructures.hpp"
 #include "VulkanRenderPass.hpp"
 #include "VulkanPipeline.hpp"
+#include "VulkanPipelineCache.hpp"
 #include "VulkanStatus.hpp"
 #include "VulkanSyncronization.hpp"
 #include "VulkanRendererInit.hpp"
 #include "VulkanSwapChain.hpp"
+#include "VulkanUploader.hpp"
+#include "VulkanGpuCulling.hpp"
+
+struct Mesh;
+struct Texture;
 
 struct ConstantSwapChainInfo
 {
@@ -26,18 +34,49 @@ struct ConstantSwapChainInfo
 
 struct VulkanRuntimeData
 {
-  const Array<const char*> mDeviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  Array<const char*> mDeviceExtensions;
 
   static constexpr size_t mMaxFramesInFlight = 2;
   VkInstance mInstance = VK_NULL_HANDLE;
   VkDebugUtilsMessengerEXT mDebugMessenger = VK_NULL_HANDLE;
   SurfaceCreationDelegate mSurfaceCreationCallback;
-  VkSurfaceKHR mSurface;
+  VkSurfaceKHR mSurface = VK_NULL_HANDLE;
+  bool mHeadless = false;
   VkPhysicalDevice mPhysicalDevice = VK_NULL_HANDLE;
   PhysicalDeviceLimits mDeviceLimits;
   VkDevice mDevice = VK_NULL_HANDLE;
+  VulkanMemoryAllocator mAllocator;
+  VulkanUploader mUploader;
+  // Shared by every pipeline creation and persisted between runs
+  VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
+  String mPipelineCachePath;
+  VulkanGpuCulling mGpuCulling;
+  String mGpuCullingShaderPath;
+  String mClusterCullingShaderPath;
+  // Set layouts shared by every shader with the same bindings
+  VulkanDescriptorLayoutCache mDescriptorLayoutCache;
+  // Long lived sets such as the materials'. Sets are freed individually.
+  VulkanDescriptorAllocator mDescriptorAllocator;
+  // Texture residency changes applied once their uploads finish
+  Array<VulkanTextureResidencySwap> mPendingTextureSwaps;
+  // Resources uploaded by the open upload batch, dropped again if its submit fails
+  Array<const Mesh*> mBatchedMeshes;
+  Array<const Texture*> mBatchedTextures;
+  Array<const Texture*> mBatchedResidencyChanges;
+  bool mBatchedDefaultAttributeBuffer = false;
+  uint32_t mPendingTextureSwapFrames = 0;
+  // Images swapped out during a frame, destroyed once that frame's fence signals again
+  Array<VulkanImage> mRetiredImages[mMaxFramesInFlight];
+  // Replacements of canceled residency changes whose upload may still be running, retired with the next frame
+  Array<VulkanImage> mCanceledTextureSwaps;
+  // Every mesh vertex format seen so far, keyed by VertexFormat::mAttributes. Shaders get a pipeline for each.
+  HashMap<uint32_t, VertexFormat> mVertexFormats;
+  // Zeroes read by attributes a mesh doesn't have, see VulkanVertex::cDefaultAttributeBinding
+  VkBuffer mDefaultAttributeBuffer = VK_NULL_HANDLE;
+  VulkanMemoryAllocation mDefaultAttributeBufferAllocation;
   VkCommandPool mCommandPool;
   SyncObjects mSyncObjects;
+  ThreadPool mThreadPool;
 
   
   VulkanImage mDepthImage;
@@ -48,6 +87,8 @@ struct VulkanRuntimeData
 
   ConstantSwapChainInfo mSwapChainInfo;
   SwapChainData mSwapChain;
+  // Backing images for mSwapChain when running headless
+  Array<ImageViewMemorySet> mOffscreenImages;
 
   
   Array<VulkanRenderFrame> mRenderFrames;
@@ -57,7 +98,17 @@ struct VulkanRuntimeData
   VkQueue mGraphicsQueue;
   
   VkQueue mPresentQueue;
-  VkRenderPass mRenderPass;
+  // Same as mGraphicsQueue when the device has no dedicated transfer family
+  VkQueue mTransferQueue;
+  // Shared by every frame and pipeline. Survives resizes as long as the swap chain format doesn't change.
+  VkRenderPass mRenderPass = VK_NULL_HANDLE;
+  // Copies of mRenderPass with the load ops and layouts a render graph pass needs, keyed by GetRenderPassKey
+  HashMap<uint32_t, VkRenderPass> mRenderPassVariants;
+  RenderGraph mRenderGraph;
+  VkFormat mRenderPassFormat = VK_FORMAT_UNDEFINED;
+  uint32_t mLastFrameCount = 0;
+  // Set when the swap chain was recreated with a different image count or format
+  bool mSwapChainLayoutChanged = false;
   VkPipelineLayout mPipelineLayout;
   VkPipeline mGraphicsPipeline;
   
@@ -70,23 +121,19 @@ struct VulkanRuntimeData
   uint32_t mCurrentImageIndex = 0;
 
   bool mFramebufferResized = false;
-  VkBuffer mVertexBuffer;
-  VkDeviceMemory mVertexBufferMemory;
-
-  VkBuffer mIndexBuffer;
-  VkDeviceMemory mIndexBufferMemory;
-
   VulkanUniformBufferManager mBufferManager;
 };
 
-inline Array<const char*> GetRequiredExtensions()
+inline Array<const char*> GetRequiredExtensions(bool headless)
 {
-  uint32_t glfwExtensionCount = 0;
-  const char** glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
   Array<const char*> extensions;
-  extensions.Assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  if(!headless)
+  {
+    uint32_t glfwExtensionCount = 0;
+    const char** glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.Assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if(enableValidationLayers)
     extensions.PushBack(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -94,7 +141,7 @@ inline Array<const char*> GetRequiredExtensions()
   return extensions;
 }
 
-inline VulkanStatus CreateInstance(VkInstance& instance)
+inline VulkanStatus CreateInstance(VkInstance& instance, bool headless)
 {
   if(enableValidationLayers && !CheckValidationLayerSupport())
     return VulkanStatus("validation layers requested, but not available!");
@@ -121,7 +168,7 @@ inline VulkanStatus CreateInstance(VkInstance& instance)
     createInfo.enabledLayerCount = 0;
     createInfo.pNext = nullptr;
   }
-  auto extensions = GetRequiredExtensions();
+  auto extensions = GetRequiredExtensions(headless);
   createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.Size());
   createInfo.ppEnabledExtensionNames = extensions.Data();
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -137,7 +184,7 @@ inline VulkanStatus CreateInstance(VkInstance& instance)
 
 inline void CreateInstance(VulkanRuntimeData& runtimeData)
 {
-  VulkanStatus status = CreateInstance(runtimeData.mInstance);
+  VulkanStatus status = CreateInstance(runtimeData.mInstance, runtimeData.mHeadless);
 }
 
 inline void CreateSurface(VkInstance instance, SurfaceCreationDelegate callback, VkSurfaceKHR& outSurface)
@@ -153,8 +200,9 @@ inline bool IsDeviceSuitable(VkPhysicalDevice physicalDevice, DeviceSuitabilityD
 
   bool extensionsSupported = CheckDeviceExtensionSupport(physicalDevice, runtimeData->mDeviceExtensions);
 
-  bool swapChainAdequate = false;
-  if(extensionsSupported)
+  // Headless rendering never presents so there's no swap chain to validate
+  bool swapChainAdequate = runtimeData->mHeadless;
+  if(extensionsSupported && !runtimeData->mHeadless)
   {
     SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(physicalDevice, data->mSurface);
     swapChainAdequate = !swapChainSupport.formats.Empty() && !swapChainSupport.presentModes.Empty();
@@ -187,12 +235,16 @@ inline void CreateLogicalDevice(VulkanRuntimeData& runtimeData)
   creationData.mPhysicalDevice = runtimeData.mPhysicalDevice;
   creationData.mSurface = runtimeData.mSurface;
   creationData.mDeviceExtensions = runtimeData.mDeviceExtensions;
+  creationData.mEnableTextureCompressionBC = runtimeData.mDeviceLimits.mSupportsTextureCompressionBC;
+  creationData.mEnableDrawIndirectFirstInstance = runtimeData.mDeviceLimits.mSupportsDrawIndirectFirstInstance;
+  creationData.mEnableMultiDrawIndirect = runtimeData.mDeviceLimits.mSupportsMultiDrawIndirect;
 
   CreateLogicalDevice(creationData, resultData);
 
   runtimeData.mDevice = resultData.mDevice;
   runtimeData.mGraphicsQueue = resultData.mGraphicsQueue;
   runtimeData.mPresentQueue = resultData.mPresentQueue;
+  runtimeData.mTransferQueue = resultData.mTransferQueue;
 }
 
 inline void CreateRenderPass(VulkanRuntimeData& runtimeData)
@@ -219,8 +271,15 @@ inline void CreateGraphicsPipeline(VulkanRuntimeData& runtimeData)
   graphicsPipelineData.mVertexShaderCode = vertexShaderCode;
   graphicsPipelineData.mRenderPass = runtimeData.mRenderPass;
   graphicsPipelineData.mViewportOffset = Vec2((float)runtimeData.mSwapChain.mExtent.width, (float)runtimeData.mSwapChain.mExtent.height);
-  graphicsPipelineData.mVertexAttributeDescriptions = VulkanVertex::getAttributeDescriptions();
-  graphicsPipelineData.mVertexBindingDescriptions = VulkanVertex::getBindingDescription();
+  VertexFormat vertexFormat = BuildVertexFormat(cAllVertexAttributes);
+  // These shaders declare the attributes in order, followed by the instance rows
+  HashMap<String, uint32_t> inputLocations;
+  for(uint32_t i = 0; i < cVertexAttributeCount; ++i)
+    inputLocations[GetVertexAttributeName(static_cast<VertexAttribute>(i))] = i;
+  for(uint32_t i = 0; i < cInstanceRowCount; ++i)
+    inputLocations[GetInstanceRowName(i)] = static_cast<uint32_t>(cVertexAttributeCount) + i;
+  graphicsPipelineData.mVertexAttributeDescriptions = VulkanVertex::getAttributeDescriptions(vertexFormat, inputLocations);
+  graphicsPipelineData.mVertexBindingDescriptions = VulkanVertex::getBindingDescription(vertexFormat);
   CreateGraphicsPipeline(graphicsPipelineData);
 
   runtimeData.mGraphicsPipeline = graphicsPipelineData.mGraphicsPipeline;
@@ -245,12 +304,41 @@ inline VulkanStatus CreateCommandPool(VkPhysicalDevice physicalDevice, VkDevice
 
 inline void InitializeVulkan(VulkanRuntimeData& runtimeData)
 {
-  CreateInstance(runtimeData.mInstance);
+  runtimeData.mDeviceExtensions.Clear();
+  if(!runtimeData.mHeadless)
+    runtimeData.mDeviceExtensions.PushBack(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+  CreateInstance(runtimeData);
   SetupDebugMessenger(runtimeData.mInstance, runtimeData.mDebugMessenger);
-  CreateSurface(runtimeData.mInstance, runtimeData.mSurfaceCreationCallback, runtimeData.mSurface);
+  if(!runtimeData.mHeadless)
+    CreateSurface(runtimeData.mInstance, runtimeData.mSurfaceCreationCallback, runtimeData.mSurface);
   SelectPhysicalDevice(runtimeData);
   CreateLogicalDevice(runtimeData);
+  runtimeData.mAllocator.Initialize(runtimeData.mPhysicalDevice, runtimeData.mDevice);
+  runtimeData.mDescriptorLayoutCache.Initialize(runtimeData.mDevice);
+  runtimeData.mDescriptorAllocator.Initialize(runtimeData.mDevice, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
   CreateCommandPool(runtimeData.mPhysicalDevice, runtimeData.mDevice, runtimeData.mSurface, runtimeData.mCommandPool);
+  QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(runtimeData.mPhysicalDevice, runtimeData.mSurface);
+  VulkanUploaderQueues uploaderQueues;
+  uploaderQueues.mGraphicsQueue = runtimeData.mGraphicsQueue;
+  uploaderQueues.mGraphicsFamily = queueFamilyIndices.graphicsFamily.value();
+  uploaderQueues.mTransferQueue = runtimeData.mTransferQueue;
+  uploaderQueues.mTransferFamily = queueFamilyIndices.transferFamily.value();
+  VulkanStatus uploaderStatus = runtimeData.mUploader.Initialize(runtimeData.mDevice, uploaderQueues, runtimeData.mAllocator);
+  ErrorIf(!uploaderStatus, "failed to create the resource uploader!");
+  PipelineCacheCreationInfo pipelineCacheInfo;
+  pipelineCacheInfo.mPhysicalDevice = runtimeData.mPhysicalDevice;
+  pipelineCacheInfo.mDevice = runtimeData.mDevice;
+  pipelineCacheInfo.mFilePath = runtimeData.mPipelineCachePath;
+  CreatePipelineCache(pipelineCacheInfo, runtimeData.mPipelineCache);
+  GpuCullingCreationInfo gpuCullingInfo;
+  gpuCullingInfo.mDevice = runtimeData.mDevice;
+  gpuCullingInfo.mPipelineCache = runtimeData.mPipelineCache;
+  gpuCullingInfo.mShaderPath = runtimeData.mGpuCullingShaderPath;
+  gpuCullingInfo.mClusterShaderPath = runtimeData.mClusterCullingShaderPath;
+  gpuCullingInfo.mSupportsDrawIndirectFirstInstance = runtimeData.mDeviceLimits.mSupportsDrawIndirectFirstInstance;
+  gpuCullingInfo.mSupportsMultiDrawIndirect = runtimeData.mDeviceLimits.mSupportsMultiDrawIndirect;
+  CreateGpuCulling(gpuCullingInfo, runtimeData.mGpuCulling);
   CreateSyncObjects(runtimeData.mDevice, VulkanRuntimeData::mMaxFramesInFlight, runtimeData.mSyncObjects);
   //CreateSwapChain(runtimeData);
   //CreateImageViews(runtimeData);
@@ -9,6 +9,9 @@ struct LogicalDeviceCreationData
   VkPhysicalDevice mPhysicalDevice;
   VkSurfaceKHR mSurface;
   Array<const char*> mDeviceExtensions;
+  bool mEnableTextureCompressionBC = false;
+  bool mEnableDrawIndirectFirstInstance = false;
+  bool mEnableMultiDrawIndirect = false;
 };
 
 struct LogicalDeviceResultData
@@ -16,6 +19,7 @@ struct LogicalDeviceResultData
   VkDevice mDevice;
   VkQueue mGraphicsQueue;
   VkQueue mPresentQueue;
+  VkQueue mTransferQueue;
 };
 
 inline void CreateLogicalDevice(LogicalDeviceCreationData& creationData, LogicalDeviceResultData& resultData)
@@ -23,7 +27,7 @@ inline void CreateLogicalDevice(LogicalDeviceCreationData& creationData, Logical
   QueueFamilyIndices indices = FindQueueFamilies(creationData.mPhysicalDevice, creationData.mSurface);
 
   Array<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value()};
 
   float queuePriority = 1.0f;
   for(uint32_t queueFamily : uniqueQueueFamilies)
@@ -43,6 +47,9 @@ inline void CreateLogicalDevice(LogicalDeviceCreationData& creationData, Logical
 
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  deviceFeatures.textureCompressionBC = creationData.mEnableTextureCompressionBC ? VK_TRUE : VK_FALSE;
+  deviceFeatures.multiDrawIndirect = creationData.mEnableMultiDrawIndirect ? VK_TRUE : VK_FALSE;
+  deviceFeatures.drawIndirectFirstInstance = creationData.mEnableDrawIndirectFirstInstance ? VK_TRUE : VK_FALSE;
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -68,4 +75,5 @@ inline void CreateLogicalDevice(LogicalDeviceCreationData& creationData, Logical
 
   vkGetDeviceQueue(resultData.mDevice, indices.graphicsFamily.value(), 0, &resultData.mGraphicsQueue);
   vkGetDeviceQueue(resultData.mDevice, indices.presentFamily.value(), 0, &resultData.mPresentQueue);
+  vkGetDeviceQueue(resultData.mDevice, indices.transferFamily.value(), 0, &resultData.mTransferQueue);
 }
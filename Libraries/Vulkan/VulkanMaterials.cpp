@@ -60,7 +60,7 @@ VkBuffer FindBuffer(RendererData& rendererData, ShaderMaterialBindingId::Enum bu
   return buffer->mBuffer;
 }
 
-void CreateMaterialDescriptorSetLayouts(RendererData& rendererData, const ZilchShader& zilchShader, VulkanShaderMaterial& vulkanShaderMaterial)
+VulkanStatus CreateMaterialDescriptorSetLayouts(RendererData& rendererData, const ZilchShader& zilchShader, VulkanShaderMaterial& vulkanShaderMaterial)
 {
   Array<VkDescriptorSetLayoutBinding> layoutBindings;
   layoutBindings.Resize(zilchShader.mBindingDescriptors.Size());
@@ -87,75 +87,28 @@ void CreateMaterialDescriptorSetLayouts(RendererData& rendererData, const ZilchS
       descriptorSetLayoutBinding.stageFlags |= VK_SHADER_STAGE_FRAGMENT_BIT;
   }
   
-  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layoutInfo.bindingCount = static_cast<uint32_t>(layoutBindings.Size());
-  layoutInfo.pBindings = layoutBindings.Data();
-  
-  VulkanStatus result;
-  if(vkCreateDescriptorSetLayout(rendererData.mRuntimeData->mDevice, &layoutInfo, nullptr, &vulkanShaderMaterial.mDescriptorSetLayout) != VK_SUCCESS)
-    result.MarkFailed("failed to create descriptor set layout!");
-}
-
-void CreateMaterialDescriptorPool(RendererData& rendererData, const ZilchShader& zilchShader, VulkanShaderMaterial& vulkanShaderMaterial)
-{
-  VulkanRuntimeData* runtimeData = rendererData.mRuntimeData;
-  uint32_t frameCount = runtimeData->mSwapChain.GetCount();
-
-  std::array<uint32_t, VK_DESCRIPTOR_TYPE_RANGE_SIZE> poolCounts = {};
-
-  size_t index = 0;
-  for(const ZilchMaterialBindingDescriptor& bindingDescriptor : zilchShader.mBindingDescriptors)
-  {
-    if(bindingDescriptor.mDescriptorType == MaterialDescriptorType::Uniform)
-      poolCounts[VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER] += frameCount;
-    if(bindingDescriptor.mDescriptorType == MaterialDescriptorType::SampledImage)
-      poolCounts[VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER] += frameCount;
-    if(bindingDescriptor.mDescriptorType == MaterialDescriptorType::UniformDynamic)
-      poolCounts[VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC] += frameCount;
-  }
-
-  Array<VkDescriptorPoolSize> poolSizes;
-  poolSizes.Reserve(poolCounts.size());
-  for(uint32_t i = VK_DESCRIPTOR_TYPE_BEGIN_RANGE; i <= VK_DESCRIPTOR_TYPE_END_RANGE; ++i)
-  {
-    if(poolCounts[i] != 0)
-    {
-      VkDescriptorPoolSize poolSize;
-      poolSize.type = static_cast<VkDescriptorType>(i);
-      poolSize.descriptorCount = poolCounts[i];
-      poolSizes.PushBack(poolSize);
-    }
-  }
-
-  VkDescriptorPoolCreateInfo poolInfo = {};
-  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.Size());
-  poolInfo.pPoolSizes = poolSizes.Data();
-  poolInfo.maxSets = frameCount;
-
-  VulkanStatus status;
-  if(vkCreateDescriptorPool(runtimeData->mDevice, &poolInfo, nullptr, &vulkanShaderMaterial.mDescriptorPool) != VK_SUCCESS)
-    status.MarkFailed("failed to create descriptor pool!");
+  // Shaders with the same bindings share one layout and update template
+  VulkanDescriptorLayout descriptorLayout;
+  VulkanStatus status = rendererData.mRuntimeData->mDescriptorLayoutCache.FindOrCreate(layoutBindings, descriptorLayout);
+  if(!status)
+    return status;
+  vulkanShaderMaterial.mDescriptorSetLayout = descriptorLayout.mLayout;
+  vulkanShaderMaterial.mUpdateTemplate = descriptorLayout.mUpdateTemplate;
+  return status;
 }
 
-void CreateMaterialDescriptorSets(RendererData& rendererData, VulkanShaderMaterial& vulkanShaderMaterial)
+VulkanStatus CreateMaterialDescriptorSets(RendererData& rendererData, VulkanShaderMaterial& vulkanShaderMaterial)
 {
   VulkanRuntimeData* runtimeData = rendererData.mRuntimeData;
   uint32_t frameCount = runtimeData->mSwapChain.GetCount();
 
   Array<VkDescriptorSetLayout> layouts(frameCount, vulkanShaderMaterial.mDescriptorSetLayout);
-  VkDescriptorSetAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocInfo.descriptorPool = vulkanShaderMaterial.mDescriptorPool;
-  allocInfo.descriptorSetCount = frameCount;
-  allocInfo.pSetLayouts = layouts.Data();
-
   vulkanShaderMaterial.mDescriptorSets.Resize(frameCount);
 
-  VulkanStatus status;
-  if(vkAllocateDescriptorSets(runtimeData->mDevice, &allocInfo, vulkanShaderMaterial.mDescriptorSets.Data()) != VK_SUCCESS)
-    status.MarkFailed("failed to allocate descriptor sets!");
+  VulkanStatus status = runtimeData->mDescriptorAllocator.Allocate(layouts.Data(), frameCount, vulkanShaderMaterial.mDescriptorSets.Data(), &vulkanShaderMaterial.mDescriptorPool);
+  if(!status)
+    vulkanShaderMaterial.mDescriptorSets.Clear();
+  return status;
 }
 
 void UpdateMaterialDescriptorSet(RendererData& rendererData, const ZilchShader& zilchShader, const ZilchMaterial& zilchMaterial, VulkanShaderMaterial& vulkanShaderMaterial, size_t frameIndex, VkDescriptorSet descriptorSet)
@@ -163,56 +116,40 @@ void UpdateMaterialDescriptorSet(RendererData& rendererData, const ZilchShader&
   VulkanRuntimeData* runtimeData = rendererData.mRuntimeData;
   size_t totalCount = zilchShader.mBindingDescriptors.Size();
 
-  Array<VkDescriptorBufferInfo> bufferInfos(totalCount);
-  Array<VkDescriptorImageInfo> imageInfos(totalCount);
-  Array<VkWriteDescriptorSet> descriptorWrites(totalCount);
+  // Laid out in binding descriptor order, which is the order the layout's template was built from
+  Array<VulkanDescriptorInfo> descriptorInfos(totalCount);
 
   size_t index = 0;
   for(const ZilchMaterialBindingDescriptor& bindingDescriptor: zilchShader.mBindingDescriptors)
   {
-    VkBuffer buffer = FindBuffer(rendererData, bindingDescriptor.mBufferBindingType, static_cast<uint32_t>(frameIndex), vulkanShaderMaterial.mBufferId);
-
-    VkWriteDescriptorSet& writeInfo = descriptorWrites[index];
-    writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writeInfo.dstSet = descriptorSet;
-    writeInfo.dstBinding = bindingDescriptor.mBindingId;
-    writeInfo.dstArrayElement = 0;
-    writeInfo.descriptorCount = 1;
-
+    VulkanDescriptorInfo& descriptorInfo = descriptorInfos[index];
     if(bindingDescriptor.mDescriptorType == MaterialDescriptorType::Uniform)
     {
-      VkDescriptorBufferInfo& bufferInfo = bufferInfos[index];
-      bufferInfo.buffer = buffer;
+      VkDescriptorBufferInfo& bufferInfo = descriptorInfo.mBuffer;
+      bufferInfo.buffer = FindBuffer(rendererData, bindingDescriptor.mBufferBindingType, static_cast<uint32_t>(frameIndex), vulkanShaderMaterial.mBufferId);
       bufferInfo.offset = bindingDescriptor.mOffsetInBytes;
       bufferInfo.range = bindingDescriptor.mSizeInBytes;
-      writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      writeInfo.pBufferInfo = &bufferInfo;
     }
     else if(bindingDescriptor.mDescriptorType == MaterialDescriptorType::UniformDynamic)
     {
-      VkDescriptorBufferInfo& bufferInfo = bufferInfos[index];
-      bufferInfo.buffer = buffer;
+      VkDescriptorBufferInfo& bufferInfo = descriptorInfo.mBuffer;
+      bufferInfo.buffer = FindBuffer(rendererData, bindingDescriptor.mBufferBindingType, static_cast<uint32_t>(frameIndex), vulkanShaderMaterial.mBufferId);
       bufferInfo.offset = 0;
       bufferInfo.range = bindingDescriptor.mSizeInBytes;
-      writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-      writeInfo.pBufferInfo = &bufferInfo;
     }
     else if(bindingDescriptor.mDescriptorType == MaterialDescriptorType::SampledImage)
     {
       VulkanImage* vulkanImage = rendererData.mRenderer->mTextureNameMap[bindingDescriptor.mSampledImageName];
       
-      VkDescriptorImageInfo& imageInfo = imageInfos[index];
+      VkDescriptorImageInfo& imageInfo = descriptorInfo.mImage;
       imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
       imageInfo.imageView = vulkanImage->mImageView;
       imageInfo.sampler = vulkanImage->mSampler;
-      writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      writeInfo.pImageInfo = &imageInfo;
     }
     ++index;
   }
 
-  uint32_t descriptorsCount = static_cast<uint32_t>(descriptorWrites.Size());
-  vkUpdateDescriptorSets(runtimeData->mDevice, descriptorsCount, descriptorWrites.Data(), 0, nullptr);
+  vkUpdateDescriptorSetWithTemplate(runtimeData->mDevice, descriptorSet, vulkanShaderMaterial.mUpdateTemplate, descriptorInfos.Data());
 }
 
 void UpdateMaterialDescriptorSets(RendererData& rendererData, const ZilchShader& zilchShader, const ZilchMaterial& zilchMaterial, VulkanShaderMaterial& vulkanShaderMaterial)
@@ -228,6 +165,19 @@ void CreateGraphicsPipeline(RendererData& rendererData, const VulkanShader& vulk
   VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
   CreatePipelineLayout(runtimeData->mDevice, &vulkanShaderMaterial.mDescriptorSetLayout, 1, vulkanShaderMaterial.mPipelineLayout);
 
+  for(const VertexFormat& vertexFormat : runtimeData->mVertexFormats.Values())
+    CreateGraphicsPipeline(rendererData, vulkanShader, vulkanShaderMaterial, vertexFormat);
+}
+
+void CreateGraphicsPipeline(RendererData& rendererData, const VulkanShader& vulkanShader, VulkanShaderMaterial& vulkanShaderMaterial, const VertexFormat& vertexFormat)
+{
+  VulkanRuntimeData* runtimeData = rendererData.mRuntimeData;
+  // Materials are only updated while the device is idle so the old pipeline can go right away
+  VkPipeline& pipeline = vulkanShaderMaterial.mPipelines[vertexFormat.mAttributes];
+  if(pipeline != VK_NULL_HANDLE)
+    vkDestroyPipeline(runtimeData->mDevice, pipeline, nullptr);
+  pipeline = VK_NULL_HANDLE;
+
   GraphicsPipelineCreationInfo creationInfo;
   creationInfo.mVertexShaderModule = vulkanShader.mVertexShaderModule;
   creationInfo.mPixelShaderModule = vulkanShader.mPixelShaderModule;
@@ -235,11 +185,11 @@ void CreateGraphicsPipeline(RendererData& rendererData, const VulkanShader& vulk
   creationInfo.mPixelShaderMainFnName = vulkanShader.mPixelEntryPointName;
   creationInfo.mDevice = runtimeData->mDevice;
   creationInfo.mPipelineLayout = vulkanShaderMaterial.mPipelineLayout;
-  creationInfo.mRenderPass = runtimeData->mRenderFrames[0].mRenderPass;
-  creationInfo.mViewportSize = Vec2((float)runtimeData->mSwapChain.mExtent.width, (float)runtimeData->mSwapChain.mExtent.height);
-  creationInfo.mVertexAttributeDescriptions = VulkanVertex::getAttributeDescriptions();
-  creationInfo.mVertexBindingDescriptions = VulkanVertex::getBindingDescription();
-  CreateGraphicsPipeline(creationInfo, vulkanShaderMaterial.mPipeline);
+  creationInfo.mPipelineCache = runtimeData->mPipelineCache;
+  creationInfo.mRenderPass = runtimeData->mRenderPass;
+  creationInfo.mVertexAttributeDescriptions = VulkanVertex::getAttributeDescriptions(vertexFormat, vulkanShader.mVertexInputLocations);
+  creationInfo.mVertexBindingDescriptions = VulkanVertex::getBindingDescription(vertexFormat);
+  CreateGraphicsPipeline(creationInfo, pipeline);
 }
 
 void PopulateMaterialBuffers(RendererData& rendererData, MaterialBatchUploadData& materialBatchData)
@@ -264,7 +214,9 @@ void PopulateMaterialBuffers(RendererData& rendererData, MaterialBatchUploadData
     const ZilchShader* shader = materialData.mZilchShader;
     if(shader == nullptr)
       continue;
-    VulkanShaderMaterial* vulkanShaderMaterial = renderer.mUniqueZilchShaderMaterialMap[shader];
+    VulkanShaderMaterial* vulkanShaderMaterial = renderer.mUniqueZilchShaderMaterialMap.FindValue(shader, nullptr);
+    if(vulkanShaderMaterial == nullptr)
+      continue;
 
     for(const MaterialFragment& fragment : material->mFragments)
     {
@@ -285,16 +237,12 @@ void PopulateMaterialBuffers(RendererData& rendererData, MaterialBatchUploadData
 
   uint32_t invalidBufferId = static_cast<uint32_t>(-1);
   uint32_t bufferId = invalidBufferId;
-  VkDeviceMemory bufferMemory = VK_NULL_HANDLE;
   byte* byteData = nullptr;
   for(size_t i = 0; i < propertiesByBuffer.Size(); ++i)
   {
     BufferSortData& data = propertiesByBuffer[i];
     if(bufferId != data.mBufferId || byteData == nullptr)
     {
-      if(byteData != nullptr)
-        renderer.UnMapGlobalUniformBufferMemory(MaterialBufferName, bufferId);
-
       bufferId = data.mBufferId;
       byteData = static_cast<byte*>(renderer.MapGlobalUniformBufferMemory(MaterialBufferName, bufferId));
     }
@@ -304,10 +252,6 @@ void PopulateMaterialBuffers(RendererData& rendererData, MaterialBatchUploadData
     // This might be wrong due to stride, have to figure out how to deal with this...
     memcpy(fieldStart, prop->mData.Data(), prop->mData.Size());
   }
-  if(bufferId != invalidBufferId)
-  {
-    renderer.UnMapGlobalUniformBufferMemory(MaterialBufferName, bufferId);
-  }
 }
 
 //void DestroyVulkanPipeline(RendererData& rendererData, VulkanMaterialPipeline* vulkanPipeline)
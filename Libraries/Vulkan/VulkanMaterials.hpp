@@ -1,5 +1,7 @@
 #pragma once
 
+#include "VulkanStatus.hpp"
+
 struct ZilchShader;
 struct ZilchMaterial;
 struct ZilchShaderManager;
@@ -11,15 +13,18 @@ struct MaterialUploadData;
 struct VulkanRuntimeData;
 struct VulkanShaderMaterial;
 struct VulkanShader;
+struct VertexFormat;
 struct RendererData;
 
-void CreateMaterialDescriptorSetLayouts(RendererData& rendererData, const ZilchShader& zilchShader, VulkanShaderMaterial& vulkanShaderMaterial);
-void CreateMaterialDescriptorPool(RendererData& rendererData, const ZilchShader& zilchShader, VulkanShaderMaterial& vulkanShaderMaterial);
-void CreateMaterialDescriptorSets(RendererData& rendererData, VulkanShaderMaterial& vulkanShaderMaterial);
+VulkanStatus CreateMaterialDescriptorSetLayouts(RendererData& rendererData, const ZilchShader& zilchShader, VulkanShaderMaterial& vulkanShaderMaterial);
+VulkanStatus CreateMaterialDescriptorSets(RendererData& rendererData, VulkanShaderMaterial& vulkanShaderMaterial);
 void UpdateMaterialDescriptorSet(RendererData& rendererData, const ZilchShader& zilchShader, const ZilchMaterial& zilchMaterial, VulkanShaderMaterial& vulkanShaderMaterial, size_t frameIndex, VkDescriptorSet descriptorSet);
 void UpdateMaterialDescriptorSets(RendererData& rendererData, const ZilchShader& zilchShader, const ZilchMaterial& zilchMaterial, VulkanShaderMaterial& vulkanShaderMaterial);
 
+/// Creates the pipeline layout and a pipeline for every vertex format meshes have been created with.
 void CreateGraphicsPipeline(RendererData& rendererData, const VulkanShader& vulkanShader, VulkanShaderMaterial& vulkanShaderMaterial);
+/// Creates (or replaces) the pipeline used to draw meshes of the given vertex format.
+void CreateGraphicsPipeline(RendererData& rendererData, const VulkanShader& vulkanShader, VulkanShaderMaterial& vulkanShaderMaterial, const VertexFormat& vertexFormat);
 void PopulateMaterialBuffers(RendererData& rendererData, MaterialBatchUploadData& materialBatchData);
 
 //void DestroyVulkanPipeline(RendererData& rendererData, VulkanMaterialPipeline* vulkanPipeline);
@@ -0,0 +1,521 @@
+#include "Precompiled.hpp"
+
+#include "VulkanMemoryAllocator.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+
+constexpr uint32_t cInvalidNode = static_cast<uint32_t>(-1);
+constexpr uint32_t cSecondLevelBits = 4;
+constexpr uint32_t cSecondLevelCount = 1 << cSecondLevelBits;
+constexpr uint32_t cFirstLevelCount = 64;
+// Every node offset and size is a multiple of this, so any alignment up to it is free
+constexpr VkDeviceSize cMinAllocationSize = 256;
+
+uint32_t FindLowestBit(uint64_t value)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return static_cast<uint32_t>(index);
+#else
+  return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+uint32_t FindHighestBit(uint64_t value)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return static_cast<uint32_t>(index);
+#else
+  return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+}
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+}//namespace
+
+//-------------------------------------------------------------------VulkanMemoryBlock
+struct VulkanMemoryBlock
+{
+  struct Node
+  {
+    VkDeviceSize mOffset = 0;
+    VkDeviceSize mSize = 0;
+    uint32_t mPrevPhysical = cInvalidNode;
+    uint32_t mNextPhysical = cInvalidNode;
+    uint32_t mPrevFree = cInvalidNode;
+    uint32_t mNextFree = cInvalidNode;
+    bool mFree = false;
+  };
+
+  void Initialize(VkDeviceSize size);
+  bool Allocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t& outNodeIndex);
+  void Free(uint32_t nodeIndex);
+  bool IsEmpty() const { return mAllocationCount == 0; }
+
+  static void MapSize(VkDeviceSize size, uint32_t& outFirstLevel, uint32_t& outSecondLevel);
+  uint32_t CreateNode();
+  void ReleaseNode(uint32_t nodeIndex);
+  void InsertFree(uint32_t nodeIndex);
+  void RemoveFree(uint32_t nodeIndex);
+  uint32_t FindFree(VkDeviceSize size);
+  // Splits the tail of the node past size off into a new free node
+  void Split(uint32_t nodeIndex, VkDeviceSize size);
+
+  VkDeviceMemory mMemory = VK_NULL_HANDLE;
+  VkDeviceSize mSize = 0;
+  uint32_t mMemoryTypeIndex = 0;
+  VulkanMemoryResourceKind mKind = VulkanMemoryResourceKind::Linear;
+  void* mMappedData = nullptr;
+  bool mDedicated = false;
+
+  Array<Node> mNodes;
+  Array<uint32_t> mUnusedNodes;
+  uint64_t mFirstLevelBitmap = 0;
+  uint32_t mSecondLevelBitmaps[cFirstLevelCount] = {};
+  uint32_t mFreeHeads[cFirstLevelCount][cSecondLevelCount];
+
+  VkDeviceSize mUsedBytes = 0;
+  size_t mAllocationCount = 0;
+};
+
+void VulkanMemoryBlock::Initialize(VkDeviceSize size)
+{
+  mSize = size;
+  mFirstLevelBitmap = 0;
+  for(uint32_t i = 0; i < cFirstLevelCount; ++i)
+  {
+    mSecondLevelBitmaps[i] = 0;
+    for(uint32_t j = 0; j < cSecondLevelCount; ++j)
+      mFreeHeads[i][j] = cInvalidNode;
+  }
+
+  uint32_t nodeIndex = CreateNode();
+  Node& node = mNodes[nodeIndex];
+  node.mOffset = 0;
+  node.mSize = size;
+  InsertFree(nodeIndex);
+}
+
+bool VulkanMemoryBlock::Allocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t& outNodeIndex)
+{
+  size = AlignUp(Math::Max(size, cMinAllocationSize), cMinAllocationSize);
+  // Large alignments can't be guaranteed by the list search so ask for enough extra to shift the start
+  VkDeviceSize searchSize = size;
+  if(alignment > cMinAllocationSize)
+    searchSize += alignment - cMinAllocationSize;
+
+  uint32_t nodeIndex = FindFree(searchSize);
+  if(nodeIndex == cInvalidNode)
+    return false;
+  RemoveFree(nodeIndex);
+
+  VkDeviceSize alignedOffset = AlignUp(mNodes[nodeIndex].mOffset, alignment);
+  VkDeviceSize padding = alignedOffset - mNodes[nodeIndex].mOffset;
+  if(padding != 0)
+  {
+    // Give the padding back as its own free node in front of this one
+    Split(nodeIndex, padding);
+    uint32_t alignedNodeIndex = mNodes[nodeIndex].mNextPhysical;
+    RemoveFree(alignedNodeIndex);
+    mNodes[nodeIndex].mFree = true;
+    InsertFree(nodeIndex);
+    nodeIndex = alignedNodeIndex;
+  }
+
+  if(mNodes[nodeIndex].mSize - size >= cMinAllocationSize)
+    Split(nodeIndex, size);
+
+  Node& node = mNodes[nodeIndex];
+  node.mFree = false;
+  mUsedBytes += node.mSize;
+  ++mAllocationCount;
+  outNodeIndex = nodeIndex;
+  return true;
+}
+
+void VulkanMemoryBlock::Free(uint32_t nodeIndex)
+{
+  Node* node = &mNodes[nodeIndex];
+  mUsedBytes -= node->mSize;
+  --mAllocationCount;
+  node->mFree = true;
+
+  // Coalesce with the physical neighbours
+  uint32_t nextIndex = node->mNextPhysical;
+  if(nextIndex != cInvalidNode && mNodes[nextIndex].mFree)
+  {
+    RemoveFree(nextIndex);
+    node->mSize += mNodes[nextIndex].mSize;
+    node->mNextPhysical = mNodes[nextIndex].mNextPhysical;
+    if(node->mNextPhysical != cInvalidNode)
+      mNodes[node->mNextPhysical].mPrevPhysical = nodeIndex;
+    ReleaseNode(nextIndex);
+  }
+
+  uint32_t prevIndex = node->mPrevPhysical;
+  if(prevIndex != cInvalidNode && mNodes[prevIndex].mFree)
+  {
+    RemoveFree(prevIndex);
+    Node& prev = mNodes[prevIndex];
+    prev.mSize += node->mSize;
+    prev.mNextPhysical = node->mNextPhysical;
+    if(prev.mNextPhysical != cInvalidNode)
+      mNodes[prev.mNextPhysical].mPrevPhysical = prevIndex;
+    ReleaseNode(nodeIndex);
+    nodeIndex = prevIndex;
+  }
+
+  InsertFree(nodeIndex);
+}
+
+void VulkanMemoryBlock::MapSize(VkDeviceSize size, uint32_t& outFirstLevel, uint32_t& outSecondLevel)
+{
+  uint32_t firstLevel = FindHighestBit(size);
+  uint32_t shift = firstLevel > cSecondLevelBits ? firstLevel - cSecondLevelBits : 0;
+  outFirstLevel = firstLevel;
+  outSecondLevel = static_cast<uint32_t>((size >> shift) & (cSecondLevelCount - 1));
+}
+
+uint32_t VulkanMemoryBlock::CreateNode()
+{
+  if(!mUnusedNodes.Empty())
+  {
+    uint32_t nodeIndex = mUnusedNodes.Back();
+    mUnusedNodes.PopBack();
+    mNodes[nodeIndex] = Node();
+    return nodeIndex;
+  }
+  mNodes.PushBack(Node());
+  return static_cast<uint32_t>(mNodes.Size() - 1);
+}
+
+void VulkanMemoryBlock::ReleaseNode(uint32_t nodeIndex)
+{
+  mUnusedNodes.PushBack(nodeIndex);
+}
+
+void VulkanMemoryBlock::InsertFree(uint32_t nodeIndex)
+{
+  Node& node = mNodes[nodeIndex];
+  node.mFree = true;
+
+  uint32_t firstLevel, secondLevel;
+  MapSize(node.mSize, firstLevel, secondLevel);
+
+  uint32_t head = mFreeHeads[firstLevel][secondLevel];
+  node.mPrevFree = cInvalidNode;
+  node.mNextFree = head;
+  if(head != cInvalidNode)
+    mNodes[head].mPrevFree = nodeIndex;
+  mFreeHeads[firstLevel][secondLevel] = nodeIndex;
+
+  mFirstLevelBitmap |= 1ull << firstLevel;
+  mSecondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+}
+
+void VulkanMemoryBlock::RemoveFree(uint32_t nodeIndex)
+{
+  Node& node = mNodes[nodeIndex];
+  uint32_t firstLevel, secondLevel;
+  MapSize(node.mSize, firstLevel, secondLevel);
+
+  if(node.mPrevFree != cInvalidNode)
+    mNodes[node.mPrevFree].mNextFree = node.mNextFree;
+  else
+    mFreeHeads[firstLevel][secondLevel] = node.mNextFree;
+  if(node.mNextFree != cInvalidNode)
+    mNodes[node.mNextFree].mPrevFree = node.mPrevFree;
+
+  if(mFreeHeads[firstLevel][secondLevel] == cInvalidNode)
+  {
+    mSecondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+    if(mSecondLevelBitmaps[firstLevel] == 0)
+      mFirstLevelBitmap &= ~(1ull << firstLevel);
+  }
+  node.mPrevFree = node.mNextFree = cInvalidNode;
+  node.mFree = false;
+}
+
+uint32_t VulkanMemoryBlock::FindFree(VkDeviceSize size)
+{
+  // Round up to the next list so that every node in the found list is guaranteed to fit
+  VkDeviceSize roundedSize = size;
+  uint32_t firstLevel = FindHighestBit(size);
+  if(firstLevel > cSecondLevelBits)
+    roundedSize += (1ull << (firstLevel - cSecondLevelBits)) - 1;
+
+  uint32_t secondLevel;
+  MapSize(roundedSize, firstLevel, secondLevel);
+  if(firstLevel < cFirstLevelCount)
+  {
+    uint32_t secondLevelMap = mSecondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+    if(secondLevelMap != 0)
+      return mFreeHeads[firstLevel][FindLowestBit(secondLevelMap)];
+
+    uint64_t firstLevelMap = firstLevel + 1 < cFirstLevelCount ? mFirstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+    if(firstLevelMap != 0)
+    {
+      firstLevel = FindLowestBit(firstLevelMap);
+      return mFreeHeads[firstLevel][FindLowestBit(mSecondLevelBitmaps[firstLevel])];
+    }
+  }
+
+  // Nothing in the larger lists, a node in the request's own list may still be big enough
+  // (always the case for a dedicated block sized exactly to its one allocation)
+  MapSize(size, firstLevel, secondLevel);
+  for(uint32_t nodeIndex = mFreeHeads[firstLevel][secondLevel]; nodeIndex != cInvalidNode; nodeIndex = mNodes[nodeIndex].mNextFree)
+  {
+    if(mNodes[nodeIndex].mSize >= size)
+      return nodeIndex;
+  }
+  return cInvalidNode;
+}
+
+void VulkanMemoryBlock::Split(uint32_t nodeIndex, VkDeviceSize size)
+{
+  uint32_t remainderIndex = CreateNode();
+  // CreateNode can grow the array so look the node up afterwards
+  Node& node = mNodes[nodeIndex];
+  Node& remainder = mNodes[remainderIndex];
+  remainder.mOffset = node.mOffset + size;
+  remainder.mSize = node.mSize - size;
+  remainder.mPrevPhysical = nodeIndex;
+  remainder.mNextPhysical = node.mNextPhysical;
+  if(node.mNextPhysical != cInvalidNode)
+    mNodes[node.mNextPhysical].mPrevPhysical = remainderIndex;
+  node.mNextPhysical = remainderIndex;
+  node.mSize = size;
+  InsertFree(remainderIndex);
+}
+
+//-------------------------------------------------------------------VulkanMemoryAllocator
+VulkanMemoryAllocator::VulkanMemoryAllocator()
+{
+}
+
+VulkanMemoryAllocator::~VulkanMemoryAllocator()
+{
+  Destroy();
+}
+
+void VulkanMemoryAllocator::Initialize(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize)
+{
+  mDevice = device;
+  mBlockSize = blockSize;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &mMemoryProperties);
+}
+
+void VulkanMemoryAllocator::Destroy()
+{
+  for(size_t typeIndex = 0; typeIndex < VK_MAX_MEMORY_TYPES; ++typeIndex)
+  {
+    for(Array<VulkanMemoryBlock*>& pool : mPools[typeIndex])
+    {
+      for(VulkanMemoryBlock* block : pool)
+        DestroyBlock(block);
+      pool.Clear();
+    }
+  }
+  for(VulkanMemoryBlock* block : mDedicatedBlocks)
+    DestroyBlock(block);
+  mDedicatedBlocks.Clear();
+}
+
+VulkanStatus VulkanMemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, VulkanMemoryResourceKind kind, VulkanMemoryAllocation& outAllocation)
+{
+  uint32_t memoryTypeIndex;
+  VulkanStatus status = FindMemoryTypeIndex(requirements.memoryTypeBits, properties, memoryTypeIndex);
+  if(!status)
+    return status;
+
+  VulkanMemoryBlock* block = nullptr;
+  uint32_t nodeIndex = cInvalidNode;
+  // Anything bigger than half a block would mostly waste the block, give it its own memory instead
+  if(requirements.size > mBlockSize / 2)
+  {
+    // The allocation starts at offset 0 so any alignment is already satisfied
+    block = CreateBlock(memoryTypeIndex, requirements.size, kind, true);
+    if(block == nullptr || !block->Allocate(requirements.size, cMinAllocationSize, nodeIndex))
+      return VulkanStatus("failed to allocate dedicated device memory!");
+    mDedicatedBlocks.PushBack(block);
+  }
+  else
+  {
+    Array<VulkanMemoryBlock*>& pool = mPools[memoryTypeIndex][static_cast<size_t>(kind)];
+    for(VulkanMemoryBlock* poolBlock : pool)
+    {
+      if(poolBlock->Allocate(requirements.size, requirements.alignment, nodeIndex))
+      {
+        block = poolBlock;
+        break;
+      }
+    }
+
+    if(block == nullptr)
+    {
+      block = CreateBlock(memoryTypeIndex, mBlockSize, kind, false);
+      if(block == nullptr || !block->Allocate(requirements.size, requirements.alignment, nodeIndex))
+        return VulkanStatus("failed to allocate device memory block!");
+      pool.PushBack(block);
+    }
+  }
+
+  const VulkanMemoryBlock::Node& node = block->mNodes[nodeIndex];
+  outAllocation.mMemory = block->mMemory;
+  outAllocation.mOffset = node.mOffset;
+  outAllocation.mSize = node.mSize;
+  outAllocation.mMappedData = nullptr;
+  if(block->mMappedData != nullptr)
+    outAllocation.mMappedData = static_cast<byte*>(block->mMappedData) + node.mOffset;
+  outAllocation.mBlock = block;
+  outAllocation.mNodeIndex = nodeIndex;
+  return VulkanStatus();
+}
+
+void VulkanMemoryAllocator::Free(VulkanMemoryAllocation& allocation)
+{
+  VulkanMemoryBlock* block = allocation.mBlock;
+  if(block == nullptr)
+    return;
+
+  block->Free(allocation.mNodeIndex);
+  allocation = VulkanMemoryAllocation();
+
+  if(!block->IsEmpty())
+    return;
+
+  if(block->mDedicated)
+  {
+    size_t index = mDedicatedBlocks.FindIndex(block);
+    Math::Swap(mDedicatedBlocks[index], mDedicatedBlocks[mDedicatedBlocks.Size() - 1]);
+    mDedicatedBlocks.PopBack();
+    DestroyBlock(block);
+    return;
+  }
+
+  // Keep one empty block around per pool so a free/allocate pattern doesn't thrash vkAllocateMemory
+  Array<VulkanMemoryBlock*>& pool = mPools[block->mMemoryTypeIndex][static_cast<size_t>(block->mKind)];
+  for(VulkanMemoryBlock* poolBlock : pool)
+  {
+    if(poolBlock != block && poolBlock->IsEmpty())
+    {
+      size_t index = pool.FindIndex(block);
+      Math::Swap(pool[index], pool[pool.Size() - 1]);
+      pool.PopBack();
+      DestroyBlock(block);
+      return;
+    }
+  }
+}
+
+VulkanStatus VulkanMemoryAllocator::AllocateAndBind(VkBuffer buffer, VkMemoryPropertyFlags properties, VulkanMemoryAllocation& outAllocation)
+{
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(mDevice, buffer, &memRequirements);
+
+  VulkanStatus status = Allocate(memRequirements, properties, VulkanMemoryResourceKind::Linear, outAllocation);
+  if(status)
+    vkBindBufferMemory(mDevice, buffer, outAllocation.mMemory, outAllocation.mOffset);
+  return status;
+}
+
+VulkanStatus VulkanMemoryAllocator::AllocateAndBind(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties, VulkanMemoryAllocation& outAllocation)
+{
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(mDevice, image, &memRequirements);
+
+  VulkanMemoryResourceKind kind = VulkanMemoryResourceKind::Optimal;
+  if(tiling == VK_IMAGE_TILING_LINEAR)
+    kind = VulkanMemoryResourceKind::Linear;
+
+  VulkanStatus status = Allocate(memRequirements, properties, kind, outAllocation);
+  if(status)
+    vkBindImageMemory(mDevice, image, outAllocation.mMemory, outAllocation.mOffset);
+  return status;
+}
+
+void VulkanMemoryAllocator::GetStatistics(VulkanMemoryStatistics& outStatistics) const
+{
+  outStatistics = VulkanMemoryStatistics();
+  for(size_t typeIndex = 0; typeIndex < VK_MAX_MEMORY_TYPES; ++typeIndex)
+  {
+    for(const Array<VulkanMemoryBlock*>& pool : mPools[typeIndex])
+    {
+      for(const VulkanMemoryBlock* block : pool)
+      {
+        ++outStatistics.mBlockCount;
+        outStatistics.mAllocationCount += block->mAllocationCount;
+        outStatistics.mAllocatedBytes += block->mSize;
+        outStatistics.mUsedBytes += block->mUsedBytes;
+      }
+    }
+  }
+  for(const VulkanMemoryBlock* block : mDedicatedBlocks)
+  {
+    ++outStatistics.mDedicatedAllocationCount;
+    outStatistics.mAllocationCount += block->mAllocationCount;
+    outStatistics.mAllocatedBytes += block->mSize;
+    outStatistics.mUsedBytes += block->mUsedBytes;
+  }
+  outStatistics.mDeviceMemoryCount = outStatistics.mBlockCount + outStatistics.mDedicatedAllocationCount;
+}
+
+VulkanMemoryBlock* VulkanMemoryAllocator::CreateBlock(uint32_t memoryTypeIndex, VkDeviceSize size, VulkanMemoryResourceKind kind, bool dedicated)
+{
+  size = AlignUp(size, cMinAllocationSize);
+
+  VkMemoryAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+  VkDeviceMemory memory;
+  if(vkAllocateMemory(mDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    return nullptr;
+
+  VulkanMemoryBlock* block = new VulkanMemoryBlock();
+  block->mMemory = memory;
+  block->mMemoryTypeIndex = memoryTypeIndex;
+  block->mKind = kind;
+  block->mDedicated = dedicated;
+  block->Initialize(size);
+
+  VkMemoryPropertyFlags propertyFlags = mMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+  if(propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    vkMapMemory(mDevice, memory, 0, VK_WHOLE_SIZE, 0, &block->mMappedData);
+  return block;
+}
+
+void VulkanMemoryAllocator::DestroyBlock(VulkanMemoryBlock* block)
+{
+  if(block->mMappedData != nullptr)
+    vkUnmapMemory(mDevice, block->mMemory);
+  vkFreeMemory(mDevice, block->mMemory, nullptr);
+  delete block;
+}
+
+VulkanStatus VulkanMemoryAllocator::FindMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& outMemoryTypeIndex) const
+{
+  for(uint32_t i = 0; i < mMemoryProperties.memoryTypeCount; i++)
+  {
+    if((typeFilter & (1 << i)) && (mMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+    {
+      outMemoryTypeIndex = i;
+      return VulkanStatus();
+    }
+  }
+
+  return VulkanStatus("failed to find suitable memory type!");
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "VulkanStandard.hpp"
+#include "VulkanStatus.hpp"
+
+struct VulkanMemoryBlock;
+
+/// Buffers and linear images are kept in different blocks than optimal images so
+/// neighbouring allocations never have to be padded out to bufferImageGranularity.
+enum class VulkanMemoryResourceKind
+{
+  Linear = 0,
+  Optimal,
+  Count
+};
+
+/// A range of device memory carved out of a larger block (or a dedicated allocation for large resources).
+struct VulkanMemoryAllocation
+{
+  VkDeviceMemory mMemory = VK_NULL_HANDLE;
+  VkDeviceSize mOffset = 0;
+  VkDeviceSize mSize = 0;
+  // Host visible blocks are mapped once on creation. Points at this allocation's offset, otherwise null.
+  void* mMappedData = nullptr;
+
+  VulkanMemoryBlock* mBlock = nullptr;
+  uint32_t mNodeIndex = static_cast<uint32_t>(-1);
+};
+
+struct VulkanMemoryStatistics
+{
+  // Number of live vkAllocateMemory calls (what counts against maxMemoryAllocationCount)
+  size_t mDeviceMemoryCount = 0;
+  size_t mBlockCount = 0;
+  size_t mDedicatedAllocationCount = 0;
+  size_t mAllocationCount = 0;
+  VkDeviceSize mAllocatedBytes = 0;
+  VkDeviceSize mUsedBytes = 0;
+};
+
+//-------------------------------------------------------------------VulkanMemoryAllocator
+/// Sub-allocates device memory out of large per memory type blocks. Each block is managed
+/// with a two-level segregated fit (TLSF) allocator so allocation and free are O(1).
+class VulkanMemoryAllocator
+{
+public:
+  VulkanMemoryAllocator();
+  ~VulkanMemoryAllocator();
+
+  void Initialize(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize = cDefaultBlockSize);
+  void Destroy();
+
+  VulkanStatus Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, VulkanMemoryResourceKind kind, VulkanMemoryAllocation& outAllocation);
+  void Free(VulkanMemoryAllocation& allocation);
+
+  // Allocates memory for the resource and binds it
+  VulkanStatus AllocateAndBind(VkBuffer buffer, VkMemoryPropertyFlags properties, VulkanMemoryAllocation& outAllocation);
+  VulkanStatus AllocateAndBind(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties, VulkanMemoryAllocation& outAllocation);
+
+  void GetStatistics(VulkanMemoryStatistics& outStatistics) const;
+
+  static constexpr VkDeviceSize cDefaultBlockSize = 64 * 1024 * 1024;
+
+private:
+  VulkanMemoryBlock* CreateBlock(uint32_t memoryTypeIndex, VkDeviceSize size, VulkanMemoryResourceKind kind, bool dedicated);
+  void DestroyBlock(VulkanMemoryBlock* block);
+  VulkanStatus FindMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& outMemoryTypeIndex) const;
+
+  VkDevice mDevice = VK_NULL_HANDLE;
+  VkPhysicalDeviceMemoryProperties mMemoryProperties = {};
+  VkDeviceSize mBlockSize = cDefaultBlockSize;
+
+  Array<VulkanMemoryBlock*> mPools[VK_MAX_MEMORY_TYPES][static_cast<size_t>(VulkanMemoryResourceKind::Count)];
+  Array<VulkanMemoryBlock*> mDedicatedBlocks;
+};
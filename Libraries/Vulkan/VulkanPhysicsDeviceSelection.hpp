@@ -56,6 +56,12 @@ struct PhysicalDeviceLimits
 {
   uint32_t mMaxUniformBufferRange;
   VkDeviceSize mMinUniformBufferOffsetAlignment;
+  VkDeviceSize mMinStorageBufferOffsetAlignment;
+  bool mSupportsTextureCompressionBC;
+  // Indirect draws with a non-zero first instance, every gpu culled batch draws from its own instance range
+  bool mSupportsDrawIndirectFirstInstance;
+  bool mSupportsMultiDrawIndirect;
+  uint32_t mMaxDrawIndirectCount;
 };
 
 inline void QueryPhysicalDeviceLimits(VkPhysicalDevice physicalDevice, PhysicalDeviceLimits& results)
@@ -65,4 +71,13 @@ inline void QueryPhysicalDeviceLimits(VkPhysicalDevice physicalDevice, PhysicalD
 
   results.mMaxUniformBufferRange = properties.limits.maxUniformBufferRange;
   results.mMinUniformBufferOffsetAlignment = properties.limits.minUniformBufferOffsetAlignment;
+  results.mMinStorageBufferOffsetAlignment = properties.limits.minStorageBufferOffsetAlignment;
+
+  VkPhysicalDeviceFeatures features;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+  results.mSupportsTextureCompressionBC = features.textureCompressionBC == VK_TRUE;
+  results.mSupportsDrawIndirectFirstInstance = features.drawIndirectFirstInstance == VK_TRUE;
+  results.mSupportsMultiDrawIndirect = features.multiDrawIndirect == VK_TRUE;
+  results.mMaxDrawIndirectCount = properties.limits.maxDrawIndirectCount;
 }
@@ -5,8 +5,6 @@
 struct GraphicsPipelineCreationInfo
 {
   VkDevice mDevice;
-  Vec2 mViewportOffset = Vec2(0, 0);
-  Vec2 mViewportSize = Vec2(0, 0);
   VkRenderPass mRenderPass;
 
   Array<VkVertexInputBindingDescription> mVertexBindingDescriptions;
@@ -17,6 +15,7 @@ struct GraphicsPipelineCreationInfo
   String mVertexShaderMainFnName = "main";
   String mPixelShaderMainFnName = "main";
   VkPipelineLayout mPipelineLayout;
+  VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
 };
 
 struct GraphicsPipelineData
@@ -110,25 +109,19 @@ inline VulkanStatus CreateGraphicsPipeline(GraphicsPipelineCreationInfo& creatio
   inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
   inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-  VkViewport viewport = {};
-  viewport.x = creationInfo.mViewportOffset.x;
-  viewport.y = creationInfo.mViewportOffset.y;
-  viewport.width = creationInfo.mViewportSize.x;
-  viewport.height = creationInfo.mViewportSize.x;
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-
-  VkRect2D scissor = {};
-  scissor.offset = {0, 0};
-  scissor.extent.width = static_cast<uint32_t>(creationInfo.mViewportSize.x);
-  scissor.extent.height = static_cast<uint32_t>(creationInfo.mViewportSize.y);
-
+  // Viewport and scissor are set while recording so pipelines don't depend on the swap chain size
   VkPipelineViewportStateCreateInfo viewportState = {};
   viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
   viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
+  viewportState.pViewports = nullptr;
   viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
+  viewportState.pScissors = nullptr;
+
+  VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamicState = {};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = static_cast<uint32_t>(sizeof(dynamicStates) / sizeof(dynamicStates[0]));
+  dynamicState.pDynamicStates = dynamicStates;
 
   VkPipelineRasterizationStateCreateInfo rasterizer = {};
   rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -196,7 +189,7 @@ inline VulkanStatus CreateGraphicsPipeline(GraphicsPipelineCreationInfo& creatio
   pipelineInfo.pMultisampleState = &multisampling;
   pipelineInfo.pDepthStencilState = &depthStencil;
   pipelineInfo.pColorBlendState = &colorBlending;
-  pipelineInfo.pDynamicState = nullptr; // Optional
+  pipelineInfo.pDynamicState = &dynamicState;
   pipelineInfo.layout = creationInfo.mPipelineLayout;
   pipelineInfo.renderPass = creationInfo.mRenderPass;
   pipelineInfo.subpass = 0;
@@ -204,7 +197,7 @@ inline VulkanStatus CreateGraphicsPipeline(GraphicsPipelineCreationInfo& creatio
   pipelineInfo.basePipelineIndex = -1; // Optional
 
   VulkanStatus result;
-  if(vkCreateGraphicsPipelines(creationInfo.mDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &resultPipeline) != VK_SUCCESS)
+  if(vkCreateGraphicsPipelines(creationInfo.mDevice, creationInfo.mPipelineCache, 1, &pipelineInfo, nullptr, &resultPipeline) != VK_SUCCESS)
     result.MarkFailed("failed to create graphics pipeline!");
   return result;
 }
@@ -225,7 +218,6 @@ inline void CreateGraphicsPipeline(GraphicsPipelineData& graphicsPipelineData)
   creationInfo.mDevice = graphicsPipelineData.mDevice;
   creationInfo.mPipelineLayout = graphicsPipelineData.mPipelineLayout;
   creationInfo.mRenderPass = graphicsPipelineData.mRenderPass;
-  creationInfo.mViewportSize = graphicsPipelineData.mViewportSize;
   creationInfo.mVertexAttributeDescriptions = graphicsPipelineData.mVertexAttributeDescriptions;
   creationInfo.mVertexBindingDescriptions = graphicsPipelineData.mVertexBindingDescriptions;
   CreateGraphicsPipeline(creationInfo, graphicsPipelineData.mGraphicsPipeline);
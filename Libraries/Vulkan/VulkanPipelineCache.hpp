@@ -0,0 +1,83 @@
+#pragma once
+
+#include "VulkanStandard.hpp"
+#include "VulkanStatus.hpp"
+#include "Utilities/File.hpp"
+
+struct PipelineCacheCreationInfo
+{
+  VkPhysicalDevice mPhysicalDevice;
+  VkDevice mDevice;
+  // Empty to create a cache that is never loaded or saved
+  String mFilePath;
+};
+
+/// Checks the header the driver writes at the start of the cache data. Data from another driver
+/// or device is either rejected or silently ignored by the implementation, so it's dropped instead.
+inline bool IsPipelineCacheDataCompatible(VkPhysicalDevice physicalDevice, const Array<char>& data)
+{
+  // VkPipelineCacheHeaderVersionOne: headerSize, headerVersion, vendorID, deviceID, pipelineCacheUUID
+  const size_t headerSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+  if(data.Size() < headerSize)
+    return false;
+
+  uint32_t header[4];
+  memcpy(header, data.Data(), sizeof(header));
+  const uint8_t* uuid = reinterpret_cast<const uint8_t*>(data.Data()) + sizeof(header);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+  if(header[0] < headerSize || header[0] > data.Size())
+    return false;
+  if(header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+    return false;
+  if(header[2] != properties.vendorID || header[3] != properties.deviceID)
+    return false;
+  return memcmp(uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+inline VulkanStatus CreatePipelineCache(PipelineCacheCreationInfo& creationInfo, VkPipelineCache& outPipelineCache)
+{
+  Array<char> data;
+  if(!creationInfo.mFilePath.Empty() && Zero::FileExists(creationInfo.mFilePath))
+  {
+    readFile(creationInfo.mFilePath, data);
+    if(!IsPipelineCacheDataCompatible(creationInfo.mPhysicalDevice, data))
+      data.Clear();
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = data.Size();
+  cacheInfo.pInitialData = data.Empty() ? nullptr : data.Data();
+
+  VulkanStatus result;
+  if(vkCreatePipelineCache(creationInfo.mDevice, &cacheInfo, nullptr, &outPipelineCache) != VK_SUCCESS)
+  {
+    // Fall back to an empty cache if the driver still didn't like the data
+    cacheInfo.initialDataSize = 0;
+    cacheInfo.pInitialData = nullptr;
+    if(vkCreatePipelineCache(creationInfo.mDevice, &cacheInfo, nullptr, &outPipelineCache) != VK_SUCCESS)
+      result.MarkFailed("failed to create pipeline cache!");
+  }
+  return result;
+}
+
+inline VulkanStatus SavePipelineCache(VkDevice device, VkPipelineCache pipelineCache, const String& filePath)
+{
+  if(pipelineCache == VK_NULL_HANDLE || filePath.Empty())
+    return VulkanStatus();
+
+  size_t dataSize = 0;
+  if(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS)
+    return VulkanStatus("failed to query pipeline cache size!");
+
+  Array<byte> data;
+  data.Resize(dataSize);
+  if(vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.Data()) != VK_SUCCESS)
+    return VulkanStatus("failed to read pipeline cache data!");
+
+  Zero::WriteToFile(filePath.c_str(), data.Data(), dataSize);
+  return VulkanStatus();
+}
@@ -7,6 +7,11 @@ struct RenderPassCreationData
   VkDevice mDevice;
   VkFormat mSwapChainImageFormat;
   VkFormat mDepthFormat;
+  VkImageLayout mColorFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  // Render passes that only differ in these stay compatible with the same pipelines and framebuffers
+  VkAttachmentLoadOp mColorLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  VkAttachmentStoreOp mColorStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+  VkImageLayout mColorInitialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
   VkRenderPass mRenderPass;
 };
@@ -16,12 +21,12 @@ inline void CreateRenderPass(RenderPassCreationData& creationData)
   VkAttachmentDescription colorAttachment = {};
   colorAttachment.format = creationData.mSwapChainImageFormat;
   colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.loadOp = creationData.mColorLoadOp;
+  colorAttachment.storeOp = creationData.mColorStoreOp;
   colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  colorAttachment.initialLayout = creationData.mColorInitialLayout;
+  colorAttachment.finalLayout = creationData.mColorFinalLayout;
 
   VkAttachmentReference colorAttachmentRef = {};
   colorAttachmentRef.attachment = 0;
@@ -48,13 +53,26 @@ inline void CreateRenderPass(RenderPassCreationData& creationData)
   subpass.pColorAttachments = &colorAttachmentRef;
   subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
-  VkSubpassDependency dependency = {};
+  // The depth image and transient color images are shared by consecutive passes, so wait on
+  // the previous pass's attachment writes and on shader reads of an image that's being reused.
+  std::array<VkSubpassDependency, 2> dependencies = {};
+  VkSubpassDependency& dependency = dependencies[0];
   dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
   dependency.dstSubpass = 0;
-  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.srcAccessMask = 0;
-  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  // A target that's sampled by a later pass has to be finished before that pass's fragment shaders run
+  VkSubpassDependency& readDependency = dependencies[1];
+  readDependency.srcSubpass = 0;
+  readDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+  readDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  readDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  readDependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  readDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  bool isReadAfterPass = creationData.mColorFinalLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
   std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
   VkRenderPassCreateInfo renderPassInfo = {};
@@ -63,8 +81,8 @@ inline void CreateRenderPass(RenderPassCreationData& creationData)
   renderPassInfo.pAttachments = attachments.data();
   renderPassInfo.subpassCount = 1;
   renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
+  renderPassInfo.dependencyCount = isReadAfterPass ? 2 : 1;
+  renderPassInfo.pDependencies = dependencies.data();
 
   if(vkCreateRenderPass(creationData.mDevice, &renderPassInfo, nullptr, &creationData.mRenderPass) != VK_SUCCESS)
     throw std::runtime_error("failed to create render pass!");
@@ -5,6 +5,7 @@
 #include "Graphics/Mesh.hpp"
 #include "Graphics/MaterialShared.hpp"
 #include "Graphics/Texture.hpp"
+#include "Graphics/TextureCompression.hpp"
 #include "Graphics/ZilchShader.hpp"
 #include "Graphics/RenderQueue.hpp"
 #include "VulkanInitialization.hpp"
@@ -22,7 +23,7 @@ VkFramebuffer& FindFrameBuffer(size_t id, VulkanRuntimeData* data)
 }
 VkRenderPass& FindRenderPass(size_t id, VulkanRuntimeData* data)
 {
-  return data->mRenderFrames[id].mRenderPass;
+  return data->mRenderPass;
 }
 VkCommandBuffer& FindCommandBuffer(size_t id, VulkanRuntimeData* data)
 {
@@ -44,25 +45,40 @@ void VulkanRenderer::Initialize(const VulkanInitializationData& initData)
   mInternal->mWidth = static_cast<uint32_t>(initData.mWidth);
   mInternal->mHeight = static_cast<uint32_t>(initData.mHeight);
   mInternal->mSurfaceCreationCallback = initData.mSurfaceCreationCallback;
+  mInternal->mHeadless = initData.mHeadless;
+  mInternal->mPipelineCachePath = initData.mPipelineCachePath;
+  mInternal->mGpuCullingShaderPath = initData.mGpuCullingShaderPath;
+  mInternal->mClusterCullingShaderPath = initData.mClusterCullingShaderPath;
   mInternal->mBufferManager.mRuntimeData = mInternal;
+  mInternal->mThreadPool.Initialize(initData.mRecordingThreadCount);
   InitializeVulkan(*mInternal);
-  CreateDepthResourcesInternal();
-  CreateSwapChainInternal();
-  CreateRenderFramesInternal();
+  CreateSwapChain();
 }
 
 void VulkanRenderer::Cleanup()
 {
-  DestroyRenderFramesInternal();
-  DestroySwapChainInternal();
-  DestroyDepthResourcesInternal();
+  DestroySwapChain();
 }
 
 void VulkanRenderer::CleanupResources()
 {
+  mInternal->mUploader.WaitForIdle();
+  for(VulkanTextureResidencySwap& swap : mInternal->mPendingTextureSwaps)
+    DestroyTextureInternal(&swap.mReplacement);
+  mInternal->mPendingTextureSwaps.Clear();
+  RetireCanceledImagesInternal(0);
+  for(uint32_t i = 0; i < mInternal->mMaxFramesInFlight; ++i)
+    DestroyRetiredImagesInternal(i);
+  for(VulkanRenderFrame& renderFrame : mInternal->mRenderFrames)
+    renderFrame.mStaleMaterials.Clear();
+
   for(VulkanMesh* mesh : mMeshMap.Values())
     DestroyMeshInternal(mesh);
   mMeshMap.Clear();
+  vkDestroyBuffer(mInternal->mDevice, mInternal->mDefaultAttributeBuffer, nullptr);
+  mInternal->mAllocator.Free(mInternal->mDefaultAttributeBufferAllocation);
+  mInternal->mDefaultAttributeBuffer = VK_NULL_HANDLE;
+  mInternal->mVertexFormats.Clear();
 
   for(VulkanImage* image : mTextureMap.Values())
     DestroyTextureInternal(image);
@@ -90,10 +106,21 @@ void VulkanRenderer::Shutdown()
   if(enableValidationLayers)
     DestroyDebugUtilsMessengerEXT(mInternal->mInstance, mInternal->mDebugMessenger, nullptr);
 
+  mInternal->mUploader.Destroy();
   vkDestroyCommandPool(mInternal->mDevice, mInternal->mCommandPool, nullptr);
 
+  DestroyRenderPassInternal();
+  DestroyGpuCulling(mInternal->mDevice, mInternal->mGpuCulling);
+  mInternal->mDescriptorAllocator.Destroy();
+  mInternal->mDescriptorLayoutCache.Destroy();
+  SavePipelineCache(mInternal->mDevice, mInternal->mPipelineCache, mInternal->mPipelineCachePath);
+  vkDestroyPipelineCache(mInternal->mDevice, mInternal->mPipelineCache, nullptr);
+
+  mInternal->mAllocator.Destroy();
   vkDestroyDevice(mInternal->mDevice, nullptr);
-  vkDestroySurfaceKHR(mInternal->mInstance, mInternal->mSurface, nullptr);
+  mInternal->mThreadPool.Shutdown();
+  if(mInternal->mSurface != VK_NULL_HANDLE)
+    vkDestroySurfaceKHR(mInternal->mInstance, mInternal->mSurface, nullptr);
   vkDestroyInstance(mInternal->mInstance, nullptr);
 }
 
@@ -105,55 +132,136 @@ void VulkanRenderer::Destroy()
 void VulkanRenderer::CreateMesh(const Mesh* mesh)
 {
   VulkanMesh* vulkanMesh = new VulkanMesh();
+  VulkanUploader& uploader = mInternal->mUploader;
+  uploader.BeginBatch();
 
-  VulkanBufferCreationData vulkanData;
-  vulkanData.mPhysicalDevice = mInternal->mPhysicalDevice;
-  vulkanData.mDevice = mInternal->mDevice;
-  vulkanData.mCommandPool = mInternal->mCommandPool;
-  vulkanData.mGraphicsQueue = mInternal->mGraphicsQueue;
+  {
+    // Only the packed vertices go to the gpu, for cooked meshes they're copied straight from the mapped file
+    vulkanMesh->mVertexFormat = mesh->mVertexFormat;
+    VkDeviceSize bufferSize = mesh->GetVertexDataSize();
+    CreateBuffer(mInternal->mAllocator, mInternal->mDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vulkanMesh->mVertexBuffer, vulkanMesh->mVertexBufferAllocation);
+    uploader.UploadToBuffer(vulkanMesh->mVertexBuffer, 0, mesh->GetVertexData(), bufferSize);
+  }
 
+  if(mInternal->mDefaultAttributeBuffer == VK_NULL_HANDLE)
   {
-    VkDeviceSize bufferSize = sizeof(mesh->mVertices[0]) * mesh->mVertices.Size();
-    CreateBuffer(vulkanData, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vulkanMesh->mVertexBuffer, vulkanMesh->mVertexBufferMemory, mesh->mVertices.Data(), bufferSize);
+    byte zeroes[VulkanVertex::cDefaultAttributeSize] = {};
+    CreateBuffer(mInternal->mAllocator, mInternal->mDevice, VulkanVertex::cDefaultAttributeSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mInternal->mDefaultAttributeBuffer, mInternal->mDefaultAttributeBufferAllocation);
+    uploader.UploadToBuffer(mInternal->mDefaultAttributeBuffer, 0, zeroes, VulkanVertex::cDefaultAttributeSize);
+    mInternal->mBatchedDefaultAttributeBuffer = true;
   }
   
   {
-    vulkanMesh->mIndexCount = static_cast<uint32_t>(mesh->mIndices.Size());
-    VkDeviceSize bufferSize = sizeof(mesh->mIndices[0]) * mesh->mIndices.Size();
-    CreateBuffer(vulkanData, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, vulkanMesh->mIndexBuffer, vulkanMesh->mIndexBufferMemory, mesh->mIndices.Data(), bufferSize);
+    vulkanMesh->mIndexCount = static_cast<uint32_t>(mesh->GetIndexCount());
+    VkDeviceSize bufferSize = sizeof(uint32_t) * mesh->GetIndexCount();
+    CreateBuffer(mInternal->mAllocator, mInternal->mDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vulkanMesh->mIndexBuffer, vulkanMesh->mIndexBufferAllocation);
+    uploader.UploadToBuffer(vulkanMesh->mIndexBuffer, 0, mesh->GetIndices(), bufferSize);
+  }
+
+  if(!mesh->mClusters.Empty() && mInternal->mGpuCulling.IsClusterCullingAvailable())
+  {
+    // The culling shader gets the instance transforms with the position decode folded in, so the bounds are moved into the packed space
+    Array<GpuMeshCluster> gpuClusters(mesh->mClusters.Size());
+    float inverseScale = 1.0f / mesh->mPositionScale;
+    for(size_t i = 0; i < mesh->mClusters.Size(); ++i)
+    {
+      const MeshCluster& cluster = mesh->mClusters[i];
+      GpuMeshCluster& gpuCluster = gpuClusters[i];
+      Vec3 center = (cluster.mCenter - mesh->mPositionBias) * inverseScale;
+      gpuCluster.mBoundingSphere = Vec4(center.x, center.y, center.z, cluster.mRadius * inverseScale);
+      gpuCluster.mCone = Vec4(cluster.mConeAxis.x, cluster.mConeAxis.y, cluster.mConeAxis.z, cluster.mConeCutoff);
+      gpuCluster.mIndexOffset = cluster.mIndexOffset;
+      gpuCluster.mIndexCount = cluster.mIndexCount;
+      gpuCluster.mPadding[0] = gpuCluster.mPadding[1] = 0;
+    }
+
+    vulkanMesh->mClusterCount = static_cast<uint32_t>(gpuClusters.Size());
+    VkDeviceSize bufferSize = sizeof(GpuMeshCluster) * gpuClusters.Size();
+    CreateBuffer(mInternal->mAllocator, mInternal->mDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vulkanMesh->mClusterBuffer, vulkanMesh->mClusterBufferAllocation);
+    uploader.UploadToBuffer(vulkanMesh->mClusterBuffer, 0, gpuClusters.Data(), bufferSize);
   }
 
   mMeshMap[mesh] = vulkanMesh;
+  mInternal->mBatchedMeshes.PushBack(mesh);
+  EndUploadBatchInternal();
+  if(!mMeshMap.ContainsKey(mesh))
+    return;
+
+  // Shaders that already have pipelines need one for a format they haven't seen
+  const VertexFormat& vertexFormat = mesh->mVertexFormat;
+  if(mInternal->mVertexFormats.ContainsKey(vertexFormat.mAttributes))
+    return;
+  mInternal->mVertexFormats[vertexFormat.mAttributes] = vertexFormat;
+
+  RendererData rendererData{this, mInternal};
+  for(auto pair : mUniqueZilchShaderMaterialMap.All())
+  {
+    VulkanShaderMaterial* vulkanShaderMaterial = pair.second;
+    VulkanShader* vulkanShader = mZilchShaderMap.FindValue(pair.first, nullptr);
+    if(vulkanShader != nullptr && vulkanShaderMaterial->mPipelineLayout != VK_NULL_HANDLE)
+      CreateGraphicsPipeline(rendererData, *vulkanShader, *vulkanShaderMaterial, vertexFormat);
+  }
 }
 
 void VulkanRenderer::DestroyMesh(const Mesh* mesh)
 {
-  VulkanMesh* vulkanMesh = mMeshMap[mesh];
+  // Meshes whose upload failed are already gone
+  VulkanMesh* vulkanMesh = mMeshMap.FindValue(mesh, nullptr);
+  if(vulkanMesh == nullptr)
+    return;
   mMeshMap.Erase(mesh);
 
   DestroyMeshInternal(vulkanMesh);
 }
 
-void VulkanRenderer::CreateTexture(const Texture* texture)
+void VulkanRenderer::CreateTexture(const Texture* texture, uint32_t firstMip)
 {
   VulkanImage* vulkanImage = new VulkanImage();
 
-  CreateImageInternal(texture, vulkanImage);
+  mInternal->mUploader.BeginBatch();
+  CreateImageInternal(texture, vulkanImage, firstMip);
   CreateImageViewInternal(texture, vulkanImage);
 
   mTextureMap[texture] = vulkanImage;
   mTextureNameMap[texture->mName] = vulkanImage;
+  mInternal->mBatchedTextures.PushBack(texture);
+  EndUploadBatchInternal();
 }
 
 void VulkanRenderer::DestroyTexture(const Texture* texture)
 {
-  VulkanImage* vulkanImage = mTextureMap[texture];
+  // Textures whose upload failed are already gone
+  VulkanImage* vulkanImage = mTextureMap.FindValue(texture, nullptr);
+  if(vulkanImage == nullptr)
+    return;
   mTextureMap.Erase(texture);
   mTextureNameMap.Erase(texture->mName);
 
+  CancelTextureResidencyInternal(vulkanImage);
   DestroyTextureInternal(vulkanImage);
 }
 
+void VulkanRenderer::SetTextureResidency(const Texture* texture, uint32_t firstMip)
+{
+  VulkanImage* vulkanImage = mTextureMap.FindValue(texture, nullptr);
+  if(vulkanImage == nullptr || texture->mMips.Empty())
+    return;
+
+  // A newer request replaces one that hasn't been swapped in yet
+  CancelTextureResidencyInternal(vulkanImage);
+  if(firstMip == vulkanImage->mFirstMip)
+    return;
+
+  // The new image is uploaded alongside rendering and only swapped in once its batch has finished
+  VulkanTextureResidencySwap& swap = mInternal->mPendingTextureSwaps.PushBack();
+  swap.mImage = vulkanImage;
+  mInternal->mUploader.BeginBatch();
+  CreateImageInternal(texture, &swap.mReplacement, firstMip);
+  CreateImageViewInternal(texture, &swap.mReplacement);
+  mInternal->mBatchedResidencyChanges.PushBack(texture);
+  EndUploadBatchInternal();
+}
+
 void VulkanRenderer::CreateShader(const ZilchShader* zilchShader)
 {
   VulkanShader* vulkanShader = new VulkanShader();
@@ -162,6 +270,7 @@ void VulkanRenderer::CreateShader(const ZilchShader* zilchShader)
   vulkanShader->mVertexShaderModule = CreateShaderModule(mInternal->mDevice, zilchShader->mShaderByteCode[ShaderStage::Vertex]);
   vulkanShader->mVertexEntryPointName = zilchShader->mResources[ShaderStage::Vertex].mEntryPointName;
   vulkanShader->mPixelEntryPointName = zilchShader->mResources[ShaderStage::Pixel].mEntryPointName;
+  vulkanShader->mVertexInputLocations = zilchShader->mVertexInputLocations;
 
   mZilchShaderMap[zilchShader] = vulkanShader;
 }
@@ -179,9 +288,16 @@ void VulkanRenderer::CreateShaderMaterial(ZilchShader* shaderMaterial)
   VulkanShaderMaterial* vulkanShaderMaterial = new VulkanShaderMaterial();
 
   RendererData rendererData{this, mInternal};
-  CreateMaterialDescriptorSetLayouts(rendererData, *shaderMaterial, *vulkanShaderMaterial);
-  CreateMaterialDescriptorPool(rendererData, *shaderMaterial, *vulkanShaderMaterial);
-  CreateMaterialDescriptorSets(rendererData, *vulkanShaderMaterial);
+  VulkanStatus status = CreateMaterialDescriptorSetLayouts(rendererData, *shaderMaterial, *vulkanShaderMaterial);
+  if(status)
+    status = CreateMaterialDescriptorSets(rendererData, *vulkanShaderMaterial);
+  // Without its sets the material is left out and anything drawn with it is skipped
+  if(!status)
+  {
+    Warn("Failed to create descriptor sets for shader '%s' (%s)", shaderMaterial->mName.c_str(), status.mErrorMessage.c_str());
+    DestroyShaderMaterialInternal(vulkanShaderMaterial);
+    return;
+  }
 
   for(ZilchMaterialBindingDescriptor& bindingDescriptor : shaderMaterial->mBindingDescriptors)
   {
@@ -194,9 +310,23 @@ void VulkanRenderer::CreateShaderMaterial(ZilchShader* shaderMaterial)
 
 void VulkanRenderer::UpdateShaderMaterialInstance(const ZilchShader* zilchShader, const ZilchMaterial* zilchMaterial)
 {
-  VulkanShaderMaterial* vulkanShaderMaterial = mUniqueZilchShaderMaterialMap[zilchShader];
+  VulkanShaderMaterial* vulkanShaderMaterial = mUniqueZilchShaderMaterialMap.FindValue(zilchShader, nullptr);
   VulkanShader* vulkanShader = mZilchShaderMap[zilchShader];
+  if(vulkanShaderMaterial == nullptr)
+    return;
+
+  // A texture that failed to upload was dropped, the material can't be bound without it
+  for(const ZilchMaterialBindingDescriptor& bindingDescriptor : zilchShader->mBindingDescriptors)
+  {
+    if(bindingDescriptor.mDescriptorType == MaterialDescriptorType::SampledImage && !mTextureNameMap.ContainsKey(bindingDescriptor.mSampledImageName))
+    {
+      Warn("Shader '%s' samples missing texture '%s'", zilchShader->mName.c_str(), bindingDescriptor.mSampledImageName.c_str());
+      DestroyShaderMaterial(zilchShader);
+      return;
+    }
+  }
 
+  vulkanShaderMaterial->mZilchMaterial = zilchMaterial;
   RendererData rendererData{this, mInternal};
   UpdateMaterialDescriptorSets(rendererData, *zilchShader, *zilchMaterial, *vulkanShaderMaterial);
   CreateGraphicsPipeline(rendererData, *vulkanShader, *vulkanShaderMaterial);
@@ -210,7 +340,7 @@ void VulkanRenderer::UploadShaderMaterialInstances(MaterialBatchUploadData& mate
 
 void VulkanRenderer::DestroyShaderMaterial(const ZilchShader* zilchShader)
 {
-  VulkanShaderMaterial* vulkanShaderMaterial = mUniqueZilchShaderMaterialMap[zilchShader];
+  VulkanShaderMaterial* vulkanShaderMaterial = mUniqueZilchShaderMaterialMap.FindValue(zilchShader, nullptr);
   mUniqueZilchShaderMaterialMap.Erase(zilchShader);
 
   DestroyShaderMaterialInternal(vulkanShaderMaterial);
@@ -222,6 +352,18 @@ RenderFrameStatus VulkanRenderer::BeginFrame()
   auto& syncObjects = mInternal->mSyncObjects;
 
   vkWaitForFences(mInternal->mDevice, 1, &syncObjects.mInFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+  DestroyRetiredImagesInternal(currentFrame);
+  RetireCanceledImagesInternal(currentFrame);
+  mInternal->mUploader.RetireCompletedBatches();
+  ApplyTextureResidencyInternal();
+
+  // Offscreen images are cycled in lock-step with the frames in flight so the fence above already protects them
+  if(mInternal->mHeadless)
+  {
+    mInternal->mCurrentImageIndex = currentFrame;
+    UpdateStaleMaterialsInternal(currentFrame);
+    return RenderFrameStatus::Success;
+  }
 
   uint32_t imageIndex;
   VkResult result = vkAcquireNextImageKHR(mInternal->mDevice, mInternal->mSwapChain.mSwapChain, UINT64_MAX, syncObjects.mImageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
@@ -230,7 +372,13 @@ RenderFrameStatus VulkanRenderer::BeginFrame()
   else if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
     return RenderFrameStatus::Error;
   
+  // The image's command buffers are about to be re-recorded so whatever frame last used it has to be done
+  if(syncObjects.mImagesInFlight[imageIndex] != VK_NULL_HANDLE)
+    vkWaitForFences(mInternal->mDevice, 1, &syncObjects.mImagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+  syncObjects.mImagesInFlight[imageIndex] = syncObjects.mInFlightFences[currentFrame];
+
   mInternal->mCurrentImageIndex = imageIndex;
+  UpdateStaleMaterialsInternal(imageIndex);
   return RenderFrameStatus::Success;
 }
 
@@ -240,14 +388,23 @@ RenderFrameStatus VulkanRenderer::EndFrame()
   uint32_t imageIndex = mInternal->mCurrentImageIndex;
   VulkanRenderFrame& vulkanRenderFrame = mInternal->mRenderFrames[imageIndex];
   auto& syncObjects = mInternal->mSyncObjects;
-  if(syncObjects.mImagesInFlight[imageIndex] != VK_NULL_HANDLE)
-    vkWaitForFences(mInternal->mDevice, 1, &syncObjects.mImagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
-  
-  syncObjects.mImagesInFlight[imageIndex] = syncObjects.mInFlightFences[currentFrame];
 
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+  if(mInternal->mHeadless)
+  {
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &vulkanRenderFrame.mCommandBuffer;
+
+    vkResetFences(mInternal->mDevice, 1, &syncObjects.mInFlightFences[currentFrame]);
+    if(vkQueueSubmit(mInternal->mGraphicsQueue, 1, &submitInfo, syncObjects.mInFlightFences[currentFrame]) != VK_SUCCESS)
+      return RenderFrameStatus::Error;
+
+    currentFrame = (currentFrame + 1) % mInternal->mMaxFramesInFlight;
+    return RenderFrameStatus::Success;
+  }
+
   VkSemaphore waitSemaphores[] = {syncObjects.mImageAvailableSemaphores[currentFrame]};
   VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
   submitInfo.waitSemaphoreCount = 1;
@@ -298,6 +455,24 @@ void VulkanRenderer::DrawRenderQueue(RenderQueue& renderQueue)
 void VulkanRenderer::WaitForIdle()
 {
   vkDeviceWaitIdle(mInternal->mDevice);
+  mInternal->mUploader.RetireCompletedBatches();
+
+  // Nothing is in flight so every deferred descriptor write and destruction can happen now
+  for(uint32_t i = 0; i < static_cast<uint32_t>(mInternal->mRenderFrames.Size()); ++i)
+    UpdateStaleMaterialsInternal(i);
+  RetireCanceledImagesInternal(0);
+  for(uint32_t i = 0; i < mInternal->mMaxFramesInFlight; ++i)
+    DestroyRetiredImagesInternal(i);
+}
+
+void VulkanRenderer::BeginUploadBatch()
+{
+  mInternal->mUploader.BeginBatch();
+}
+
+void VulkanRenderer::EndUploadBatch()
+{
+  EndUploadBatchInternal();
 }
 
 void VulkanRenderer::Reshape(size_t width, size_t height, float aspectRatio)
@@ -314,6 +489,20 @@ void VulkanRenderer::GetShape(size_t& width, size_t& height, float& aspectRatio)
   aspectRatio = width / (float)height;
 }
 
+void VulkanRenderer::CreateSwapChain()
+{
+  CreateDepthResourcesInternal();
+  CreateSwapChainInternal();
+  CreateRenderFramesInternal();
+}
+
+void VulkanRenderer::DestroySwapChain()
+{
+  DestroyRenderFramesInternal();
+  DestroySwapChainInternal();
+  DestroyDepthResourcesInternal();
+}
+
 Matrix4 VulkanRenderer::BuildPerspectiveMatrix(float verticalFov, float aspectRatio, float nearDistance, float farDistance) const
 {
 // Near and far distances are expected to be positive
@@ -338,13 +527,24 @@ Matrix4 VulkanRenderer::BuildPerspectiveMatrix(float verticalFov, float aspectRa
   return m;
 }
 
+bool VulkanRenderer::SupportsGpuCulling() const
+{
+  return mInternal->mGpuCulling.IsAvailable();
+}
+
+bool VulkanRenderer::SupportsTextureStreaming() const
+{
+  // Swapped images are picked up by rewriting the descriptor sets of the materials that sample them
+  return true;
+}
+
 void* VulkanRenderer::MapGlobalUniformBufferMemory(const String& bufferName, uint32_t bufferId)
 {
   VulkanUniformBuffer* buffer = mInternal->mBufferManager.FindGlobalBuffer(bufferName, bufferId);
 
   void* data = nullptr;
   if(buffer != nullptr)
-    vkMapMemory(mInternal->mDevice, buffer->mBufferMemory, 0, mInternal->mDeviceLimits.mMaxUniformBufferRange, 0, &data);
+    data = buffer->mBufferAllocation.mMappedData;
   return data;
 }
 
@@ -354,24 +554,18 @@ void* VulkanRenderer::MapPerFrameUniformBufferMemory(const String& bufferName, u
 
   void* data = nullptr;
   if(buffer != nullptr)
-    vkMapMemory(mInternal->mDevice, buffer->mBufferMemory, 0, mInternal->mDeviceLimits.mMaxUniformBufferRange, 0, &data);
+    data = buffer->mBufferAllocation.mMappedData;
   return data;
 }
 
-void VulkanRenderer::UnMapGlobalUniformBufferMemory(const String& bufferName, uint32_t bufferId)
+bool VulkanRenderer::SwapChainLayoutChanged() const
 {
-  VulkanUniformBuffer* buffer = mInternal->mBufferManager.FindGlobalBuffer(bufferName, bufferId);
-
-  if(buffer != nullptr && buffer->mBufferMemory != VK_NULL_HANDLE)
-    vkUnmapMemory(mInternal->mDevice, buffer->mBufferMemory);
+  return mInternal->mSwapChainLayoutChanged;
 }
 
-void VulkanRenderer::UnMapPerFrameUniformBufferMemory(const String& bufferName, uint32_t bufferId, uint32_t frameIndex)
+void VulkanRenderer::GetMemoryStatistics(VulkanMemoryStatistics& outStatistics) const
 {
-  VulkanUniformBuffer* buffer = mInternal->mBufferManager.FindOrCreatePerFrameBuffer(bufferName, bufferId, frameIndex);
-
-  if(buffer != nullptr && buffer->mBufferMemory != VK_NULL_HANDLE)
-    vkUnmapMemory(mInternal->mDevice, buffer->mBufferMemory);
+  mInternal->mAllocator.GetStatistics(outStatistics);
 }
 
 size_t VulkanRenderer::AlignUniformBufferOffset(size_t offset)
@@ -382,17 +576,22 @@ size_t VulkanRenderer::AlignUniformBufferOffset(size_t offset)
 void VulkanRenderer::DestroyMeshInternal(VulkanMesh* vulkanMesh)
 {
   vkDestroyBuffer(mInternal->mDevice, vulkanMesh->mIndexBuffer, nullptr);
-  vkFreeMemory(mInternal->mDevice, vulkanMesh->mIndexBufferMemory, nullptr);
+  mInternal->mAllocator.Free(vulkanMesh->mIndexBufferAllocation);
   vkDestroyBuffer(mInternal->mDevice, vulkanMesh->mVertexBuffer, nullptr);
-  vkFreeMemory(mInternal->mDevice, vulkanMesh->mVertexBufferMemory, nullptr);
+  mInternal->mAllocator.Free(vulkanMesh->mVertexBufferAllocation);
+  if(vulkanMesh->mClusterBuffer != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(mInternal->mDevice, vulkanMesh->mClusterBuffer, nullptr);
+    mInternal->mAllocator.Free(vulkanMesh->mClusterBufferAllocation);
+  }
 }
 
 void VulkanRenderer::DestroyTextureInternal(VulkanImage* vulkanImage)
 {
   vkDestroySampler(mInternal->mDevice, vulkanImage->mSampler, nullptr);
   vkDestroyImageView(mInternal->mDevice, vulkanImage->mImageView, nullptr);
-  vkFreeMemory(mInternal->mDevice, vulkanImage->mImageMemory, nullptr);
   vkDestroyImage(mInternal->mDevice, vulkanImage->mImage, nullptr);
+  mInternal->mAllocator.Free(vulkanImage->mImageAllocation);
 }
 
 void VulkanRenderer::DestroyShaderInternal(VulkanShader* vulkanShader)
@@ -408,14 +607,16 @@ void VulkanRenderer::DestroyShaderMaterialInternal(VulkanShaderMaterial* vulkanS
   if(vulkanShaderMaterial == nullptr)
     return;
 
-  vkDestroyPipeline(mInternal->mDevice, vulkanShaderMaterial->mPipeline, nullptr);
+  for(VkPipeline pipeline : vulkanShaderMaterial->mPipelines.Values())
+    vkDestroyPipeline(mInternal->mDevice, pipeline, nullptr);
   vkDestroyPipelineLayout(mInternal->mDevice, vulkanShaderMaterial->mPipelineLayout, nullptr);
-  vkDestroyDescriptorPool(mInternal->mDevice, vulkanShaderMaterial->mDescriptorPool, nullptr);
-  vkDestroyDescriptorSetLayout(mInternal->mDevice, vulkanShaderMaterial->mDescriptorSetLayout, nullptr);
-  vulkanShaderMaterial->mPipeline = VK_NULL_HANDLE;
+  uint32_t descriptorSetCount = static_cast<uint32_t>(vulkanShaderMaterial->mDescriptorSets.Size());
+  mInternal->mDescriptorAllocator.Free(vulkanShaderMaterial->mDescriptorPool, vulkanShaderMaterial->mDescriptorSets.Data(), descriptorSetCount);
+  vulkanShaderMaterial->mPipelines.Clear();
   vulkanShaderMaterial->mPipelineLayout = VK_NULL_HANDLE;
   vulkanShaderMaterial->mDescriptorPool = VK_NULL_HANDLE;
   vulkanShaderMaterial->mDescriptorSetLayout = VK_NULL_HANDLE;
+  vulkanShaderMaterial->mUpdateTemplate = VK_NULL_HANDLE;
   vulkanShaderMaterial->mDescriptorSets.Clear();
   delete vulkanShaderMaterial;
 }
@@ -433,6 +634,12 @@ void VulkanRenderer::RecreateFramesInternal()
 
 void VulkanRenderer::CreateSwapChainInternal()
 {
+  if(mInternal->mHeadless)
+  {
+    CreateOffscreenImagesInternal();
+    return;
+  }
+
   SwapChainCreationInfo swapChainInfo;
   swapChainInfo.mDevice = mInternal->mDevice;
   swapChainInfo.mPhysicalDevice = mInternal->mPhysicalDevice;
@@ -447,6 +654,16 @@ void VulkanRenderer::CreateSwapChainInternal()
 void VulkanRenderer::CreateRenderFramesInternal()
 {
   size_t count = mInternal->mSwapChain.mImages.Size();
+  VkFormat format = mInternal->mSwapChain.mImageFormat;
+  // Pipelines and per-frame descriptor sets only have to be rebuilt if the image count or format changed
+  mInternal->mSwapChainLayoutChanged = (count != mInternal->mLastFrameCount || format != mInternal->mRenderPassFormat);
+  mInternal->mLastFrameCount = static_cast<uint32_t>(count);
+  if(mInternal->mRenderPass == VK_NULL_HANDLE || format != mInternal->mRenderPassFormat)
+  {
+    DestroyRenderPassInternal();
+    CreateRenderPassInternal();
+  }
+
   mInternal->mRenderFrames.Resize(count);
 
   Array<VkCommandBuffer> commandBuffers(count);
@@ -459,19 +676,20 @@ void VulkanRenderer::CreateRenderFramesInternal()
     vulkanFrame.mSwapChainImageView = mInternal->mSwapChain.mImageViews[i];
     vulkanFrame.mCommandBuffer = commandBuffers[i];
 
+    // Command pools are externally synchronized so every recording thread gets its own
+    vulkanFrame.mThreadCommandPools.Resize(mInternal->mThreadPool.GetThreadCount());
+    for(VulkanThreadCommandPool& threadPool : vulkanFrame.mThreadCommandPools)
+      CreateCommandPool(mInternal->mPhysicalDevice, mInternal->mDevice, mInternal->mSurface, threadPool.mCommandPool);
 
-    RenderPassCreationData creationData;
-    creationData.mRenderPass = vulkanFrame.mRenderPass;
-    creationData.mDevice = mInternal->mDevice;
-    creationData.mSwapChainImageFormat = mInternal->mSwapChain.mImageFormat;
-    creationData.mDepthFormat = mInternal->mDepthFormat;
-    CreateRenderPass(creationData);
-    vulkanFrame.mRenderPass = creationData.mRenderPass;
+    // Culling writes the instance stream and draw commands from a compute shader
+    VkBufferUsageFlags frameBufferUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    vulkanFrame.mFrameAllocator.Initialize(&mInternal->mAllocator, mInternal->mDevice, frameBufferUsage);
+    vulkanFrame.mDescriptorAllocator.Initialize(mInternal->mDevice);
 
     std::array<VkImageView, 2> attachments = {mInternal->mSwapChain.mImageViews[i], mInternal->mDepthImage.mImageView};
     VkFramebufferCreateInfo framebufferInfo = {};
     framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    framebufferInfo.renderPass = vulkanFrame.mRenderPass;
+    framebufferInfo.renderPass = mInternal->mRenderPass;
     framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
     framebufferInfo.pAttachments = attachments.data();
     framebufferInfo.width = mInternal->mSwapChain.mExtent.width;
@@ -485,17 +703,132 @@ void VulkanRenderer::CreateRenderFramesInternal()
 
 void VulkanRenderer::DestroyRenderFramesInternal()
 {
-  size_t count = mInternal->mSwapChain.mImages.Size();
   for(VulkanRenderFrame& renderFrame : mInternal->mRenderFrames)
   {
+    vkFreeCommandBuffers(mInternal->mDevice, mInternal->mCommandPool, 1, &renderFrame.mCommandBuffer);
+    for(VulkanThreadCommandPool& threadPool : renderFrame.mThreadCommandPools)
+      vkDestroyCommandPool(mInternal->mDevice, threadPool.mCommandPool, nullptr);
+    renderFrame.mThreadCommandPools.Clear();
+    renderFrame.mFrameAllocator.Destroy();
+    renderFrame.mDescriptorAllocator.Destroy();
+    DestroyTransientTargetsInternal(renderFrame);
     vkDestroyFramebuffer(mInternal->mDevice, renderFrame.mFrameBuffer, nullptr);
-    vkDestroyRenderPass(mInternal->mDevice, renderFrame.mRenderPass, nullptr);
   }
   mInternal->mRenderFrames.Clear();
 }
 
+void VulkanRenderer::CreateRenderPassInternal()
+{
+  RenderPassCreationData creationData;
+  creationData.mDevice = mInternal->mDevice;
+  creationData.mSwapChainImageFormat = mInternal->mSwapChain.mImageFormat;
+  creationData.mDepthFormat = mInternal->mDepthFormat;
+  if(mInternal->mHeadless)
+    creationData.mColorFinalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  CreateRenderPass(creationData);
+  mInternal->mRenderPass = creationData.mRenderPass;
+  mInternal->mRenderPassFormat = creationData.mSwapChainImageFormat;
+}
+
+void VulkanRenderer::DestroyRenderPassInternal()
+{
+  if(mInternal->mRenderPass == VK_NULL_HANDLE)
+    return;
+  for(VkRenderPass renderPass : mInternal->mRenderPassVariants.Values())
+    vkDestroyRenderPass(mInternal->mDevice, renderPass, nullptr);
+  mInternal->mRenderPassVariants.Clear();
+  vkDestroyRenderPass(mInternal->mDevice, mInternal->mRenderPass, nullptr);
+  mInternal->mRenderPass = VK_NULL_HANDLE;
+  mInternal->mRenderPassFormat = VK_FORMAT_UNDEFINED;
+}
+
+VkRenderPass VulkanRenderer::FindOrCreateRenderPassInternal(const RenderGraphPass& pass)
+{
+  uint32_t key = static_cast<uint32_t>(pass.mLoadOp);
+  key |= static_cast<uint32_t>(pass.mInitialUsage) << 2;
+  key |= static_cast<uint32_t>(pass.mFinalUsage) << 4;
+  key |= static_cast<uint32_t>(pass.mStoreContents) << 6;
+  VkRenderPass* existingRenderPass = mInternal->mRenderPassVariants.FindPointer(key);
+  if(existingRenderPass != nullptr)
+    return *existingRenderPass;
+
+  // Only the load/store ops and layouts differ from mRenderPass so the pipelines and framebuffers built against it still work
+  RenderPassCreationData creationData;
+  creationData.mDevice = mInternal->mDevice;
+  creationData.mSwapChainImageFormat = mInternal->mRenderPassFormat;
+  creationData.mDepthFormat = mInternal->mDepthFormat;
+  creationData.mColorLoadOp = ConvertLoadOp(pass.mLoadOp);
+  creationData.mColorStoreOp = pass.mStoreContents ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  creationData.mColorInitialLayout = ConvertTargetUsage(pass.mInitialUsage, mInternal->mHeadless);
+  creationData.mColorFinalLayout = ConvertTargetUsage(pass.mFinalUsage, mInternal->mHeadless);
+  CreateRenderPass(creationData);
+  mInternal->mRenderPassVariants.Insert(key, creationData.mRenderPass);
+  return creationData.mRenderPass;
+}
+
+void VulkanRenderer::CreateTransientTargetsInternal(VulkanRenderFrame& renderFrame, size_t count)
+{
+  // Transient targets match the swap chain so they can use the same render passes and pipelines
+  SwapChainData& swapChain = mInternal->mSwapChain;
+  for(size_t i = renderFrame.mTransientTargets.Size(); i < count; ++i)
+  {
+    VulkanTransientTarget& target = renderFrame.mTransientTargets.PushBack();
+
+    ImageCreationInfo imageInfo;
+    imageInfo.mDevice = mInternal->mDevice;
+    imageInfo.mWidth = swapChain.mExtent.width;
+    imageInfo.mHeight = swapChain.mExtent.height;
+    imageInfo.mMipLevels = 1;
+    imageInfo.mFormat = swapChain.mImageFormat;
+    imageInfo.mTiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.mUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.mType = VK_IMAGE_TYPE_2D;
+    CreateImage(imageInfo, target.mImage);
+
+    ImageMemoryCreationInfo memoryInfo;
+    memoryInfo.mAllocator = &mInternal->mAllocator;
+    memoryInfo.mImage = target.mImage;
+    memoryInfo.mProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    memoryInfo.mTiling = imageInfo.mTiling;
+    CreateImageMemory(memoryInfo, target.mImageAllocation);
+
+    CreateSwapChainImageView(mInternal->mDevice, swapChain.mImageFormat, 1, target.mImage, target.mImageView);
+
+    std::array<VkImageView, 2> attachments = {target.mImageView, mInternal->mDepthImage.mImageView};
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = mInternal->mRenderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    framebufferInfo.pAttachments = attachments.data();
+    framebufferInfo.width = swapChain.mExtent.width;
+    framebufferInfo.height = swapChain.mExtent.height;
+    framebufferInfo.layers = 1;
+
+    if(vkCreateFramebuffer(mInternal->mDevice, &framebufferInfo, nullptr, &target.mFrameBuffer) != VK_SUCCESS)
+      throw std::runtime_error("failed to create transient target framebuffer!");
+  }
+}
+
+void VulkanRenderer::DestroyTransientTargetsInternal(VulkanRenderFrame& renderFrame)
+{
+  for(VulkanTransientTarget& target : renderFrame.mTransientTargets)
+  {
+    vkDestroyFramebuffer(mInternal->mDevice, target.mFrameBuffer, nullptr);
+    vkDestroyImageView(mInternal->mDevice, target.mImageView, nullptr);
+    vkDestroyImage(mInternal->mDevice, target.mImage, nullptr);
+    mInternal->mAllocator.Free(target.mImageAllocation);
+  }
+  renderFrame.mTransientTargets.Clear();
+}
+
 void VulkanRenderer::DestroySwapChainInternal()
 {
+  if(mInternal->mHeadless)
+  {
+    DestroyOffscreenImagesInternal();
+    return;
+  }
+
   if(mInternal->mSwapChain.mImageViews.Empty())
     return;
 
@@ -507,42 +840,257 @@ void VulkanRenderer::DestroySwapChainInternal()
   vkDestroySwapchainKHR(mInternal->mDevice, mInternal->mSwapChain.mSwapChain, nullptr);
 }
 
-void VulkanRenderer::CreateImageInternal(const Texture* texture, VulkanImage* image)
+void VulkanRenderer::CreateOffscreenImagesInternal()
+{
+  // Mirror what a swap chain would provide so the rest of the frame code doesn't care where the images came from
+  SwapChainData& swapChain = mInternal->mSwapChain;
+  swapChain.mSwapChain = VK_NULL_HANDLE;
+  swapChain.mImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+  swapChain.mExtent.width = mInternal->mWidth;
+  swapChain.mExtent.height = mInternal->mHeight;
+
+  size_t count = mInternal->mMaxFramesInFlight;
+  mInternal->mOffscreenImages.Resize(count);
+  swapChain.mImages.Resize(count);
+  swapChain.mImageViews.Resize(count);
+  for(size_t i = 0; i < count; ++i)
+  {
+    ImageViewMemorySet& offscreenImage = mInternal->mOffscreenImages[i];
+
+    ImageCreationInfo imageInfo;
+    imageInfo.mDevice = mInternal->mDevice;
+    imageInfo.mWidth = mInternal->mWidth;
+    imageInfo.mHeight = mInternal->mHeight;
+    imageInfo.mMipLevels = 1;
+    imageInfo.mFormat = swapChain.mImageFormat;
+    imageInfo.mTiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.mUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.mType = VK_IMAGE_TYPE_2D;
+    CreateImage(imageInfo, offscreenImage.mImage);
+
+    ImageMemoryCreationInfo memoryInfo;
+    memoryInfo.mAllocator = &mInternal->mAllocator;
+    memoryInfo.mImage = offscreenImage.mImage;
+    memoryInfo.mProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    memoryInfo.mTiling = imageInfo.mTiling;
+    CreateImageMemory(memoryInfo, offscreenImage.mImageAllocation);
+
+    CreateSwapChainImageView(mInternal->mDevice, swapChain.mImageFormat, 1, offscreenImage.mImage, offscreenImage.mImageView);
+    swapChain.mImages[i] = offscreenImage.mImage;
+    swapChain.mImageViews[i] = offscreenImage.mImageView;
+  }
+  mInternal->mSyncObjects.mImagesInFlight.Resize(count, VK_NULL_HANDLE);
+}
+
+void VulkanRenderer::DestroyOffscreenImagesInternal()
 {
+  for(ImageViewMemorySet& offscreenImage : mInternal->mOffscreenImages)
+    ::Cleanup(mInternal->mDevice, mInternal->mAllocator, offscreenImage);
+  mInternal->mOffscreenImages.Clear();
+  mInternal->mSwapChain.mImageViews.Clear();
+  mInternal->mSwapChain.mImages.Clear();
+}
+
+void VulkanRenderer::CreateImageInternal(const Texture* texture, VulkanImage* image, uint32_t firstMip)
+{
+  // Devices without BC support get the texture decoded to RGBA8. Sampler settings still come from the original.
+  const Texture* original = texture;
+  Texture decompressed;
+  if(GetImageFormatInternal(texture) != texture->mFormat)
+  {
+    DecompressTexture(*texture, decompressed);
+    texture = &decompressed;
+  }
+
+  // Levels can only be left out when they're stored, otherwise they're generated from the top level
+  if(texture->mMips.Empty())
+    firstMip = 0;
+  size_t dataOffset = texture->mMips.Empty() ? 0 : texture->mMips[firstMip].mOffset;
+  uint32_t mipLevels = static_cast<uint32_t>(texture->mMipLevels) - firstMip;
+  image->mFirstMip = firstMip;
+
   TextureImageCreationInfo textureInfo;
   textureInfo.mPhysicalDevice = mInternal->mPhysicalDevice;
   textureInfo.mDevice = mInternal->mDevice;
   textureInfo.mGraphicsQueue = mInternal->mGraphicsQueue;
   textureInfo.mGraphicsPipeline = mInternal->mGraphicsPipeline;
   textureInfo.mCommandPool = mInternal->mCommandPool;
+  textureInfo.mAllocator = &mInternal->mAllocator;
+  textureInfo.mUploader = &mInternal->mUploader;
   textureInfo.mFormat = GetImageFormat(texture->mFormat);
-  textureInfo.mPixels = texture->mTextureData.Data();
-  textureInfo.mPixelsSize = static_cast<uint32_t>(texture->mTextureData.Size());
-  textureInfo.mWidth = static_cast<uint32_t>(texture->mSizeX);
-  textureInfo.mHeight = static_cast<uint32_t>(texture->mSizeY);
-  textureInfo.mMipLevels = static_cast<uint32_t>(texture->mMipLevels);
+  textureInfo.mPixels = texture->mTextureData.Data() + dataOffset;
+  textureInfo.mPixelsSize = static_cast<uint32_t>(texture->mTextureData.Size() - dataOffset);
+  textureInfo.mWidth = static_cast<uint32_t>(Math::Max(texture->mSizeX >> firstMip, size_t(1)));
+  textureInfo.mHeight = static_cast<uint32_t>(Math::Max(texture->mSizeY >> firstMip, size_t(1)));
+  textureInfo.mMipLevels = mipLevels;
+  for(size_t level = firstMip; level < texture->mMips.Size(); ++level)
+    textureInfo.mMipOffsets.PushBack(static_cast<VkDeviceSize>(texture->mMips[level].mOffset - dataOffset));
   CreateTextureImage(textureInfo, *image);
 
   SamplerCreationInfo samplerInfo;
   samplerInfo.mDevice = mInternal->mDevice;
-  samplerInfo.mMaxLod = static_cast<float>(texture->mMipLevels);
-  samplerInfo.mAddressingU = ConvertSamplerAddressMode(texture->mAddressingX);
-  samplerInfo.mAddressingV = ConvertSamplerAddressMode(texture->mAddressingY);
-  samplerInfo.mMinFilter = ConvertFilterMode(texture->mMinFilter);
-  samplerInfo.mMagFilter = ConvertFilterMode(texture->mMagFilter);
+  samplerInfo.mMaxLod = static_cast<float>(mipLevels);
+  samplerInfo.mAddressingU = ConvertSamplerAddressMode(original->mAddressingX);
+  samplerInfo.mAddressingV = ConvertSamplerAddressMode(original->mAddressingY);
+  samplerInfo.mMinFilter = ConvertFilterMode(original->mMinFilter);
+  samplerInfo.mMagFilter = ConvertFilterMode(original->mMagFilter);
   CreateTextureSampler(samplerInfo, image->mSampler);
 }
 
 void VulkanRenderer::CreateImageViewInternal(const Texture* texture, VulkanImage* image)
 {
   ImageViewCreationInfo info(mInternal->mDevice, image->mImage);
-  info.mFormat = GetImageFormat(texture->mFormat);
+  info.mFormat = GetImageFormat(GetImageFormatInternal(texture));
   info.mViewType = VK_IMAGE_VIEW_TYPE_2D;
   info.mAspectFlags = VK_IMAGE_ASPECT_COLOR_BIT;
-  info.mMipLevels = static_cast<uint32_t>(texture->mMipLevels);
+  info.mMipLevels = static_cast<uint32_t>(texture->mMipLevels) - image->mFirstMip;
   VulkanStatus status = CreateImageView(info, image->mImageView);
 }
 
+TextureFormat VulkanRenderer::GetImageFormatInternal(const Texture* texture) const
+{
+  if(IsBlockCompressed(texture->mFormat) && !mInternal->mDeviceLimits.mSupportsTextureCompressionBC)
+    return GetDecompressedFormat(texture->mFormat);
+  return texture->mFormat;
+}
+
+void VulkanRenderer::ApplyTextureResidencyInternal()
+{
+  Array<VulkanTextureResidencySwap>& swaps = mInternal->mPendingTextureSwaps;
+  if(swaps.Empty())
+    return;
+  // Uploads are usually done a frame later. If streaming keeps the uploader busy the swaps wait on it after a few frames.
+  if(mInternal->mUploader.HasPendingUploads())
+  {
+    if(++mInternal->mPendingTextureSwapFrames <= mInternal->mMaxFramesInFlight)
+      return;
+    mInternal->mUploader.WaitForIdle();
+  }
+  mInternal->mPendingTextureSwapFrames = 0;
+
+  // Other frames in flight may still read the old images. Frames finish in submit order, so once this
+  // frame's fence signals again every frame that could have used them is done too.
+  Array<VulkanImage>& retiredImages = mInternal->mRetiredImages[mInternal->mCurrentFrame];
+  Zero::HashSet<VulkanImage*> swappedImages;
+  for(VulkanTextureResidencySwap& swap : swaps)
+  {
+    VulkanImage* vulkanImage = swap.mImage;
+    retiredImages.PushBack(*vulkanImage);
+    *vulkanImage = swap.mReplacement;
+    swappedImages.Insert(vulkanImage);
+  }
+  swaps.Clear();
+
+  // Materials that sample the texture still hold the old view. Each image's descriptor set is only
+  // rewritten once the frame that last used it has finished, see UpdateStaleMaterialsInternal.
+  for(auto pair : mUniqueZilchShaderMaterialMap.All())
+  {
+    const ZilchShader* zilchShader = pair.first;
+    VulkanShaderMaterial* vulkanShaderMaterial = pair.second;
+    if(vulkanShaderMaterial->mZilchMaterial == nullptr)
+      continue;
+
+    for(const ZilchMaterialBindingDescriptor& bindingDescriptor : zilchShader->mBindingDescriptors)
+    {
+      if(bindingDescriptor.mDescriptorType != MaterialDescriptorType::SampledImage)
+        continue;
+      if(swappedImages.Contains(mTextureNameMap.FindValue(bindingDescriptor.mSampledImageName, nullptr)))
+      {
+        for(VulkanRenderFrame& renderFrame : mInternal->mRenderFrames)
+          renderFrame.mStaleMaterials.PushBack(zilchShader);
+        break;
+      }
+    }
+  }
+}
+
+void VulkanRenderer::UpdateStaleMaterialsInternal(uint32_t imageIndex)
+{
+  VulkanRenderFrame& renderFrame = mInternal->mRenderFrames[imageIndex];
+  RendererData rendererData{this, mInternal};
+  for(const ZilchShader* zilchShader : renderFrame.mStaleMaterials)
+  {
+    // The material may have been destroyed since its texture was swapped
+    VulkanShaderMaterial* vulkanShaderMaterial = mUniqueZilchShaderMaterialMap.FindValue(zilchShader, nullptr);
+    if(vulkanShaderMaterial == nullptr || vulkanShaderMaterial->mZilchMaterial == nullptr)
+      continue;
+    UpdateMaterialDescriptorSet(rendererData, *zilchShader, *vulkanShaderMaterial->mZilchMaterial, *vulkanShaderMaterial, imageIndex, vulkanShaderMaterial->mDescriptorSets[imageIndex]);
+  }
+  renderFrame.mStaleMaterials.Clear();
+}
+
+void VulkanRenderer::DestroyRetiredImagesInternal(uint32_t frameIndex)
+{
+  Array<VulkanImage>& retiredImages = mInternal->mRetiredImages[frameIndex];
+  for(VulkanImage& image : retiredImages)
+    DestroyTextureInternal(&image);
+  retiredImages.Clear();
+}
+
+void VulkanRenderer::RetireCanceledImagesInternal(uint32_t frameIndex)
+{
+  // Upload batches are submitted before the frame that's about to be recorded, so its fence covers them
+  Array<VulkanImage>& retiredImages = mInternal->mRetiredImages[frameIndex];
+  for(VulkanImage& image : mInternal->mCanceledTextureSwaps)
+    retiredImages.PushBack(image);
+  mInternal->mCanceledTextureSwaps.Clear();
+}
+
+void VulkanRenderer::CancelTextureResidencyInternal(VulkanImage* vulkanImage)
+{
+  Array<VulkanTextureResidencySwap>& swaps = mInternal->mPendingTextureSwaps;
+  for(size_t i = 0; i < swaps.Size(); ++i)
+  {
+    if(swaps[i].mImage != vulkanImage)
+      continue;
+
+    // The replacement may still be the target of an upload, it's retired with the next frame instead
+    mInternal->mCanceledTextureSwaps.PushBack(swaps[i].mReplacement);
+    swaps[i] = swaps.Back();
+    swaps.PopBack();
+    return;
+  }
+}
+
+void VulkanRenderer::EndUploadBatchInternal()
+{
+  VulkanUploader& uploader = mInternal->mUploader;
+  VulkanStatus status = uploader.EndBatch();
+  if(uploader.IsBatching())
+    return;
+
+  if(!status)
+  {
+    Warn("Upload batch failed (%s), dropping %d meshes, %d textures and %d residency changes", status.mErrorMessage.c_str(),
+      static_cast<int>(mInternal->mBatchedMeshes.Size()), static_cast<int>(mInternal->mBatchedTextures.Size()), static_cast<int>(mInternal->mBatchedResidencyChanges.Size()));
+    // Part of the batch may have been submitted early when the ring filled up and can still be writing these resources
+    uploader.WaitForIdle();
+
+    for(const Mesh* mesh : mInternal->mBatchedMeshes)
+      DestroyMesh(mesh);
+    for(const Texture* texture : mInternal->mBatchedResidencyChanges)
+    {
+      VulkanImage* vulkanImage = mTextureMap.FindValue(texture, nullptr);
+      if(vulkanImage != nullptr)
+        CancelTextureResidencyInternal(vulkanImage);
+    }
+    for(const Texture* texture : mInternal->mBatchedTextures)
+      DestroyTexture(texture);
+    // Only meshes from this batch could be using it, it's created again with the next mesh
+    if(mInternal->mBatchedDefaultAttributeBuffer)
+    {
+      vkDestroyBuffer(mInternal->mDevice, mInternal->mDefaultAttributeBuffer, nullptr);
+      mInternal->mAllocator.Free(mInternal->mDefaultAttributeBufferAllocation);
+      mInternal->mDefaultAttributeBuffer = VK_NULL_HANDLE;
+    }
+  }
+
+  mInternal->mBatchedMeshes.Clear();
+  mInternal->mBatchedTextures.Clear();
+  mInternal->mBatchedResidencyChanges.Clear();
+  mInternal->mBatchedDefaultAttributeBuffer = false;
+}
+
 void VulkanRenderer::CreateDepthResourcesInternal()
 {
   mInternal->mDepthFormat = FindDepthFormat(mInternal->mPhysicalDevice);
@@ -559,13 +1107,11 @@ void VulkanRenderer::CreateDepthResourcesInternal()
   CreateImage(imageInfo, mInternal->mDepthImage.mImage);
 
   ImageMemoryCreationInfo memoryInfo;
+  memoryInfo.mAllocator = &mInternal->mAllocator;
   memoryInfo.mImage = mInternal->mDepthImage.mImage;
-  memoryInfo.mDevice = mInternal->mDevice;
-  memoryInfo.mPhysicalDevice = mInternal->mPhysicalDevice;
   memoryInfo.mProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-  CreateImageMemory(memoryInfo, mInternal->mDepthImage.mImageMemory);
-
-  vkBindImageMemory(mInternal->mDevice, mInternal->mDepthImage.mImage, mInternal->mDepthImage.mImageMemory, 0);
+  memoryInfo.mTiling = imageInfo.mTiling;
+  CreateImageMemory(memoryInfo, mInternal->mDepthImage.mImageAllocation);
 
   ImageViewCreationInfo viewCreationInfo(mInternal->mDevice, mInternal->mDepthImage.mImage);
   viewCreationInfo.mFormat = mInternal->mDepthFormat;
@@ -588,5 +1134,5 @@ void VulkanRenderer::CreateDepthResourcesInternal()
 
 void VulkanRenderer::DestroyDepthResourcesInternal()
 {
-  ::Cleanup(mInternal->mDevice, mInternal->mDepthImage);
+  ::Cleanup(mInternal->mDevice, mInternal->mAllocator, mInternal->mDepthImage);
 }
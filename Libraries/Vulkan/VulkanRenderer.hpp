@@ -4,9 +4,11 @@
 #include "Graphics/Renderer.hpp"
 #include "Graphics/GraphicsBufferTypes.hpp"
 #include "VulkanRendererInit.hpp"
+#include "VulkanMemoryAllocator.hpp"
 
 struct Mesh;
 struct Texture;
+enum class TextureFormat;
 struct ZilchShader;
 struct RenderQueue;
 
@@ -15,18 +17,11 @@ struct VulkanMesh;
 struct VulkanShader;
 struct VulkanImage;
 struct VulkanRenderFrame;
+struct RenderGraphPass;
 struct VulkanShaderMaterial;
 struct VulkanUniformBuffers;
 class VulkanRenderer;
 
-enum class RenderFrameStatus
-{
-  Success = 0,
-  OutOfDate,
-  SubOptimal,
-  Error
-};
-
 class VulkanRenderer : public Renderer
 {
 public:
@@ -35,15 +30,16 @@ public:
 
   void Initialize(const VulkanInitializationData& initData);
   void Cleanup();
-  void CleanupResources();
+  virtual void CleanupResources() override;
   virtual void Shutdown() override;
   virtual void Destroy() override;
 
   virtual void CreateMesh(const Mesh* mesh) override;
   virtual void DestroyMesh(const Mesh* mesh) override;
 
-  virtual void CreateTexture(const Texture* texture) override;
+  virtual void CreateTexture(const Texture* texture, uint32_t firstMip) override;
   virtual void DestroyTexture(const Texture* texture) override;
+  virtual void SetTextureResidency(const Texture* texture, uint32_t firstMip) override;
 
   virtual void CreateShader(const ZilchShader* zilchShader) override;
   virtual void DestroyShader(const ZilchShader* zilchShader) override;
@@ -53,20 +49,29 @@ public:
   virtual void UploadShaderMaterialInstances(MaterialBatchUploadData& materialBatchUploadData) override;
   virtual void DestroyShaderMaterial(const ZilchShader* zilchShader) override;
 
-  RenderFrameStatus BeginFrame();
-  RenderFrameStatus EndFrame();
+  virtual RenderFrameStatus BeginFrame() override;
+  virtual RenderFrameStatus EndFrame() override;
   virtual void DrawRenderQueue(RenderQueue& renderQueue) override;
   virtual void WaitForIdle() override;
 
+  virtual void BeginUploadBatch() override;
+  virtual void EndUploadBatch() override;
+
   virtual void Reshape(size_t width, size_t height, float aspectRatio) override;
   virtual void GetShape(size_t& width, size_t& height, float& aspectRatio) const override;
+  virtual void CreateSwapChain() override;
+  virtual void DestroySwapChain() override;
 
   virtual Matrix4 BuildPerspectiveMatrix(float verticalFov, float aspectRatio, float nearDistance, float farDistance) const override;
+  virtual bool SupportsGpuCulling() const override;
+  virtual bool SupportsTextureStreaming() const override;
 
   void* MapGlobalUniformBufferMemory(const String& bufferName, uint32_t bufferId);
   void* MapPerFrameUniformBufferMemory(const String& bufferName, uint32_t bufferId, uint32_t frameIndex);
-  void UnMapGlobalUniformBufferMemory(const String& bufferName, uint32_t bufferId);
-  void UnMapPerFrameUniformBufferMemory(const String& bufferName, uint32_t bufferId, uint32_t frameIndex);
+  /// True if the last swap chain recreation changed the image count or format. Shader materials
+  /// (pipelines and per-frame descriptor sets) have to be rebuilt when this happens.
+  virtual bool SwapChainLayoutChanged() const override;
+  void GetMemoryStatistics(VulkanMemoryStatistics& outStatistics) const;
   size_t AlignUniformBufferOffset(size_t offset);
   
 //private:
@@ -78,10 +83,26 @@ public:
   void RecreateFramesInternal();
   void CreateSwapChainInternal();
   void DestroySwapChainInternal();
+  void CreateOffscreenImagesInternal();
+  void DestroyOffscreenImagesInternal();
   void CreateRenderFramesInternal();
   void DestroyRenderFramesInternal();
-  void CreateImageInternal(const Texture* texture, VulkanImage* image);
+  void CreateRenderPassInternal();
+  void DestroyRenderPassInternal();
+  VkRenderPass FindOrCreateRenderPassInternal(const RenderGraphPass& pass);
+  void CreateTransientTargetsInternal(VulkanRenderFrame& renderFrame, size_t count);
+  void DestroyTransientTargetsInternal(VulkanRenderFrame& renderFrame);
+  void CreateImageInternal(const Texture* texture, VulkanImage* image, uint32_t firstMip);
   void CreateImageViewInternal(const Texture* texture, VulkanImage* image);
+  /// The format the texture's image is created with, which differs from the texture's own when the device can't sample it.
+  TextureFormat GetImageFormatInternal(const Texture* texture) const;
+  void ApplyTextureResidencyInternal();
+  void UpdateStaleMaterialsInternal(uint32_t imageIndex);
+  void DestroyRetiredImagesInternal(uint32_t frameIndex);
+  void RetireCanceledImagesInternal(uint32_t frameIndex);
+  void CancelTextureResidencyInternal(VulkanImage* vulkanImage);
+  /// Ends an upload batch. If the outermost batch failed to submit, everything uploaded in it is destroyed again.
+  void EndUploadBatchInternal();
   void CreateDepthResourcesInternal();
   void DestroyDepthResourcesInternal();
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include "VulkanStandard.hpp"
 #include "VulkanStatus.hpp"
 
 struct SurfaceCreationDelegate
@@ -15,6 +16,16 @@ struct VulkanInitializationData
   size_t mWidth;
   size_t mHeight;
   SurfaceCreationDelegate mSurfaceCreationCallback;
+  // Renders into offscreen images instead of a swap chain. No surface or present queue is required.
+  bool mHeadless = false;
+  // Where the pipeline cache is loaded from and saved to. Empty disables persisting it.
+  String mPipelineCachePath;
+  // Compiled compute shader used for gpu culling. Empty or missing leaves culling on the cpu.
+  String mGpuCullingShaderPath;
+  // Compiled compute shader that culls mesh clusters. Empty, missing or a device without multi draw indirect culls clusters on the cpu.
+  String mClusterCullingShaderPath;
+  // Worker threads used to record command buffers. Zero picks one per hardware thread.
+  size_t mRecordingThreadCount = 0;
 };
 
 constexpr const char* TransformsBufferName = "Transforms";
@@ -5,7 +5,10 @@
 #include "VulkanRenderer.hpp"
 #include "VulkanInitialization.hpp"
 #include "VulkanCommandBuffer.hpp"
+#include "VulkanGpuCulling.hpp"
 #include "RenderQueue.hpp"
+#include "Graphics/FrustumCulling.hpp"
+#include "Graphics/Mesh.hpp"
 
 uint32_t GetFrameId(RendererData& rendererData)
 {
@@ -40,105 +43,491 @@ void PopulateGlobalBuffers(RendererData& rendererData, const RenderQueue& render
     cameraData.mViewportSize = viewBlock.mViewportSize;
     offset += renderer.AlignUniformBufferOffset(sizeof(cameraData));
   }
-  renderer.UnMapPerFrameUniformBufferMemory(GlobalsBufferName, 0, frameId);
 }
 
-void PopulateTransformBuffers(RendererData& rendererData, const ViewBlock& viewBlock, const RenderGroupRenderTask& renderGroupTask)
+void PopulateTransformBuffers(RendererData& rendererData, const ViewBlock& viewBlock, const RenderGroupRenderTask& renderGroupTask, RenderGroupBatches& batches)
 {
-  VulkanRenderer& renderer = *rendererData.mRenderer;
+  VulkanRuntimeData& runtimeData = *rendererData.mRuntimeData;
   uint32_t frameId = GetFrameId(rendererData);
+  VulkanRenderFrame& vulkanRenderFrame = runtimeData.mRenderFrames[frameId];
   TransformData transformData;
 
   transformData.mPerspectiveToApiPerspective.SetIdentity();
   transformData.mWorldToView = viewBlock.mWorldToView;
   transformData.mViewToPerspective = viewBlock.mViewToPerspective;
 
-  byte* data = static_cast<byte*>(renderer.MapPerFrameUniformBufferMemory(TransformsBufferName, 0, frameId));
+  // Per object transforms come from the instance stream so the whole group shares one block.
+  // That keeps the dynamic offset the same for every draw and the descriptor set only changes with the shader.
+  // Every group gets its own block so views don't overwrite each other before the frame is submitted.
+  VulkanUniformBuffer* transformsBuffer = runtimeData.mBufferManager.FindOrCreatePerFrameBuffer(TransformsBufferName, 0, frameId);
+  VkDeviceSize uniformAlignment = runtimeData.mDeviceLimits.mMinUniformBufferOffsetAlignment;
+  batches.mTransforms = SubAllocateUniformBuffer(*transformsBuffer, sizeof(TransformData), uniformAlignment);
+  ErrorIf(batches.mTransforms.mData == nullptr, "Per-frame transform buffer is full");
+  if(batches.mTransforms.mData != nullptr)
+    memcpy(batches.mTransforms.mData, &transformData, sizeof(transformData));
 
-  size_t offset = 0;
-  size_t objCount = renderGroupTask.mFrameData.Size();
-  for(size_t i = 0; i < objCount; ++i)
+  size_t instanceCount = batches.mInstanceOrder.Size();
+  FindClusterBatches(rendererData, renderGroupTask, batches);
+  batches.mCullOnGpu = renderGroupTask.mCullOnGpu && runtimeData.mGpuCulling.IsAvailable() && instanceCount != 0;
+  if(batches.mCullOnGpu)
+    PopulateGpuCullingBuffers(rendererData, renderGroupTask, batches);
+  else
   {
-    const GraphicalFrameData& graphicalFrameData = renderGroupTask.mFrameData[i];
-    transformData.mLocalToWorld = graphicalFrameData.mLocalToWorld;
-    byte* memory = data + offset + renderer.AlignUniformBufferOffset(sizeof(TransformData)) * i;
-    memcpy(memory, &transformData, sizeof(transformData));
+    // Storage aligned since the cluster culling shader can read the stream
+    VkDeviceSize storageAlignment = Math::Max(runtimeData.mDeviceLimits.mMinStorageBufferOffsetAlignment, static_cast<VkDeviceSize>(sizeof(Vec4)));
+    batches.mInstances = vulkanRenderFrame.mFrameAllocator.Allocate(sizeof(InstanceData) * instanceCount, storageAlignment);
+    if(instanceCount != 0 && batches.mInstances.mData == nullptr)
+    {
+      ErrorIf(true, "Failed to allocate the instance stream");
+      batches.mBatches.Clear();
+      batches.mClusterBatches.Clear();
+      return;
+    }
+    InstanceData* instanceData = static_cast<InstanceData*>(batches.mInstances.mData);
+    for(size_t i = 0; i < instanceCount; ++i)
+    {
+      const GraphicalFrameData& frameData = renderGroupTask.mFrameData[batches.mInstanceOrder[i]];
+      FilloutInstanceData(frameData.mLocalToWorld, frameData.mMesh, instanceData[i]);
+    }
   }
-  renderer.UnMapPerFrameUniformBufferMemory(TransformsBufferName, 0, frameId);
+  PopulateClusterBatches(rendererData, viewBlock, renderGroupTask, batches);
 }
 
-void DrawModels(RendererData& rendererData, const ViewBlock& viewBlock, const RenderGroupRenderTask& renderGroupTask)
+void PopulateGpuCullingBuffers(RendererData& rendererData, const RenderGroupRenderTask& renderGroupTask, RenderGroupBatches& batches)
 {
   VulkanRenderer& renderer = *rendererData.mRenderer;
   VulkanRuntimeData& runtimeData = *rendererData.mRuntimeData;
-  uint32_t frameId = GetFrameId(rendererData);
-  VulkanRenderFrame& vulkanRenderFrame = runtimeData.mRenderFrames[frameId];
-  VkCommandBuffer commandBuffer = vulkanRenderFrame.mCommandBuffer;
-  size_t objCount = renderGroupTask.mFrameData.Size();
+  VulkanFrameAllocator& frameAllocator = runtimeData.mRenderFrames[GetFrameId(rendererData)].mFrameAllocator;
+  VkDeviceSize storageAlignment = Math::Max(runtimeData.mDeviceLimits.mMinStorageBufferOffsetAlignment, static_cast<VkDeviceSize>(sizeof(Vec4)));
+  size_t instanceCount = batches.mInstanceOrder.Size();
+  size_t batchCount = batches.mBatches.Size();
 
-  uint32_t dynamicOffsets[1] =
+  // The shader writes the visible instances here so nothing is uploaded
+  batches.mInstances = frameAllocator.Allocate(sizeof(InstanceData) * instanceCount, storageAlignment);
+  batches.mCullObjects = frameAllocator.Allocate(sizeof(CullObject) * instanceCount, storageAlignment);
+  batches.mDrawCommands = frameAllocator.Allocate(sizeof(VkDrawIndexedIndirectCommand) * batchCount, storageAlignment);
+  if(batches.mInstances.mData == nullptr || batches.mCullObjects.mData == nullptr || batches.mDrawCommands.mData == nullptr)
   {
-    static_cast<uint32_t>(renderer.AlignUniformBufferOffset(sizeof(TransformData)))
-  };
+    ErrorIf(true, "Failed to allocate gpu culling buffers");
+    batches.mBatches.Clear();
+    batches.mClusterBatches.Clear();
+    return;
+  }
 
-  uint32_t baseOffset = 0;
-  uint32_t dynamicOffsetBase[1] = {baseOffset};
-  CommandBufferWriteInfo writeInfo;
-  writeInfo.mDevice = renderer.mInternal->mDevice;
-  writeInfo.mCommandPool = renderer.mInternal->mCommandPool;
-  writeInfo.mRenderPass = renderer.mInternal->mRenderFrames[0].mRenderPass;
-  writeInfo.mSwapChain = renderer.mInternal->mSwapChain.mSwapChain;
-  writeInfo.mSwapChainExtent = renderer.mInternal->mSwapChain.mExtent;
-  writeInfo.mSwapChainFramebuffer = vulkanRenderFrame.mFrameBuffer;
-  writeInfo.mDrawCount = static_cast<uint32_t>(objCount);
-  writeInfo.mDynamicOffsetsCount = 1;
-  writeInfo.mDynamicOffsetsBase = dynamicOffsetBase;
-  writeInfo.mDynamicOffsets = dynamicOffsets;
+  // Instance counts start at zero and the shader appends every visible instance to its batch's range.
+  // A batch keeps its whole range reserved so the instance stream never has to be compacted across batches.
+  CullObject* cullObjects = static_cast<CullObject*>(batches.mCullObjects.mData);
+  VkDrawIndexedIndirectCommand* drawCommands = static_cast<VkDrawIndexedIndirectCommand*>(batches.mDrawCommands.mData);
+  InstanceData* instanceData = static_cast<InstanceData*>(batches.mInstances.mData);
+  batches.mCullObjectCount = 0;
+  for(size_t batchIndex = 0; batchIndex < batchCount; ++batchIndex)
+  {
+    const InstanceBatch& batch = batches.mBatches[batchIndex];
+    VulkanMesh* vulkanMesh = renderer.mMeshMap.FindValue(batch.mMesh, nullptr);
 
-  BeginCommandBuffer(commandBuffer);
-  BeginRenderPass(writeInfo, commandBuffer);
+    VkDrawIndexedIndirectCommand& drawCommand = drawCommands[batchIndex];
+    MeshLod lod = batch.mMesh->GetLod(batch.mLod);
+    drawCommand.indexCount = vulkanMesh != nullptr ? lod.mIndexCount : 0;
+    drawCommand.instanceCount = 0;
+    drawCommand.firstIndex = lod.mIndexOffset;
+    drawCommand.vertexOffset = 0;
+    drawCommand.firstInstance = batch.mFirstInstance;
+
+    // Clustered batches are culled per cluster instead, their instances go straight into the stream
+    if(batches.mBatchClusters[batchIndex] != cInvalidClusterBatch)
+    {
+      for(uint32_t i = batch.mFirstInstance; i < batch.mFirstInstance + batch.mInstanceCount; ++i)
+      {
+        const GraphicalFrameData& frameData = renderGroupTask.mFrameData[batches.mInstanceOrder[i]];
+        FilloutInstanceData(frameData.mLocalToWorld, frameData.mMesh, instanceData[i]);
+      }
+      continue;
+    }
+
+    for(uint32_t i = batch.mFirstInstance; i < batch.mFirstInstance + batch.mInstanceCount; ++i)
+    {
+      const GraphicalFrameData& frameData = renderGroupTask.mFrameData[batches.mInstanceOrder[i]];
+      CullObject& cullObject = cullObjects[batches.mCullObjectCount++];
+      FilloutInstanceData(frameData.mLocalToWorld, frameData.mMesh, cullObject.mInstanceData);
+      cullObject.mBoundingSphere = frameData.mWorldBoundingSphere;
+      cullObject.mBatchIndex = static_cast<uint32_t>(batchIndex);
+    }
+  }
+}
+
+// Caps the frame memory one batch's indirect draws can take, batches with more instance and cluster pairs are culled on the cpu
+constexpr size_t cMaxGpuClusterDraws = 256 * 1024;
+
+void FindClusterBatches(RendererData& rendererData, const RenderGroupRenderTask& renderGroupTask, RenderGroupBatches& batches)
+{
+  VulkanRenderer& renderer = *rendererData.mRenderer;
+  bool gpuAvailable = renderGroupTask.mCullClustersOnGpu && rendererData.mRuntimeData->mGpuCulling.IsClusterCullingAvailable();
+  batches.mClusterBatches.Clear();
+  batches.mClusterDraws.Clear();
+  batches.mBatchClusters.Clear();
+  batches.mBatchClusters.Resize(batches.mBatches.Size(), cInvalidClusterBatch);
+  for(size_t i = 0; i < batches.mBatches.Size(); ++i)
+  {
+    // Coarser lods are only drawn far enough away that culling them whole is enough
+    const InstanceBatch& batch = batches.mBatches[i];
+    if(batch.mLod != 0 || batch.mMesh->mClusters.Empty())
+      continue;
+    VulkanMesh* vulkanMesh = renderer.mMeshMap.FindValue(batch.mMesh, nullptr);
+    if(vulkanMesh == nullptr)
+      continue;
+
+    batches.mBatchClusters[i] = static_cast<uint32_t>(batches.mClusterBatches.Size());
+    ClusterBatch& clusterBatch = batches.mClusterBatches.PushBack();
+    clusterBatch.mBatchIndex = static_cast<uint32_t>(i);
+    size_t pairCount = static_cast<size_t>(vulkanMesh->mClusterCount) * batch.mInstanceCount;
+    clusterBatch.mCullOnGpu = gpuAvailable && vulkanMesh->mClusterBuffer != VK_NULL_HANDLE && pairCount <= cMaxGpuClusterDraws;
+  }
+}
+
+void PopulateClusterBatches(RendererData& rendererData, const ViewBlock& viewBlock, const RenderGroupRenderTask& renderGroupTask, RenderGroupBatches& batches)
+{
+  VulkanRuntimeData& runtimeData = *rendererData.mRuntimeData;
+  VulkanFrameAllocator& frameAllocator = runtimeData.mRenderFrames[GetFrameId(rendererData)].mFrameAllocator;
+  VkDeviceSize storageAlignment = Math::Max(runtimeData.mDeviceLimits.mMinStorageBufferOffsetAlignment, static_cast<VkDeviceSize>(sizeof(Vec4)));
+  for(ClusterBatch& clusterBatch : batches.mClusterBatches)
+  {
+    const InstanceBatch& batch = batches.mBatches[clusterBatch.mBatchIndex];
+    const Array<MeshCluster>& clusters = batch.mMesh->mClusters;
+    if(clusterBatch.mCullOnGpu)
+    {
+      clusterBatch.mDrawCount = static_cast<uint32_t>(clusters.Size()) * batch.mInstanceCount;
+      clusterBatch.mDrawCommands = frameAllocator.Allocate(sizeof(VkDrawIndexedIndirectCommand) * clusterBatch.mDrawCount, storageAlignment);
+      if(clusterBatch.mDrawCommands.mData != nullptr)
+        continue;
+      clusterBatch.mCullOnGpu = false;
+    }
+    CullClusterBatchOnCpu(viewBlock, renderGroupTask, batches, clusterBatch);
+  }
+}
 
-  for(size_t i = 0; i < objCount; ++i)
+void CullClusterBatchOnCpu(const ViewBlock& viewBlock, const RenderGroupRenderTask& renderGroupTask, RenderGroupBatches& batches, ClusterBatch& clusterBatch)
+{
+  const InstanceBatch& batch = batches.mBatches[clusterBatch.mBatchIndex];
+  const Array<MeshCluster>& clusters = batch.mMesh->mClusters;
+  Vec3 cameraPosition = Math::MultiplyPoint(viewBlock.mWorldToView.Inverted(), Vec3::cZero);
+
+  // Neighboring clusters are neighboring index ranges, so runs of visible ones are merged into one draw
+  clusterBatch.mFirstDraw = static_cast<uint32_t>(batches.mClusterDraws.Size());
+  for(uint32_t i = batch.mFirstInstance; i < batch.mFirstInstance + batch.mInstanceCount; ++i)
   {
-    const GraphicalFrameData& graphicalFrameData = renderGroupTask.mFrameData[i];
-    VulkanMesh* vulkanMesh = renderer.mMeshMap.FindValue(graphicalFrameData.mMesh, nullptr);
-    VulkanShaderMaterial* vulkanShaderMaterial = renderer.mUniqueZilchShaderMaterialMap.FindValue(graphicalFrameData.mZilchShader, nullptr);
-    if(vulkanShaderMaterial != nullptr)
+    const GraphicalFrameData& frameData = renderGroupTask.mFrameData[batches.mInstanceOrder[i]];
+    Vec3 localCameraPosition = Math::MultiplyPoint(frameData.mLocalToWorld.Inverted(), cameraPosition);
+    ClusterDraw* lastDraw = nullptr;
+    for(const MeshCluster& cluster : clusters)
     {
-      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanShaderMaterial->mPipeline);
+      Vec3 center;
+      float radius;
+      TransformBoundingSphere(frameData.mLocalToWorld, cluster.mCenter, cluster.mRadius, center, radius);
+      if(!IsSphereVisible(viewBlock.mFrustum, center.x, center.y, center.z, radius) || IsClusterBackFacing(cluster, localCameraPosition))
+        continue;
+
+      if(lastDraw != nullptr && lastDraw->mFirstIndex + lastDraw->mIndexCount == cluster.mIndexOffset)
+      {
+        lastDraw->mIndexCount += cluster.mIndexCount;
+        continue;
+      }
+      lastDraw = &batches.mClusterDraws.PushBack();
+      lastDraw->mFirstIndex = cluster.mIndexOffset;
+      lastDraw->mIndexCount = cluster.mIndexCount;
+      lastDraw->mInstance = i;
+    }
+  }
+  clusterBatch.mDrawCount = static_cast<uint32_t>(batches.mClusterDraws.Size()) - clusterBatch.mFirstDraw;
+}
+
+// Below this many batches a render group is recorded by a single thread
+constexpr size_t cMinDrawsPerRecordingChunk = 64;
+
+VkCommandBuffer AcquireSecondaryCommandBuffer(VkDevice device, VulkanThreadCommandPool& threadPool)
+{
+  if(threadPool.mUsedCount == threadPool.mSecondaryCommandBuffers.Size())
+  {
+    VkCommandBuffer& commandBuffer = threadPool.mSecondaryCommandBuffers.PushBack();
+    CreateCommandBuffer(device, threadPool.mCommandPool, &commandBuffer, 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+  }
+  return threadPool.mSecondaryCommandBuffers[threadPool.mUsedCount++];
+}
+
+void ResetThreadCommandPools(RendererData& rendererData)
+{
+  VulkanRuntimeData& runtimeData = *rendererData.mRuntimeData;
+  VulkanRenderFrame& vulkanRenderFrame = runtimeData.mRenderFrames[GetFrameId(rendererData)];
+  for(VulkanThreadCommandPool& threadPool : vulkanRenderFrame.mThreadCommandPools)
+  {
+    vkResetCommandPool(runtimeData.mDevice, threadPool.mCommandPool, 0);
+    threadPool.mUsedCount = 0;
+  }
+}
+
+void DrawClusterBatch(RendererData& rendererData, const RenderGroupBatches& batches, const ClusterBatch& clusterBatch, VkCommandBuffer commandBuffer)
+{
+  if(!clusterBatch.mCullOnGpu)
+  {
+    for(uint32_t i = clusterBatch.mFirstDraw; i < clusterBatch.mFirstDraw + clusterBatch.mDrawCount; ++i)
+    {
+      const ClusterDraw& draw = batches.mClusterDraws[i];
+      vkCmdDrawIndexed(commandBuffer, draw.mIndexCount, 1, draw.mFirstIndex, 0, draw.mInstance);
+    }
+    return;
+  }
+
+  // Culled pairs have no instances and cost next to nothing, so every pair is drawn in as few calls as the device allows
+  const uint32_t drawCommandStride = sizeof(VkDrawIndexedIndirectCommand);
+  uint32_t maxDrawCount = Math::Max(rendererData.mRuntimeData->mDeviceLimits.mMaxDrawIndirectCount, 1u);
+  for(uint32_t first = 0; first < clusterBatch.mDrawCount; first += maxDrawCount)
+  {
+    uint32_t drawCount = Math::Min(maxDrawCount, clusterBatch.mDrawCount - first);
+    vkCmdDrawIndexedIndirect(commandBuffer, clusterBatch.mDrawCommands.mBuffer, clusterBatch.mDrawCommands.mOffset + first * drawCommandStride, drawCount, drawCommandStride);
+  }
+}
 
+void RecordDrawChunk(RendererData& rendererData, const RenderGroupBatches& batches, const CommandBufferWriteInfo& writeInfo, size_t start, size_t end, VkCommandBuffer commandBuffer)
+{
+  VulkanRenderer& renderer = *rendererData.mRenderer;
+  uint32_t frameId = GetFrameId(rendererData);
+
+  BeginSecondaryCommandBuffer(commandBuffer, writeInfo.mRenderPass, writeInfo.mSwapChainFramebuffer);
+  SetViewportAndScissor(commandBuffer, writeInfo.mSwapChainExtent);
+
+  // Batches index into the group's instance range with firstInstance so it's only bound once
+  vkCmdBindVertexBuffers(commandBuffer, VulkanVertex::cInstanceBinding, 1, &batches.mInstances.mBuffer, &batches.mInstances.mOffset);
+  VkDeviceSize defaultAttributeOffset = 0;
+  vkCmdBindVertexBuffers(commandBuffer, VulkanVertex::cDefaultAttributeBinding, 1, &rendererData.mRuntimeData->mDefaultAttributeBuffer, &defaultAttributeOffset);
+  const uint32_t drawCommandStride = sizeof(VkDrawIndexedIndirectCommand);
+
+  // Batches arrive in draw key order so consecutive ones usually share a pipeline or mesh.
+  // Only bind what actually changed since the last draw in this command buffer.
+  VulkanShaderMaterial* boundShaderMaterial = nullptr;
+  VkPipeline boundPipeline = VK_NULL_HANDLE;
+  VulkanMesh* boundMesh = nullptr;
+  for(size_t i = start; i < end; ++i)
+  {
+    const InstanceBatch& batch = batches.mBatches[i];
+    VulkanMesh* vulkanMesh = renderer.mMeshMap.FindValue(batch.mMesh, nullptr);
+    VulkanShaderMaterial* vulkanShaderMaterial = renderer.mUniqueZilchShaderMaterialMap.FindValue(batch.mZilchShader, nullptr);
+    if(vulkanMesh == nullptr || vulkanShaderMaterial == nullptr)
+      continue;
+    // Meshes with different vertex formats use different pipelines of the same shader
+    VkPipeline pipeline = vulkanShaderMaterial->mPipelines.FindValue(vulkanMesh->mVertexFormat.mAttributes, VK_NULL_HANDLE);
+    if(pipeline == VK_NULL_HANDLE)
+      continue;
+
+    if(pipeline != boundPipeline)
+    {
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+      boundPipeline = pipeline;
+    }
+    if(vulkanShaderMaterial != boundShaderMaterial)
+    {
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanShaderMaterial->mPipelineLayout, 0, 1, &vulkanShaderMaterial->mDescriptorSets[frameId], writeInfo.mDynamicOffsetsCount, writeInfo.mDynamicOffsets);
+      boundShaderMaterial = vulkanShaderMaterial;
+    }
+    if(vulkanMesh != boundMesh)
+    {
       VkBuffer vertexBuffers[] = {vulkanMesh->mVertexBuffer};
       VkDeviceSize offsets[] = {0};
       vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
       vkCmdBindIndexBuffer(commandBuffer, vulkanMesh->mIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+      boundMesh = vulkanMesh;
+    }
+    uint32_t clusterBatchIndex = batches.mBatchClusters.Empty() ? cInvalidClusterBatch : batches.mBatchClusters[i];
+    if(clusterBatchIndex != cInvalidClusterBatch)
+      DrawClusterBatch(rendererData, batches, batches.mClusterBatches[clusterBatchIndex], commandBuffer);
+    // Every batch binds a different mesh or draws a different lod so the indirect draws can't be merged into one call
+    else if(batches.mCullOnGpu)
+      vkCmdDrawIndexedIndirect(commandBuffer, batches.mDrawCommands.mBuffer, batches.mDrawCommands.mOffset + i * drawCommandStride, 1, drawCommandStride);
+    else
+    {
+      MeshLod lod = batch.mMesh->GetLod(batch.mLod);
+      vkCmdDrawIndexed(commandBuffer, lod.mIndexCount, batch.mInstanceCount, lod.mIndexOffset, 0, batch.mFirstInstance);
+    }
+  }
 
-      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanShaderMaterial->mPipelineLayout, 0, 1, &vulkanShaderMaterial->mDescriptorSets[frameId], writeInfo.mDynamicOffsetsCount, writeInfo.mDynamicOffsetsBase);
-      vkCmdDrawIndexed(commandBuffer, vulkanMesh->mIndexCount, 1, 0, 0, 0);
+  EndCommandBuffer(commandBuffer);
+}
+
+void CullInstancesOnCpu(const ViewBlock& viewBlock, const RenderGroupBatches& batches)
+{
+  // Does what CullInstances.comp would have, the buffers are still host visible since nothing was submitted
+  const CullObject* cullObjects = static_cast<const CullObject*>(batches.mCullObjects.mData);
+  VkDrawIndexedIndirectCommand* drawCommands = static_cast<VkDrawIndexedIndirectCommand*>(batches.mDrawCommands.mData);
+  InstanceData* instanceData = static_cast<InstanceData*>(batches.mInstances.mData);
+  for(uint32_t i = 0; i < batches.mCullObjectCount; ++i)
+  {
+    const CullObject& cullObject = cullObjects[i];
+    const Vec4& sphere = cullObject.mBoundingSphere;
+    if(!IsSphereVisible(viewBlock.mFrustum, sphere.x, sphere.y, sphere.z, sphere.w))
+      continue;
+
+    VkDrawIndexedIndirectCommand& drawCommand = drawCommands[cullObject.mBatchIndex];
+    instanceData[drawCommand.firstInstance + drawCommand.instanceCount++] = cullObject.mInstanceData;
+  }
+}
+
+void RecordRenderGroupCulling(RendererData& rendererData, const ViewBlock& viewBlock, const RenderGroupRenderTask& renderGroupTask, RenderGroupBatches& batches, VkCommandBuffer commandBuffer)
+{
+  VulkanRuntimeData& runtimeData = *rendererData.mRuntimeData;
+  VulkanRenderFrame& vulkanRenderFrame = runtimeData.mRenderFrames[GetFrameId(rendererData)];
+  VulkanRenderer& renderer = *rendererData.mRenderer;
+  size_t instanceCount = batches.mInstanceOrder.Size();
+  size_t batchCount = batches.mBatches.Size();
+
+  if(batches.mCullOnGpu && batches.mCullObjectCount != 0)
+  {
+    GpuCullingDispatchInfo dispatchInfo;
+    dispatchInfo.mDevice = runtimeData.mDevice;
+    dispatchInfo.mDescriptorAllocator = &vulkanRenderFrame.mDescriptorAllocator;
+    dispatchInfo.mFrustum = &viewBlock.mFrustum;
+    dispatchInfo.mObjectCount = batches.mCullObjectCount;
+    dispatchInfo.mObjects = {batches.mCullObjects.mBuffer, batches.mCullObjects.mOffset, sizeof(CullObject) * batches.mCullObjectCount};
+    dispatchInfo.mDrawCommands = {batches.mDrawCommands.mBuffer, batches.mDrawCommands.mOffset, sizeof(VkDrawIndexedIndirectCommand) * batchCount};
+    dispatchInfo.mInstances = {batches.mInstances.mBuffer, batches.mInstances.mOffset, sizeof(InstanceData) * instanceCount};
+    VulkanStatus status = RecordGpuCulling(runtimeData.mGpuCulling, dispatchInfo, commandBuffer);
+    if(!status)
+    {
+      Warn("Gpu culling failed (%s), culling the group on the cpu", status.mErrorMessage.c_str());
+      CullInstancesOnCpu(viewBlock, batches);
     }
+  }
 
-    for(size_t j = 0; j < writeInfo.mDynamicOffsetsCount; ++j)
-      writeInfo.mDynamicOffsetsBase[j] += writeInfo.mDynamicOffsets[j];
+  Vec3 cameraPosition = Math::MultiplyPoint(viewBlock.mWorldToView.Inverted(), Vec3::cZero);
+  for(ClusterBatch& clusterBatch : batches.mClusterBatches)
+  {
+    if(!clusterBatch.mCullOnGpu)
+      continue;
+    const InstanceBatch& batch = batches.mBatches[clusterBatch.mBatchIndex];
+    VulkanMesh* vulkanMesh = renderer.mMeshMap.FindValue(batch.mMesh, nullptr);
+
+    GpuClusterCullingDispatchInfo dispatchInfo;
+    dispatchInfo.mDevice = runtimeData.mDevice;
+    dispatchInfo.mDescriptorAllocator = &vulkanRenderFrame.mDescriptorAllocator;
+    dispatchInfo.mFrustum = &viewBlock.mFrustum;
+    dispatchInfo.mCameraPosition = cameraPosition;
+    dispatchInfo.mClusterCount = vulkanMesh->mClusterCount;
+    dispatchInfo.mFirstInstance = batch.mFirstInstance;
+    dispatchInfo.mInstanceCount = batch.mInstanceCount;
+    dispatchInfo.mClusters = {vulkanMesh->mClusterBuffer, 0, sizeof(GpuMeshCluster) * vulkanMesh->mClusterCount};
+    dispatchInfo.mInstances = {batches.mInstances.mBuffer, batches.mInstances.mOffset, sizeof(InstanceData) * instanceCount};
+    dispatchInfo.mDrawCommands = {clusterBatch.mDrawCommands.mBuffer, clusterBatch.mDrawCommands.mOffset, sizeof(VkDrawIndexedIndirectCommand) * clusterBatch.mDrawCount};
+    VulkanStatus status = RecordGpuClusterCulling(runtimeData.mGpuCulling, dispatchInfo, commandBuffer);
+    if(!status)
+    {
+      // The indirect draws were never written, draw the batch from cpu culled ranges instead
+      Warn("Gpu cluster culling failed (%s), culling the batch on the cpu", status.mErrorMessage.c_str());
+      clusterBatch.mCullOnGpu = false;
+      CullClusterBatchOnCpu(viewBlock, renderGroupTask, batches, clusterBatch);
+    }
   }
+}
+
+void DrawModels(RendererData& rendererData, const CommandBufferWriteInfo& passWriteInfo, const RenderGroupBatches& batches)
+{
+  VulkanRuntimeData& runtimeData = *rendererData.mRuntimeData;
+  VulkanRenderFrame& vulkanRenderFrame = runtimeData.mRenderFrames[GetFrameId(rendererData)];
+  size_t batchCount = batches.mBatches.Size();
+
+  // Every draw in the group reads the same transform block
+  uint32_t dynamicOffsets[1] = {static_cast<uint32_t>(batches.mTransforms.mOffset)};
+  CommandBufferWriteInfo writeInfo = passWriteInfo;
+  writeInfo.mDrawCount = static_cast<uint32_t>(batchCount);
+  writeInfo.mDynamicOffsetsCount = 1;
+  writeInfo.mDynamicOffsets = dynamicOffsets;
+
+  // Split the draws into contiguous chunks, one secondary command buffer each. The primary
+  // buffer executes them in chunk order so the draw order is the same as recording serially.
+  ThreadPool& threadPool = runtimeData.mThreadPool;
+  size_t threadCount = threadPool.GetThreadCount();
+  size_t chunkSize = Math::Max(cMinDrawsPerRecordingChunk, (batchCount + threadCount - 1) / threadCount);
+  size_t chunkCount = (batchCount + chunkSize - 1) / chunkSize;
+  Array<VkCommandBuffer> chunkCommandBuffers(chunkCount);
+  threadPool.ParallelFor(chunkCount, [&](size_t chunkIndex, size_t threadIndex)
+  {
+    VkCommandBuffer secondaryCommandBuffer = AcquireSecondaryCommandBuffer(runtimeData.mDevice, vulkanRenderFrame.mThreadCommandPools[threadIndex]);
+    size_t start = chunkIndex * chunkSize;
+    size_t end = Math::Min(start + chunkSize, batchCount);
+    RecordDrawChunk(rendererData, batches, writeInfo, start, end, secondaryCommandBuffer);
+    chunkCommandBuffers[chunkIndex] = secondaryCommandBuffer;
+  });
+
+  if(!chunkCommandBuffers.Empty())
+    vkCmdExecuteCommands(vulkanRenderFrame.mCommandBuffer, static_cast<uint32_t>(chunkCommandBuffers.Size()), chunkCommandBuffers.Data());
+}
+
+void DrawPass(RendererData& rendererData, const RenderGraphPass& pass, const Array<RenderGroupBatches>& passBatches)
+{
+  VulkanRenderer& renderer = *rendererData.mRenderer;
+  VulkanRuntimeData& runtimeData = *rendererData.mRuntimeData;
+  VulkanRenderFrame& vulkanRenderFrame = runtimeData.mRenderFrames[GetFrameId(rendererData)];
+  VkCommandBuffer commandBuffer = vulkanRenderFrame.mCommandBuffer;
+
+  CommandBufferWriteInfo writeInfo;
+  writeInfo.mDevice = runtimeData.mDevice;
+  writeInfo.mCommandPool = runtimeData.mCommandPool;
+  writeInfo.mRenderPass = renderer.FindOrCreateRenderPassInternal(pass);
+  writeInfo.mSwapChain = runtimeData.mSwapChain.mSwapChain;
+  writeInfo.mSwapChainExtent = runtimeData.mSwapChain.mExtent;
+  if(pass.mPhysicalTarget == 0)
+    writeInfo.mSwapChainFramebuffer = vulkanRenderFrame.mFrameBuffer;
+  else
+    writeInfo.mSwapChainFramebuffer = vulkanRenderFrame.mTransientTargets[pass.mPhysicalTarget - 1].mFrameBuffer;
+  writeInfo.mSubpassContents = VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+  writeInfo.mClearColor = {{pass.mClearColor.x, pass.mClearColor.y, pass.mClearColor.z, pass.mClearColor.w}};
+  writeInfo.mClearDepth = pass.mClearDepth;
 
+  BeginRenderPass(writeInfo, commandBuffer);
+  for(const RenderGroupBatches& batches : passBatches)
+  {
+    if(!batches.mBatches.Empty())
+      DrawModels(rendererData, writeInfo, batches);
+  }
   EndRenderPass(writeInfo, commandBuffer);
-  EndCommandBuffer(commandBuffer);
 }
 
 void ProcessRenderQueue(RendererData& rendererData, const RenderQueue& renderQueue)
 {
+  VulkanRenderer& renderer = *rendererData.mRenderer;
+  VulkanRuntimeData& runtimeData = *rendererData.mRuntimeData;
+  uint32_t frameId = GetFrameId(rendererData);
+  VulkanRenderFrame& vulkanRenderFrame = runtimeData.mRenderFrames[frameId];
+
+  // The frame's last submit has finished so everything it allocated can be reused
+  vulkanRenderFrame.mFrameAllocator.Reset();
+  runtimeData.mBufferManager.ResetPerFrameBuffers(frameId);
+  vulkanRenderFrame.mDescriptorAllocator.Reset();
+  ResetThreadCommandPools(rendererData);
+
+  RenderGraph& renderGraph = runtimeData.mRenderGraph;
+  renderGraph.Compile(renderQueue);
+  renderer.CreateTransientTargetsInternal(vulkanRenderFrame, renderGraph.GetPhysicalTargetCount() - 1);
+
   GlobalBufferOffset offsets;
   PopulateGlobalBuffers(rendererData, renderQueue, offsets);
-  for(const ViewBlock& viewBlock : renderQueue.mViewBlocks)
+
+  // Every pass of every view is recorded into the frame's one primary command buffer
+  VkCommandBuffer commandBuffer = vulkanRenderFrame.mCommandBuffer;
+  BeginCommandBuffer(commandBuffer);
+  Array<RenderGroupBatches> passBatches;
+  for(const RenderGraphPass& pass : renderGraph.mPasses)
   {
-    const FrameBlock& frameBlock = renderQueue.mFrameBlocks[viewBlock.mFrameBlockId];
-    for(const RenderTask* task : viewBlock.mRenderTaskEvent.mRenderTasks)
+    // Culling dispatches can't be recorded inside a render pass so every group in the pass is prepared up front
+    passBatches.Resize(pass.mDrawCount);
+    for(uint32_t i = 0; i < pass.mDrawCount; ++i)
     {
-      if(task->mTaskType == RenderTaskType::RenderGroup)
-      {
-        const RenderGroupRenderTask* renderGroupTask = reinterpret_cast<const RenderGroupRenderTask*>(task);
-        PopulateTransformBuffers(rendererData, viewBlock, *renderGroupTask);
-        DrawModels(rendererData, viewBlock, *renderGroupTask);
-      }
+      const RenderGraphDraw& draw = renderGraph.mDraws[pass.mFirstDraw + i];
+      RenderGroupBatches& batches = passBatches[i];
+      BuildInstanceBatches(*draw.mRenderGroupTask, batches.mBatches, batches.mInstanceOrder);
+      PopulateTransformBuffers(rendererData, *draw.mViewBlock, *draw.mRenderGroupTask, batches);
+      if(batches.mTransforms.mData == nullptr)
+        batches.mBatches.Clear();
+      if(!batches.mBatches.Empty())
+        RecordRenderGroupCulling(rendererData, *draw.mViewBlock, *draw.mRenderGroupTask, batches, commandBuffer);
     }
+    DrawPass(rendererData, pass, passBatches);
   }
+  EndCommandBuffer(commandBuffer);
 }
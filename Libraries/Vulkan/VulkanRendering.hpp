@@ -1,12 +1,58 @@
 #pragma once
 #include "Graphics/GraphicsBufferTypes.hpp"
+#include "Graphics/RenderTasks.hpp"
+#include "VulkanFrameAllocator.hpp"
 
 struct RendererData;
 struct FrameBlock;
 struct ViewBlock;
 struct RenderTaskEvent;
-struct RenderGroupRenderTask;
 struct RenderQueue;
+struct RenderGraphPass;
+struct CommandBufferWriteInfo;
+
+constexpr uint32_t cInvalidClusterBatch = static_cast<uint32_t>(-1);
+
+/// A run of neighboring visible clusters of one instance, from culling clusters on the cpu.
+struct ClusterDraw
+{
+  uint32_t mFirstIndex;
+  uint32_t mIndexCount;
+  uint32_t mInstance;
+};
+
+/// A batch of a clustered mesh at full detail. It's culled and drawn per cluster instead of whole.
+struct ClusterBatch
+{
+  uint32_t mBatchIndex = 0;
+  // Gpu culled batches have one indirect draw per instance and cluster in mDrawCommands,
+  // cpu culled ones have a range of RenderGroupBatches::mClusterDraws
+  bool mCullOnGpu = false;
+  uint32_t mFirstDraw = 0;
+  uint32_t mDrawCount = 0;
+  VulkanFrameAllocation mDrawCommands;
+};
+
+struct RenderGroupBatches
+{
+  Array<InstanceBatch> mBatches;
+  Array<uint32_t> mInstanceOrder;
+  // Where PopulateTransformBuffers wrote the group's transform block and instance stream
+  VulkanFrameAllocation mTransforms;
+  VulkanFrameAllocation mInstances;
+  // Only used when the group is culled on the gpu. The culling dispatch fills out the
+  // instance stream and each batch's indirect draw from the cull objects.
+  bool mCullOnGpu = false;
+  VulkanFrameAllocation mCullObjects;
+  VulkanFrameAllocation mDrawCommands;
+  // Less than the instance count when clustered batches write their instances directly
+  uint32_t mCullObjectCount = 0;
+
+  // Index into mClusterBatches for every batch, cInvalidClusterBatch for batches drawn whole
+  Array<uint32_t> mBatchClusters;
+  Array<ClusterBatch> mClusterBatches;
+  Array<ClusterDraw> mClusterDraws;
+};
 
 struct GlobalBufferOffset
 {
@@ -15,7 +61,23 @@ struct GlobalBufferOffset
 };
 
 void PopulateGlobalBuffers(RendererData& rendererData, const RenderQueue& renderQueue, GlobalBufferOffset& offsets);
-void PopulateTransformBuffers(RendererData& rendererData, const ViewBlock& viewBlock, const RenderGroupRenderTask& renderGroupTask);
-void DrawModels(RendererData& rendererData, const ViewBlock& viewBlock, const RenderGroupRenderTask& renderGroupTask);
+void PopulateTransformBuffers(RendererData& rendererData, const ViewBlock& viewBlock, const RenderGroupRenderTask& renderGroupTask, RenderGroupBatches& batches);
+/// Writes the cull objects and zeroed indirect draws the culling dispatch reads and fills out.
+void PopulateGpuCullingBuffers(RendererData& rendererData, const RenderGroupRenderTask& renderGroupTask, RenderGroupBatches& batches);
+/// Picks the batches drawn per cluster. Has to run before the instance stream is written.
+void FindClusterBatches(RendererData& rendererData, const RenderGroupRenderTask& renderGroupTask, RenderGroupBatches& batches);
+/// Culls the clustered batches that stay on the cpu and allocates the indirect draws of the ones culled on the gpu.
+void PopulateClusterBatches(RendererData& rendererData, const ViewBlock& viewBlock, const RenderGroupRenderTask& renderGroupTask, RenderGroupBatches& batches);
+/// Appends the batch's visible clusters to mClusterDraws, merging neighboring ones of the same instance.
+void CullClusterBatchOnCpu(const ViewBlock& viewBlock, const RenderGroupRenderTask& renderGroupTask, RenderGroupBatches& batches, ClusterBatch& clusterBatch);
+/// Fills out the instance stream and indirect draws of a gpu culled group on the cpu instead.
+void CullInstancesOnCpu(const ViewBlock& viewBlock, const RenderGroupBatches& batches);
+/// Records the culling dispatches of a group's gpu culled instances and clusters. Has to happen before the group's render pass begins.
+/// Batches whose dispatch can't be recorded fall back to being culled on the cpu.
+void RecordRenderGroupCulling(RendererData& rendererData, const ViewBlock& viewBlock, const RenderGroupRenderTask& renderGroupTask, RenderGroupBatches& batches, VkCommandBuffer commandBuffer);
+/// Records one render group inside the pass described by passWriteInfo.
+void DrawModels(RendererData& rendererData, const CommandBufferWriteInfo& passWriteInfo, const RenderGroupBatches& batches);
+/// Begins the compiled pass's render pass and draws every group in it.
+void DrawPass(RendererData& rendererData, const RenderGraphPass& pass, const Array<RenderGroupBatches>& passBatches);
 
 void ProcessRenderQueue(RendererData& rendererData, const RenderQueue& renderQueue);
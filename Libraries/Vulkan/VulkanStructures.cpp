@@ -1,12 +1,27 @@
 #include "Precompiled.hpp"
 
 #include "Graphics/Vertex.hpp"
+#include "Graphics/GraphicsBufferTypes.hpp"
 
 #include <vulkan/vulkan.h>
 #include "VulkanStructures.hpp"
 #include "VulkanBufferCreation.hpp"
 #include "VulkanInitialization.hpp"
 
+VulkanFrameAllocation SubAllocateUniformBuffer(VulkanUniformBuffer& buffer, VkDeviceSize size, VkDeviceSize alignment)
+{
+  VulkanFrameAllocation result;
+  VkDeviceSize offset = (buffer.mUsedSize + alignment - 1) / alignment * alignment;
+  if(offset + size > buffer.mAllocatedSize)
+    return result;
+
+  buffer.mUsedSize = offset + size;
+  result.mBuffer = buffer.mBuffer;
+  result.mOffset = offset;
+  result.mData = static_cast<byte*>(buffer.mBufferAllocation.mMappedData) + offset;
+  return result;
+}
+
 VulkanUniformBufferManager::~VulkanUniformBufferManager()
 {
   Destroy();
@@ -19,7 +34,7 @@ void VulkanUniformBufferManager::Destroy()
     for(VulkanUniformBuffer& buffer : globalBuffer.mBuffersById.Values())
     {
       vkDestroyBuffer(mRuntimeData->mDevice, buffer.mBuffer, nullptr);
-      vkFreeMemory(mRuntimeData->mDevice, buffer.mBufferMemory, nullptr);
+      mRuntimeData->mAllocator.Free(buffer.mBufferAllocation);
     }
   }
   for(VulkanPerFrameBuffers& perFrameBuffer : mNamedPerFrameBuffers.Values())
@@ -29,7 +44,7 @@ void VulkanUniformBufferManager::Destroy()
       for(VulkanUniformBuffer& buffer : frameBuffers.mBuffers)
       {
         vkDestroyBuffer(mRuntimeData->mDevice, buffer.mBuffer, nullptr);
-        vkFreeMemory(mRuntimeData->mDevice, buffer.mBufferMemory, nullptr);
+        mRuntimeData->mAllocator.Free(buffer.mBufferAllocation);
       }
     }
   }
@@ -45,14 +60,14 @@ VulkanPerFrameBuffers::FrameBuffers* VulkanUniformBufferManager::CreatePerFrameB
   {
     uint32_t frameCount = mRuntimeData->mSwapChain.GetCount();
     frameBuffers.mBuffers.Resize(frameCount);
-    VulkanBufferCreationData vulkanData{mRuntimeData->mPhysicalDevice, mRuntimeData->mDevice, mRuntimeData->mGraphicsQueue, mRuntimeData->mCommandPool};
+    VulkanBufferCreationData vulkanData{mRuntimeData->mPhysicalDevice, mRuntimeData->mDevice, mRuntimeData->mGraphicsQueue, mRuntimeData->mCommandPool, &mRuntimeData->mAllocator};
     for(size_t i = 0; i < frameCount; i++)
     {
       VulkanUniformBuffer& buffer = frameBuffers.mBuffers[i];
       buffer.mAllocatedSize = 1024 * 1024;// mRuntimeData->mDeviceLimits.mMaxUniformBufferRange;
       buffer.mUsedSize = 0;
       VkImageUsageFlags usageFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-      CreateBuffer(vulkanData, buffer.mAllocatedSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, usageFlags, buffer.mBuffer, buffer.mBufferMemory);
+      CreateBuffer(vulkanData, buffer.mAllocatedSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, usageFlags, buffer.mBuffer, buffer.mBufferAllocation);
     }
   }
   return &frameBuffers;
@@ -81,6 +96,18 @@ VulkanUniformBuffer* VulkanUniformBufferManager::FindOrCreatePerFrameBuffer(cons
   return &frameBuffers->mBuffers[frameId];
 }
 
+void VulkanUniformBufferManager::ResetPerFrameBuffers(uint32_t frameId)
+{
+  for(VulkanPerFrameBuffers& perFrameBuffer : mNamedPerFrameBuffers.Values())
+  {
+    for(VulkanPerFrameBuffers::FrameBuffers& frameBuffers : perFrameBuffer.mBuffersById.Values())
+    {
+      if(frameId < frameBuffers.mBuffers.Size())
+        frameBuffers.mBuffers[frameId].mUsedSize = 0;
+    }
+  }
+}
+
 uint32_t VulkanUniformBufferManager::GlobalBufferCount(const String& name)
 {
   VulkanGlobalUniformBuffers* buffers = mNamedGlobalBuffers.FindPointer(name);
@@ -94,9 +121,9 @@ VulkanUniformBuffer* VulkanUniformBufferManager::CreateGlobalBuffer(const String
   VulkanUniformBuffer& buffer = mNamedGlobalBuffers[name].mBuffersById[bufferId];
   buffer.mAllocatedSize = mRuntimeData->mDeviceLimits.mMaxUniformBufferRange;
   buffer.mUsedSize = 0;
-  VulkanBufferCreationData vulkanData{mRuntimeData->mPhysicalDevice, mRuntimeData->mDevice, mRuntimeData->mGraphicsQueue, mRuntimeData->mCommandPool};
+  VulkanBufferCreationData vulkanData{mRuntimeData->mPhysicalDevice, mRuntimeData->mDevice, mRuntimeData->mGraphicsQueue, mRuntimeData->mCommandPool, &mRuntimeData->mAllocator};
   VkImageUsageFlags usageFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-  CreateBuffer(vulkanData, buffer.mAllocatedSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, usageFlags, buffer.mBuffer, buffer.mBufferMemory);
+  CreateBuffer(vulkanData, buffer.mAllocatedSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, usageFlags, buffer.mBuffer, buffer.mBufferAllocation);
   return &buffer;
 }
 
@@ -110,52 +137,87 @@ VulkanUniformBuffer* VulkanUniformBufferManager::FindGlobalBuffer(const String&
   return nullptr;
 }
 
-Array<VkVertexInputBindingDescription> VulkanVertex::getBindingDescription()
+namespace
+{
+
+VkFormat GetVertexAttributeVulkanFormat(VertexAttributeFormat format)
+{
+  switch(format)
+  {
+  case VertexAttributeFormat::Snorm16x4: return VK_FORMAT_R16G16B16A16_SNORM;
+  case VertexAttributeFormat::OctahedralSnorm16x2: return VK_FORMAT_R16G16_SNORM;
+  case VertexAttributeFormat::Half2: return VK_FORMAT_R16G16_SFLOAT;
+  case VertexAttributeFormat::Unorm8x4: return VK_FORMAT_R8G8B8A8_UNORM;
+  case VertexAttributeFormat::Float4: return VK_FORMAT_R32G32B32A32_SFLOAT;
+  default:
+    return VK_FORMAT_UNDEFINED;
+  }
+}
+
+}//namespace
+
+Array<VkVertexInputBindingDescription> VulkanVertex::getBindingDescription(const VertexFormat& vertexFormat)
 {
   Array<VkVertexInputBindingDescription> bindingDescriptions;
-  bindingDescriptions.Resize(1);
+  bindingDescriptions.Resize(3);
 
   bindingDescriptions[0].binding = 0;
-  bindingDescriptions[0].stride = sizeof(Vertex);
+  bindingDescriptions[0].stride = vertexFormat.mStride;
   bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
+  bindingDescriptions[1].binding = cInstanceBinding;
+  bindingDescriptions[1].stride = sizeof(InstanceData);
+  bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+  bindingDescriptions[2].binding = cDefaultAttributeBinding;
+  bindingDescriptions[2].stride = 0;
+  bindingDescriptions[2].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
   return bindingDescriptions;
 }
 
-Array<VkVertexInputAttributeDescription> VulkanVertex::getAttributeDescriptions()
+Array<VkVertexInputAttributeDescription> VulkanVertex::getAttributeDescriptions(const VertexFormat& vertexFormat, const HashMap<String, uint32_t>& inputLocations)
 {
   Array<VkVertexInputAttributeDescription> attributeDescriptions;
-  attributeDescriptions.Reserve(5);
-
-  VkVertexInputAttributeDescription& posDescription = attributeDescriptions.PushBack();
-  posDescription.binding = 0;
-  posDescription.location = static_cast<uint32_t>(attributeDescriptions.Size() - 1);
-  posDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
-  posDescription.offset = offsetof(Vertex, pos);
-
-  VkVertexInputAttributeDescription& normalDescription = attributeDescriptions.PushBack();
-  normalDescription.binding = 0;
-  normalDescription.location = static_cast<uint32_t>(attributeDescriptions.Size() - 1);
-  normalDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
-  normalDescription.offset = offsetof(Vertex, normal);
-
-  VkVertexInputAttributeDescription& colorDescription = attributeDescriptions.PushBack();
-  colorDescription.binding = 0;
-  colorDescription.location = static_cast<uint32_t>(attributeDescriptions.Size() - 1);
-  colorDescription.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-  colorDescription.offset = offsetof(Vertex, color);
-
-  VkVertexInputAttributeDescription& uvDescription = attributeDescriptions.PushBack();
-  uvDescription.binding = 0;
-  uvDescription.location = static_cast<uint32_t>(attributeDescriptions.Size() - 1);
-  uvDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
-  uvDescription.offset = offsetof(Vertex, uv);
-
-  VkVertexInputAttributeDescription& aux0Description = attributeDescriptions.PushBack();
-  aux0Description.binding = 0;
-  aux0Description.location = static_cast<uint32_t>(attributeDescriptions.Size() - 1);
-  aux0Description.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-  aux0Description.offset = offsetof(Vertex, aux0);
+  attributeDescriptions.Reserve(cVertexAttributeCount + cInstanceRowCount);
+
+  // The shader's vertex definitions declare every attribute, so the ones this mesh is
+  // missing still need an input. They read the zeroed default buffer instead.
+  for(size_t i = 0; i < cVertexAttributeCount; ++i)
+  {
+    VertexAttribute attribute = static_cast<VertexAttribute>(i);
+    const uint32_t* location = inputLocations.FindPointer(GetVertexAttributeName(attribute));
+    if(location == nullptr)
+      continue;
+
+    VkVertexInputAttributeDescription& description = attributeDescriptions.PushBack();
+    description.location = *location;
+    description.format = GetVertexAttributeVulkanFormat(GetVertexAttributeFormat(attribute));
+    if(vertexFormat.Has(attribute))
+    {
+      description.binding = 0;
+      description.offset = vertexFormat.mOffsets[i];
+    }
+    else
+    {
+      description.binding = cDefaultAttributeBinding;
+      description.offset = 0;
+    }
+  }
+
+  // One vec4 per row of the instance's 3x4 local to world
+  for(uint32_t i = 0; i < cInstanceRowCount; ++i)
+  {
+    const uint32_t* location = inputLocations.FindPointer(GetInstanceRowName(i));
+    if(location == nullptr)
+      continue;
+
+    VkVertexInputAttributeDescription& instanceDescription = attributeDescriptions.PushBack();
+    instanceDescription.binding = cInstanceBinding;
+    instanceDescription.location = *location;
+    instanceDescription.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    instanceDescription.offset = i * sizeof(Vec4);
+  }
 
   return attributeDescriptions;
 }
@@ -1,8 +1,14 @@
 #pragma once
 
 #include "VulkanStandard.hpp"
+#include "VulkanMemoryAllocator.hpp"
+#include "VulkanFrameAllocator.hpp"
+#include "VulkanDescriptors.hpp"
+#include "Graphics/VertexFormat.hpp"
 
 struct VulkanRuntimeData;
+struct ZilchShader;
+struct ZilchMaterial;
 class VulkanRenderer;
 
 struct RendererData
@@ -14,11 +20,18 @@ struct RendererData
 struct VulkanMesh
 {
   VkBuffer mVertexBuffer;
-  VkDeviceMemory mVertexBufferMemory;
+  VulkanMemoryAllocation mVertexBufferAllocation;
 
   VkBuffer mIndexBuffer;
-  VkDeviceMemory mIndexBufferMemory;
+  VulkanMemoryAllocation mIndexBufferAllocation;
   uint32_t mIndexCount;
+  // Picks the shader's pipeline, see VulkanShaderMaterial::mPipelines
+  VertexFormat mVertexFormat;
+
+  // GpuMeshClusters read by the cluster culling shader. Only created for meshes that have clusters.
+  VkBuffer mClusterBuffer = VK_NULL_HANDLE;
+  VulkanMemoryAllocation mClusterBufferAllocation;
+  uint32_t mClusterCount = 0;
 };
 
 struct VulkanShader
@@ -27,6 +40,8 @@ struct VulkanShader
   VkShaderModule mPixelShaderModule;
   String mVertexEntryPointName;
   String mPixelEntryPointName;
+  // See ZilchShader::mVertexInputLocations
+  HashMap<String, uint32_t> mVertexInputLocations;
 };
 
 //struct VulkanMaterial
@@ -48,11 +63,17 @@ struct VulkanShader
 
 struct VulkanShaderMaterial
 {
+  // Shared through the layout cache, not owned by the material
   VkDescriptorSetLayout mDescriptorSetLayout;
+  VkDescriptorUpdateTemplate mUpdateTemplate;
   VkPipelineLayout mPipelineLayout;
   Array<VkDescriptorSet> mDescriptorSets;
   
-  VkPipeline mPipeline;
+  // One pipeline per mesh vertex format, keyed by VertexFormat::mAttributes
+  HashMap<uint32_t, VkPipeline> mPipelines;
+  // Material the descriptor sets were last written from
+  const ZilchMaterial* mZilchMaterial = nullptr;
+  // Pool mDescriptorSets were allocated from in the global descriptor allocator
   VkDescriptorPool mDescriptorPool;
   
   uint32_t mBufferId = 0;
@@ -62,11 +83,16 @@ struct VulkanShaderMaterial
 struct VulkanUniformBuffer
 {
   VkBuffer mBuffer;
-  VkDeviceMemory mBufferMemory;
+  // Uniform buffers are host visible so this is always mapped
+  VulkanMemoryAllocation mBufferAllocation;
   VkDeviceSize mUsedSize = 0;
   VkDeviceSize mAllocatedSize = 0;
 };
 
+/// Bump allocates from the buffer. The buffer can't be chained since descriptor sets point at it,
+/// so this returns an empty allocation when it's full.
+VulkanFrameAllocation SubAllocateUniformBuffer(VulkanUniformBuffer& buffer, VkDeviceSize size, VkDeviceSize alignment);
+
 struct VulkanGlobalUniformBuffers
 {
   HashMap<uint32_t, VulkanUniformBuffer> mBuffersById;
@@ -89,6 +115,8 @@ struct VulkanUniformBufferManager
   VulkanPerFrameBuffers::FrameBuffers* CreatePerFrameBuffer(const String& name, uint32_t bufferId);
   VulkanUniformBuffer* FindPerFrameBuffer(const String& name, uint32_t bufferId, uint32_t frameId);
   VulkanUniformBuffer* FindOrCreatePerFrameBuffer(const String& name, uint32_t bufferId, uint32_t frameId);
+  /// Rewinds every per-frame buffer of the frame so it can be sub-allocated from the start again.
+  void ResetPerFrameBuffers(uint32_t frameId);
 
   uint32_t GlobalBufferCount(const String& name);
   VulkanUniformBuffer* CreateGlobalBuffer(const String& name, uint32_t bufferId);
@@ -102,16 +130,50 @@ struct VulkanUniformBufferManager
 
 struct VulkanVertex
 {
-  static Array<VkVertexInputBindingDescription> getBindingDescription();
-  static Array<VkVertexInputAttributeDescription> getAttributeDescriptions();
+  // Per-instance data (InstanceData) is streamed from this binding
+  static constexpr uint32_t cInstanceBinding = 1;
+  // Attributes the mesh doesn't have read zero from a buffer bound here with a stride of 0
+  static constexpr uint32_t cDefaultAttributeBinding = 2;
+  static constexpr VkDeviceSize cDefaultAttributeSize = 16;
+
+  static Array<VkVertexInputBindingDescription> getBindingDescription(const VertexFormat& vertexFormat);
+  /// Locations come from the shader's vertex definitions by field name. Inputs the shader doesn't declare are left out.
+  static Array<VkVertexInputAttributeDescription> getAttributeDescriptions(const VertexFormat& vertexFormat, const HashMap<String, uint32_t>& inputLocations);
 };
 
 struct VulkanImage
 {
   VkImage mImage = VK_NULL_HANDLE;
-  VkDeviceMemory mImageMemory = VK_NULL_HANDLE;
+  VulkanMemoryAllocation mImageAllocation;
   VkImageView mImageView = VK_NULL_HANDLE;
   VkSampler mSampler = VK_NULL_HANDLE;
+  // Texture level the image's first level holds. Streamed textures leave out their largest levels.
+  uint32_t mFirstMip = 0;
+};
+
+// A streamed texture's new image waiting on its upload. Swapped into mImage at the start of a frame.
+struct VulkanTextureResidencySwap
+{
+  VulkanImage* mImage = nullptr;
+  VulkanImage mReplacement;
+};
+
+// Secondary command buffers recorded by one thread for one frame. The pool is reset once the frame's
+// previous submit has finished and buffers are handed back out in order.
+struct VulkanThreadCommandPool
+{
+  VkCommandPool mCommandPool = VK_NULL_HANDLE;
+  Array<VkCommandBuffer> mSecondaryCommandBuffers;
+  size_t mUsedCount = 0;
+};
+
+// Backing image for one of the render graph's physical transient targets
+struct VulkanTransientTarget
+{
+  VkImage mImage = VK_NULL_HANDLE;
+  VulkanMemoryAllocation mImageAllocation;
+  VkImageView mImageView = VK_NULL_HANDLE;
+  VkFramebuffer mFrameBuffer = VK_NULL_HANDLE;
 };
 
 class VulkanRenderer;
@@ -120,9 +182,19 @@ struct VulkanRenderFrame
   VulkanRenderer* mRenderer;
   VkImage mSwapChainImage;
   VkImageView mSwapChainImageView;
-  VkRenderPass mRenderPass;
   VkFramebuffer mFrameBuffer;
   VkCommandBuffer mCommandBuffer;
+  // Indexed by ThreadPool thread index
+  Array<VulkanThreadCommandPool> mThreadCommandPools;
+  // Per instance data streamed for this frame. Reset when the frame is recorded again.
+  VulkanFrameAllocator mFrameAllocator;
+  // Transient descriptor sets, such as the culling dispatches'. Reset when the frame is recorded again.
+  VulkanDescriptorAllocator mDescriptorAllocator;
+  // Indexed by physical target - 1 since physical target 0 is the swap chain image. Grown on demand.
+  Array<VulkanTransientTarget> mTransientTargets;
+  // Materials whose descriptor set for this image still samples a swapped out texture.
+  // Rewritten once the frame that last used this image has finished.
+  Array<const ZilchShader*> mStaleMaterials;
 
   VkDescriptorSet mDescriptorSet;
 };
@@ -0,0 +1,468 @@
+#include "Precompiled.hpp"
+
+#include "VulkanUploader.hpp"
+
+#include "VulkanBufferCreation.hpp"
+
+//-------------------------------------------------------------------VulkanUploader
+VulkanUploader::VulkanUploader()
+{
+}
+
+VulkanUploader::~VulkanUploader()
+{
+  Destroy();
+}
+
+VulkanStatus VulkanUploader::Initialize(VkDevice device, const VulkanUploaderQueues& queues, VulkanMemoryAllocator& allocator, VkDeviceSize ringSize)
+{
+  VulkanStatus result;
+  mDevice = device;
+  mQueues = queues;
+  mUseTransferQueue = queues.mTransferFamily != queues.mGraphicsFamily;
+  mAllocator = &allocator;
+  mRingSize = ringSize;
+  mRingHead = mRingTail = 0;
+
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = mQueues.mTransferFamily;
+  if(vkCreateCommandPool(mDevice, &poolInfo, nullptr, &mTransferPool.mPool) != VK_SUCCESS)
+  {
+    result.MarkFailed("failed to create upload command pool!");
+    return result;
+  }
+  if(mUseTransferQueue)
+  {
+    poolInfo.queueFamilyIndex = mQueues.mGraphicsFamily;
+    if(vkCreateCommandPool(mDevice, &poolInfo, nullptr, &mGraphicsPool.mPool) != VK_SUCCESS)
+    {
+      result.MarkFailed("failed to create upload command pool!");
+      return result;
+    }
+  }
+
+  return TryCreateBuffer(allocator, mDevice, mRingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, mRingBuffer, mRingAllocation);
+}
+
+void VulkanUploader::Destroy()
+{
+  if(mDevice == VK_NULL_HANDLE)
+    return;
+
+  Flush();
+  WaitForIdle();
+
+  for(VkFence fence : mFreeFences)
+    vkDestroyFence(mDevice, fence, nullptr);
+  mFreeFences.Clear();
+  for(VkSemaphore semaphore : mFreeSemaphores)
+    vkDestroySemaphore(mDevice, semaphore, nullptr);
+  mFreeSemaphores.Clear();
+
+  for(CommandPool* pool : {&mTransferPool, &mGraphicsPool})
+  {
+    if(pool->mPool == VK_NULL_HANDLE)
+      continue;
+    // Destroying the pool frees its command buffers
+    vkDestroyCommandPool(mDevice, pool->mPool, nullptr);
+    pool->mPool = VK_NULL_HANDLE;
+    pool->mFreeCommandBuffers.Clear();
+  }
+
+  vkDestroyBuffer(mDevice, mRingBuffer, nullptr);
+  mAllocator->Free(mRingAllocation);
+  mRingBuffer = VK_NULL_HANDLE;
+  mDevice = VK_NULL_HANDLE;
+}
+
+void VulkanUploader::BeginBatch()
+{
+  ++mBatchDepth;
+}
+
+VulkanStatus VulkanUploader::EndBatch()
+{
+  ErrorIf(mBatchDepth == 0, "Unbalanced upload batch");
+  --mBatchDepth;
+  if(mBatchDepth != 0)
+    return VulkanStatus();
+
+  VulkanStatus result = Flush();
+  if(!mBatchStatus)
+    result = mBatchStatus;
+  mBatchStatus = VulkanStatus();
+  return result;
+}
+
+VulkanStatus VulkanUploader::Flush()
+{
+  VulkanStatus result;
+  if(!mRecording)
+    return result;
+
+  // Make the uploaded data visible to everything submitted after this batch on the graphics queue
+  VkCommandBuffer lastCommandBuffer = GetGraphicsCommandBuffer();
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(lastCommandBuffer,
+    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+    1, &barrier,
+    0, nullptr,
+    0, nullptr);
+
+  if(!mFreeFences.Empty())
+  {
+    mCurrentBatch.mFence = mFreeFences.Back();
+    mFreeFences.PopBack();
+  }
+  else
+  {
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    vkCreateFence(mDevice, &fenceInfo, nullptr, &mCurrentBatch.mFence);
+  }
+
+  vkEndCommandBuffer(mCurrentBatch.mCommandBuffer);
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &mCurrentBatch.mCommandBuffer;
+
+  if(!mUseTransferQueue)
+  {
+    if(vkQueueSubmit(mQueues.mGraphicsQueue, 1, &submitInfo, mCurrentBatch.mFence) != VK_SUCCESS)
+      result.MarkFailed("failed to submit upload batch!");
+  }
+  else
+  {
+    if(!mFreeSemaphores.Empty())
+    {
+      mCurrentBatch.mSemaphore = mFreeSemaphores.Back();
+      mFreeSemaphores.PopBack();
+    }
+    else
+    {
+      VkSemaphoreCreateInfo semaphoreInfo = {};
+      semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mCurrentBatch.mSemaphore);
+    }
+
+    // Copies on the transfer queue, then the acquires (and any graphics only work) once they're done.
+    // Later frames are submitted to the graphics queue after this so they always see the finished resources.
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &mCurrentBatch.mSemaphore;
+    if(vkQueueSubmit(mQueues.mTransferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+      result.MarkFailed("failed to submit upload batch!");
+
+    vkEndCommandBuffer(mCurrentBatch.mGraphicsCommandBuffer);
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo graphicsSubmitInfo = {};
+    graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    graphicsSubmitInfo.waitSemaphoreCount = 1;
+    graphicsSubmitInfo.pWaitSemaphores = &mCurrentBatch.mSemaphore;
+    graphicsSubmitInfo.pWaitDstStageMask = &waitStage;
+    graphicsSubmitInfo.commandBufferCount = 1;
+    graphicsSubmitInfo.pCommandBuffers = &mCurrentBatch.mGraphicsCommandBuffer;
+    // The acquires would wait forever on a semaphore that's never signaled
+    if(result && vkQueueSubmit(mQueues.mGraphicsQueue, 1, &graphicsSubmitInfo, mCurrentBatch.mFence) != VK_SUCCESS)
+      result.MarkFailed("failed to submit upload acquire batch!");
+  }
+
+  // A batch that wasn't submitted never signals its fence, so it can't wait in the pending list
+  if(result)
+  {
+    mCurrentBatch.mRingEnd = mRingHead;
+    mPendingBatches.PushBack(mCurrentBatch);
+  }
+  else
+  {
+    DiscardBatch(mCurrentBatch);
+    if(mBatchStatus)
+      mBatchStatus = result;
+  }
+  mCurrentBatch = Batch();
+  mRecording = false;
+  return result;
+}
+
+VkCommandBuffer VulkanUploader::GetCommandBuffer()
+{
+  if(!mRecording)
+    BeginRecording();
+  return mCurrentBatch.mCommandBuffer;
+}
+
+VkCommandBuffer VulkanUploader::GetGraphicsCommandBuffer()
+{
+  if(!mRecording)
+    BeginRecording();
+  if(!mUseTransferQueue)
+    return mCurrentBatch.mCommandBuffer;
+  return mCurrentBatch.mGraphicsCommandBuffer;
+}
+
+VulkanStagingRange VulkanUploader::Stage(const void* data, VkDeviceSize size, VkDeviceSize alignment)
+{
+  // Make sure there's an open batch first, the staged range belongs to it
+  GetCommandBuffer();
+
+  VulkanStagingRange range;
+  if(size > mRingSize)
+  {
+    // Too big to ever fit in the ring, give it its own buffer that lives as long as the batch
+    TemporaryBuffer& temporary = mCurrentBatch.mTemporaryBuffers.PushBack();
+    CreateBuffer(*mAllocator, mDevice, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, temporary.mBuffer, temporary.mAllocation);
+    range.mBuffer = temporary.mBuffer;
+    range.mOffset = 0;
+    range.mMappedData = temporary.mAllocation.mMappedData;
+  }
+  else
+  {
+    VkDeviceSize offset;
+    while(!TryAllocateRing(size, alignment, offset))
+    {
+      RetireCompletedBatches();
+      if(TryAllocateRing(size, alignment, offset))
+        break;
+
+      // The ring is full of work that hasn't been submitted or hasn't finished yet
+      if(mFirstPendingBatch == mPendingBatches.Size())
+      {
+        VulkanStatus flushStatus = Flush();
+        GetCommandBuffer();
+        // A dropped batch gave its staging back, there's nothing to wait on
+        if(!flushStatus)
+          continue;
+      }
+      RetireOldestBatch(true);
+    }
+    range.mBuffer = mRingBuffer;
+    range.mOffset = offset;
+    range.mMappedData = static_cast<byte*>(mRingAllocation.mMappedData) + offset;
+  }
+
+  if(data != nullptr)
+    memcpy(range.mMappedData, data, static_cast<size_t>(size));
+  return range;
+}
+
+void VulkanUploader::UploadToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+  VulkanStagingRange range = Stage(data, size);
+
+  VkBufferCopy copyRegion = {};
+  copyRegion.srcOffset = range.mOffset;
+  copyRegion.dstOffset = dstOffset;
+  copyRegion.size = size;
+  vkCmdCopyBuffer(GetCommandBuffer(), range.mBuffer, dstBuffer, 1, &copyRegion);
+
+  VkAccessFlags dstAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+  VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  TransferBufferOwnership(dstBuffer, dstOffset, size, dstAccess, dstStage);
+}
+
+void VulkanUploader::TransferBufferOwnership(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage)
+{
+  if(!mUseTransferQueue)
+    return;
+
+  // The release and acquire barriers have to describe the exact same transfer
+  VkBufferMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcQueueFamilyIndex = mQueues.mTransferFamily;
+  barrier.dstQueueFamilyIndex = mQueues.mGraphicsFamily;
+  barrier.buffer = buffer;
+  barrier.offset = offset;
+  barrier.size = size;
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = 0;
+  vkCmdPipelineBarrier(GetCommandBuffer(),
+    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+    0, nullptr,
+    1, &barrier,
+    0, nullptr);
+
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = dstAccess;
+  vkCmdPipelineBarrier(GetGraphicsCommandBuffer(),
+    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0,
+    0, nullptr,
+    1, &barrier,
+    0, nullptr);
+}
+
+void VulkanUploader::TransferImageOwnership(VkImage image, VkImageLayout layout, VkImageAspectFlags aspect, uint32_t mipLevels, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage)
+{
+  if(!mUseTransferQueue)
+    return;
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = layout;
+  barrier.newLayout = layout;
+  barrier.srcQueueFamilyIndex = mQueues.mTransferFamily;
+  barrier.dstQueueFamilyIndex = mQueues.mGraphicsFamily;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = aspect;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = mipLevels;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = 0;
+  vkCmdPipelineBarrier(GetCommandBuffer(),
+    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+    0, nullptr,
+    0, nullptr,
+    1, &barrier);
+
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = dstAccess;
+  vkCmdPipelineBarrier(GetGraphicsCommandBuffer(),
+    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0,
+    0, nullptr,
+    0, nullptr,
+    1, &barrier);
+}
+
+void VulkanUploader::RetireCompletedBatches()
+{
+  while(mFirstPendingBatch < mPendingBatches.Size())
+  {
+    if(vkGetFenceStatus(mDevice, mPendingBatches[mFirstPendingBatch].mFence) != VK_SUCCESS)
+      break;
+    RetireOldestBatch(false);
+  }
+}
+
+void VulkanUploader::WaitForIdle()
+{
+  while(mFirstPendingBatch < mPendingBatches.Size())
+    RetireOldestBatch(true);
+}
+
+bool VulkanUploader::HasPendingUploads() const
+{
+  return mFirstPendingBatch < mPendingBatches.Size();
+}
+
+void VulkanUploader::BeginRecording()
+{
+  mCurrentBatch.mCommandBuffer = BeginCommandBuffer(mTransferPool);
+  if(mUseTransferQueue)
+    mCurrentBatch.mGraphicsCommandBuffer = BeginCommandBuffer(mGraphicsPool);
+  mRecording = true;
+}
+
+VkCommandBuffer VulkanUploader::BeginCommandBuffer(CommandPool& pool)
+{
+  VkCommandBuffer commandBuffer;
+  if(!pool.mFreeCommandBuffers.Empty())
+  {
+    commandBuffer = pool.mFreeCommandBuffers.Back();
+    pool.mFreeCommandBuffers.PopBack();
+  }
+  else
+  {
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = pool.mPool;
+    allocInfo.commandBufferCount = 1;
+    vkAllocateCommandBuffers(mDevice, &allocInfo, &commandBuffer);
+  }
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(commandBuffer, &beginInfo);
+  return commandBuffer;
+}
+
+bool VulkanUploader::TryAllocateRing(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset)
+{
+  // Nothing staged or in flight, start over at the front so a large request doesn't have to wrap
+  if(mRingHead == mRingTail && mFirstPendingBatch == mPendingBatches.Size())
+    mRingHead = mRingTail = 0;
+
+  VkDeviceSize position = (mRingHead + alignment - 1) & ~(alignment - 1);
+  VkDeviceSize ringOffset = position % mRingSize;
+  // Allocations never straddle the end of the ring, skip to the start instead
+  if(ringOffset + size > mRingSize)
+  {
+    position += mRingSize - ringOffset;
+    ringOffset = 0;
+  }
+  if(position + size - mRingTail > mRingSize)
+    return false;
+
+  mRingHead = position + size;
+  outOffset = ringOffset;
+  return true;
+}
+
+void VulkanUploader::RetireOldestBatch(bool wait)
+{
+  Batch& batch = mPendingBatches[mFirstPendingBatch];
+  if(wait)
+    vkWaitForFences(mDevice, 1, &batch.mFence, VK_TRUE, UINT64_MAX);
+
+  mRingTail = batch.mRingEnd;
+  ReleaseBatch(batch);
+
+  ++mFirstPendingBatch;
+  if(mFirstPendingBatch == mPendingBatches.Size())
+  {
+    mPendingBatches.Clear();
+    mFirstPendingBatch = 0;
+  }
+}
+
+void VulkanUploader::ReleaseBatch(Batch& batch)
+{
+  for(TemporaryBuffer& temporary : batch.mTemporaryBuffers)
+  {
+    vkDestroyBuffer(mDevice, temporary.mBuffer, nullptr);
+    mAllocator->Free(temporary.mAllocation);
+  }
+  batch.mTemporaryBuffers.Clear();
+
+  vkResetFences(mDevice, 1, &batch.mFence);
+  mFreeFences.PushBack(batch.mFence);
+  // The graphics submit waited on the semaphore so it's unsignaled again by the time the fence is
+  if(batch.mSemaphore != VK_NULL_HANDLE)
+    mFreeSemaphores.PushBack(batch.mSemaphore);
+
+  vkResetCommandBuffer(batch.mCommandBuffer, 0);
+  mTransferPool.mFreeCommandBuffers.PushBack(batch.mCommandBuffer);
+  if(batch.mGraphicsCommandBuffer != VK_NULL_HANDLE)
+  {
+    vkResetCommandBuffer(batch.mGraphicsCommandBuffer, 0);
+    mGraphicsPool.mFreeCommandBuffers.PushBack(batch.mGraphicsCommandBuffer);
+  }
+}
+
+void VulkanUploader::DiscardBatch(Batch& batch)
+{
+  // The copies may have been submitted to the transfer queue even though the acquires weren't
+  if(batch.mSemaphore != VK_NULL_HANDLE)
+  {
+    vkQueueWaitIdle(mQueues.mTransferQueue);
+    // Possibly left signaled with nothing to wait on it, so it can't be reused
+    vkDestroySemaphore(mDevice, batch.mSemaphore, nullptr);
+    batch.mSemaphore = VK_NULL_HANDLE;
+  }
+
+  // The staging range is handed to the batch before it, or freed outright if nothing is in flight
+  if(mFirstPendingBatch < mPendingBatches.Size())
+    mPendingBatches.Back().mRingEnd = mRingHead;
+  else
+    mRingTail = mRingHead;
+  ReleaseBatch(batch);
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "VulkanStandard.hpp"
+#include "VulkanStatus.hpp"
+#include "VulkanMemoryAllocator.hpp"
+
+/// Where staged data ended up. Copy commands should read from mBuffer at mOffset.
+struct VulkanStagingRange
+{
+  VkBuffer mBuffer = VK_NULL_HANDLE;
+  VkDeviceSize mOffset = 0;
+  void* mMappedData = nullptr;
+};
+
+struct VulkanUploaderQueues
+{
+  VkQueue mGraphicsQueue = VK_NULL_HANDLE;
+  uint32_t mGraphicsFamily = 0;
+  // May be the same queue/family as graphics
+  VkQueue mTransferQueue = VK_NULL_HANDLE;
+  uint32_t mTransferFamily = 0;
+};
+
+//-------------------------------------------------------------------VulkanUploader
+/// Records resource uploads (staging copies, layout transitions, mip generation) into a single
+/// command buffer per batch. Staging data is written into a persistently mapped ring buffer and a
+/// batch's part of the ring is only reused once the fence of its submit has signaled, so nothing
+/// ever waits on the queue to go idle.
+///
+/// When the device has a dedicated transfer family the copies run on that queue. Each uploaded
+/// resource is released from the transfer family and acquired by the graphics family in a small
+/// graphics command buffer that waits on a semaphore signaled by the transfer submit. Work that
+/// needs the graphics queue (mip blits) is recorded into that graphics command buffer.
+class VulkanUploader
+{
+public:
+  VulkanUploader();
+  ~VulkanUploader();
+
+  VulkanStatus Initialize(VkDevice device, const VulkanUploaderQueues& queues, VulkanMemoryAllocator& allocator, VkDeviceSize ringSize = cDefaultRingSize);
+  void Destroy();
+
+  /// Batches nest. Commands recorded between the outermost Begin/End are submitted together.
+  /// Recording outside of a batch opens one that is submitted on the next EndBatch/Flush.
+  void BeginBatch();
+  /// Fails if any submit since the outermost BeginBatch failed, including ones made early because the ring was full.
+  VulkanStatus EndBatch();
+  bool IsBatching() const { return mBatchDepth != 0; }
+  /// Submits whatever has been recorded so far. If the submit fails the batch is dropped, none of its uploads happen.
+  VulkanStatus Flush();
+
+  bool UsesTransferQueue() const { return mUseTransferQueue; }
+
+  /// The command buffer to record copies into (runs on the transfer queue if there is one).
+  VkCommandBuffer GetCommandBuffer();
+  /// The command buffer for upload work that needs the graphics queue. Recorded after the ownership
+  /// acquires, so anything transferred with Transfer*Ownership is usable here.
+  VkCommandBuffer GetGraphicsCommandBuffer();
+
+  /// Copies the data into staging memory that stays alive until the current batch completes on the gpu.
+  VulkanStagingRange Stage(const void* data, VkDeviceSize size, VkDeviceSize alignment = 16);
+  /// Stages the data, records a copy into the given buffer, and hands the range to the graphics queue.
+  void UploadToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+  /// Moves ownership of a resource written on the transfer queue to the graphics queue.
+  /// Does nothing when both are the same family.
+  void TransferBufferOwnership(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+  void TransferImageOwnership(VkImage image, VkImageLayout layout, VkImageAspectFlags aspect, uint32_t mipLevels, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+
+  /// Releases the staging memory of any batch the gpu has finished.
+  void RetireCompletedBatches();
+  /// Blocks until every submitted batch has finished.
+  void WaitForIdle();
+  /// True while a submitted batch hasn't finished on the gpu yet.
+  bool HasPendingUploads() const;
+
+  static constexpr VkDeviceSize cDefaultRingSize = 32 * 1024 * 1024;
+
+private:
+  struct TemporaryBuffer
+  {
+    VkBuffer mBuffer;
+    VulkanMemoryAllocation mAllocation;
+  };
+  struct Batch
+  {
+    VkCommandBuffer mCommandBuffer = VK_NULL_HANDLE;
+    // Only used with a dedicated transfer queue
+    VkCommandBuffer mGraphicsCommandBuffer = VK_NULL_HANDLE;
+    VkSemaphore mSemaphore = VK_NULL_HANDLE;
+    VkFence mFence = VK_NULL_HANDLE;
+    // Ring position one past the last byte staged by this batch
+    VkDeviceSize mRingEnd = 0;
+    // Staging for requests that don't fit in the ring at all
+    Array<TemporaryBuffer> mTemporaryBuffers;
+  };
+  struct CommandPool
+  {
+    VkCommandPool mPool = VK_NULL_HANDLE;
+    Array<VkCommandBuffer> mFreeCommandBuffers;
+  };
+
+  void BeginRecording();
+  VkCommandBuffer BeginCommandBuffer(CommandPool& pool);
+  bool TryAllocateRing(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset);
+  void RetireOldestBatch(bool wait);
+  void ReleaseBatch(Batch& batch);
+  void DiscardBatch(Batch& batch);
+
+  VkDevice mDevice = VK_NULL_HANDLE;
+  VulkanUploaderQueues mQueues;
+  bool mUseTransferQueue = false;
+  CommandPool mTransferPool;
+  CommandPool mGraphicsPool;
+  VulkanMemoryAllocator* mAllocator = nullptr;
+
+  VkBuffer mRingBuffer = VK_NULL_HANDLE;
+  VulkanMemoryAllocation mRingAllocation;
+  VkDeviceSize mRingSize = 0;
+  // Monotonic positions, the ring offset is position % mRingSize
+  VkDeviceSize mRingHead = 0;
+  VkDeviceSize mRingTail = 0;
+
+  size_t mBatchDepth = 0;
+  // The first failed submit since the outermost batch began
+  VulkanStatus mBatchStatus;
+  bool mRecording = false;
+  Batch mCurrentBatch;
+  // Submitted batches, oldest first. Batches complete in order so retired ones are only
+  // skipped over and the array is cleared once they're all done.
+  Array<Batch> mPendingBatches;
+  size_t mFirstPendingBatch = 0;
+  Array<VkFence> mFreeFences;
+  Array<VkSemaphore> mFreeSemaphores;
+};